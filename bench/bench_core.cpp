@@ -0,0 +1,631 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+// Micro-benchmarks for the hot paths in core/.
+//
+// Every benchmark reports ns/op, heap bytes/op and heap allocations/op. The
+// allocation numbers come from replacing the global operator new/delete in
+// this binary, so they count every allocation the measured code makes,
+// including the ones hidden inside std::string and std::map.
+//
+// Usage:
+//   bench_core [--filter <substring>] [--json <file>] [--compare <file>]
+//              [--threshold <percent>]
+//
+// --json saves the results so two commits can be compared;
+// --compare loads such a file and flags every benchmark whose ns/op or
+// allocations/op got worse by more than the threshold (default 10%). The
+// exit code is 1 when anything regressed, so it can gate a CI job.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../core/compression.hpp"
+#include "../core/http.hpp"
+#include "../core/json.hpp"
+#include "../core/loopback.hpp"
+#include "../core/metrics.hpp"
+#include "../core/multipart.hpp"
+#include "../core/request_body.hpp"
+#include "../core/sse.hpp"
+#include "../core/string_utils.hpp"
+
+/////////////////////////////////
+// Allocation counting
+/////////////////////////////////
+
+static size_t allocation_count = 0;
+static size_t allocation_bytes = 0;
+
+void *operator new(size_t size) {
+    ++allocation_count;
+    allocation_bytes += size;
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+// Kept out of line: inlined next to a new-expression, free() looks to GCC
+// like it releases memory from the wrong allocator.
+[[gnu::noinline]] void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+void operator delete[](void *memory) noexcept { operator delete(memory); }
+void operator delete(void *memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void *memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+/////////////////////////////////
+// Harness
+/////////////////////////////////
+
+// Keeps the compiler from proving a result unused and deleting the work.
+template <typename T> inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+    std::string name;
+    double ns_per_op = 0;
+    double bytes_per_op = 0;
+    double allocs_per_op = 0;
+    size_t iterations = 0;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> body;
+};
+
+// Runs the body in batches until a batch takes at least `min_time`, then
+// measures five batches of that size and keeps the median, which is far less
+// sensitive to a stray context switch than the mean.
+static Result run_benchmark(const Benchmark &benchmark) {
+    using clock = std::chrono::steady_clock;
+    const auto min_time = std::chrono::milliseconds(50);
+
+    size_t iterations = 1;
+    while (true) {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            benchmark.body();
+        }
+        if (clock::now() - start >= min_time || iterations >= (1u << 30)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    for (int sample = 0; sample < 5; ++sample) {
+        size_t count_before = allocation_count;
+        size_t bytes_before = allocation_bytes;
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            benchmark.body();
+        }
+        auto elapsed = clock::now() - start;
+        allocations = allocation_count - count_before;
+        bytes = allocation_bytes - bytes_before;
+        samples.push_back(
+            std::chrono::duration<double, std::nano>(elapsed).count() /
+            static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = benchmark.name;
+    result.ns_per_op = samples[samples.size() / 2];
+    result.allocs_per_op =
+        static_cast<double>(allocations) / static_cast<double>(iterations);
+    result.bytes_per_op =
+        static_cast<double>(bytes) / static_cast<double>(iterations);
+    result.iterations = iterations;
+    return result;
+}
+
+/////////////////////////////////
+// Corpus
+/////////////////////////////////
+
+static std::string small_get() {
+    return "GET /index.html HTTP/1.1\r\n"
+           "Host: localhost\r\n"
+           "\r\n";
+}
+
+static std::string browser_get() {
+    return "GET /api/v1/dashboard?tab=overview&range=7d HTTP/1.1\r\n"
+           "Host: app.example.com\r\n"
+           "Connection: keep-alive\r\n"
+           "Cache-Control: max-age=0\r\n"
+           "sec-ch-ua: \"Chromium\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+           "sec-ch-ua-mobile: ?0\r\n"
+           "sec-ch-ua-platform: \"Linux\"\r\n"
+           "Upgrade-Insecure-Requests: 1\r\n"
+           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+           "(KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+           "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+           "image/avif,image/webp,*/*;q=0.8\r\n"
+           "Sec-Fetch-Site: same-origin\r\n"
+           "Sec-Fetch-Mode: navigate\r\n"
+           "Sec-Fetch-User: ?1\r\n"
+           "Sec-Fetch-Dest: document\r\n"
+           "Referer: https://app.example.com/login\r\n"
+           "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+           "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+           "Cookie: session=6f1c2a9e0b7d4c3f8a5e; theme=dark; "
+           "_ga=GA1.1.123456789.1700000000; consent=yes\r\n"
+           "If-None-Match: \"33a64df551425fcc55e4d42a148795d9f25f89d4\"\r\n"
+           "\r\n";
+}
+
+static std::string large_post() {
+    std::string body(64 * 1024, 'x');
+    for (size_t i = 0; i < body.size(); i += 80) {
+        body[i] = '\n';
+    }
+    return "POST /upload HTTP/1.1\r\n"
+           "Host: localhost\r\n"
+           "Content-Type: application/octet-stream\r\n"
+           "Content-Length: " +
+           std::to_string(body.size()) +
+           "\r\n"
+           "\r\n" +
+           body;
+}
+
+static std::vector<std::string> pipelined_batch() {
+    std::vector<std::string> batch;
+    for (int i = 0; i < 16; ++i) {
+        batch.push_back("GET /items/" + std::to_string(i) +
+                        " HTTP/1.1\r\n"
+                        "Host: localhost\r\n"
+                        "Accept: application/json\r\n"
+                        "\r\n");
+    }
+    return batch;
+}
+
+struct BenchItem {
+    int id;
+    std::string name;
+    std::vector<std::string> tags;
+    double price;
+};
+JSON_FIELDS(BenchItem, id, name, tags, price)
+
+// Writes `input` to the client end, lets `connection` handle it and reads
+// back everything it answered.
+static void loopback_round_trip(ServerConnection &connection,
+                                LoopbackStream &client, LoopbackStream &server,
+                                std::string_view input) {
+    static char sink[64 * 1024];
+    client.write(input.data(), input.size());
+    serve(connection, server);
+    while (client.read(sink, sizeof(sink)) > 0) {
+    }
+}
+
+static std::vector<Benchmark> build_benchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    static const std::string small = small_get();
+    static const std::string browser = browser_get();
+    static const std::string upload = large_post();
+    static const std::vector<std::string> batch = pipelined_batch();
+
+    static std::string pipelined;
+    for (const std::string &request : batch) {
+        pipelined += request;
+    }
+
+    benchmarks.push_back({"parse/small_get", [] {
+                              HttpRequest request = HttpRequest::parse(small);
+                              do_not_optimize(request);
+                          }});
+    benchmarks.push_back({"parse/browser_get", [] {
+                              HttpRequest request =
+                                  HttpRequest::parse(browser);
+                              do_not_optimize(request);
+                          }});
+    benchmarks.push_back({"parse/post_64k", [] {
+                              HttpRequest request = HttpRequest::parse(upload);
+                              do_not_optimize(request);
+                          }});
+    benchmarks.push_back(
+        {"parse/pipelined_16", [] {
+             std::string_view remaining = pipelined;
+             size_t length;
+             while ((length = HttpRequest::complete_length(remaining)) > 0) {
+                 HttpRequest request = HttpRequest::parse(
+                     std::string(remaining.substr(0, length)));
+                 do_not_optimize(request);
+                 remaining.remove_prefix(length);
+             }
+         }});
+
+    static const HttpResponse small_response = HttpResponse::ok("pong");
+    static const HttpResponse json_response = HttpResponse::json_response(
+        R"({"id":42,"name":"widget","tags":["a","b","c"],"price":19.99})");
+    static const HttpResponse large_response =
+        HttpResponse::ok(std::string(64 * 1024, 'y'));
+    static HttpResponse header_heavy = [] {
+        HttpResponse response = HttpResponse::html_response("<p>hi</p>");
+        response.set_header("Cache-Control", "no-cache, no-store");
+        response.set_header("ETag", "\"33a64df551425fcc55e4\"");
+        response.set_header("Last-Modified", "Wed, 21 Oct 2015 07:28:00 GMT");
+        response.set_header("Vary", "Accept-Encoding");
+        response.set_header("Server", "cpp_web_sockets");
+        response.set_header("X-Request-Id", "f3b8c1d2-0a9e");
+        response.set_header("X-Frame-Options", "DENY");
+        response.set_header("Strict-Transport-Security", "max-age=63072000");
+        return response;
+    }();
+
+    benchmarks.push_back({"to_string/small", [] {
+                              std::string wire = small_response.to_string();
+                              do_not_optimize(wire);
+                          }});
+    benchmarks.push_back({"to_string/json", [] {
+                              std::string wire = json_response.to_string();
+                              do_not_optimize(wire);
+                          }});
+    benchmarks.push_back({"to_string/header_heavy", [] {
+                              std::string wire = header_heavy.to_string();
+                              do_not_optimize(wire);
+                          }});
+    benchmarks.push_back({"to_string/body_64k", [] {
+                              std::string wire = large_response.to_string();
+                              do_not_optimize(wire);
+                          }});
+
+    static const std::vector<BenchItem> items = [] {
+        std::vector<BenchItem> list;
+        for (int i = 0; i < 100; ++i) {
+            list.push_back({i, "widget " + std::to_string(i), {"a", "b"},
+                            19.99 + i});
+        }
+        return list;
+    }();
+    benchmarks.push_back({"to_json/items_100", [] {
+                              std::string json = to_json(items);
+                              do_not_optimize(json);
+                          }});
+    benchmarks.push_back({"json_response/items_100", [] {
+                              HttpResponse response =
+                                  HttpResponse::json_response(items);
+                              do_not_optimize(response);
+                          }});
+
+    // About 20KB, the upper end of typical API request bodies.
+    static const std::string order_json = [] {
+        std::string json = R"({"customer":{"id":77,"name":"A \"quoted\" )"
+                           R"(name"},"items":[)";
+        for (int i = 0; i < 350; ++i) {
+            json += std::string(i ? "," : "") + R"({"sku":"SKU-)" +
+                    std::to_string(i) + R"(","qty":)" + std::to_string(i % 9) +
+                    R"(,"price":19.99,"tags":["a","b"]})";
+        }
+        return json + R"(],"total":1234.5})";
+    }();
+    benchmarks.push_back({"json_index/order_20k", [] {
+                              JsonDocument document(order_json);
+                              do_not_optimize(document);
+                          }});
+    benchmarks.push_back({"json_fields/order_20k", [] {
+                              JsonDocument document(order_json);
+                              double total = document["total"].get_double();
+                              int64_t qty = document.at_path("/items/150/qty")
+                                                .get_int64();
+                              do_not_optimize(total);
+                              do_not_optimize(qty);
+                          }});
+
+    // 1MB upload in 16KB chunks, decoded as it would arrive off the socket.
+    static const std::string chunked_upload = [] {
+        std::string wire;
+        std::string chunk(16 * 1024, 'u');
+        for (int i = 0; i < 64; ++i) {
+            wire += "4000\r\n" + chunk + "\r\n";
+        }
+        return wire + "0\r\n\r\n";
+    }();
+    benchmarks.push_back({"body_decoder/chunked_1m", [] {
+                              RequestBody body;
+                              BodyDecoder decoder(BodyFraming{true, 0});
+                              std::string_view wire = chunked_upload;
+                              for (size_t offset = 0; offset < wire.size();
+                                   offset += 64 * 1024) {
+                                  decoder.feed(wire.substr(offset, 64 * 1024),
+                                               body);
+                              }
+                              do_not_optimize(body);
+                          }});
+
+    // A form with one 1MB binary file, fed in 64KB reads.
+    static const std::string multipart_form = [] {
+        std::string file(1024 * 1024, '\0');
+        for (size_t i = 0; i < file.size(); ++i) {
+            file[i] = static_cast<char>((i * 37 + i / 11) & 0xff);
+        }
+        return "--------------------------8c5a2f1e7d3b9046\r\n"
+               "Content-Disposition: form-data; name=\"file\"; "
+               "filename=\"data.bin\"\r\n"
+               "Content-Type: application/octet-stream\r\n\r\n" +
+               file + "\r\n--------------------------8c5a2f1e7d3b9046--\r\n";
+    }();
+    benchmarks.push_back({"multipart/file_1m", [] {
+                              size_t bytes = 0;
+                              MultipartParser parser(
+                                  "------------------------8c5a2f1e7d3b9046",
+                                  {nullptr,
+                                   [&bytes](std::string_view data) {
+                                       bytes += data.size();
+                                   },
+                                   nullptr});
+                              std::string_view form = multipart_form;
+                              for (size_t offset = 0; offset < form.size();
+                                   offset += 64 * 1024) {
+                                  parser.feed(form.substr(offset, 64 * 1024));
+                              }
+                              do_not_optimize(bytes);
+                          }});
+
+    // Publishing encodes the event once, however many subscribers follow.
+    static EventStream event_stream(256, std::chrono::hours(1));
+    static const std::string event_data(512, 'e');
+    benchmarks.push_back({"sse/publish_512", [] {
+                              EncodedEvent event = event_stream.publish(
+                                  {"", "update", event_data, std::nullopt});
+                              do_not_optimize(event);
+                          }});
+
+    static const std::string query = "c++ programming & (network) sockets!";
+    benchmarks.push_back({"percent_encoding/default", [] {
+                              std::string encoded = percent_encoding(query);
+                              do_not_optimize(encoded);
+                          }});
+    benchmarks.push_back({"percent_encoding/spaces", [] {
+                              std::string encoded =
+                                  percent_encoding(query, "spaces");
+                              do_not_optimize(encoded);
+                          }});
+
+    benchmarks.push_back({"format_header_name", [] {
+                              std::string name =
+                                  format_header_name("x-forwarded-for");
+                              do_not_optimize(name);
+                          }});
+
+    static const HttpRequest parsed_browser = HttpRequest::parse(browser);
+    benchmarks.push_back({"get_header/hit", [] {
+                              std::string value =
+                                  parsed_browser.get_header("Accept-Encoding");
+                              do_not_optimize(value);
+                          }});
+    benchmarks.push_back({"get_header/miss", [] {
+                              std::string value =
+                                  parsed_browser.get_header("X-Missing");
+                              do_not_optimize(value);
+                          }});
+
+    // The 28 KB /report page: levels 1 and 6 bracket what the adaptive
+    // level moves between.
+    static const std::string report = [] {
+        std::string html = "<html><body><table>";
+        for (int row = 1; row <= 1000; ++row) {
+            html += "<tr><td>" + std::to_string(row) + "</td><td>" +
+                    std::to_string(row * row) + "</td></tr>";
+        }
+        return html + "</table></body></html>";
+    }();
+    for (auto [name, encoding, level] :
+         {std::tuple{"compress/gzip_1_report", ContentEncoding::GZIP, 1},
+          std::tuple{"compress/gzip_6_report", ContentEncoding::GZIP, 6},
+          std::tuple{"compress/br_1_report", ContentEncoding::BROTLI, 1},
+          std::tuple{"compress/br_6_report", ContentEncoding::BROTLI, 6}}) {
+        benchmarks.push_back({name, [encoding, level] {
+                                  std::string compressed =
+                                      compress(report, encoding, level);
+                                  do_not_optimize(compressed);
+                              }});
+    }
+
+    static const MetricsRegistry::Counter counter =
+        MetricsRegistry::instance().counter("bench_counter_total", "bench");
+    static const MetricsRegistry::Histogram histogram =
+        MetricsRegistry::instance().histogram("bench_latency_seconds",
+                                              "bench");
+    static uint64_t sample = 0;
+    benchmarks.push_back({"metrics/counter_add", [] { counter.add(); }});
+    benchmarks.push_back({"metrics/histogram_record", [] {
+                              histogram.record_microseconds(++sample & 0xFFFF);
+                          }});
+
+    // Whole requests through the connection state machine with the kernel
+    // taken out: the ring copies, framing, parsing, routing and
+    // serialization that remain are what a request costs the server itself.
+    static auto http_loopback = LoopbackStream::pair();
+    static ServerConnection http_connection(
+        [](const HttpRequest &) { return HttpResponse::ok(); });
+    benchmarks.push_back({"loopback/small_get", [] {
+                              loopback_round_trip(http_connection,
+                                                  http_loopback.first,
+                                                  http_loopback.second, small);
+                          }});
+    benchmarks.push_back({"loopback/pipelined_16", [] {
+                              loopback_round_trip(
+                                  http_connection, http_loopback.first,
+                                  http_loopback.second, pipelined);
+                          }});
+
+    static auto websocket_loopback = LoopbackStream::pair();
+    static ServerConnection websocket_connection(
+        [](const HttpRequest &) { return HttpResponse::not_found("/"); },
+        [](ServerConnection &connection, WebSocketOpcode opcode,
+           const std::string &payload) {
+            connection.send_message(opcode, payload);
+        });
+    loopback_round_trip(websocket_connection, websocket_loopback.first,
+                        websocket_loopback.second,
+                        "GET /ws HTTP/1.1\r\nUpgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                        "Sec-WebSocket-Version: 13\r\n\r\n");
+    static const std::string echo_frame = encode_websocket_frame(
+        WebSocketOpcode::TEXT, std::string(128, 'w'), true, 0x12345678);
+    benchmarks.push_back({"loopback/websocket_echo_128", [] {
+                              loopback_round_trip(websocket_connection,
+                                                  websocket_loopback.first,
+                                                  websocket_loopback.second,
+                                                  echo_frame);
+                          }});
+
+    return benchmarks;
+}
+
+/////////////////////////////////
+// Reporting
+/////////////////////////////////
+
+static void write_json(const std::vector<Result> &results,
+                       const std::string &path) {
+    std::ofstream out(path);
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", "
+            << "\"ns_per_op\": " << result.ns_per_op << ", "
+            << "\"bytes_per_op\": " << result.bytes_per_op << ", "
+            << "\"allocs_per_op\": " << result.allocs_per_op << ", "
+            << "\"iterations\": " << result.iterations << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+// Reads back what write_json() wrote. Not a general JSON parser: it relies
+// on the one-object-per-line layout above.
+static std::map<std::string, Result> read_json(const std::string &path) {
+    std::map<std::string, Result> results;
+    std::ifstream in(path);
+    std::string line;
+
+    auto number_after = [](const std::string &text, const std::string &key) {
+        size_t position = text.find("\"" + key + "\": ");
+        if (position == std::string::npos) {
+            return 0.0;
+        }
+        return std::strtod(text.c_str() + position + key.size() + 4, nullptr);
+    };
+
+    while (std::getline(in, line)) {
+        size_t name_start = line.find("\"name\": \"");
+        if (name_start == std::string::npos) {
+            continue;
+        }
+        name_start += 9;
+        Result result;
+        result.name = line.substr(name_start, line.find('"', name_start) -
+                                                  name_start);
+        result.ns_per_op = number_after(line, "ns_per_op");
+        result.bytes_per_op = number_after(line, "bytes_per_op");
+        result.allocs_per_op = number_after(line, "allocs_per_op");
+        results[result.name] = result;
+    }
+    return results;
+}
+
+int main(int argc, char *argv[]) {
+    std::string filter;
+    std::string json_path;
+    std::string compare_path;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = std::strtod(argv[++i], nullptr);
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter <substring>] [--json <file>]"
+                         " [--compare <file>] [--threshold <percent>]\n";
+            return 2;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!compare_path.empty()) {
+        baseline = read_json(compare_path);
+    }
+
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right
+              << std::setw(12) << "ns/op" << std::setw(12) << "bytes/op"
+              << std::setw(12) << "allocs/op";
+    if (!baseline.empty()) {
+        std::cout << std::setw(12) << "delta";
+    }
+    std::cout << "\n";
+
+    std::vector<Result> results;
+    bool regressed = false;
+    for (const Benchmark &benchmark : build_benchmarks()) {
+        if (!filter.empty() &&
+            benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        Result result = run_benchmark(benchmark);
+        results.push_back(result);
+
+        std::cout << std::left << std::setw(28) << result.name << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(12)
+                  << result.ns_per_op << std::setw(12) << result.bytes_per_op
+                  << std::setw(12) << result.allocs_per_op;
+
+        auto previous = baseline.find(result.name);
+        if (previous != baseline.end() && previous->second.ns_per_op > 0) {
+            double delta = (result.ns_per_op - previous->second.ns_per_op) /
+                           previous->second.ns_per_op * 100.0;
+            bool slower = delta > threshold;
+            bool more_allocs =
+                result.allocs_per_op > previous->second.allocs_per_op + 0.5;
+            std::cout << std::setw(11) << std::showpos << delta
+                      << std::noshowpos << "%";
+            if (slower || more_allocs) {
+                std::cout << "  REGRESSION";
+                regressed = true;
+            }
+        }
+        std::cout << "\n";
+    }
+
+    if (!json_path.empty()) {
+        write_json(results, json_path);
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1,515 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+// WebSocket fan-out benchmark against a running server.
+//
+// Opens N subscriber connections on /ws plus one publisher, publishes
+// timestamped binary messages at a fixed rate and measures how long each
+// message takes to reach every subscriber. Each step of the sweep reports
+// delivery latency percentiles, deliveries/s and the server's resident
+// memory per idle subscriber connection.
+//
+// Usage:
+//   bench_websocket [--host <ip>] [--port <n>] [--subscribers 100,1000]
+//                   [--sizes 64,1024] [--rate <msgs/s>] [--duration <s>]
+//                   [--threads <n>] [--server-pid <pid>]
+//
+// Subscriber counts are swept in ascending order and connections are kept
+// between steps; every payload size is run at every subscriber count.
+// Latency is measured from each message's scheduled publish time, so a
+// publisher stalled by a slow server does not hide the delay. Memory needs
+// the server's pid: pass --server-pid, or a single process named "server"
+// is looked up in /proc.
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/histogram.hpp"
+#include "../core/http.hpp"
+#include "../core/string_utils.hpp"
+#include "../core/websocket.hpp"
+
+struct FanoutOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    std::vector<size_t> subscribers = {100, 1000};
+    std::vector<size_t> sizes = {64, 1024};
+    double rate = 1000.0;
+    double duration = 5.0;
+    size_t threads = 2;
+    int server_pid = 0;
+};
+
+// Every payload starts with the scheduled publish time, the sweep step and
+// a sequence number; the rest is padding up to the requested size.
+struct MessageHeader {
+    uint64_t scheduled_ns;
+    uint32_t step;
+    uint32_t sequence;
+};
+static_assert(sizeof(MessageHeader) == 16);
+
+// How long a step waits for stragglers after its last publish.
+static constexpr auto DRAIN_TIMEOUT = std::chrono::seconds(2);
+
+static uint64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/////////////////////////////////
+// Connections
+/////////////////////////////////
+
+// Connects and performs the upgrade handshake; returns a non-blocking fd.
+static int open_websocket(const FanoutOptions &options, std::mt19937 &rng) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create socket: " +
+                                 std::string(strerror(errno)));
+    }
+
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0) {
+        close(fd);
+        throw std::runtime_error("Connect failed: " +
+                                 std::string(strerror(errno)));
+    }
+
+    std::string nonce(16, '\0');
+    for (char &c : nonce) {
+        c = static_cast<char>(rng());
+    }
+    std::string key = base64_encode(nonce);
+
+    HttpRequest request;
+    request.create_get("/ws");
+    request.set_header("Upgrade", "websocket");
+    request.set_header("Connection", "Upgrade");
+    request.set_header("Sec-WebSocket-Key", key);
+    request.set_header("Sec-WebSocket-Version", "13");
+    std::string raw_request = request.to_string();
+    if (send(fd, raw_request.data(), raw_request.size(), MSG_NOSIGNAL) < 0) {
+        close(fd);
+        throw std::runtime_error("Failed to send upgrade request");
+    }
+
+    std::string raw_response;
+    char buffer[1024];
+    while (HttpResponse::complete_length(raw_response) == 0) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            close(fd);
+            throw std::runtime_error("Server closed during handshake");
+        }
+        raw_response.append(buffer, received);
+    }
+
+    HttpResponse response = HttpResponse::parse(raw_response);
+    if (response.status_code != 101 ||
+        response.get_header("Sec-WebSocket-Accept") !=
+            websocket_accept_key(key)) {
+        close(fd);
+        throw std::runtime_error("WebSocket upgrade rejected");
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static void raise_fd_limit() {
+    struct rlimit fd_limit;
+    if (getrlimit(RLIMIT_NOFILE, &fd_limit) == 0) {
+        fd_limit.rlim_cur = fd_limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &fd_limit);
+    }
+}
+
+/////////////////////////////////
+// Server Memory
+/////////////////////////////////
+
+static int find_server_pid() {
+    int found = 0;
+    DIR *proc = opendir("/proc");
+    if (!proc) {
+        return 0;
+    }
+    while (struct dirent *entry = readdir(proc)) {
+        int pid = std::atoi(entry->d_name);
+        if (pid <= 0) {
+            continue;
+        }
+        std::ifstream comm("/proc/" + std::string(entry->d_name) + "/comm");
+        std::string name;
+        if (std::getline(comm, name) && name == "server") {
+            if (found) {
+                found = -1;  // ambiguous
+                break;
+            }
+            found = pid;
+        }
+    }
+    closedir(proc);
+    return std::max(found, 0);
+}
+
+// Resident set size in bytes, or 0 when it cannot be read.
+static size_t resident_bytes(int pid) {
+    if (pid <= 0) {
+        return 0;
+    }
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+    return 0;
+}
+
+/////////////////////////////////
+// Subscribers
+/////////////////////////////////
+
+struct SubscriberGroup {
+    std::vector<int> fds;
+    HdrHistogram latency;
+    uint64_t delivered = 0;
+    uint64_t disconnected = 0;
+};
+
+// Reads every frame arriving on the group's connections until `stop` is
+// set, recording latency for messages that belong to `step`. Messages left
+// over from an earlier step are ignored.
+static void run_subscribers(SubscriberGroup &group, uint32_t step,
+                            const std::atomic<bool> &stop,
+                            std::atomic<uint64_t> &delivered_total) {
+    int epoll_fd = epoll_create1(0);
+    std::vector<std::string> pending(group.fds.size());
+    for (size_t i = 0; i < group.fds.size(); ++i) {
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, group.fds[i], &event);
+    }
+
+    char buffer[64 * 1024];
+    struct epoll_event events[256];
+    while (!stop.load(std::memory_order_relaxed)) {
+        int ready = epoll_wait(epoll_fd, events, 256, 50);
+        uint64_t delivered_now = 0;
+        for (int e = 0; e < ready; ++e) {
+            size_t index = events[e].data.u64;
+            int fd = group.fds[index];
+            std::string &input = pending[index];
+
+            ssize_t received;
+            while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                input.append(buffer, received);
+            }
+            if (received == 0 || (received < 0 && errno != EAGAIN &&
+                                  errno != EWOULDBLOCK)) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                ++group.disconnected;
+                continue;
+            }
+
+            uint64_t now = steady_now_ns();
+            size_t consumed = 0;
+            WebSocketFrame frame;
+            size_t length;
+            while ((length = decode_websocket_frame(
+                        std::string_view(input).substr(consumed), frame)) >
+                   0) {
+                consumed += length;
+                if (frame.opcode != WebSocketOpcode::BINARY ||
+                    frame.payload.size() < sizeof(MessageHeader)) {
+                    continue;
+                }
+                MessageHeader header;
+                std::memcpy(&header, frame.payload.data(), sizeof(header));
+                if (header.step != step) {
+                    continue;
+                }
+                group.latency.record(now - std::min(now, header.scheduled_ns));
+                ++group.delivered;
+                ++delivered_now;
+            }
+            input.erase(0, consumed);
+        }
+        if (delivered_now) {
+            delivered_total.fetch_add(delivered_now,
+                                      std::memory_order_relaxed);
+        }
+    }
+    close(epoll_fd);
+}
+
+/////////////////////////////////
+// Sweep
+/////////////////////////////////
+
+struct StepResult {
+    size_t subscribers;
+    size_t size;
+    uint64_t published = 0;
+    uint64_t delivered = 0;
+    uint64_t disconnected = 0;
+    double elapsed_seconds = 0;
+    HdrHistogram latency;
+};
+
+static StepResult run_step(const FanoutOptions &options, int publisher_fd,
+                           const std::vector<int> &subscriber_fds,
+                           size_t size, uint32_t step) {
+    StepResult result;
+    result.subscribers = subscriber_fds.size();
+    result.size = std::max(size, sizeof(MessageHeader));
+
+    size_t thread_count = std::min(options.threads, subscriber_fds.size());
+    std::vector<SubscriberGroup> groups(thread_count);
+    for (size_t i = 0; i < subscriber_fds.size(); ++i) {
+        groups[i % thread_count].fds.push_back(subscriber_fds[i]);
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> delivered_total{0};
+    std::vector<std::thread> threads;
+    for (auto &group : groups) {
+        threads.emplace_back([&group, step, &stop, &delivered_total] {
+            run_subscribers(group, step, stop, delivered_total);
+        });
+    }
+
+    // Open-loop publishing: message i is due at start + i * interval no
+    // matter how long the previous send took.
+    auto interval = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / options.rate));
+    uint64_t total = static_cast<uint64_t>(options.rate * options.duration);
+    std::string payload(result.size, 'x');
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < total; ++i) {
+        auto due = start + interval * i;
+        std::this_thread::sleep_until(due);
+
+        MessageHeader header{
+            static_cast<uint64_t>(std::chrono::duration_cast<
+                                      std::chrono::nanoseconds>(
+                                      due.time_since_epoch())
+                                      .count()),
+            step, static_cast<uint32_t>(i)};
+        std::memcpy(payload.data(), &header, sizeof(header));
+
+        std::string frame = encode_websocket_frame(
+            WebSocketOpcode::BINARY, payload, true,
+            static_cast<uint32_t>(i * 2654435761u));
+        size_t offset = 0;
+        while (offset < frame.size()) {
+            ssize_t sent = send(publisher_fd, frame.data() + offset,
+                                frame.size() - offset, MSG_NOSIGNAL);
+            if (sent < 0) {
+                throw std::runtime_error("Publisher connection failed");
+            }
+            offset += sent;
+        }
+        ++result.published;
+    }
+
+    uint64_t expected = result.published * subscriber_fds.size();
+    auto deadline = std::chrono::steady_clock::now() + DRAIN_TIMEOUT;
+    while (delivered_total.load() < expected &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    result.elapsed_seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+    stop = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &group : groups) {
+        result.latency.merge(group.latency);
+        result.delivered += group.delivered;
+        result.disconnected += group.disconnected;
+    }
+    return result;
+}
+
+static void print_header() {
+    std::cout << std::right << std::setw(8) << "subs" << std::setw(8)
+              << "bytes" << std::setw(10) << "published" << std::setw(12)
+              << "delivered" << std::setw(12) << "deliv/s" << std::setw(10)
+              << "p50 us" << std::setw(10) << "p99 us" << std::setw(10)
+              << "p99.9 us" << std::setw(10) << "max us" << std::setw(11)
+              << "KiB/conn" << "\n";
+}
+
+static void print_step(const StepResult &result, double kib_per_connection) {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    std::cout << std::fixed << std::setprecision(1) << std::setw(8)
+              << result.subscribers << std::setw(8) << result.size
+              << std::setw(10) << result.published << std::setw(12)
+              << result.delivered << std::setw(12) << std::setprecision(0)
+              << result.delivered / result.elapsed_seconds
+              << std::setprecision(1) << std::setw(10)
+              << us(result.latency.value_at_percentile(50.0)) << std::setw(10)
+              << us(result.latency.value_at_percentile(99.0)) << std::setw(10)
+              << us(result.latency.value_at_percentile(99.9)) << std::setw(10)
+              << us(result.latency.max());
+    if (kib_per_connection >= 0) {
+        std::cout << std::setw(11) << kib_per_connection;
+    } else {
+        std::cout << std::setw(11) << "-";
+    }
+    if (result.disconnected) {
+        std::cout << "  (" << result.disconnected << " disconnected)";
+    }
+    std::cout << "\n";
+}
+
+static std::vector<size_t> parse_list(const std::string &value) {
+    std::vector<size_t> list;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        list.push_back(std::stoul(item));
+    }
+    return list;
+}
+
+int main(int argc, char *argv[]) {
+    FanoutOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--host") {
+                options.host = value;
+            } else if (arg == "--port") {
+                options.port = static_cast<uint16_t>(std::stoul(value));
+            } else if (arg == "--subscribers") {
+                options.subscribers = parse_list(value);
+            } else if (arg == "--sizes") {
+                options.sizes = parse_list(value);
+            } else if (arg == "--rate") {
+                options.rate = std::stod(value);
+            } else if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--threads") {
+                options.threads = std::stoul(value);
+            } else if (arg == "--server-pid") {
+                options.server_pid = std::stoi(value);
+            } else {
+                throw std::invalid_argument(arg);
+            }
+        }
+        if (options.rate <= 0 || options.duration <= 0 ||
+            options.threads == 0 || options.subscribers.empty() ||
+            options.sizes.empty()) {
+            throw std::invalid_argument("empty sweep");
+        }
+    } catch (const std::exception &) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--host <ip>] [--port <n>] [--subscribers 100,1000]"
+                     " [--sizes 64,1024] [--rate <msgs/s>]"
+                     " [--duration <s>] [--threads <n>]"
+                     " [--server-pid <pid>]\n";
+        return 2;
+    }
+
+    raise_fd_limit();
+    std::sort(options.subscribers.begin(), options.subscribers.end());
+    if (options.server_pid == 0) {
+        options.server_pid = find_server_pid();
+    }
+
+    std::mt19937 rng(std::random_device{}());
+    std::vector<int> subscriber_fds;
+    int publisher_fd = -1;
+    int status = 0;
+
+    try {
+        publisher_fd = open_websocket(options, rng);
+        // The publisher writes in blocking mode; it never reads.
+        fcntl(publisher_fd, F_SETFL,
+              fcntl(publisher_fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+        print_header();
+        uint32_t step = 0;
+        for (size_t count : options.subscribers) {
+            size_t rss_before = resident_bytes(options.server_pid);
+            size_t added = 0;
+            while (subscriber_fds.size() < count) {
+                subscriber_fds.push_back(open_websocket(options, rng));
+                ++added;
+            }
+            // Give the server a moment to finish the handshakes it has
+            // queued before sampling its memory.
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            size_t rss_after = resident_bytes(options.server_pid);
+
+            double kib_per_connection = -1;
+            if (rss_before && rss_after && added) {
+                kib_per_connection =
+                    (static_cast<double>(rss_after) -
+                     static_cast<double>(rss_before)) /
+                    1024.0 / static_cast<double>(added);
+            }
+
+            for (size_t size : options.sizes) {
+                StepResult result = run_step(options, publisher_fd,
+                                             subscriber_fds, size, ++step);
+                print_step(result, kib_per_connection);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        status = 1;
+    }
+
+    for (int fd : subscriber_fds) {
+        close(fd);
+    }
+    if (publisher_fd >= 0) {
+        close(publisher_fd);
+    }
+    return status;
+}
@@ -0,0 +1,492 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../core/http.hpp"
+#include "../core/transport.hpp"
+#include "load_generator.hpp"
+
+/////////////////////////////////
+// Option Parsing
+/////////////////////////////////
+
+static void print_load_usage() {
+    std::cerr
+        << "usage: client --load [options]\n"
+           "  --host <ip>          server address (default 127.0.0.1)\n"
+           "  --port <n>           server port (default 8080)\n"
+           "  --unix <path>        connect over a UNIX socket (@ = abstract)\n"
+           "  --path <uri>         request path (default /test)\n"
+           "  --rate <n>           requests per second, all threads\n"
+           "  --duration <s>       seconds of scheduled load (default 10)\n"
+           "  --connections <n>    open connections (default 16)\n"
+           "  --threads <n>        event loop threads (default 2)\n"
+           "  --pipeline <n>       max in-flight requests per connection\n"
+           "  --histogram <file>   write the .hgrm percentile distribution\n";
+}
+
+bool parse_load_options(int argc, char *argv[], LoadOptions &options) {
+    try {
+        for (int i = 0; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << flag << "\n";
+                print_load_usage();
+                return false;
+            }
+            std::string value = argv[++i];
+
+            if (flag == "--host") {
+                options.host = value;
+            } else if (flag == "--port") {
+                options.port = static_cast<uint16_t>(std::stoul(value));
+            } else if (flag == "--unix") {
+                options.unix_path = value;
+            } else if (flag == "--path") {
+                options.path = value;
+            } else if (flag == "--rate") {
+                options.rate = std::stod(value);
+            } else if (flag == "--duration") {
+                options.duration = std::stod(value);
+            } else if (flag == "--connections") {
+                options.connections = std::stoul(value);
+            } else if (flag == "--threads") {
+                options.threads = std::stoul(value);
+            } else if (flag == "--pipeline") {
+                options.pipeline = std::stoul(value);
+            } else if (flag == "--histogram") {
+                options.histogram_path = value;
+            } else {
+                std::cerr << "Unknown option " << flag << "\n";
+                print_load_usage();
+                return false;
+            }
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Invalid option value\n";
+        print_load_usage();
+        return false;
+    }
+
+    if (options.rate <= 0 || options.duration <= 0 ||
+        options.connections == 0 || options.threads == 0 ||
+        options.pipeline == 0) {
+        std::cerr << "rate, duration, connections, threads and pipeline must "
+                     "be positive\n";
+        return false;
+    }
+    options.threads = std::min(options.threads, options.connections);
+    return true;
+}
+
+/////////////////////////////////
+// Worker
+/////////////////////////////////
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t now_ns(Clock::time_point origin) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                origin)
+        .count();
+}
+
+// How long the loop keeps waiting for outstanding responses after the last
+// request was scheduled.
+static constexpr uint64_t DRAIN_TIMEOUT_NS = 2'000'000'000;
+
+struct LoadConnection {
+    int fd = -1;
+    std::string output;
+    size_t output_offset = 0;
+    std::string input;
+    // Intended send time of every request written but not yet answered, in
+    // order; pipelined responses come back in the same order.
+    std::deque<uint64_t> in_flight;
+};
+
+static int open_connection(const LoadOptions &options) {
+    Endpoint endpoint = options.unix_path.empty()
+                            ? Endpoint::tcp(options.host, options.port)
+                            : Endpoint::unix_socket(options.unix_path);
+    // Connecting blocks, but only during setup and reconnects; on loopback
+    // that is a single round trip.
+    int fd = connect_socket(resolve(endpoint));
+    if (fd < 0) {
+        throw std::runtime_error("Connect to " + endpoint.to_string() +
+                                 " failed");
+    }
+
+    if (endpoint.kind == Endpoint::Kind::TCP) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+class LoadWorker {
+  public:
+    LoadWorker(const LoadOptions &options, size_t index,
+               Clock::time_point origin)
+        : options(options), origin(origin) {
+        // Each worker owns an equal share of the rate, offset so the workers'
+        // schedules interleave instead of firing in lockstep.
+        double thread_rate = options.rate / options.threads;
+        interval_ns = 1e9 / thread_rate;
+        first_send_ns = 1e9 / options.rate * index;
+        total_requests =
+            static_cast<uint64_t>(options.duration * thread_rate + 0.5);
+
+        size_t count = options.connections / options.threads +
+                       (index < options.connections % options.threads ? 1 : 0);
+        connections.resize(count);
+
+        HttpRequest request;
+        request.create_get(options.path);
+        request.set_header("Host",
+                           options.host + ":" + std::to_string(options.port));
+        request_bytes = request.to_string();
+    }
+
+    ~LoadWorker() {
+        for (auto &conn : connections) {
+            if (conn.fd >= 0) {
+                close(conn.fd);
+            }
+        }
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+    }
+
+    void run(LoadReport &report);
+
+  private:
+    uint64_t intended_time(uint64_t index) const {
+        return static_cast<uint64_t>(first_send_ns + index * interval_ns);
+    }
+
+    void connect_all();
+    void reconnect(LoadConnection &conn);
+    void dispatch();
+    bool flush(LoadConnection &conn);
+    bool receive(LoadConnection &conn);
+    void wait(uint64_t until_ns);
+
+    const LoadOptions &options;
+    Clock::time_point origin;
+    double interval_ns;
+    double first_send_ns;
+    uint64_t total_requests;
+    std::string request_bytes;
+
+    int epoll_fd = -1;
+    std::vector<LoadConnection> connections;
+
+    uint64_t scheduled = 0;
+    // Requests whose intended time has passed but that no connection had
+    // room for yet. They keep their intended time, so waiting here counts.
+    std::deque<uint64_t> backlog;
+    size_t next_connection = 0;
+
+    HdrHistogram latency;
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+};
+
+void LoadWorker::connect_all() {
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    for (size_t i = 0; i < connections.size(); ++i) {
+        connections[i].fd = open_connection(options);
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connections[i].fd, &event);
+    }
+}
+
+void LoadWorker::reconnect(LoadConnection &conn) {
+    // Whatever was in flight on a dead connection is lost; count it rather
+    // than silently resending and hiding the failure.
+    errors += conn.in_flight.size();
+    conn.in_flight.clear();
+    conn.output.clear();
+    conn.output_offset = 0;
+    conn.input.clear();
+
+    uint64_t slot = static_cast<uint64_t>(&conn - connections.data());
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    conn.fd = open_connection(options);
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &event);
+}
+
+void LoadWorker::dispatch() {
+    // Round-robin the backlog over connections with pipeline room left, so
+    // one slow connection does not collect every late request.
+    size_t checked = 0;
+    while (!backlog.empty() && checked < connections.size()) {
+        LoadConnection &conn = connections[next_connection];
+        next_connection = (next_connection + 1) % connections.size();
+
+        if (conn.in_flight.size() >= options.pipeline) {
+            ++checked;
+            continue;
+        }
+        checked = 0;
+        conn.in_flight.push_back(backlog.front());
+        backlog.pop_front();
+        conn.output += request_bytes;
+    }
+
+    for (auto &conn : connections) {
+        if (conn.output_offset < conn.output.size() && !flush(conn)) {
+            reconnect(conn);
+        }
+    }
+}
+
+bool LoadWorker::flush(LoadConnection &conn) {
+    while (conn.output_offset < conn.output.size()) {
+        ssize_t sent = send(conn.fd, conn.output.data() + conn.output_offset,
+                            conn.output.size() - conn.output_offset,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        conn.output_offset += sent;
+    }
+
+    if (conn.output_offset == conn.output.size()) {
+        conn.output.clear();
+        conn.output_offset = 0;
+    }
+
+    uint64_t slot = static_cast<uint64_t>(&conn - connections.data());
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    if (!conn.output.empty()) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.u64 = slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &event);
+    return true;
+}
+
+bool LoadWorker::receive(LoadConnection &conn) {
+    char buffer[16 * 1024];
+    while (true) {
+        ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        conn.input.append(buffer, received);
+    }
+
+    uint64_t now = now_ns(origin);
+    size_t consumed = 0;
+    while (!conn.in_flight.empty()) {
+        std::string_view pending(conn.input);
+        pending.remove_prefix(consumed);
+        size_t length = HttpResponse::complete_length(pending);
+        if (length == 0) {
+            break;
+        }
+
+        // "HTTP/1.1 200 ..." - only the status class matters here.
+        bool success = pending.size() > 9 && pending[9] == '2';
+        if (success) {
+            latency.record(now - std::min(now, conn.in_flight.front()));
+            ++completed;
+        } else {
+            ++errors;
+        }
+        conn.in_flight.pop_front();
+        consumed += length;
+    }
+    conn.input.erase(0, consumed);
+    return true;
+}
+
+void LoadWorker::wait(uint64_t until_ns) {
+    uint64_t now = now_ns(origin);
+    int timeout_ms = 0;
+    if (until_ns > now) {
+        // epoll only has millisecond resolution; spin through the last
+        // millisecond rather than oversleeping past the next send time.
+        timeout_ms = static_cast<int>((until_ns - now) / 1'000'000);
+    }
+
+    struct epoll_event events[64];
+    int ready = epoll_wait(epoll_fd, events, 64, timeout_ms);
+    for (int i = 0; i < ready; ++i) {
+        LoadConnection &conn = connections[events[i].data.u64];
+        bool healthy = true;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            healthy = false;
+        }
+        if (healthy && (events[i].events & EPOLLIN)) {
+            healthy = receive(conn);
+        }
+        if (healthy && (events[i].events & EPOLLOUT)) {
+            healthy = flush(conn);
+        }
+        if (!healthy) {
+            reconnect(conn);
+        }
+    }
+}
+
+void LoadWorker::run(LoadReport &report) {
+    connect_all();
+    std::this_thread::sleep_until(origin);
+
+    uint64_t end_ns = intended_time(total_requests);
+    while (true) {
+        uint64_t now = now_ns(origin);
+        while (scheduled < total_requests && intended_time(scheduled) <= now) {
+            backlog.push_back(intended_time(scheduled));
+            ++scheduled;
+        }
+        dispatch();
+
+        bool outstanding = !backlog.empty();
+        for (const auto &conn : connections) {
+            outstanding = outstanding || !conn.in_flight.empty();
+        }
+        if (scheduled == total_requests &&
+            (!outstanding || now > end_ns + DRAIN_TIMEOUT_NS)) {
+            break;
+        }
+
+        uint64_t next = scheduled < total_requests
+                            ? intended_time(scheduled)
+                            : end_ns + DRAIN_TIMEOUT_NS;
+        wait(next);
+    }
+
+    uint64_t timeouts = backlog.size();
+    for (const auto &conn : connections) {
+        timeouts += conn.in_flight.size();
+    }
+
+    report.latency.merge(latency);
+    report.scheduled += scheduled;
+    report.completed += completed;
+    report.errors += errors;
+    report.timeouts += timeouts;
+}
+
+/////////////////////////////////
+// Driver
+/////////////////////////////////
+
+LoadReport run_load(const LoadOptions &options) {
+    std::vector<LoadReport> reports(options.threads);
+    std::vector<std::exception_ptr> failures(options.threads);
+    std::vector<std::thread> threads;
+
+    // Give every thread time to connect before the shared schedule starts.
+    Clock::time_point origin = Clock::now() + std::chrono::milliseconds(100);
+    for (size_t i = 0; i < options.threads; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                LoadWorker worker(options, i, origin);
+                worker.run(reports[i]);
+            } catch (...) {
+                failures[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &failure : failures) {
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    LoadReport total;
+    for (const auto &report : reports) {
+        total.latency.merge(report.latency);
+        total.scheduled += report.scheduled;
+        total.completed += report.completed;
+        total.errors += report.errors;
+        total.timeouts += report.timeouts;
+    }
+    total.elapsed_seconds =
+        std::chrono::duration<double>(Clock::now() - origin).count();
+    return total;
+}
+
+void print_load_report(const LoadOptions &options, const LoadReport &report) {
+    std::cout << "Open-loop load against " << options.host << ":"
+              << options.port << options.path << "\n"
+              << "  " << options.rate << " req/s for " << options.duration
+              << "s over " << options.connections << " connections, "
+              << options.threads << " threads, pipeline depth "
+              << options.pipeline << "\n\n";
+
+    std::cout << "Latency (corrected for coordinated omission):\n"
+              << report.latency.summary(1000.0, "us") << "\n";
+
+    double achieved = report.elapsed_seconds > 0
+                          ? report.completed / report.elapsed_seconds
+                          : 0.0;
+    std::cout << "  scheduled  " << report.scheduled << "\n"
+              << "  completed  " << report.completed << "\n"
+              << "  errors     " << report.errors << "\n"
+              << "  timeouts   " << report.timeouts << "\n"
+              << "  achieved   " << static_cast<uint64_t>(achieved)
+              << " req/s\n";
+
+    if (!options.histogram_path.empty()) {
+        std::ofstream out(options.histogram_path);
+        if (!out) {
+            std::cerr << "Failed to open " << options.histogram_path << "\n";
+            return;
+        }
+        report.latency.write_distribution(out, 1000.0);
+        std::cout << "  histogram  " << options.histogram_path << "\n";
+    }
+}
@@ -0,0 +1,52 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../core/histogram.hpp"
+
+/////////////////////////////////
+// Open-loop Load Generator
+/////////////////////////////////
+
+// Options for `client --load`. Defaults target the server on loopback.
+struct LoadOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    std::string unix_path;  // connect here instead of host:port if set
+    std::string path = "/test";
+    double rate = 1000.0;    // requests per second across all threads
+    double duration = 10.0;  // seconds of scheduled sending
+    size_t connections = 16;
+    size_t threads = 2;
+    size_t pipeline = 1;            // max in-flight requests per connection
+    std::string histogram_path;     // optional .hgrm output
+};
+
+struct LoadReport {
+    HdrHistogram latency;  // nanoseconds, from *intended* send time
+    uint64_t scheduled = 0;
+    uint64_t completed = 0;
+    uint64_t errors = 0;    // non-2xx responses
+    uint64_t timeouts = 0;  // still outstanding when the run ended
+    double elapsed_seconds = 0;
+};
+
+// Parses the arguments following `--load`. Returns false and prints usage
+// on anything it does not understand.
+bool parse_load_options(int argc, char *argv[], LoadOptions &options);
+
+// Runs an open-loop test: requests are scheduled at a constant rate
+// regardless of how fast responses come back, and each latency is measured
+// from the moment the request *should* have been sent. A stalled server
+// therefore shows up as the queueing delay every scheduled request really
+// experienced, instead of the load generator politely waiting and hiding
+// it (coordinated omission).
+LoadReport run_load(const LoadOptions &options);
+
+void print_load_report(const LoadOptions &options, const LoadReport &report);
@@ -9,7 +9,40 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
-int main() {
+#include <string>
+
+#include "load_generator.hpp"
+#include "replay.hpp"
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--load") {
+        LoadOptions options;
+        if (!parse_load_options(argc - 2, argv + 2, options)) {
+            return 1;
+        }
+        try {
+            print_load_report(options, run_load(options));
+        } catch (const std::exception &e) {
+            std::cerr << "Load test failed: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--replay") {
+        ReplayOptions options;
+        if (!parse_replay_options(argc - 2, argv + 2, options)) {
+            return 1;
+        }
+        try {
+            ReplayReport report = run_replay(options);
+            print_replay_report(options, report);
+            return report.matches() ? 0 : 1;
+        } catch (const std::exception &e) {
+            std::cerr << "Replay failed: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
     int client_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (client_fd < 0) {
         std::cerr << "Failed to create socket\n";
@@ -0,0 +1,652 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../core/capture.hpp"
+#include "../core/http.hpp"
+#include "replay.hpp"
+
+/////////////////////////////////
+// Option Parsing
+/////////////////////////////////
+
+static void print_replay_usage() {
+    std::cerr
+        << "usage: client --replay <capture> [options]\n"
+           "  --host <ip>      server address (default 127.0.0.1)\n"
+           "  --port <n>       server port (default 8080)\n"
+           "  --speed <x>      pace multiplier, 0 = as fast as possible\n"
+           "                   (default 1, the captured pace)\n"
+           "  --threads <n>    event loop threads (default 1)\n";
+}
+
+bool parse_replay_options(int argc, char *argv[], ReplayOptions &options) {
+    if (argc < 1) {
+        print_replay_usage();
+        return false;
+    }
+    options.capture_path = argv[0];
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << flag << "\n";
+                print_replay_usage();
+                return false;
+            }
+            std::string value = argv[++i];
+
+            if (flag == "--host") {
+                options.host = value;
+            } else if (flag == "--port") {
+                options.port = static_cast<uint16_t>(std::stoul(value));
+            } else if (flag == "--speed") {
+                options.speed = std::stod(value);
+            } else if (flag == "--threads") {
+                options.threads = std::stoul(value);
+            } else {
+                std::cerr << "Unknown option " << flag << "\n";
+                print_replay_usage();
+                return false;
+            }
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Invalid option value\n";
+        print_replay_usage();
+        return false;
+    }
+
+    if (options.speed < 0 || options.threads == 0) {
+        std::cerr << "speed must not be negative, threads must be positive\n";
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////
+// Loading
+/////////////////////////////////
+
+// Everything one captured connection did, in order.
+struct ReplaySession {
+    uint64_t connection_id = 0;
+    uint64_t open_us = 0;
+    struct Chunk {
+        uint64_t at_us;
+        std::string bytes;
+    };
+    std::vector<Chunk> chunks;
+    struct Expected {
+        int status;
+        uint64_t length;
+        bool head_only;  // answer to HEAD: Content-Length but no body
+    };
+    std::vector<Expected> expected;
+};
+
+static std::vector<ReplaySession> load_capture(const std::string &path) {
+    CaptureReader reader(path);
+    std::map<uint64_t, ReplaySession> by_id;
+    CaptureRecord record;
+    while (reader.next(record)) {
+        auto [found, created] = by_id.try_emplace(record.connection_id);
+        ReplaySession &session = found->second;
+        if (created) {
+            session.connection_id = record.connection_id;
+            session.open_us = record.timestamp_us;
+        }
+        if (record.type == CaptureRecordType::REQUEST) {
+            session.chunks.push_back(
+                {record.timestamp_us, std::move(record.data)});
+        } else if (record.type == CaptureRecordType::RESPONSE) {
+            session.expected.push_back({record.status, record.length, false});
+        }
+    }
+    if (reader.truncated()) {
+        std::cerr << "Capture ends in a partial record; replaying what is "
+                     "complete\n";
+    }
+
+    // A HEAD response declares a body it does not send, so framing it needs
+    // the request method. Split the sent bytes into requests the same way
+    // the server does, up to an upgrade.
+    std::vector<ReplaySession> sessions;
+    for (auto &[id, session] : by_id) {
+        std::string sent;
+        for (const auto &chunk : session.chunks) {
+            sent += chunk.bytes;
+        }
+        std::string_view pending(sent);
+        for (auto &expected : session.expected) {
+            size_t length = HttpRequest::complete_length(pending);
+            if (length == 0 || expected.status == 101) {
+                break;
+            }
+            expected.head_only = pending.rfind("HEAD ", 0) == 0;
+            pending.remove_prefix(length);
+        }
+        sessions.push_back(std::move(session));
+    }
+    return sessions;
+}
+
+/////////////////////////////////
+// Worker
+/////////////////////////////////
+
+using Clock = std::chrono::steady_clock;
+
+// How long to keep waiting for responses after the last captured byte was
+// sent.
+static constexpr uint64_t DRAIN_TIMEOUT_NS = 5'000'000'000;
+static constexpr size_t MAX_SAMPLES = 10;
+
+static int open_connection(const ReplayOptions &options) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+        close(fd);
+        throw std::runtime_error("Invalid host address: " + options.host);
+    }
+
+    // Blocking connect; on loopback that is a single round trip.
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+class ReplayWorker {
+  public:
+    ReplayWorker(const ReplayOptions &options,
+                 std::vector<const ReplaySession *> sessions,
+                 Clock::time_point origin);
+    ~ReplayWorker();
+
+    void run(ReplayReport &report);
+
+  private:
+    struct Connection {
+        const ReplaySession *session = nullptr;
+        int fd = -1;
+        bool failed = false;
+        // After a 101, or the head of an event stream, what the server
+        // sends is no longer HTTP responses.
+        bool upgraded = false;
+        size_t chunks_queued = 0;
+        std::string output;
+        size_t output_offset = 0;
+        std::string input;
+        size_t received = 0;
+        // The response being read: its status, its bytes so far and its
+        // body framing, once the head is in.
+        int status = 0;
+        uint64_t length = 0;
+        std::optional<BodyDecoder> body;
+    };
+
+    // One entry per connect or chunk send, sorted by when it is due.
+    struct Event {
+        uint64_t due_ns;
+        size_t connection;
+        bool open;
+    };
+
+    uint64_t elapsed_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Clock::now() - origin)
+            .count();
+    }
+    uint64_t scaled(uint64_t at_us) const {
+        return options.speed == 0
+                   ? 0
+                   : static_cast<uint64_t>(at_us * 1000 / options.speed);
+    }
+    bool finished(const Connection &conn) const {
+        return conn.failed || conn.fd < 0 ||
+               (conn.chunks_queued == conn.session->chunks.size() &&
+                conn.output.empty() &&
+                (conn.upgraded ||
+                 conn.received >= conn.session->expected.size()));
+    }
+
+    void fire(const Event &event);
+    void fail(Connection &conn);
+    void flush(Connection &conn);
+    void receive(Connection &conn);
+    void compare(Connection &conn, int status, uint64_t length);
+    void wait(uint64_t until_ns);
+
+    const ReplayOptions &options;
+    Clock::time_point origin;
+    int epoll_fd = -1;
+    std::vector<Connection> connections;
+    std::vector<Event> timeline;
+    ReplayReport totals;
+};
+
+ReplayWorker::ReplayWorker(const ReplayOptions &options,
+                           std::vector<const ReplaySession *> sessions,
+                           Clock::time_point origin)
+    : options(options), origin(origin) {
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    connections.resize(sessions.size());
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        connections[i].session = sessions[i];
+        timeline.push_back({scaled(sessions[i]->open_us), i, true});
+        for (const auto &chunk : sessions[i]->chunks) {
+            timeline.push_back({scaled(chunk.at_us), i, false});
+        }
+    }
+    // Stable, so a connection's own events keep their captured order.
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const Event &a, const Event &b) {
+                         return a.due_ns < b.due_ns;
+                     });
+}
+
+ReplayWorker::~ReplayWorker() {
+    for (auto &conn : connections) {
+        if (conn.fd >= 0) {
+            close(conn.fd);
+        }
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+}
+
+void ReplayWorker::fail(Connection &conn) {
+    if (!conn.failed) {
+        ++totals.connection_errors;
+    }
+    conn.failed = true;
+    if (conn.fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conn.fd = -1;
+    }
+}
+
+void ReplayWorker::fire(const Event &event) {
+    Connection &conn = connections[event.connection];
+    if (event.open) {
+        conn.fd = open_connection(options);
+        if (conn.fd < 0) {
+            conn.failed = true;
+            ++totals.connection_errors;
+            return;
+        }
+        ++totals.connections;
+        struct epoll_event interest{};
+        interest.events = EPOLLIN;
+        interest.data.u64 = event.connection;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &interest);
+        return;
+    }
+
+    const std::string &bytes = conn.session->chunks[conn.chunks_queued].bytes;
+    ++conn.chunks_queued;
+    if (conn.fd < 0) {
+        return;
+    }
+    conn.output += bytes;
+    totals.bytes_sent += bytes.size();
+    flush(conn);
+}
+
+void ReplayWorker::flush(Connection &conn) {
+    while (conn.output_offset < conn.output.size()) {
+        ssize_t sent = send(conn.fd, conn.output.data() + conn.output_offset,
+                            conn.output.size() - conn.output_offset,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            fail(conn);
+            return;
+        }
+        conn.output_offset += sent;
+    }
+    if (conn.output_offset == conn.output.size()) {
+        conn.output.clear();
+        conn.output_offset = 0;
+    }
+
+    struct epoll_event interest{};
+    interest.events = EPOLLIN;
+    if (!conn.output.empty()) {
+        interest.events |= EPOLLOUT;
+    }
+    interest.data.u64 = static_cast<uint64_t>(&conn - connections.data());
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &interest);
+}
+
+void ReplayWorker::compare(Connection &conn, int status, uint64_t length) {
+    const auto &expected = conn.session->expected;
+    size_t index = conn.received++;
+    if (index >= expected.size()) {
+        ++totals.unexpected;
+        return;
+    }
+    ++totals.responses;
+
+    bool status_differs = expected[index].status != status;
+    bool length_differs = expected[index].length != length;
+    totals.status_mismatches += status_differs;
+    totals.length_mismatches += !status_differs && length_differs;
+    if ((status_differs || length_differs) &&
+        totals.samples.size() < MAX_SAMPLES) {
+        totals.samples.push_back(
+            "connection " + std::to_string(conn.session->connection_id) +
+            " response " + std::to_string(index) + ": captured " +
+            std::to_string(expected[index].status) + " (" +
+            std::to_string(expected[index].length) + " bytes), got " +
+            std::to_string(status) + " (" + std::to_string(length) +
+            " bytes)");
+    }
+}
+
+void ReplayWorker::receive(Connection &conn) {
+    char buffer[16 * 1024];
+    bool closed = false;
+    while (true) {
+        ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (received == 0) {
+            closed = true;
+            break;
+        }
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closed = true;
+            }
+            break;
+        }
+        // After an upgrade the server sends WebSocket frames; drop them.
+        if (!conn.upgraded) {
+            conn.input.append(buffer, received);
+        }
+    }
+
+    // Responses are framed like HttpClient frames them, and compared by
+    // their size on the wire, which is what the capture recorded.
+    size_t consumed = 0;
+    while (!conn.upgraded && consumed < conn.input.size()) {
+        std::string_view pending(conn.input);
+        pending.remove_prefix(consumed);
+        if (!conn.body) {
+            size_t head_end = pending.find("\r\n\r\n");
+            if (head_end == std::string_view::npos) {
+                break;
+            }
+            std::string head(pending.substr(0, head_end + 4));
+            consumed += head.size();
+            HttpResponse response = HttpResponse::parse(head);
+            // Interim responses such as 100 Continue are not captured.
+            if (response.status_code >= 100 && response.status_code < 200 &&
+                response.status_code != 101) {
+                continue;
+            }
+
+            const auto &expected = conn.session->expected;
+            bool head_only = conn.received < expected.size() &&
+                             expected[conn.received].head_only;
+            conn.status = response.status_code;
+            conn.length = head.size();
+            // An event stream never ends; only its head was captured.
+            if (conn.status == 101 ||
+                response.get_header("content-type")
+                        .rfind("text/event-stream", 0) == 0) {
+                compare(conn, conn.status, conn.length);
+                conn.upgraded = true;
+                break;
+            }
+            try {
+                conn.body.emplace(
+                    response_body_framing(head, conn.status, head_only));
+            } catch (const std::runtime_error &) {
+                fail(conn);
+                return;
+            }
+        } else {
+            size_t used;
+            try {
+                used = conn.body->feed(pending, [](std::string_view) {});
+            } catch (const std::runtime_error &) {
+                fail(conn);
+                return;
+            }
+            consumed += used;
+            conn.length += used;
+        }
+        if (conn.body->done()) {
+            compare(conn, conn.status, conn.length);
+            conn.body.reset();
+        }
+    }
+    conn.input.erase(0, consumed);
+
+    if (closed) {
+        // A body without a length ends here; one that was cut short is
+        // compared as it is and counts as a length mismatch.
+        if (conn.body) {
+            compare(conn, conn.status, conn.length);
+            conn.body.reset();
+        }
+        // The server may close after its last response; that only counts
+        // as a failure if captured bytes were still to be sent.
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conn.fd = -1;
+        if (conn.chunks_queued < conn.session->chunks.size()) {
+            conn.failed = true;
+            ++totals.connection_errors;
+        }
+    }
+}
+
+void ReplayWorker::wait(uint64_t until_ns) {
+    uint64_t now = elapsed_ns();
+    int timeout_ms = 0;
+    if (until_ns > now) {
+        timeout_ms = static_cast<int>((until_ns - now) / 1'000'000);
+    }
+
+    struct epoll_event events[64];
+    int ready = epoll_wait(epoll_fd, events, 64, timeout_ms);
+    for (int i = 0; i < ready; ++i) {
+        Connection &conn = connections[events[i].data.u64];
+        if (conn.fd < 0) {
+            continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            receive(conn);
+        }
+        if (conn.fd >= 0 && (events[i].events & EPOLLOUT)) {
+            flush(conn);
+        }
+    }
+}
+
+void ReplayWorker::run(ReplayReport &report) {
+    std::this_thread::sleep_until(origin);
+
+    size_t next = 0;
+    uint64_t last_due = timeline.empty() ? 0 : timeline.back().due_ns;
+    while (true) {
+        uint64_t now = elapsed_ns();
+        while (next < timeline.size() && timeline[next].due_ns <= now) {
+            fire(timeline[next++]);
+        }
+
+        bool done = next == timeline.size();
+        for (auto &conn : connections) {
+            if (conn.fd >= 0 && finished(conn)) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                close(conn.fd);
+                conn.fd = -1;
+            }
+            done = done && finished(conn);
+        }
+        if (done || (next == timeline.size() &&
+                     now > last_due + DRAIN_TIMEOUT_NS)) {
+            break;
+        }
+
+        wait(next < timeline.size() ? timeline[next].due_ns
+                                    : last_due + DRAIN_TIMEOUT_NS);
+    }
+
+    for (const auto &conn : connections) {
+        const ReplaySession &session = *conn.session;
+        if (!conn.upgraded && conn.received < session.expected.size()) {
+            totals.missing += session.expected.size() - conn.received;
+        }
+        totals.requests += session.expected.size();
+    }
+
+    report.connections += totals.connections;
+    report.requests += totals.requests;
+    report.bytes_sent += totals.bytes_sent;
+    report.responses += totals.responses;
+    report.status_mismatches += totals.status_mismatches;
+    report.length_mismatches += totals.length_mismatches;
+    report.missing += totals.missing;
+    report.unexpected += totals.unexpected;
+    report.connection_errors += totals.connection_errors;
+    report.samples.insert(report.samples.end(), totals.samples.begin(),
+                          totals.samples.end());
+}
+
+/////////////////////////////////
+// Driver
+/////////////////////////////////
+
+ReplayReport run_replay(const ReplayOptions &options) {
+    std::vector<ReplaySession> sessions = load_capture(options.capture_path);
+
+    size_t thread_count = std::max<size_t>(
+        1, std::min(options.threads, sessions.size()));
+    std::vector<std::vector<const ReplaySession *>> shares(thread_count);
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        shares[i % thread_count].push_back(&sessions[i]);
+    }
+
+    std::vector<ReplayReport> reports(thread_count);
+    std::vector<std::exception_ptr> failures(thread_count);
+    std::vector<std::thread> threads;
+    Clock::time_point origin = Clock::now() + std::chrono::milliseconds(100);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                ReplayWorker worker(options, shares[i], origin);
+                worker.run(reports[i]);
+            } catch (...) {
+                failures[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &failure : failures) {
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    ReplayReport total;
+    for (auto &report : reports) {
+        total.connections += report.connections;
+        total.requests += report.requests;
+        total.bytes_sent += report.bytes_sent;
+        total.responses += report.responses;
+        total.status_mismatches += report.status_mismatches;
+        total.length_mismatches += report.length_mismatches;
+        total.missing += report.missing;
+        total.unexpected += report.unexpected;
+        total.connection_errors += report.connection_errors;
+        for (auto &sample : report.samples) {
+            if (total.samples.size() < MAX_SAMPLES) {
+                total.samples.push_back(std::move(sample));
+            }
+        }
+    }
+    total.elapsed_seconds =
+        std::chrono::duration<double>(Clock::now() - origin).count();
+    return total;
+}
+
+void print_replay_report(const ReplayOptions &options,
+                         const ReplayReport &report) {
+    std::cout << "Replay of " << options.capture_path << " against "
+              << options.host << ":" << options.port << " at ";
+    if (options.speed == 0) {
+        std::cout << "full speed";
+    } else {
+        std::cout << options.speed << "x captured pace";
+    }
+    std::cout << ", " << options.threads << " threads\n\n";
+
+    double rate = report.elapsed_seconds > 0
+                      ? report.responses / report.elapsed_seconds
+                      : 0.0;
+    std::cout << "  connections        " << report.connections << "\n"
+              << "  requests           " << report.requests << "\n"
+              << "  bytes sent         " << report.bytes_sent << "\n"
+              << "  responses          " << report.responses << "\n"
+              << "  elapsed            " << report.elapsed_seconds << " s\n"
+              << "  rate               " << static_cast<uint64_t>(rate)
+              << " responses/s\n\n"
+              << "  status mismatches  " << report.status_mismatches << "\n"
+              << "  length mismatches  " << report.length_mismatches << "\n"
+              << "  missing            " << report.missing << "\n"
+              << "  unexpected         " << report.unexpected << "\n"
+              << "  connection errors  " << report.connection_errors << "\n";
+
+    for (const auto &sample : report.samples) {
+        std::cout << "  " << sample << "\n";
+    }
+    std::cout << (report.matches() ? "\nResponses match the capture\n"
+                                   : "\nResponses differ from the capture\n");
+}
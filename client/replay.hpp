@@ -0,0 +1,60 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// Capture Replay
+/////////////////////////////////
+
+// Options for `client --replay <capture>`.
+struct ReplayOptions {
+    std::string capture_path;
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    // 1 replays at the captured pace, 2 twice as fast, and so on; 0 sends
+    // everything as fast as the server takes it.
+    double speed = 1.0;
+    size_t threads = 1;
+};
+
+struct ReplayReport {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t responses = 0;           // received and compared
+    uint64_t status_mismatches = 0;
+    uint64_t length_mismatches = 0;
+    uint64_t missing = 0;             // captured but never received
+    uint64_t unexpected = 0;          // received but not captured
+    uint64_t connection_errors = 0;   // connect or send failures
+    double elapsed_seconds = 0;
+    // The first few differences, for the report.
+    std::vector<std::string> samples;
+
+    bool matches() const {
+        return status_mismatches == 0 && length_mismatches == 0 &&
+               missing == 0 && unexpected == 0 && connection_errors == 0;
+    }
+};
+
+// Parses the arguments following `--replay`. Returns false and prints usage
+// on anything it does not understand.
+bool parse_replay_options(int argc, char *argv[], ReplayOptions &options);
+
+// Opens one connection per captured connection, sends the captured bytes in
+// their original recv() sized chunks and relative timing (scaled by
+// `speed`), and compares each response's status and length with what the
+// server answered when the traffic was captured. Responses are compared
+// until a connection upgrades to WebSocket; frames after that are sent but
+// not checked. Throws std::runtime_error if the capture cannot be read.
+ReplayReport run_replay(const ReplayOptions &options);
+
+void print_replay_report(const ReplayOptions &options,
+                         const ReplayReport &report);
@@ -0,0 +1,131 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "admission.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/////////////////////////////////
+// Rate Limiter
+/////////////////////////////////
+
+RateLimiter::RateLimiter(double rate, double burst, size_t max_clients)
+    : rate(rate), burst(std::max(burst, 1.0)), max_clients(max_clients) {}
+
+void RateLimiter::refill(Bucket &bucket,
+                         std::chrono::steady_clock::time_point now) const {
+    std::chrono::duration<double> elapsed = now - bucket.updated;
+    if (elapsed.count() > 0) {
+        bucket.tokens =
+            std::min(burst, bucket.tokens + elapsed.count() * rate);
+        bucket.updated = now;
+    }
+}
+
+bool RateLimiter::try_acquire(const std::string &client,
+                              std::chrono::steady_clock::time_point now) {
+    auto found = buckets.find(client);
+    if (found == buckets.end()) {
+        if (buckets.size() >= max_clients) {
+            evict(now);
+        }
+        found = buckets.emplace(client, Bucket{burst, now}).first;
+    }
+    Bucket &bucket = found->second;
+    refill(bucket, now);
+    if (bucket.tokens < 1) {
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+// A full bucket is the same as no bucket. When every one is still in use,
+// they are all dropped: better to forget the limits for a moment than to
+// grow without bound.
+void RateLimiter::evict(std::chrono::steady_clock::time_point now) {
+    for (auto it = buckets.begin(); it != buckets.end();) {
+        refill(it->second, now);
+        if (it->second.tokens >= burst) {
+            it = buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (buckets.size() >= max_clients) {
+        buckets.clear();
+    }
+}
+
+/////////////////////////////////
+// Concurrency Limiter
+/////////////////////////////////
+
+ConcurrencyLimiter::ConcurrencyLimiter(Options options)
+    : options(options),
+      current_limit(static_cast<double>(std::clamp(
+          options.initial_limit, options.min_limit, options.max_limit))) {}
+
+bool ConcurrencyLimiter::try_acquire() {
+    if (active >= limit()) {
+        return false;
+    }
+    ++active;
+    peak_in_flight = std::max(peak_in_flight, active);
+    return true;
+}
+
+void ConcurrencyLimiter::release(std::chrono::microseconds latency,
+                                 bool sample) {
+    if (active > 0) {
+        --active;
+    }
+    if (probing && active < options.min_limit) {
+        probe_drained = true;
+    }
+    if (!sample || (probing && !probe_drained)) {
+        return;
+    }
+    latency_sum += static_cast<double>(std::max<int64_t>(latency.count(), 1));
+    if (++samples < options.window) {
+        return;
+    }
+    update(latency_sum / static_cast<double>(samples));
+    samples = 0;
+    latency_sum = 0;
+    peak_in_flight = active;
+}
+
+void ConcurrencyLimiter::update(double latency) {
+    if (probing) {
+        baseline = latency;
+        probing = false;
+        current_limit = limit_before_probe;
+        return;
+    }
+    if (baseline == 0 || latency < baseline) {
+        baseline = latency;
+    }
+    if (++windows % options.probe_interval == 0) {
+        probing = true;
+        probe_drained = false;
+        limit_before_probe = current_limit;
+        current_limit = static_cast<double>(options.min_limit);
+        return;
+    }
+
+    double gradient =
+        std::clamp(options.tolerance * baseline / latency, 0.5, 1.0);
+    // A window that never came near the limit cannot say whether more
+    // would have been fine, so the limit only grows when it was used.
+    if (gradient >= 1.0 &&
+        static_cast<double>(peak_in_flight) < current_limit / 2) {
+        return;
+    }
+    double target = current_limit * gradient + std::sqrt(current_limit);
+    current_limit = std::clamp(current_limit * 0.8 + target * 0.2,
+                               static_cast<double>(options.min_limit),
+                               static_cast<double>(options.max_limit));
+}
@@ -0,0 +1,110 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+/////////////////////////////////
+// Rate Limiter
+/////////////////////////////////
+
+// One token bucket per client: each request takes a token, and tokens come
+// back at `rate` per second up to `burst`. Buckets that have filled up
+// again are forgotten once more than `max_clients` are tracked, so a flood
+// of addresses costs bounded memory. Used from one thread.
+class RateLimiter {
+  public:
+    RateLimiter(double rate, double burst, size_t max_clients = 100000);
+
+    // Takes a token from `client`'s bucket; false when it is empty.
+    bool try_acquire(const std::string &client,
+                     std::chrono::steady_clock::time_point now =
+                         std::chrono::steady_clock::now());
+
+    size_t tracked() const { return buckets.size(); }
+
+  private:
+    struct Bucket {
+        double tokens;
+        std::chrono::steady_clock::time_point updated;
+    };
+
+    void refill(Bucket &bucket,
+                std::chrono::steady_clock::time_point now) const;
+    void evict(std::chrono::steady_clock::time_point now);
+
+    double rate;
+    double burst;
+    size_t max_clients;
+    std::unordered_map<std::string, Bucket> buckets;
+};
+
+/////////////////////////////////
+// Concurrency Limiter
+/////////////////////////////////
+
+// Caps the requests in flight at a limit that follows measured latency
+// (the gradient scheme of Netflix's concurrency-limits). The baseline is
+// the lowest windowed average latency seen. Once a window's average is
+// more than `tolerance` times the baseline the limit shrinks in proportion;
+// otherwise it grows by about its square root, which leaves a little
+// queueing to detect more capacity. So under overload the excess is
+// refused up front while the requests admitted keep their latency, instead
+// of everyone queueing behind everyone else.
+//
+// Every `probe_interval` windows the limit drops to the minimum for one
+// window and the baseline is measured afresh, so it follows a workload
+// that has really become slower rather than only ever falling.
+//
+// Used from one thread: the server acquires on the I/O thread and releases
+// from completions, which run there too.
+class ConcurrencyLimiter {
+  public:
+    struct Options {
+        size_t initial_limit = 32;
+        size_t min_limit = 4;
+        size_t max_limit = 1024;
+        double tolerance = 2.0;
+        // Latency samples per limit update.
+        size_t window = 64;
+        size_t probe_interval = 256;
+    };
+
+    ConcurrencyLimiter() : ConcurrencyLimiter(Options{}) {}
+    explicit ConcurrencyLimiter(Options options);
+
+    // Admits a request if fewer than limit() are in flight.
+    bool try_acquire();
+
+    // Ends an admitted request. Failed requests should not be sampled:
+    // their latency says nothing about load.
+    void release(std::chrono::microseconds latency, bool sample = true);
+
+    size_t limit() const { return static_cast<size_t>(current_limit); }
+    size_t in_flight() const { return active; }
+
+  private:
+    void update(double latency);
+
+    Options options;
+    double current_limit;
+    size_t active = 0;
+    double baseline = 0;
+    size_t windows = 0;
+
+    // While probing, samples only count once the requests admitted under the
+    // old limit have drained.
+    bool probing = false;
+    bool probe_drained = false;
+    double limit_before_probe = 0;
+
+    // The window being collected.
+    size_t samples = 0;
+    double latency_sum = 0;
+    size_t peak_in_flight = 0;
+};
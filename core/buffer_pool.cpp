@@ -0,0 +1,150 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <cstring>
+
+#include "buffer_pool.hpp"
+
+struct BufferPool::ThreadCache {
+    std::array<std::vector<char *>, SIZE_CLASSES.size()> cached;
+
+    // Buffers cached by a thread that exits go back to the global list
+    // instead of leaking with the thread.
+    ~ThreadCache() {
+        for (size_t size_class = 0; size_class < cached.size();
+             ++size_class) {
+            BufferPool::instance().spill(cached[size_class], size_class,
+                                         cached[size_class].size());
+        }
+    }
+};
+
+BufferPool &BufferPool::instance() {
+    // Deliberately never destroyed: thread caches of threads that outlive
+    // main() still need somewhere to return their buffers to.
+    static BufferPool *pool = new BufferPool();
+    return *pool;
+}
+
+BufferPool::ThreadCache &BufferPool::thread_cache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t min_size) {
+    size_t size_class = SIZE_CLASSES.size() - 1;
+    for (size_t i = 0; i < SIZE_CLASSES.size(); ++i) {
+        if (SIZE_CLASSES[i] >= min_size) {
+            size_class = i;
+            break;
+        }
+    }
+
+    std::vector<char *> &cached = thread_cache().cached[size_class];
+    if (cached.empty()) {
+        refill(thread_cache(), size_class);
+    }
+
+    char *memory;
+    if (!cached.empty()) {
+        memory = cached.back();
+        cached.pop_back();
+    } else {
+        memory = new char[SIZE_CLASSES[size_class]];
+    }
+
+    handed_out.fetch_add(1, std::memory_order_relaxed);
+    return Buffer(memory, size_class);
+}
+
+BufferPool::Buffer BufferPool::grow(Buffer buffer) {
+    if (!buffer.valid()) {
+        return acquire();
+    }
+    if (buffer.size_class + 1 >= SIZE_CLASSES.size()) {
+        return buffer;
+    }
+
+    Buffer bigger = acquire(SIZE_CLASSES[buffer.size_class + 1]);
+    std::memcpy(bigger.data(), buffer.data(), buffer.size);
+    bigger.size = buffer.size;
+    return bigger;
+}
+
+void BufferPool::give_back(char *memory, size_t size_class) {
+    handed_out.fetch_sub(1, std::memory_order_relaxed);
+
+    std::vector<char *> &cached = thread_cache().cached[size_class];
+    cached.push_back(memory);
+    if (cached.size() > THREAD_CACHE_LIMIT) {
+        spill(cached, size_class, cached.size() - THREAD_CACHE_LIMIT / 2);
+    }
+}
+
+void BufferPool::refill(ThreadCache &cache, size_t size_class) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<char *> &free_list = free_lists[size_class];
+    while (!free_list.empty() &&
+           cache.cached[size_class].size() < TRANSFER_BATCH) {
+        cache.cached[size_class].push_back(free_list.back());
+        free_list.pop_back();
+        retained -= SIZE_CLASSES[size_class];
+    }
+}
+
+void BufferPool::spill(std::vector<char *> &cached, size_t size_class,
+                       size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < count && !cached.empty(); ++i) {
+        char *memory = cached.back();
+        cached.pop_back();
+        if (retained + SIZE_CLASSES[size_class] <= max_retained_bytes) {
+            free_lists[size_class].push_back(memory);
+            retained += SIZE_CLASSES[size_class];
+        } else {
+            delete[] memory;
+        }
+    }
+}
+
+size_t BufferPool::outstanding() const {
+    return handed_out.load(std::memory_order_relaxed);
+}
+
+size_t BufferPool::retained_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return retained;
+}
+
+void BufferPool::set_max_retained_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    max_retained_bytes = bytes;
+}
+
+BufferPool::Buffer &BufferPool::Buffer::operator=(Buffer &&other) noexcept {
+    if (this != &other) {
+        release();
+        memory = std::exchange(other.memory, nullptr);
+        size_class = other.size_class;
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::consume(size_t count) {
+    if (count >= size) {
+        size = 0;
+        return;
+    }
+    std::memmove(memory, memory + count, size - count);
+    size -= count;
+}
+
+void BufferPool::Buffer::release() {
+    if (memory != nullptr) {
+        BufferPool::instance().give_back(memory, size_class);
+        memory = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,106 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/////////////////////////////////
+// I/O Buffer Pool
+/////////////////////////////////
+
+// Process-wide pool of fixed-size I/O buffers in three size classes.
+//
+// Connections borrow a buffer only while bytes are actually in flight (a
+// recv() in progress, or a request that has not fully arrived yet) and give
+// it back as soon as the data is consumed. An idle keep-alive connection
+// therefore holds no buffer at all, and 100k of them cost the connection
+// bookkeeping, not 100k * buffer size.
+//
+// Each thread keeps a small cache per size class, so the common
+// acquire/release pair on one thread never touches a lock. Caches refill
+// from and spill to a mutex-protected global free list in batches, and the
+// global list keeps at most `max_retained_bytes` around; anything beyond
+// that goes back to the allocator.
+class BufferPool {
+  public:
+    static constexpr std::array<size_t, 3> SIZE_CLASSES = {4 * 1024, 16 * 1024,
+                                                           64 * 1024};
+    static constexpr size_t THREAD_CACHE_LIMIT = 32;
+    static constexpr size_t TRANSFER_BATCH = 8;
+
+    // Move-only handle to one pooled buffer. Returns the memory to the pool
+    // on destruction. `size` tracks how many bytes are valid.
+    class Buffer {
+      public:
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept { *this = std::move(other); }
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+        ~Buffer() { release(); }
+
+        char *data() { return memory; }
+        const char *data() const { return memory; }
+        size_t capacity() const {
+            return memory ? SIZE_CLASSES[size_class] : 0;
+        }
+        bool valid() const { return memory != nullptr; }
+
+        // Space after the valid bytes, where the next recv() goes.
+        char *tail() { return memory + size; }
+        size_t tail_room() const { return capacity() - size; }
+
+        // Drops the first `count` valid bytes, moving the rest to the front.
+        void consume(size_t count);
+        void release();
+
+        size_t size = 0;
+
+      private:
+        friend class BufferPool;
+        Buffer(char *memory, size_t size_class)
+            : memory(memory), size_class(size_class) {}
+
+        char *memory = nullptr;
+        size_t size_class = 0;
+    };
+
+    static BufferPool &instance();
+
+    // Smallest class that fits `min_size`; requests above the largest class
+    // are clamped to it.
+    Buffer acquire(size_t min_size = SIZE_CLASSES[0]);
+
+    // Returns a buffer of the next larger class holding the same bytes, or
+    // the same buffer when it is already the largest.
+    Buffer grow(Buffer buffer);
+
+    // Buffers currently handed out, across all threads.
+    size_t outstanding() const;
+    size_t retained_bytes() const;
+
+    void set_max_retained_bytes(size_t bytes);
+
+  private:
+    BufferPool() = default;
+
+    struct ThreadCache;
+    static ThreadCache &thread_cache();
+
+    void give_back(char *memory, size_t size_class);
+    void refill(ThreadCache &cache, size_t size_class);
+    void spill(std::vector<char *> &cached, size_t size_class, size_t count);
+
+    mutable std::mutex mutex;
+    std::array<std::vector<char *>, SIZE_CLASSES.size()> free_lists;
+    size_t retained = 0;
+    size_t max_retained_bytes = 64 * 1024 * 1024;
+    std::atomic<size_t> handed_out{0};
+};
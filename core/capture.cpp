@@ -0,0 +1,172 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <cstring>
+#include <stdexcept>
+
+#include "capture.hpp"
+
+static constexpr char CAPTURE_MAGIC[8] = {'W', 'S', 'C', 'A',
+                                          'P', '0', '0', '1'};
+
+// Far above any single recv(); a larger length means a corrupt file.
+static constexpr uint64_t MAX_RECORD_BYTES = 64 * 1024 * 1024;
+
+/////////////////////////////////
+// Writer
+/////////////////////////////////
+
+CaptureWriter::CaptureWriter(const std::string &path)
+    : file(path, std::ios::binary | std::ios::trunc),
+      origin(std::chrono::steady_clock::now()) {
+    if (!file) {
+        throw std::runtime_error("Cannot open capture file: " + path);
+    }
+    buffer.append(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+}
+
+CaptureWriter::~CaptureWriter() { flush(); }
+
+void CaptureWriter::put_varint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer += static_cast<char>(value);
+}
+
+void CaptureWriter::begin(CaptureRecordType type, uint64_t connection_id) {
+    uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - origin)
+                          .count();
+    buffer += static_cast<char>(type);
+    put_varint(connection_id);
+    put_varint(now_us - last_us);
+    last_us = now_us;
+    ++record_count;
+}
+
+void CaptureWriter::open(uint64_t connection_id) {
+    if (failed) {
+        return;
+    }
+    begin(CaptureRecordType::OPEN, connection_id);
+}
+
+void CaptureWriter::request(uint64_t connection_id, std::string_view bytes) {
+    if (failed) {
+        return;
+    }
+    begin(CaptureRecordType::REQUEST, connection_id);
+    put_varint(bytes.size());
+    buffer.append(bytes);
+    if (buffer.size() >= FLUSH_THRESHOLD) {
+        flush();
+    }
+}
+
+void CaptureWriter::response(uint64_t connection_id, int status,
+                             uint64_t length) {
+    if (failed) {
+        return;
+    }
+    begin(CaptureRecordType::RESPONSE, connection_id);
+    put_varint(static_cast<uint64_t>(status));
+    put_varint(length);
+}
+
+void CaptureWriter::close(uint64_t connection_id) {
+    if (failed) {
+        return;
+    }
+    begin(CaptureRecordType::CLOSE, connection_id);
+}
+
+bool CaptureWriter::flush() {
+    if (failed) {
+        return false;
+    }
+    if (!buffer.empty()) {
+        file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    file.flush();
+    failed = !file;
+    return !failed;
+}
+
+/////////////////////////////////
+// Reader
+/////////////////////////////////
+
+CaptureReader::CaptureReader(const std::string &path)
+    : file(path, std::ios::binary) {
+    if (!file) {
+        throw std::runtime_error("Cannot open capture file: " + path);
+    }
+    char magic[sizeof(CAPTURE_MAGIC)];
+    if (!file.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not a capture file: " + path);
+    }
+}
+
+bool CaptureReader::get_varint(uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int byte = file.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    throw std::runtime_error("Malformed capture file: varint too long");
+}
+
+bool CaptureReader::next(CaptureRecord &record) {
+    int type = file.get();
+    if (type == EOF) {
+        return false;
+    }
+    if (type < static_cast<int>(CaptureRecordType::OPEN) ||
+        type > static_cast<int>(CaptureRecordType::CLOSE)) {
+        throw std::runtime_error("Malformed capture file: unknown record "
+                                 "type " +
+                                 std::to_string(type));
+    }
+
+    record = CaptureRecord();
+    record.type = static_cast<CaptureRecordType>(type);
+    uint64_t delta_us = 0;
+    bool complete = get_varint(record.connection_id) && get_varint(delta_us);
+    timestamp_us += delta_us;
+    record.timestamp_us = timestamp_us;
+
+    if (complete && record.type == CaptureRecordType::REQUEST) {
+        uint64_t length;
+        complete = get_varint(length);
+        if (complete && length > MAX_RECORD_BYTES) {
+            throw std::runtime_error("Malformed capture file: record of " +
+                                     std::to_string(length) + " bytes");
+        }
+        if (complete) {
+            record.data.resize(length);
+            complete =
+                static_cast<bool>(file.read(record.data.data(), length));
+        }
+    } else if (complete && record.type == CaptureRecordType::RESPONSE) {
+        uint64_t status;
+        complete = get_varint(status) && get_varint(record.length);
+        record.status = static_cast<int>(status);
+    }
+
+    if (!complete) {
+        was_truncated = true;
+        return false;
+    }
+    return true;
+}
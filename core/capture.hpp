@@ -0,0 +1,99 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+/////////////////////////////////
+// Traffic Capture
+/////////////////////////////////
+
+// Capture files record what clients sent the server, byte for byte and
+// with the recv() boundaries and timing they arrived with, plus the status
+// and size of every response, so real traffic can be replayed against a
+// new build and the answers compared.
+//
+// Layout: the 8 byte magic "WSCAP001", then records appended back to back.
+// Every record is a type byte, the connection id and the time since the
+// previous record in microseconds, both as LEB128 varints. REQUEST records
+// add a varint length and the raw bytes; RESPONSE records add the status
+// and the response length as varints. Small requests cost a handful of
+// bytes over their own size.
+enum class CaptureRecordType : uint8_t {
+    OPEN = 1,      // connection accepted
+    REQUEST = 2,   // bytes read from the client
+    RESPONSE = 3,  // response queued: status and length
+    CLOSE = 4,     // connection closed
+};
+
+struct CaptureRecord {
+    CaptureRecordType type = CaptureRecordType::OPEN;
+    uint64_t connection_id = 0;
+    uint64_t timestamp_us = 0;  // since the capture started
+    std::string data;           // REQUEST only
+    int status = 0;             // RESPONSE only
+    uint64_t length = 0;        // RESPONSE only
+};
+
+// Buffers records in memory and appends them to the file in large writes;
+// whatever is buffered is lost if the process dies before flush(). Not
+// thread-safe; the server's I/O thread owns it.
+class CaptureWriter {
+  public:
+    static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    // Truncates `path`. Throws std::runtime_error if it cannot be opened.
+    explicit CaptureWriter(const std::string &path);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    void open(uint64_t connection_id);
+    void request(uint64_t connection_id, std::string_view bytes);
+    void response(uint64_t connection_id, int status, uint64_t length);
+    void close(uint64_t connection_id);
+
+    // Writes out everything buffered. Returns false once a write has
+    // failed; the writer then stops recording.
+    bool flush();
+    bool ok() const { return !failed; }
+    uint64_t records() const { return record_count; }
+
+  private:
+    void begin(CaptureRecordType type, uint64_t connection_id);
+    void put_varint(uint64_t value);
+
+    std::ofstream file;
+    std::string buffer;
+    std::chrono::steady_clock::time_point origin;
+    uint64_t last_us = 0;
+    uint64_t record_count = 0;
+    bool failed = false;
+};
+
+class CaptureReader {
+  public:
+    // Throws std::runtime_error if `path` cannot be opened or is not a
+    // capture file.
+    explicit CaptureReader(const std::string &path);
+
+    // Reads the next record. Returns false at the end of the file. A record
+    // cut short by a crash mid-write also ends the capture, and sets
+    // truncated().
+    bool next(CaptureRecord &record);
+    bool truncated() const { return was_truncated; }
+
+  private:
+    bool get_varint(uint64_t &value);
+
+    std::ifstream file;
+    uint64_t timestamp_us = 0;
+    bool was_truncated = false;
+};
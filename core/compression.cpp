@@ -0,0 +1,471 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#include <zlib.h>
+
+#include "compression.hpp"
+
+/////////////////////////////////
+// Content Encoding
+/////////////////////////////////
+
+std::string content_encoding_token(ContentEncoding encoding) {
+    switch (encoding) {
+    case ContentEncoding::GZIP:
+        return "gzip";
+    case ContentEncoding::BROTLI:
+        return "br";
+    default:
+        return "identity";
+    }
+}
+
+ContentEncoding
+negotiate_encoding(const std::string &accept_encoding,
+                   const std::vector<ContentEncoding> &available) {
+    bool accepts_gzip = false;
+    bool accepts_br = false;
+    // An explicit "gzip;q=0" holds even when "*" accepts everything else.
+    bool refuses_gzip = false;
+    bool refuses_br = false;
+
+    size_t start = 0;
+    while (start < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', start);
+        if (end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        std::string item = accept_encoding.substr(start, end - start);
+        start = end + 1;
+
+        std::string token = item.substr(0, item.find(';'));
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        std::transform(token.begin(), token.end(), token.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+
+        // "gzip;q=0" explicitly refuses gzip, any other weight accepts it.
+        bool refused = false;
+        size_t q_pos = item.find("q=");
+        if (q_pos != std::string::npos) {
+            refused = std::strtod(item.c_str() + q_pos + 2, nullptr) <= 0.0;
+        }
+        if (token == "gzip" || token == "x-gzip") {
+            refuses_gzip |= refused;
+            accepts_gzip |= !refused;
+        } else if (token == "br") {
+            refuses_br |= refused;
+            accepts_br |= !refused;
+        } else if (token == "*" && !refused) {
+            accepts_gzip = true;
+            accepts_br = true;
+        }
+    }
+
+    auto has = [&available](ContentEncoding encoding) {
+        return std::find(available.begin(), available.end(), encoding) !=
+               available.end();
+    };
+
+    if (accepts_br && !refuses_br && has(ContentEncoding::BROTLI)) {
+        return ContentEncoding::BROTLI;
+    }
+    if (accepts_gzip && !refuses_gzip && has(ContentEncoding::GZIP)) {
+        return ContentEncoding::GZIP;
+    }
+    return ContentEncoding::IDENTITY;
+}
+
+/////////////////////////////////
+// Compressor
+/////////////////////////////////
+
+// zlib writes the gzip header and trailer when 16 is added to the window
+// bits; inflate() detects gzip or zlib when 32 is.
+constexpr int GZIP_WINDOW_BITS = 15 + 16;
+constexpr int AUTO_WINDOW_BITS = 15 + 32;
+
+static int brotli_quality(int level) { return std::clamp(level / 2 + 1, 1, 5); }
+
+Compressor::Compressor(ContentEncoding encoding, int level)
+    : encoding(encoding) {
+    level = std::clamp(level, 1, 9);
+    if (encoding == ContentEncoding::GZIP) {
+        zlib = std::make_unique<z_stream>();
+        if (deflateInit2(zlib.get(), level, Z_DEFLATED, GZIP_WINDOW_BITS, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            zlib.reset();
+            throw std::runtime_error("Cannot initialize gzip compressor");
+        }
+    } else if (encoding == ContentEncoding::BROTLI) {
+        brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (brotli == nullptr) {
+            throw std::runtime_error("Cannot initialize brotli compressor");
+        }
+        BrotliEncoderSetParameter(brotli, BROTLI_PARAM_QUALITY,
+                                  brotli_quality(level));
+    }
+}
+
+Compressor::~Compressor() {
+    if (zlib) {
+        deflateEnd(zlib.get());
+    }
+    if (brotli != nullptr) {
+        BrotliEncoderDestroyInstance(brotli);
+    }
+}
+
+void Compressor::write(std::string_view input, std::string &output) {
+    run(input, Mode::PROCESS, output);
+}
+
+void Compressor::flush(std::string &output) { run({}, Mode::FLUSH, output); }
+
+void Compressor::finish(std::string &output) {
+    run({}, Mode::FINISH, output);
+}
+
+void Compressor::run(std::string_view input, Mode mode, std::string &output) {
+    if (encoding == ContentEncoding::IDENTITY) {
+        output.append(input);
+        return;
+    }
+    char buffer[16384];
+
+    if (zlib) {
+        int flush = mode == Mode::PROCESS ? Z_NO_FLUSH
+                    : mode == Mode::FLUSH ? Z_SYNC_FLUSH
+                                          : Z_FINISH;
+        zlib->next_in =
+            reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        zlib->avail_in = static_cast<uInt>(input.size());
+        while (true) {
+            zlib->next_out = reinterpret_cast<Bytef *>(buffer);
+            zlib->avail_out = sizeof(buffer);
+            int result = deflate(zlib.get(), flush);
+            if (result == Z_STREAM_ERROR) {
+                throw std::runtime_error("gzip compression failed");
+            }
+            output.append(buffer, sizeof(buffer) - zlib->avail_out);
+            // Room left over means deflate() has nothing more to give,
+            // except that finishing is only done once it says so.
+            if (flush == Z_FINISH ? result == Z_STREAM_END
+                                  : zlib->avail_out != 0) {
+                return;
+            }
+        }
+    }
+
+    BrotliEncoderOperation operation =
+        mode == Mode::PROCESS ? BROTLI_OPERATION_PROCESS
+        : mode == Mode::FLUSH ? BROTLI_OPERATION_FLUSH
+                              : BROTLI_OPERATION_FINISH;
+    size_t available_in = input.size();
+    const uint8_t *next_in = reinterpret_cast<const uint8_t *>(input.data());
+    while (true) {
+        size_t available_out = sizeof(buffer);
+        uint8_t *next_out = reinterpret_cast<uint8_t *>(buffer);
+        if (!BrotliEncoderCompressStream(brotli, operation, &available_in,
+                                         &next_in, &available_out, &next_out,
+                                         nullptr)) {
+            throw std::runtime_error("brotli compression failed");
+        }
+        output.append(buffer, sizeof(buffer) - available_out);
+        bool done = mode == Mode::FINISH
+                        ? BrotliEncoderIsFinished(brotli)
+                        : available_in == 0 &&
+                              !BrotliEncoderHasMoreOutput(brotli);
+        if (done) {
+            return;
+        }
+    }
+}
+
+std::string compress(std::string_view data, ContentEncoding encoding,
+                     int level) {
+    Compressor compressor(encoding, level);
+    std::string output;
+    compressor.write(data, output);
+    compressor.finish(output);
+    return output;
+}
+
+std::string decompress(std::string_view data, ContentEncoding encoding) {
+    std::string output;
+    char buffer[16384];
+
+    if (encoding == ContentEncoding::GZIP) {
+        z_stream stream{};
+        if (inflateInit2(&stream, AUTO_WINDOW_BITS) != Z_OK) {
+            throw std::runtime_error("Cannot initialize gzip decompressor");
+        }
+        stream.next_in =
+            reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        int result = Z_OK;
+        while (result != Z_STREAM_END) {
+            stream.next_out = reinterpret_cast<Bytef *>(buffer);
+            stream.avail_out = sizeof(buffer);
+            result = inflate(&stream, Z_NO_FLUSH);
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                inflateEnd(&stream);
+                throw std::runtime_error("Corrupt or truncated gzip data");
+            }
+        }
+        inflateEnd(&stream);
+        return output;
+    }
+
+    if (encoding == ContentEncoding::BROTLI) {
+        BrotliDecoderState *state =
+            BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        if (state == nullptr) {
+            throw std::runtime_error("Cannot initialize brotli decompressor");
+        }
+        size_t available_in = data.size();
+        const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data.data());
+        BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+        while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+            size_t available_out = sizeof(buffer);
+            uint8_t *next_out = reinterpret_cast<uint8_t *>(buffer);
+            result = BrotliDecoderDecompressStream(state, &available_in,
+                                                   &next_in, &available_out,
+                                                   &next_out, nullptr);
+            output.append(buffer, sizeof(buffer) - available_out);
+        }
+        BrotliDecoderDestroyInstance(state);
+        if (result != BROTLI_DECODER_RESULT_SUCCESS) {
+            throw std::runtime_error("Corrupt or truncated brotli data");
+        }
+        return output;
+    }
+
+    return std::string(data);
+}
+
+CompressingStreambuf::CompressingStreambuf(std::ostream &sink,
+                                           ContentEncoding encoding,
+                                           int level)
+    : sink(sink), compressor(encoding, level), pending(16384) {
+    setp(pending.data(), pending.data() + pending.size());
+}
+
+CompressingStreambuf::int_type
+CompressingStreambuf::overflow(int_type character) {
+    compress_pending();
+    // Small writes keep the encoder busy without producing much; a chunk
+    // goes out once there is a buffer's worth.
+    if (compressed.size() >= pending.size()) {
+        write_chunk();
+    }
+    if (!traits_type::eq_int_type(character, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+    }
+    return traits_type::not_eof(character);
+}
+
+int CompressingStreambuf::sync() {
+    if (finished) {
+        return 0;
+    }
+    compress_pending();
+    compressor.flush(compressed);
+    write_chunk();
+    sink.flush();
+    return sink ? 0 : -1;
+}
+
+void CompressingStreambuf::finish() {
+    if (finished) {
+        return;
+    }
+    compress_pending();
+    compressor.finish(compressed);
+    write_chunk();
+    sink << "0\r\n\r\n";
+    sink.flush();
+    finished = true;
+}
+
+void CompressingStreambuf::compress_pending() {
+    compressor.write(std::string_view(pbase(), pptr() - pbase()),
+                     compressed);
+    setp(pending.data(), pending.data() + pending.size());
+}
+
+void CompressingStreambuf::write_chunk() {
+    if (compressed.empty()) {
+        return;
+    }
+    char size_line[24];
+    int length = std::snprintf(size_line, sizeof(size_line), "%zx\r\n",
+                               compressed.size());
+    sink.write(size_line, length);
+    sink.write(compressed.data(),
+               static_cast<std::streamsize>(compressed.size()));
+    sink.write("\r\n", 2);
+    compressed.clear();
+}
+
+/////////////////////////////////
+// Response Compression
+/////////////////////////////////
+
+bool is_compressible_type(std::string_view content_type) {
+    std::string type(content_type.substr(0, content_type.find(';')));
+    type.erase(0, type.find_first_not_of(" \t"));
+    type.erase(type.find_last_not_of(" \t") + 1);
+    std::transform(type.begin(), type.end(), type.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    auto ends_with = [&type](std::string_view suffix) {
+        return type.size() >= suffix.size() &&
+               type.compare(type.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+    };
+    // Covers application/json, application/xml, image/svg+xml,
+    // application/ld+json and the like.
+    return type.rfind("text/", 0) == 0 || ends_with("json") ||
+           ends_with("xml") || ends_with("javascript") ||
+           type == "application/wasm";
+}
+
+static void add_vary_accept_encoding(HttpResponse &response) {
+    std::string vary = response.get_header("vary");
+    std::string lower = vary;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (lower.find("accept-encoding") != std::string::npos || vary == "*") {
+        return;
+    }
+    response.set_header("Vary",
+                        vary.empty() ? "Accept-Encoding"
+                                     : vary + ", Accept-Encoding");
+}
+
+ContentEncoding compress_response(HttpResponse &response,
+                                  const std::string &accept_encoding,
+                                  int level, bool allow_chunked) {
+    int status = response.status_code;
+    bool streaming = response.is_streaming_response();
+    if (status < 200 || status == 204 || status == 206 || status == 304 ||
+        (streaming && !allow_chunked) ||
+        response.has_header("content-encoding") ||
+        !is_compressible_type(response.get_header("content-type"))) {
+        return ContentEncoding::IDENTITY;
+    }
+    // A streaming response announces its uncompressed length up front.
+    size_t size = streaming ? std::strtoull(
+                                  response.get_header("content-length").c_str(),
+                                  nullptr, 10)
+                            : response.body.size();
+    if (size < MIN_COMPRESSED_BODY) {
+        return ContentEncoding::IDENTITY;
+    }
+
+    add_vary_accept_encoding(response);
+    ContentEncoding encoding = negotiate_encoding(
+        accept_encoding, {ContentEncoding::BROTLI, ContentEncoding::GZIP});
+    if (encoding == ContentEncoding::IDENTITY) {
+        return encoding;
+    }
+
+    if (!streaming) {
+        std::string compressed = compress(response.body, encoding, level);
+        if (compressed.size() >= response.body.size()) {
+            return ContentEncoding::IDENTITY;
+        }
+        response.body = std::move(compressed);
+        response.set_header("Content-Encoding",
+                            content_encoding_token(encoding));
+        response.set_header("Content-Length",
+                            std::to_string(response.body.size()));
+        return encoding;
+    }
+
+    // The copy keeps the original callback; the response gets a new one
+    // that runs it through the compressor.
+    auto original = std::make_shared<const HttpResponse>(response);
+    response.set_streaming(
+        [original, encoding, level](std::ostream &os) {
+            CompressingStreambuf buffer(os, encoding, level);
+            std::ostream compressed(&buffer);
+            original->write_to_stream(compressed);
+            buffer.finish();
+        },
+        0, response.get_header("content-type"));
+    response.headers.erase("content-length");
+    response.set_header("Transfer-Encoding", "chunked");
+    response.set_header("Content-Encoding", content_encoding_token(encoding));
+    return encoding;
+}
+
+/////////////////////////////////
+// Adaptive Compression Level
+/////////////////////////////////
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL +
+           static_cast<uint64_t>(now.tv_nsec);
+}
+
+AdaptiveCompressionLevel::AdaptiveCompressionLevel(int min_level,
+                                                   int max_level,
+                                                   uint64_t interval_ms)
+    : min_level(std::clamp(min_level, 1, 9)),
+      max_level(std::clamp(max_level, this->min_level, 9)),
+      interval_ns(interval_ms * 1000000ULL),
+      cpus(std::max(1U, std::thread::hardware_concurrency())),
+      current(this->max_level),
+      next_sample_ns(clock_ns(CLOCK_MONOTONIC) + interval_ns),
+      last_cpu_ns(clock_ns(CLOCK_PROCESS_CPUTIME_ID)),
+      last_wall_ns(clock_ns(CLOCK_MONOTONIC)) {}
+
+int AdaptiveCompressionLevel::level() {
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    uint64_t due = next_sample_ns.load(std::memory_order_relaxed);
+    // Only the thread that moves the deadline takes the sample. Acquiring
+    // the deadline orders this sample after the previous sampler's stores.
+    if (now >= due &&
+        next_sample_ns.compare_exchange_strong(due, now + interval_ns,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed)) {
+        uint64_t cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+        uint64_t last_wall = last_wall_ns.load(std::memory_order_acquire);
+        uint64_t last_cpu = last_cpu_ns.load(std::memory_order_acquire);
+        double available = static_cast<double>(now - last_wall) * cpus;
+        if (available > 0 && cpu >= last_cpu) {
+            update(static_cast<double>(cpu - last_cpu) / available);
+        }
+        last_cpu_ns.store(cpu, std::memory_order_release);
+        last_wall_ns.store(now, std::memory_order_release);
+    }
+    return current.load(std::memory_order_relaxed);
+}
+
+void AdaptiveCompressionLevel::update(double utilization) {
+    int level = current.load(std::memory_order_relaxed);
+    if (utilization > HIGH_UTILIZATION) {
+        level = std::max(min_level, level - 1);
+    } else if (utilization < LOW_UTILIZATION) {
+        level = std::min(max_level, level + 1);
+    }
+    current.store(level, std::memory_order_relaxed);
+}
@@ -0,0 +1,165 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+#include "http.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct z_stream_s;
+struct BrotliEncoderStateStruct;
+
+/////////////////////////////////
+// Content Encoding
+/////////////////////////////////
+
+// Encodings a response body can be sent in.
+enum class ContentEncoding { IDENTITY, GZIP, BROTLI };
+
+std::string content_encoding_token(ContentEncoding encoding);
+
+// Picks the best encoding out of `available` that the client accepts
+// according to its Accept-Encoding header. Preference is br > gzip >
+// identity; anything with q=0 is treated as refused.
+ContentEncoding
+negotiate_encoding(const std::string &accept_encoding,
+                   const std::vector<ContentEncoding> &available);
+
+/////////////////////////////////
+// Compressor
+/////////////////////////////////
+
+// One gzip or brotli stream fed piece by piece. `level` is on zlib's 1-9
+// scale; brotli maps it onto its cheaper qualities (1-5), since its higher
+// ones are far too slow for responses built per request. IDENTITY copies
+// its input through.
+class Compressor {
+  public:
+    Compressor(ContentEncoding encoding, int level);
+    ~Compressor();
+    Compressor(const Compressor &) = delete;
+    Compressor &operator=(const Compressor &) = delete;
+
+    // Appends whatever the encoder produces for `input` to `output`; most
+    // of it stays inside the encoder until flush() or finish().
+    void write(std::string_view input, std::string &output);
+
+    // Emits everything written so far in a form the client can decode
+    // right away, without ending the stream. Costs a few bytes each time.
+    void flush(std::string &output);
+
+    // Ends the stream. Nothing may be written afterwards.
+    void finish(std::string &output);
+
+  private:
+    enum class Mode { PROCESS, FLUSH, FINISH };
+    void run(std::string_view input, Mode mode, std::string &output);
+
+    ContentEncoding encoding;
+    std::unique_ptr<z_stream_s> zlib;
+    BrotliEncoderStateStruct *brotli = nullptr;
+};
+
+// One-shot helpers around Compressor and the matching decoders.
+// decompress() throws std::runtime_error on corrupt input.
+std::string compress(std::string_view data, ContentEncoding encoding,
+                     int level);
+std::string decompress(std::string_view data, ContentEncoding encoding);
+
+// Output stream that compresses everything written to it and writes the
+// result to `sink` in chunked transfer coding. Each std::flush on the
+// stream becomes one chunk the client can decode immediately, so a
+// streaming response still reaches the client as it is produced.
+// finish() writes the last chunk and the terminating zero-size one.
+class CompressingStreambuf : public std::streambuf {
+  public:
+    CompressingStreambuf(std::ostream &sink, ContentEncoding encoding,
+                         int level);
+    void finish();
+
+  protected:
+    int_type overflow(int_type character) override;
+    int sync() override;
+
+  private:
+    void compress_pending();
+    void write_chunk();
+
+    std::ostream &sink;
+    Compressor compressor;
+    std::vector<char> pending;
+    std::string compressed;
+    bool finished = false;
+};
+
+/////////////////////////////////
+// Response Compression
+/////////////////////////////////
+
+// Bodies below this are sent as they are: the gzip header and trailer
+// alone are 18 bytes, and small responses fit in one packet anyway.
+constexpr size_t MIN_COMPRESSED_BODY = 1024;
+
+// Text, JSON, JavaScript, XML and SVG. Images, audio, video, fonts and
+// archives are already compressed and only get bigger.
+bool is_compressible_type(std::string_view content_type);
+
+// Compresses `response` with the best encoding the client accepts, if it is
+// worth it: a final status other than 204, 206 or 304, a compressible type,
+// no Content-Encoding yet and a body of at least MIN_COMPRESSED_BODY.
+// Buffered bodies are replaced and Content-Length updated, or left alone
+// when compression does not make them smaller. Streaming responses are
+// rewrapped to compress as they stream; their length is then unknown, so
+// they switch to "Transfer-Encoding: chunked" (HTTP/1.1 only, pass
+// `allow_chunked` false otherwise). Adds "Vary: Accept-Encoding" whenever
+// the result depends on that header. Returns the encoding used.
+ContentEncoding compress_response(HttpResponse &response,
+                                  const std::string &accept_encoding,
+                                  int level, bool allow_chunked = true);
+
+/////////////////////////////////
+// Adaptive Compression Level
+/////////////////////////////////
+
+// Compression level that backs off while the process is using most of the
+// machine's CPU and climbs back once it is not. level() re-samples the
+// process's CPU time at most once per interval, from whichever thread asks
+// first; the others keep reading the current value without locking.
+class AdaptiveCompressionLevel {
+  public:
+    // Above `HIGH_UTILIZATION` the level drops by one per sample, below
+    // `LOW_UTILIZATION` it rises by one.
+    static constexpr double HIGH_UTILIZATION = 0.85;
+    static constexpr double LOW_UTILIZATION = 0.60;
+
+    AdaptiveCompressionLevel(int min_level = 1, int max_level = 6,
+                             uint64_t interval_ms = 1000);
+
+    int level();
+
+    // Feeds one sample directly: busy CPU time over available CPU time.
+    void update(double utilization);
+
+    int min() const { return min_level; }
+    int max() const { return max_level; }
+
+  private:
+    int min_level;
+    int max_level;
+    uint64_t interval_ns;
+    unsigned cpus;
+    std::atomic<int> current;
+    std::atomic<uint64_t> next_sample_ns;
+    // Written by whichever thread takes a sample, so atomic too.
+    std::atomic<uint64_t> last_cpu_ns;
+    std::atomic<uint64_t> last_wall_ns;
+};
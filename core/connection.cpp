@@ -0,0 +1,443 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "connection.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+
+#include "http2.hpp"
+
+/////////////////////////////////
+// Server Connection
+/////////////////////////////////
+
+ServerConnection::ServerConnection(Handler handler, MessageHandler on_message,
+                                   Options options)
+    : options(std::move(options)) {
+    bool accepts_websocket = on_message != nullptr;
+    hooks.request = [handler = std::move(handler), accepts_websocket,
+                     path = this->options.websocket_path](
+                        ServerConnection &connection, HttpRequest &request,
+                        const std::string &) {
+        if (accepts_websocket && request.path == path) {
+            connection.accept_websocket(request);
+            return;
+        }
+        HttpResponse response;
+        try {
+            response = handler(request);
+        } catch (const std::exception &) {
+            response = HttpResponse::server_error("handler failed");
+        }
+        connection.send_response(response);
+    };
+    hooks.message = std::move(on_message);
+}
+
+ServerConnection::ServerConnection(Hooks hooks, Options options)
+    : hooks(std::move(hooks)), options(std::move(options)) {}
+
+char *ServerConnection::input_tail() {
+    if (close_after_flush) {
+        return nullptr;
+    }
+    if (!input.valid()) {
+        input = BufferPool::instance().acquire(BufferPool::SIZE_CLASSES[1]);
+    } else if (input.tail_room() == 0) {
+        input = BufferPool::instance().grow(std::move(input));
+    }
+    if (input.tail_room() > 0) {
+        return input.tail();
+    }
+    if (deferred > 0) {
+        return nullptr;
+    }
+
+    // The largest buffer is full and still holds nothing complete.
+    if (websocket) {
+        close_websocket(WS_CLOSE_MESSAGE_TOO_BIG);
+    } else if (std::string_view(input.data(), input.size).find("\r\n\r\n") !=
+               std::string_view::npos) {
+        refuse(HttpResponse(413, "Content Too Large"));
+    } else {
+        refuse(HttpResponse(431, "Request Header Fields Too Large"));
+    }
+    return nullptr;
+}
+
+size_t ServerConnection::input_room() {
+    return input_tail() ? input.tail_room() : 0;
+}
+
+// Parsing waits for a deferred response, and the input buffer filled up
+// with the requests behind it; reading waits too.
+bool ServerConnection::input_held() const {
+    return deferred > 0 && input.valid() && input.tail_room() == 0 &&
+           input.capacity() == BufferPool::SIZE_CLASSES.back();
+}
+
+bool ServerConnection::mid_request() const {
+    return upload != nullptr || !large_frame.empty() ||
+           (input.valid() && input.size > 0);
+}
+
+void ServerConnection::received(size_t count) {
+    input.size += count;
+    handle_input();
+}
+
+void ServerConnection::receive(std::string_view data) {
+    while (!data.empty() && input_tail()) {
+        size_t count = std::min(data.size(), input.tail_room());
+        std::copy_n(data.data(), count, input.tail());
+        data.remove_prefix(count);
+        received(count);
+    }
+}
+
+bool ServerConnection::wants_splice() const {
+    return upload && upload->splice && !close_after_flush &&
+           (!input.valid() || input.size == 0);
+}
+
+ssize_t ServerConnection::splice_input(int socket_fd) {
+    ssize_t moved;
+    try {
+        moved = upload->body->splice_from(socket_fd,
+                                          upload->decoder.raw_remaining());
+    } catch (const std::runtime_error &e) {
+        refuse(HttpResponse::server_error(e.what()));
+        errno = EIO;
+        return -1;
+    }
+    if (moved > 0) {
+        upload->decoder.skip_raw(static_cast<size_t>(moved));
+        if (upload->decoder.done()) {
+            finish_upload();
+        }
+    }
+    return moved;
+}
+
+void ServerConnection::send_response(const HttpResponse &response) {
+    output_queue.append(response.to_string());
+    if (response.is_streaming_response()) {
+        std::ostringstream body;
+        response.write_to_stream(body);
+        output_queue.append(body.str());
+    }
+}
+
+void ServerConnection::send_message(WebSocketOpcode opcode,
+                                    std::string_view payload) {
+    output_queue.append(encode_websocket_frame(opcode, payload));
+}
+
+bool ServerConnection::accept_websocket(const HttpRequest &request) {
+    if (!is_websocket_upgrade(request)) {
+        HttpResponse response(426, "Upgrade Required");
+        response.set_header("Upgrade", "websocket");
+        response.set_header("Sec-WebSocket-Version", "13");
+        send_response(response);
+        return false;
+    }
+    send_response(HttpResponse::switching_protocol(
+        request.get_header("sec-websocket-key")));
+    websocket = true;
+    return true;
+}
+
+void ServerConnection::close_websocket(uint16_t code,
+                                       std::string_view reason) {
+    output_queue.append(encode_websocket_close(code, reason));
+    close_when_flushed();
+    if (hooks.websocket_closed) {
+        hooks.websocket_closed(*this, code);
+    }
+}
+
+void ServerConnection::refuse(const HttpResponse &response) {
+    uint64_t queued_before = output_queue.appended_bytes();
+    send_response(response);
+    close_when_flushed();
+    if (hooks.rejected) {
+        hooks.rejected(*this, response.status_code,
+                       output_queue.appended_bytes() - queued_before);
+    }
+}
+
+void ServerConnection::close_when_flushed() {
+    close_after_flush = true;
+    input.release();
+    upload.reset();
+    large_frame = std::string();
+}
+
+void ServerConnection::hand_over() { raw = true; }
+
+void ServerConnection::defer() { ++deferred; }
+
+void ServerConnection::resume() {
+    --deferred;
+    handle_input();
+}
+
+// A single read may carry several pipelined requests or frames, or only
+// part of one; everything complete is handled and the rest kept. An
+// upgrade switches parsing mid-buffer. Requests behind a deferred one
+// wait in the input until its response is queued.
+void ServerConnection::handle_input() {
+    while (input.valid() && !close_after_flush && deferred == 0) {
+        std::string_view pending(input.data(), input.size);
+        if (raw) {
+            if (hooks.raw_input) {
+                hooks.raw_input(*this, pending);
+            }
+            // The hook may have closed the connection, input and all.
+            if (input.valid()) {
+                input.consume(pending.size());
+            }
+            break;
+        }
+        if (websocket) {
+            WebSocketFrame frame;
+            if (!large_frame.empty()) {
+                size_t count = std::min(pending.size(),
+                                        large_frame_size - large_frame.size());
+                large_frame.append(pending.data(), count);
+                input.consume(count);
+                if (large_frame.size() < large_frame_size) {
+                    break;
+                }
+                // Checked when its first bytes arrived, so it decodes.
+                decode_websocket_frame(large_frame, frame, true);
+                large_frame = std::string();
+                handle_frame(frame);
+                continue;
+            }
+            size_t frame_length;
+            try {
+                frame_length = decode_websocket_frame(pending, frame, true);
+            } catch (const std::runtime_error &) {
+                close_websocket(WS_CLOSE_PROTOCOL_ERROR);
+                break;
+            }
+            if (frame_length == 0) {
+                start_large_frame(pending);
+                break;
+            }
+            input.consume(frame_length);
+            handle_frame(frame);
+            continue;
+        }
+
+        if (upload) {
+            if (!continue_upload(pending)) {
+                break;
+            }
+            finish_upload();
+            continue;
+        }
+
+        // HTTP/2 with prior knowledge: the preface is not a valid
+        // HTTP/1.1 request, so wait until it could be told apart.
+        if (preface_possible && hooks.http2_preface) {
+            size_t compared =
+                std::min(pending.size(), HTTP2_CONNECTION_PREFACE.size());
+            if (pending.substr(0, compared) ==
+                HTTP2_CONNECTION_PREFACE.substr(0, compared)) {
+                if (compared < HTTP2_CONNECTION_PREFACE.size()) {
+                    break;
+                }
+                preface_possible = false;
+                hooks.http2_preface(*this);
+                continue;
+            }
+        }
+        preface_possible = false;
+
+        size_t head_end = pending.find("\r\n\r\n");
+        if (head_end == std::string_view::npos) {
+            break;
+        }
+        if (start_upload(pending.substr(0, head_end + 4))) {
+            continue;
+        }
+
+        size_t request_length = HttpRequest::complete_length(pending);
+        if (request_length == 0) {
+            break;
+        }
+        std::string raw_request(input.data(), request_length);
+        input.consume(request_length);
+        handle_request(raw_request);
+    }
+    if (input.valid() && input.size == 0) {
+        input.release();
+    }
+}
+
+// An incomplete frame that would not fit the largest input buffer is
+// collected in `large_frame` instead, if its payload is within
+// max_message_size.
+void ServerConnection::start_large_frame(std::string_view pending) {
+    uint64_t payload_length;
+    size_t header_size = websocket_frame_header(pending, payload_length);
+    if (header_size == 0) {
+        return;
+    }
+    if (payload_length > options.max_message_size) {
+        close_websocket(WS_CLOSE_MESSAGE_TOO_BIG);
+        return;
+    }
+    large_frame_size = header_size + static_cast<size_t>(payload_length);
+    if (large_frame_size <= BufferPool::SIZE_CLASSES.back()) {
+        return;
+    }
+    large_frame.reserve(large_frame_size);
+    large_frame.assign(pending);
+    input.consume(pending.size());
+}
+
+// Takes over a request whose body should be streamed, consuming its head
+// from the input. Returns false for requests complete_length() frames.
+bool ServerConnection::start_upload(std::string_view head) {
+    BodyFraming framing;
+    try {
+        framing = body_framing(head);
+    } catch (const std::runtime_error &e) {
+        refuse(HttpResponse::bad_request(e.what()));
+        return true;
+    }
+    if (!framing.chunked &&
+        framing.content_length <= options.streamed_body_threshold) {
+        return false;
+    }
+    if (framing.content_length > options.body_limits.max_size) {
+        refuse(HttpResponse(413, "Content Too Large"));
+        return true;
+    }
+
+    std::string raw_head(head);
+    input.consume(head.size());
+    bool splice = options.splice_uploads && !framing.chunked &&
+                  framing.content_length > options.body_limits.memory_limit;
+    upload = std::make_unique<Upload>(
+        Upload{raw_head, BodyDecoder(framing),
+               std::make_shared<RequestBody>(options.body_limits), splice});
+    if (hooks.upload) {
+        hooks.upload(*this);
+    }
+
+    // Clients that asked wait for this before sending a large body.
+    HttpRequest request = HttpRequest::parse(raw_head);
+    std::string expect = request.get_header("expect");
+    std::transform(expect.begin(), expect.end(), expect.begin(), ::tolower);
+    if (request.version == "HTTP/1.1" && expect == "100-continue") {
+        output_queue.append("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    return true;
+}
+
+// Feeds buffered input to the streamed body. Returns false while the body
+// is still incomplete or after the request was refused.
+bool ServerConnection::continue_upload(std::string_view pending) {
+    try {
+        input.consume(upload->decoder.feed(pending, *upload->body));
+    } catch (const BodyTooLarge &) {
+        refuse(HttpResponse(413, "Content Too Large"));
+        return false;
+    } catch (const std::runtime_error &e) {
+        refuse(HttpResponse::bad_request(e.what()));
+        return false;
+    }
+    return upload->decoder.done();
+}
+
+void ServerConnection::finish_upload() {
+    std::unique_ptr<Upload> finished = std::move(upload);
+    handle_request(finished->head, std::move(finished->body));
+}
+
+// `raw_request` is the whole request, or only its head when the body was
+// streamed into `body`.
+void ServerConnection::handle_request(const std::string &raw_request,
+                                      std::shared_ptr<RequestBody> body) {
+    ++handled_requests;
+    HttpRequest request;
+    try {
+        request = HttpRequest::parse(raw_request);
+    } catch (const std::runtime_error &) {
+        refuse(HttpResponse::bad_request("Malformed body"));
+        return;
+    }
+    if (body && body->spilled()) {
+        request.spilled_body = std::move(body);
+    } else if (body) {
+        request.body = body->take_memory();
+    }
+    if (request.method.empty() || request.path.empty() ||
+        request.version.rfind("HTTP/", 0) != 0) {
+        uint64_t queued_before = output_queue.appended_bytes();
+        send_response(HttpResponse::bad_request("Malformed request line"));
+        if (hooks.rejected) {
+            hooks.rejected(*this, 400,
+                           output_queue.appended_bytes() - queued_before);
+        }
+        return;
+    }
+    hooks.request(*this, request, raw_request);
+}
+
+void ServerConnection::handle_frame(WebSocketFrame &frame) {
+    switch (frame.opcode) {
+    case WebSocketOpcode::TEXT:
+    case WebSocketOpcode::BINARY:
+        if (frame.payload.size() > options.max_message_size) {
+            close_websocket(WS_CLOSE_MESSAGE_TOO_BIG);
+        } else if (in_fragmented_message) {
+            close_websocket(WS_CLOSE_PROTOCOL_ERROR);
+        } else if (frame.fin) {
+            ++handled_messages;
+            hooks.message(*this, frame.opcode, frame.payload);
+        } else {
+            in_fragmented_message = true;
+            fragment_opcode = frame.opcode;
+            fragments = std::move(frame.payload);
+        }
+        break;
+    case WebSocketOpcode::CONTINUATION:
+        if (!in_fragmented_message) {
+            close_websocket(WS_CLOSE_PROTOCOL_ERROR);
+            break;
+        }
+        fragments += frame.payload;
+        if (fragments.size() > options.max_message_size) {
+            close_websocket(WS_CLOSE_MESSAGE_TOO_BIG);
+        } else if (frame.fin) {
+            ++handled_messages;
+            hooks.message(*this, fragment_opcode, fragments);
+            in_fragmented_message = false;
+            fragments.clear();
+        }
+        break;
+    case WebSocketOpcode::PING:
+        send_message(WebSocketOpcode::PONG, frame.payload);
+        break;
+    case WebSocketOpcode::PONG:
+        break;
+    case WebSocketOpcode::CLOSE: {
+        uint16_t code = WS_CLOSE_NORMAL;
+        if (frame.payload.size() >= 2) {
+            code = static_cast<uint8_t>(frame.payload[0]) << 8 |
+                   static_cast<uint8_t>(frame.payload[1]);
+        }
+        close_websocket(code);
+        break;
+    }
+    }
+}
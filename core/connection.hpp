@@ -0,0 +1,215 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "buffer_pool.hpp"
+#include "http.hpp"
+#include "output_queue.hpp"
+#include "request_body.hpp"
+#include "websocket.hpp"
+
+/////////////////////////////////
+// Server Connection
+/////////////////////////////////
+
+// The server end of one HTTP/1.1 connection, independent of the socket,
+// like Http2Connection: read into input_tail() and report it with
+// received(), or hand over bytes with receive(); write out what output()
+// holds. It frames pipelined requests and hands them on in order. Large
+// and chunked bodies are streamed into a RequestBody instead of being
+// buffered whole. After an upgrade to WebSocket it decodes frames:
+// fragmented messages are reassembled, pings answered and a close echoed.
+// So the whole parse, route and serialize path can run on any transport,
+// an in-memory one included.
+//
+// What to do with requests and messages is left to the hooks. A request
+// is answered by queuing a response before the hook returns, or later:
+// defer() holds the requests behind it in the input until resume(), so
+// responses still go out in request order.
+class ServerConnection {
+  public:
+    struct Hooks {
+        // A complete request. `raw` is what was framed: the whole request,
+        // or only its head when the body was streamed into `request`.
+        std::function<void(ServerConnection &, HttpRequest &request,
+                           const std::string &raw)>
+            request;
+        // Every complete TEXT or BINARY message.
+        std::function<void(ServerConnection &, WebSocketOpcode,
+                           const std::string &payload)>
+            message;
+        // The body of the request being framed is going to be streamed.
+        std::function<void(ServerConnection &)> upload;
+        // A request the connection answered itself because it was
+        // malformed or too large, or one passed to refuse(). `bytes` is the
+        // size of the queued answer.
+        std::function<void(ServerConnection &, int status, size_t bytes)>
+            rejected;
+        // A close frame was queued, for whatever reason.
+        std::function<void(ServerConnection &, uint16_t code)>
+            websocket_closed;
+        // The client opened with the HTTP/2 connection preface. The hook
+        // is expected to hand_over(); without it, the preface is framed as
+        // an HTTP/1.1 request.
+        std::function<void(ServerConnection &)> http2_preface;
+        // All input once the connection was handed over.
+        std::function<void(ServerConnection &, std::string_view data)>
+            raw_input;
+    };
+
+    using Handler = std::function<HttpResponse(const HttpRequest &)>;
+    // Gets every complete TEXT or BINARY message; replies go through
+    // send_message().
+    using MessageHandler = std::function<void(
+        ServerConnection &, WebSocketOpcode, const std::string &payload)>;
+
+    struct Options {
+        // Used by the Handler constructor: without a MessageHandler
+        // upgrades are not accepted, and requests for this path go to the
+        // handler like any other.
+        std::string websocket_path = "/ws";
+        // Larger messages, and frames announcing a larger payload, are
+        // closed with 1009.
+        size_t max_message_size = 1024 * 1024;
+        // Bodies up to this size are framed whole in the input buffer;
+        // larger and chunked ones are streamed within `body_limits`.
+        size_t streamed_body_threshold = BufferPool::SIZE_CLASSES[1];
+        BodyLimits body_limits;
+        // Raw bodies past the memory limit may be moved from the socket to
+        // their file with splice_input(). Off when the bytes have to pass
+        // through userspace anyway, as with TLS.
+        bool splice_uploads = false;
+    };
+
+    explicit ServerConnection(Handler handler,
+                              MessageHandler on_message = nullptr)
+        : ServerConnection(std::move(handler), std::move(on_message),
+                           Options{}) {}
+    ServerConnection(Handler handler, MessageHandler on_message,
+                     Options options);
+    explicit ServerConnection(Hooks hooks)
+        : ServerConnection(std::move(hooks), Options{}) {}
+    ServerConnection(Hooks hooks, Options options);
+
+    // Room for the next read, growing the input buffer when it is full.
+    // input_room() is 0 once closing(), and while the largest buffer is
+    // full of requests waiting behind a deferred one.
+    char *input_tail();
+    size_t input_room();
+
+    // Takes `count` bytes just read into input_tail() and handles
+    // everything that is now complete.
+    void received(size_t count);
+
+    // Copies `data` in and handles it, for transports that bring their own
+    // buffers.
+    void receive(std::string_view data);
+
+    // True while the next bytes of an upload can skip the input buffer.
+    bool wants_splice() const;
+    // Moves upload bytes from `socket_fd` straight into the body's file.
+    // Returns like RequestBody::splice_from(); a body that cannot be
+    // written is refused with 500.
+    ssize_t splice_input(int socket_fd);
+
+    void send_response(const HttpResponse &response);
+    // Queues a WebSocket message for the client.
+    void send_message(WebSocketOpcode opcode, std::string_view payload);
+
+    // Answers an upgrade request with 101 and parses WebSocket frames from
+    // then on, or answers anything else on the path with 426. Returns
+    // whether the connection was upgraded.
+    bool accept_websocket(const HttpRequest &request);
+    // Queues a close frame and stops reading; the connection should be
+    // closed once it has been written.
+    void close_websocket(uint16_t code, std::string_view reason = "");
+
+    // Answers with `response` and stops reading; the rest of the input
+    // cannot be framed any more.
+    void refuse(const HttpResponse &response);
+    // Stops reading, for a connection to be closed once output() drains.
+    void close_when_flushed();
+
+    // From now on all input goes to the raw_input hook, as after switching
+    // to HTTP/2 or subscribing to an event stream.
+    void hand_over();
+
+    // The response to the request now in the hook comes later; requests
+    // behind it wait until resume().
+    void defer();
+    void resume();
+
+    OutputQueue &output() { return output_queue; }
+    const OutputQueue &output() const { return output_queue; }
+
+    // True once nothing more will be read and the connection should be
+    // closed when output() is flushed: a request or frame could not be
+    // handled, or the WebSocket was closed.
+    bool closing() const { return close_after_flush; }
+    bool wants_input() const { return !close_after_flush && !input_held(); }
+    // Some of a request has arrived but not all of it.
+    bool mid_request() const;
+    // Nothing half-received or waiting for a deferred response, so
+    // closing the connection cannot cut a request short.
+    bool idle() const { return deferred == 0 && !mid_request(); }
+    bool is_websocket() const { return websocket; }
+    bool handed_over() const { return raw; }
+    uint64_t requests() const { return handled_requests; }
+    uint64_t messages() const { return handled_messages; }
+
+  private:
+    // A request whose body is streamed rather than buffered whole. Its
+    // head waits here while the decoder moves the body into `body`.
+    struct Upload {
+        std::string head;
+        BodyDecoder decoder;
+        std::shared_ptr<RequestBody> body;
+        bool splice;
+    };
+
+    void handle_input();
+    bool start_upload(std::string_view head);
+    bool continue_upload(std::string_view pending);
+    void finish_upload();
+    void handle_request(const std::string &raw_request,
+                        std::shared_ptr<RequestBody> body = nullptr);
+    void handle_frame(WebSocketFrame &frame);
+    void start_large_frame(std::string_view pending);
+    bool input_held() const;
+
+    Hooks hooks;
+    Options options;
+
+    BufferPool::Buffer input;
+    OutputQueue output_queue;
+    std::unique_ptr<Upload> upload;
+    bool close_after_flush = false;
+    bool websocket = false;
+    bool raw = false;
+    // The preface can only be the first thing a client sends, so it is
+    // looked for until the first bytes rule it out.
+    bool preface_possible = true;
+    size_t deferred = 0;
+    uint64_t handled_requests = 0;
+    uint64_t handled_messages = 0;
+
+    // A message whose first frame had FIN clear.
+    bool in_fragmented_message = false;
+    WebSocketOpcode fragment_opcode = WebSocketOpcode::TEXT;
+    std::string fragments;
+    // A frame larger than the largest input buffer, collected until all
+    // `large_frame_size` bytes of it are here.
+    std::string large_frame;
+    size_t large_frame_size = 0;
+};
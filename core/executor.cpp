@@ -0,0 +1,183 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <stdexcept>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "executor.hpp"
+
+// How many extra jobs a worker takes from the injection queue in one go.
+// Moving them into its own deque makes them stealable by idle workers while
+// this one is busy.
+static constexpr size_t INJECTION_BATCH = 4;
+
+WorkStealingExecutor::WorkStealingExecutor(size_t worker_count,
+                                           size_t queue_capacity)
+    : injection_queue(queue_capacity) {
+    if (worker_count == 0) {
+        worker_count = 1;
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        throw std::runtime_error("Failed to create completion eventfd");
+    }
+
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers[i]->thread = std::thread(&WorkStealingExecutor::worker_loop,
+                                         this, i);
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    stopping.store(true, std::memory_order_release);
+    work_signal.fetch_add(1, std::memory_order_release);
+    work_signal.notify_all();
+
+    for (auto &worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    // Jobs that never ran and completions nobody collected are dropped.
+    Job *job = nullptr;
+    while (injection_queue.pop(job)) {
+        delete job;
+    }
+    for (auto &worker : workers) {
+        for (Job *pending : worker->deque) {
+            delete pending;
+        }
+    }
+    job = completed.exchange(nullptr, std::memory_order_acquire);
+    while (job != nullptr) {
+        Job *next = job->next;
+        delete job;
+        job = next;
+    }
+
+    close(event_fd);
+}
+
+void WorkStealingExecutor::submit(Work work, Completion completion) {
+    Job *job = new Job{std::move(work), std::move(completion), nullptr};
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    if (!injection_queue.push(job)) {
+        // Slow path: the injection queue is full, so hand the job straight
+        // to a worker's deque. This is the only place submit() can block.
+        Worker &worker = *workers[next_worker++ % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.deque.push_back(job);
+    }
+
+    work_signal.fetch_add(1, std::memory_order_release);
+    work_signal.notify_one();
+}
+
+WorkStealingExecutor::Job *WorkStealingExecutor::find_work(size_t index) {
+    Worker &self = *workers[index];
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.deque.empty()) {
+            Job *job = self.deque.back();
+            self.deque.pop_back();
+            return job;
+        }
+    }
+
+    Job *job = nullptr;
+    if (injection_queue.pop(job)) {
+        Job *extra = nullptr;
+        std::lock_guard<std::mutex> lock(self.mutex);
+        for (size_t i = 0; i < INJECTION_BATCH && injection_queue.pop(extra);
+             ++i) {
+            self.deque.push_back(extra);
+        }
+        return job;
+    }
+
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker &victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.deque.empty()) {
+            Job *stolen = victim.deque.front();
+            victim.deque.pop_front();
+            return stolen;
+        }
+    }
+    return nullptr;
+}
+
+void WorkStealingExecutor::worker_loop(size_t index) {
+    while (!stopping.load(std::memory_order_acquire)) {
+        // Read the signal before looking for work: if a submit() lands
+        // between find_work() and wait(), the value has changed and wait()
+        // returns immediately instead of sleeping on a queued job.
+        uint32_t seen = work_signal.load(std::memory_order_acquire);
+
+        Job *job = find_work(index);
+        if (job == nullptr) {
+            work_signal.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+
+        try {
+            job->work();
+        } catch (...) {
+            job->error = std::current_exception();
+        }
+        post_completion(job);
+    }
+}
+
+void WorkStealingExecutor::post_completion(Job *job) {
+    Job *head = completed.load(std::memory_order_relaxed);
+    do {
+        job->next = head;
+    } while (!completed.compare_exchange_weak(head, job,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+
+    uint64_t one = 1;
+    ssize_t ignored = write(event_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+size_t WorkStealingExecutor::run_completions() {
+    uint64_t counter;
+    ssize_t ignored = read(event_fd, &counter, sizeof(counter));
+    (void)ignored;
+
+    Job *list = completed.exchange(nullptr, std::memory_order_acquire);
+
+    // The completion list is a stack; reverse it so completions run in the
+    // order the jobs finished.
+    Job *ordered = nullptr;
+    while (list != nullptr) {
+        Job *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    size_t count = 0;
+    while (ordered != nullptr) {
+        Job *next = ordered->next;
+        std::unique_ptr<Job> job(ordered);
+        outstanding.fetch_sub(1, std::memory_order_relaxed);
+        if (job->completion) {
+            job->completion(job->error);
+        }
+        ordered = next;
+        ++count;
+    }
+    return count;
+}
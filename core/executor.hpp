@@ -0,0 +1,171 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////
+// Bounded MPMC Queue
+/////////////////////////////////
+
+// Dmitry Vyukov's bounded multi-producer/multi-consumer queue. Every slot
+// carries a sequence number that tells producers and consumers whether it
+// is free or filled for their lap around the ring, so push and pop are one
+// CAS on a shared index plus one release store, and no thread ever blocks
+// another. Capacity must be a power of two.
+template <typename T> class MpmcQueue {
+  public:
+    explicit MpmcQueue(size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]) {
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(T value) {
+        size_t position = enqueue_position.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+            slot = &slots[position & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position);
+            if (diff == 0) {
+                if (enqueue_position.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                position = enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value) {
+        size_t position = dequeue_position.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+            slot = &slots[position & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position + 1);
+            if (diff == 0) {
+                if (dequeue_position.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                position = dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(slot->value);
+        slot->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> enqueue_position{0};
+    alignas(64) std::atomic<size_t> dequeue_position{0};
+};
+
+/////////////////////////////////
+// Work-Stealing Executor
+/////////////////////////////////
+
+// Runs CPU-heavy handler work off the I/O thread.
+//
+// The I/O thread submits jobs into a lock-free injection queue and wakes an
+// idle worker through an atomic counter (futex-backed std::atomic::wait), so
+// submit() never takes a lock unless that queue is full. Workers move
+// batches from the injection queue into their own deque, run from the back
+// of it (LIFO keeps recently touched data in cache) and, when both are
+// empty, steal from the front of the other workers' deques. The deque locks
+// are only ever contended between workers.
+//
+// When a job finishes it is pushed onto a lock-free completion list and the
+// eventfd returned by completion_fd() is signalled. The I/O thread adds that
+// fd to its select()/poll() set and calls run_completions(), which runs each
+// job's completion callback on the I/O thread. That is where the response is
+// written, so sockets are never touched from a worker.
+class WorkStealingExecutor {
+  public:
+    using Work = std::function<void()>;
+    // Receives the exception thrown by the work, or nullptr on success.
+    using Completion = std::function<void(std::exception_ptr)>;
+
+    explicit WorkStealingExecutor(
+        size_t worker_count = std::thread::hardware_concurrency(),
+        size_t queue_capacity = 4096);
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+    WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+    void submit(Work work, Completion completion);
+
+    int completion_fd() const { return event_fd; }
+
+    // Runs every completion posted since the last call, in submission-ish
+    // order, and returns how many ran. Must be called from the I/O thread.
+    size_t run_completions();
+
+    size_t worker_count() const { return workers.size(); }
+    size_t in_flight() const {
+        return outstanding.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Job {
+        Work work;
+        Completion completion;
+        std::exception_ptr error;
+        Job *next = nullptr;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job *> deque;
+        std::thread thread;
+    };
+
+    MpmcQueue<Job *> injection_queue;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<uint32_t> work_signal{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> outstanding{0};
+
+    std::atomic<Job *> completed{nullptr};
+    int event_fd = -1;
+
+    size_t next_worker = 0;  // I/O thread only, for the overflow path
+
+    void worker_loop(size_t index);
+    Job *find_work(size_t index);
+    void post_completion(Job *job);
+};
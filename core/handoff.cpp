@@ -0,0 +1,198 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "handoff.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern char **environ;
+
+/////////////////////////////////
+// Listener Handoff
+/////////////////////////////////
+
+namespace {
+
+constexpr char HANDOFF_ENV[] = "SERVER_HANDOFF_FD";
+
+// Listeners for plain HTTP and TLS, with room to spare.
+constexpr size_t MAX_HANDOFF_FDS = 16;
+
+}  // namespace
+
+void send_fds(int socket_fd, const std::vector<int> &fds) {
+    if (fds.empty() || fds.size() > MAX_HANDOFF_FDS) {
+        throw std::runtime_error("Cannot hand off " +
+                                 std::to_string(fds.size()) + " fds");
+    }
+    // SCM_RIGHTS needs at least one byte of ordinary data to ride on.
+    char count = static_cast<char>(fds.size());
+    struct iovec data = {&count, 1};
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                                    MAX_HANDOFF_FDS)] = {};
+    struct msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != 1) {
+        throw std::runtime_error(std::string("Failed to send fds: ") +
+                                 std::strerror(errno));
+    }
+}
+
+std::vector<int> receive_fds(int socket_fd) {
+    char count = 0;
+    struct iovec data = {&count, 1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                                    MAX_HANDOFF_FDS)] = {};
+    struct msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        throw std::runtime_error(
+            received == 0 ? std::string("Handoff socket closed")
+                          : std::string("Failed to receive fds: ") +
+                                std::strerror(errno));
+    }
+
+    std::vector<int> fds;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+         header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET ||
+            header->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t attached = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t first = fds.size();
+        fds.resize(first + attached);
+        std::memcpy(fds.data() + first, CMSG_DATA(header),
+                    attached * sizeof(int));
+    }
+    if (fds.empty() || (message.msg_flags & MSG_CTRUNC) ||
+        fds.size() != static_cast<size_t>(count)) {
+        for (int fd : fds) {
+            close(fd);
+        }
+        throw std::runtime_error("Handoff message carried no usable fds");
+    }
+    return fds;
+}
+
+void send_ready(int socket_fd) {
+    ssize_t sent;
+    do {
+        sent = send(socket_fd, &HANDOFF_READY, 1, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != 1) {
+        throw std::runtime_error(std::string("Failed to report ready: ") +
+                                 std::strerror(errno));
+    }
+}
+
+bool receive_ready(int socket_fd) {
+    char ready = 0;
+    ssize_t received;
+    do {
+        received = read(socket_fd, &ready, 1);
+    } while (received < 0 && errno == EINTR);
+    return received == 1 && ready == HANDOFF_READY;
+}
+
+Replacement spawn_replacement(const std::string &executable,
+                              const std::vector<std::string> &args) {
+    // Everything the child needs is built before fork(): in a process with
+    // threads only async-signal-safe calls are allowed between fork() and
+    // exec.
+    std::vector<char *> argv;
+    for (const std::string &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    std::string handoff_variable =
+        std::string(HANDOFF_ENV) + "=" + std::to_string(HANDOFF_FD);
+    std::vector<char *> envp;
+    size_t name_length = std::strlen(HANDOFF_ENV);
+    for (char **variable = environ; *variable != nullptr; ++variable) {
+        if (std::strncmp(*variable, HANDOFF_ENV, name_length) != 0 ||
+            (*variable)[name_length] != '=') {
+            envp.push_back(*variable);
+        }
+    }
+    envp.push_back(handoff_variable.data());
+    envp.push_back(nullptr);
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+        throw std::runtime_error(std::string("Failed to create socketpair: ") +
+                                 std::strerror(errno));
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pair[0]);
+        close(pair[1]);
+        throw std::runtime_error(std::string("Failed to fork: ") +
+                                 std::strerror(errno));
+    }
+    if (pid == 0) {
+        // dup2() onto itself would leave close-on-exec set.
+        if (pair[1] == HANDOFF_FD) {
+            fcntl(HANDOFF_FD, F_SETFD, 0);
+        } else if (dup2(pair[1], HANDOFF_FD) < 0) {
+            _exit(127);
+        }
+        // Client sockets and listeners must not leak into the new process:
+        // a connection would stay open for as long as it lives.
+        close_range(HANDOFF_FD + 1, ~0U, 0);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        execve(executable.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+
+    close(pair[1]);
+    return {pid, pair[0]};
+}
+
+int inherited_handoff_socket() {
+    const char *value = std::getenv(HANDOFF_ENV);
+    if (value == nullptr) {
+        return -1;
+    }
+    int fd = std::atoi(value);
+    unsetenv(HANDOFF_ENV);
+    if (fd < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,59 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/////////////////////////////////
+// Listener Handoff
+/////////////////////////////////
+
+// A restart hands the listening sockets to a replacement process instead of
+// closing them, so the kernel keeps queueing connections throughout and
+// nobody sees a refused connect(). The old process starts the new one with
+// spawn_replacement() and send_fds(); the new one finds the socket with
+// inherited_handoff_socket(), takes the listeners with receive_fds() and
+// answers with send_ready() once it is serving. Only then does the old
+// process stop accepting and drain.
+
+// Where the replacement finds its end of the handoff socket, named in its
+// environment as SERVER_HANDOFF_FD.
+constexpr int HANDOFF_FD = 3;
+constexpr char HANDOFF_READY = 'R';
+
+// Sends `fds` as SCM_RIGHTS ancillary data on a UNIX domain socket; the
+// receiver gets its own descriptors for the same open sockets. Throws
+// std::runtime_error if the message cannot be sent.
+void send_fds(int socket_fd, const std::vector<int> &fds);
+
+// Blocks until a send_fds() message arrives and returns its descriptors,
+// close-on-exec, in the order they were sent. Throws std::runtime_error on
+// EOF or when the message carried none.
+std::vector<int> receive_fds(int socket_fd);
+
+// The replacement's answer once it is serving. send_ready() throws
+// std::runtime_error if the old process could not be told;
+// receive_ready() is false on EOF or anything but HANDOFF_READY.
+void send_ready(int socket_fd);
+bool receive_ready(int socket_fd);
+
+struct Replacement {
+    pid_t pid = -1;
+    int socket_fd = -1;  // our end of the handoff socket
+};
+
+// Runs `executable` with `args` (args[0] included) in a child that keeps
+// only stdin, stdout, stderr and its end of a new socketpair, at
+// HANDOFF_FD. Throws std::runtime_error if the socketpair or fork fails; a
+// failed exec shows up as EOF on `socket_fd`.
+Replacement spawn_replacement(const std::string &executable,
+                              const std::vector<std::string> &args);
+
+// In a replacement: the handoff socket from the process being replaced,
+// or -1 for a normal start. Clears SERVER_HANDOFF_FD so it is not passed
+// on.
+int inherited_handoff_socket();
@@ -0,0 +1,167 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "histogram.hpp"
+
+HdrHistogram::HdrHistogram(unsigned significant_bits, unsigned max_value_bits)
+    : significant_bits(significant_bits), max_value_bits(max_value_bits) {
+    if (significant_bits < 2 || significant_bits > 16 ||
+        max_value_bits <= significant_bits || max_value_bits > 63) {
+        throw std::invalid_argument("Unsupported histogram configuration");
+    }
+    counts.assign(bucket_count(significant_bits, max_value_bits), 0);
+}
+
+size_t HdrHistogram::bucket_index(uint64_t value, unsigned significant_bits) {
+    const uint64_t sub_buckets = uint64_t{1} << significant_bits;
+    if (value < sub_buckets) {
+        return static_cast<size_t>(value);
+    }
+
+    // `shift` drops all but the top significant_bits - 1 bits below the
+    // most significant one, so `value >> shift` lands in
+    // [sub_buckets / 2, sub_buckets).
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned shift = msb - (significant_bits - 1);
+    uint64_t half = sub_buckets / 2;
+    return static_cast<size_t>(sub_buckets + (shift - 1) * half +
+                               ((value >> shift) - half));
+}
+
+uint64_t HdrHistogram::bucket_upper_bound(size_t index,
+                                          unsigned significant_bits) {
+    const uint64_t sub_buckets = uint64_t{1} << significant_bits;
+    if (index < sub_buckets) {
+        return index;
+    }
+    uint64_t half = sub_buckets / 2;
+    uint64_t offset = index - sub_buckets;
+    unsigned shift = static_cast<unsigned>(offset / half) + 1;
+    uint64_t mantissa = offset % half + half;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+size_t HdrHistogram::bucket_count(unsigned significant_bits,
+                                  unsigned max_value_bits) {
+    uint64_t largest = (uint64_t{1} << max_value_bits) - 1;
+    return bucket_index(largest, significant_bits) + 1;
+}
+
+void HdrHistogram::record(uint64_t value, uint64_t count) {
+    size_t index = std::min(bucket_index(value, significant_bits),
+                            counts.size() - 1);
+    counts[index] += count;
+    total += count;
+    sum += static_cast<long double>(value) * count;
+    lowest = std::min(lowest, value);
+    highest = std::max(highest, value);
+}
+
+void HdrHistogram::merge(const HdrHistogram &other) {
+    if (other.significant_bits != significant_bits ||
+        other.counts.size() != counts.size()) {
+        throw std::invalid_argument(
+            "Cannot merge differently sized histograms");
+    }
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    lowest = std::min(lowest, other.lowest);
+    highest = std::max(highest, other.highest);
+}
+
+void HdrHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = 0;
+    lowest = UINT64_MAX;
+    highest = 0;
+}
+
+double HdrHistogram::mean() const {
+    return total ? static_cast<double>(sum / total) : 0.0;
+}
+
+uint64_t HdrHistogram::value_at_percentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t rank = static_cast<uint64_t>(
+        percentile / 100.0 * static_cast<double>(total) + 0.5);
+    rank = std::clamp<uint64_t>(rank, 1, total);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucket_upper_bound(i, significant_bits), highest);
+        }
+    }
+    return highest;
+}
+
+std::string HdrHistogram::summary(double unit,
+                                  const std::string &unit_name) const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(unit == 1.0 ? 0 : 1);
+
+    const std::pair<const char *, double> rows[] = {
+        {"p50", 50.0},    {"p90", 90.0},       {"p99", 99.0},
+        {"p99.9", 99.9},  {"p99.99", 99.99},
+    };
+    for (const auto &[label, percentile] : rows) {
+        out << std::setw(8) << label << "  " << std::setw(12)
+            << static_cast<double>(value_at_percentile(percentile)) / unit
+            << " " << unit_name << "\n";
+    }
+    out << std::setw(8) << "max"
+        << "  " << std::setw(12) << static_cast<double>(highest) / unit << " "
+        << unit_name << "\n";
+    out << std::setw(8) << "mean"
+        << "  " << std::setw(12) << mean() / unit << " " << unit_name << "\n";
+    out << std::setw(8) << "count"
+        << "  " << std::setw(12) << std::setprecision(0)
+        << static_cast<double>(total) << "\n";
+    return out.str();
+}
+
+void HdrHistogram::write_distribution(std::ostream &out, double unit) const {
+    out << std::setw(12) << "Value" << std::setw(15) << "Percentile"
+        << std::setw(12) << "TotalCount" << std::setw(18) << "1/(1-Percentile)"
+        << "\n\n";
+    out << std::fixed;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        seen += counts[i];
+        double fraction =
+            static_cast<double>(seen) / static_cast<double>(total);
+        uint64_t value = std::min(bucket_upper_bound(i, significant_bits),
+                                  highest);
+
+        out << std::setprecision(3) << std::setw(12)
+            << static_cast<double>(value) / unit << std::setprecision(12)
+            << std::setw(15) << fraction << std::setw(12) << seen;
+        if (fraction < 1.0) {
+            out << std::setprecision(2) << std::setw(18)
+                << 1.0 / (1.0 - fraction);
+        }
+        out << "\n";
+    }
+
+    out << "#[Mean    = " << std::setprecision(3) << mean() / unit
+        << ", Max     = " << static_cast<double>(highest) / unit << "]\n";
+    out << "#[Total count    = " << total << "]\n";
+}
@@ -0,0 +1,77 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// HDR Histogram
+/////////////////////////////////
+
+// High-dynamic-range histogram for latencies (or any non-negative integer).
+//
+// Buckets are log-linear: values below 2^significant_bits get one bucket
+// each, and every power of two above that is split into
+// 2^(significant_bits - 1) equal sub-buckets. The relative error of any
+// reported value is therefore bounded by 2^-(significant_bits - 1), about
+// 0.8% for the default of 8, no matter whether the value is 200ns or 20s,
+// while the whole range up to 2^max_value_bits fits in a few thousand
+// counters. Recording is one bit scan and one increment.
+//
+// Histograms with the same configuration can be merged, which is how
+// per-thread histograms are combined into one report without any
+// synchronization on the recording path.
+class HdrHistogram {
+  public:
+    explicit HdrHistogram(unsigned significant_bits = 8,
+                          unsigned max_value_bits = 40);
+
+    void record(uint64_t value) { record(value, 1); }
+    void record(uint64_t value, uint64_t count);
+    void merge(const HdrHistogram &other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? lowest : 0; }
+    uint64_t max() const { return highest; }
+    double mean() const;
+
+    // Highest value equivalent to the one at `percentile` (0-100], i.e. the
+    // upper edge of its bucket, clamped to the largest value recorded.
+    uint64_t value_at_percentile(double percentile) const;
+
+    // Bucket mapping shared with other log-linear counters (see metrics).
+    static size_t bucket_index(uint64_t value, unsigned significant_bits);
+    static uint64_t bucket_upper_bound(size_t index,
+                                       unsigned significant_bits);
+    static size_t bucket_count(unsigned significant_bits,
+                               unsigned max_value_bits);
+
+    size_t buckets() const { return counts.size(); }
+    uint64_t count_at(size_t index) const { return counts[index]; }
+
+    // p50/p90/p99/p99.9/p99.99/max table with values divided by `unit`
+    // (e.g. 1000.0 to print nanoseconds as microseconds).
+    std::string summary(double unit = 1.0,
+                        const std::string &unit_name = "") const;
+
+    // Full percentile distribution in the .hgrm text layout used by
+    // HdrHistogram tooling (value, percentile, total count, 1/(1-p)), so
+    // runs can be plotted and compared with the usual HDR plotters.
+    void write_distribution(std::ostream &out, double unit = 1.0) const;
+
+  private:
+    unsigned significant_bits;
+    unsigned max_value_bits;
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t lowest = UINT64_MAX;
+    uint64_t highest = 0;
+    long double sum = 0;
+};
@@ -0,0 +1,427 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "hpack.hpp"
+#include "hpack_tables.hpp"
+
+/////////////////////////////////
+// Integers
+/////////////////////////////////
+
+void hpack_encode_integer(std::string &out, uint64_t value,
+                          unsigned prefix_bits, uint8_t flags) {
+    uint64_t prefix_max = (1u << prefix_bits) - 1;
+    if (value < prefix_max) {
+        out += static_cast<char>(flags | value);
+        return;
+    }
+    out += static_cast<char>(flags | prefix_max);
+    value -= prefix_max;
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+uint64_t hpack_decode_integer(std::string_view data, size_t &pos,
+                              unsigned prefix_bits) {
+    if (pos >= data.size()) {
+        throw std::runtime_error("HPACK: truncated integer");
+    }
+    uint64_t prefix_max = (1u << prefix_bits) - 1;
+    uint64_t value = static_cast<uint8_t>(data[pos++]) & prefix_max;
+    if (value < prefix_max) {
+        return value;
+    }
+
+    // Anything that needs more than 28 continuation bits is not a length
+    // or index a sane peer sends.
+    for (unsigned shift = 0; shift <= 28; shift += 7) {
+        if (pos >= data.size()) {
+            throw std::runtime_error("HPACK: truncated integer");
+        }
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("HPACK: integer overflow");
+}
+
+/////////////////////////////////
+// Huffman
+/////////////////////////////////
+
+static constexpr unsigned HUFFMAN_MAX_BITS = 30;
+static constexpr uint16_t HUFFMAN_EOS = 256;
+
+// Canonical decoding: codes of one length are consecutive, and every
+// code left-aligned to 30 bits is below limit[L] exactly when its length is
+// at most L. The decoder peeks 30 bits, finds the first length whose limit
+// is above them, and indexes the symbol directly.
+struct HuffmanDecodeTable {
+    std::array<uint32_t, HUFFMAN_MAX_BITS + 1> limit{};
+    std::array<uint32_t, HUFFMAN_MAX_BITS + 1> first_code{};
+    std::array<uint16_t, HUFFMAN_MAX_BITS + 1> first_index{};
+    std::array<uint16_t, 257> symbols{};
+    unsigned min_bits = HUFFMAN_MAX_BITS;
+};
+
+static const HuffmanDecodeTable &huffman_decode_table() {
+    static const HuffmanDecodeTable table = [] {
+        HuffmanDecodeTable t;
+        std::array<uint16_t, HUFFMAN_MAX_BITS + 1> counts{};
+        for (uint16_t sym = 0; sym < 257; ++sym) {
+            ++counts[hpack_huffman_codes[sym].bits];
+            t.min_bits = std::min<unsigned>(t.min_bits,
+                                            hpack_huffman_codes[sym].bits);
+        }
+        for (uint16_t sym = 0; sym < 257; ++sym) {
+            t.symbols[sym] = sym;
+        }
+        std::stable_sort(t.symbols.begin(), t.symbols.end(),
+                         [](uint16_t a, uint16_t b) {
+                             return hpack_huffman_codes[a].bits <
+                                    hpack_huffman_codes[b].bits;
+                         });
+
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (unsigned bits = 1; bits <= HUFFMAN_MAX_BITS; ++bits) {
+            t.first_code[bits] = code;
+            t.first_index[bits] = index;
+            code += counts[bits];
+            index += counts[bits];
+            t.limit[bits] = code << (HUFFMAN_MAX_BITS - bits);
+            code <<= 1;
+        }
+        return t;
+    }();
+    return table;
+}
+
+size_t huffman_encoded_length(std::string_view data) {
+    size_t bits = 0;
+    for (char c : data) {
+        bits += hpack_huffman_codes[static_cast<uint8_t>(c)].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+std::string huffman_encode(std::string_view data) {
+    std::string out;
+    out.reserve(huffman_encoded_length(data));
+    uint64_t pending = 0;
+    unsigned pending_bits = 0;
+    for (char c : data) {
+        const HpackHuffmanCode &code =
+            hpack_huffman_codes[static_cast<uint8_t>(c)];
+        pending = pending << code.bits | code.code;
+        pending_bits += code.bits;
+        while (pending_bits >= 8) {
+            pending_bits -= 8;
+            out += static_cast<char>(pending >> pending_bits);
+        }
+    }
+    if (pending_bits > 0) {
+        // Pad with the most significant bits of EOS, which are all ones.
+        out += static_cast<char>(pending << (8 - pending_bits) |
+                                 (0xff >> pending_bits));
+    }
+    return out;
+}
+
+std::string huffman_decode(std::string_view data) {
+    const HuffmanDecodeTable &table = huffman_decode_table();
+    std::string out;
+    out.reserve(data.size() * 8 / 5);
+
+    // Bits are kept left-aligned in `window`.
+    uint64_t window = 0;
+    unsigned window_bits = 0;
+    size_t pos = 0;
+    while (true) {
+        while (window_bits <= 56 && pos < data.size()) {
+            window |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos++]))
+                      << (56 - window_bits);
+            window_bits += 8;
+        }
+        if (window_bits < table.min_bits) {
+            break;
+        }
+
+        uint32_t peek =
+            static_cast<uint32_t>(window >> (64 - HUFFMAN_MAX_BITS));
+        unsigned bits = table.min_bits;
+        while (bits < HUFFMAN_MAX_BITS && peek >= table.limit[bits]) {
+            ++bits;
+        }
+        if (bits > window_bits) {
+            // Only the padding is left.
+            break;
+        }
+
+        uint32_t code = peek >> (HUFFMAN_MAX_BITS - bits);
+        uint16_t symbol = table.symbols[table.first_index[bits] + code -
+                                        table.first_code[bits]];
+        if (symbol == HUFFMAN_EOS) {
+            throw std::runtime_error("HPACK: EOS in Huffman string");
+        }
+        out += static_cast<char>(symbol);
+        window <<= bits;
+        window_bits -= bits;
+    }
+
+    if (window_bits > 7) {
+        throw std::runtime_error("HPACK: Huffman padding too long");
+    }
+    uint64_t padding_mask = window_bits ? ~0ull << (64 - window_bits) : 0;
+    if ((window & padding_mask) != padding_mask) {
+        throw std::runtime_error("HPACK: Huffman padding is not EOS");
+    }
+    return out;
+}
+
+/////////////////////////////////
+// Dynamic Table
+/////////////////////////////////
+
+void HpackDynamicTable::evict_to(size_t target) {
+    while (bytes > target) {
+        const HeaderField &oldest = entries.back();
+        bytes -= oldest.name.size() + oldest.value.size() + ENTRY_OVERHEAD;
+        entries.pop_back();
+    }
+}
+
+void HpackDynamicTable::insert(std::string_view name, std::string_view value) {
+    size_t entry_size = name.size() + value.size() + ENTRY_OVERHEAD;
+    if (entry_size > limit) {
+        // Not an error: the table just ends up empty.
+        evict_to(0);
+        return;
+    }
+    evict_to(limit - entry_size);
+    entries.push_front({std::string(name), std::string(value)});
+    bytes += entry_size;
+}
+
+void HpackDynamicTable::set_max_size(size_t max_size) {
+    limit = max_size;
+    evict_to(limit);
+}
+
+// Index of an exact match (> 0) or of a name-only match (< 0) in the static
+// and dynamic tables, 0 for neither.
+static int64_t find_field(const HpackDynamicTable &dynamic,
+                          std::string_view name, std::string_view value) {
+    int64_t name_match = 0;
+    for (size_t i = 0; i < hpack_static_table.size(); ++i) {
+        if (hpack_static_table[i].name == name) {
+            if (hpack_static_table[i].value == value) {
+                return static_cast<int64_t>(i + 1);
+            }
+            if (name_match == 0) {
+                name_match = -static_cast<int64_t>(i + 1);
+            }
+        }
+    }
+    for (size_t i = 0; i < dynamic.count(); ++i) {
+        const HeaderField &entry = dynamic.at(i);
+        if (entry.name == name) {
+            int64_t index = static_cast<int64_t>(hpack_static_table.size() +
+                                                 i + 1);
+            if (entry.value == value) {
+                return index;
+            }
+            if (name_match == 0) {
+                name_match = -index;
+            }
+        }
+    }
+    return name_match;
+}
+
+/////////////////////////////////
+// Encoder
+/////////////////////////////////
+
+enum class Indexing { INCREMENTAL, WITHOUT, NEVER };
+
+static Indexing indexing_for(std::string_view name) {
+    if (name == "authorization" || name == "proxy-authorization" ||
+        name == "cookie" || name == "set-cookie") {
+        return Indexing::NEVER;
+    }
+    if (name == ":path" || name == "content-length" || name == "date" ||
+        name == "etag" || name == "last-modified" || name == "age" ||
+        name == "if-none-match" || name == "if-modified-since" ||
+        name == "content-range" || name == "location") {
+        return Indexing::WITHOUT;
+    }
+    return Indexing::INCREMENTAL;
+}
+
+HpackEncoder::HpackEncoder(size_t max_table_size) : dynamic(max_table_size) {}
+
+void HpackEncoder::set_max_table_size(size_t max_size) {
+    if (!size_update_pending) {
+        smallest_pending_size = max_size;
+    }
+    smallest_pending_size = std::min(smallest_pending_size, max_size);
+    size_update_pending = true;
+    dynamic.set_max_size(max_size);
+}
+
+void HpackEncoder::encode_string(std::string &out, std::string_view value) {
+    size_t huffman_length = huffman_encoded_length(value);
+    if (huffman_length < value.size()) {
+        hpack_encode_integer(out, huffman_length, 7, 0x80);
+        out += huffman_encode(value);
+    } else {
+        hpack_encode_integer(out, value.size(), 7);
+        out.append(value);
+    }
+}
+
+std::string HpackEncoder::encode(const HeaderList &headers) {
+    std::string out;
+    encode(headers, out);
+    return out;
+}
+
+void HpackEncoder::encode(const HeaderList &headers, std::string &out) {
+    if (size_update_pending) {
+        // A shrink followed by a grow must announce the minimum first, so
+        // the decoder evicts what the encoder evicted.
+        if (smallest_pending_size < dynamic.max_size()) {
+            hpack_encode_integer(out, smallest_pending_size, 5, 0x20);
+        }
+        hpack_encode_integer(out, dynamic.max_size(), 5, 0x20);
+        size_update_pending = false;
+    }
+
+    for (const HeaderField &field : headers) {
+        int64_t match = find_field(dynamic, field.name, field.value);
+        if (match > 0) {
+            hpack_encode_integer(out, match, 7, 0x80);
+            continue;
+        }
+
+        Indexing indexing = indexing_for(field.name);
+        uint64_t name_index = match < 0 ? -match : 0;
+        if (indexing == Indexing::INCREMENTAL) {
+            hpack_encode_integer(out, name_index, 6, 0x40);
+        } else {
+            hpack_encode_integer(out, name_index, 4,
+                                 indexing == Indexing::NEVER ? 0x10 : 0x00);
+        }
+        if (name_index == 0) {
+            encode_string(out, field.name);
+        }
+        encode_string(out, field.value);
+
+        if (indexing == Indexing::INCREMENTAL) {
+            dynamic.insert(field.name, field.value);
+        }
+    }
+}
+
+/////////////////////////////////
+// Decoder
+/////////////////////////////////
+
+HpackDecoder::HpackDecoder(size_t max_table_size)
+    : dynamic(max_table_size), settings_max_size(max_table_size) {}
+
+void HpackDecoder::set_max_table_size(size_t max_size) {
+    settings_max_size = max_size;
+    if (dynamic.max_size() > max_size) {
+        dynamic.set_max_size(max_size);
+    }
+}
+
+std::string HpackDecoder::decode_string(std::string_view block,
+                                        size_t &pos) {
+    if (pos >= block.size()) {
+        throw std::runtime_error("HPACK: truncated string");
+    }
+    bool huffman = static_cast<uint8_t>(block[pos]) & 0x80;
+    uint64_t length = hpack_decode_integer(block, pos, 7);
+    if (length > block.size() - pos) {
+        throw std::runtime_error("HPACK: string runs past the block");
+    }
+    std::string_view raw = block.substr(pos, length);
+    pos += length;
+    return huffman ? huffman_decode(raw) : std::string(raw);
+}
+
+HeaderField HpackDecoder::lookup(uint64_t index) const {
+    if (index == 0) {
+        throw std::runtime_error("HPACK: index 0");
+    }
+    if (index <= hpack_static_table.size()) {
+        const HpackStaticEntry &entry = hpack_static_table[index - 1];
+        return {std::string(entry.name), std::string(entry.value)};
+    }
+    index -= hpack_static_table.size() + 1;
+    if (index >= dynamic.count()) {
+        throw std::runtime_error("HPACK: index past the dynamic table");
+    }
+    return dynamic.at(index);
+}
+
+HeaderList HpackDecoder::decode(std::string_view block) {
+    HeaderList headers;
+    size_t list_size = 0;
+    size_t pos = 0;
+    bool fields_seen = false;
+
+    while (pos < block.size()) {
+        uint8_t first = static_cast<uint8_t>(block[pos]);
+
+        if ((first & 0xe0) == 0x20) {
+            // Dynamic table size update; only allowed before any field.
+            if (fields_seen) {
+                throw std::runtime_error("HPACK: size update after a field");
+            }
+            uint64_t size = hpack_decode_integer(block, pos, 5);
+            if (size > settings_max_size) {
+                throw std::runtime_error("HPACK: size update above the limit");
+            }
+            dynamic.set_max_size(size);
+            continue;
+        }
+        fields_seen = true;
+
+        HeaderField field;
+        if (first & 0x80) {
+            field = lookup(hpack_decode_integer(block, pos, 7));
+        } else {
+            bool incremental = (first & 0xc0) == 0x40;
+            uint64_t name_index =
+                hpack_decode_integer(block, pos, incremental ? 6 : 4);
+            field.name = name_index ? lookup(name_index).name
+                                    : decode_string(block, pos);
+            field.value = decode_string(block, pos);
+            if (incremental) {
+                dynamic.insert(field.name, field.value);
+            }
+        }
+
+        list_size += field.name.size() + field.value.size() +
+                     HpackDynamicTable::ENTRY_OVERHEAD;
+        if (list_size > max_list_size) {
+            throw std::runtime_error("HPACK: header list too large");
+        }
+        headers.push_back(std::move(field));
+    }
+    return headers;
+}
@@ -0,0 +1,135 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/////////////////////////////////
+// HPACK Primitives
+/////////////////////////////////
+
+// HTTP/2 header compression (RFC 7541). Header names are lower-case on the
+// wire, which matches how HttpRequest/HttpResponse store them.
+struct HeaderField {
+    std::string name;
+    std::string value;
+
+    bool operator==(const HeaderField &other) const {
+        return name == other.name && value == other.value;
+    }
+};
+using HeaderList = std::vector<HeaderField>;
+
+// Appends `value` as an HPACK integer with an N-bit prefix; `flags` holds
+// the bits above the prefix in the first byte.
+void hpack_encode_integer(std::string &out, uint64_t value,
+                          unsigned prefix_bits, uint8_t flags = 0);
+
+// Decodes the integer starting at `pos`, advancing it. Throws
+// std::runtime_error when the block ends early or the value overflows.
+uint64_t hpack_decode_integer(std::string_view data, size_t &pos,
+                              unsigned prefix_bits);
+
+// Static Huffman code of Appendix B. Decoding throws std::runtime_error on
+// EOS, on padding longer than 7 bits, or on padding that is not all ones.
+size_t huffman_encoded_length(std::string_view data);
+std::string huffman_encode(std::string_view data);
+std::string huffman_decode(std::string_view data);
+
+/////////////////////////////////
+// Dynamic Table
+/////////////////////////////////
+
+// FIFO of recently sent fields, newest first. Every entry costs its name
+// and value length plus 32 bytes against the size limit; inserting evicts
+// from the old end until the new entry fits.
+class HpackDynamicTable {
+  public:
+    static constexpr size_t ENTRY_OVERHEAD = 32;
+
+    explicit HpackDynamicTable(size_t max_size) : limit(max_size) {}
+
+    void insert(std::string_view name, std::string_view value);
+    void set_max_size(size_t max_size);
+
+    // 0 is the newest entry (HPACK index 62).
+    const HeaderField &at(size_t index) const { return entries[index]; }
+    size_t count() const { return entries.size(); }
+    size_t size() const { return bytes; }
+    size_t max_size() const { return limit; }
+
+  private:
+    void evict_to(size_t target);
+
+    std::deque<HeaderField> entries;
+    size_t bytes = 0;
+    size_t limit;
+};
+
+/////////////////////////////////
+// Encoder / Decoder
+/////////////////////////////////
+
+// Per-connection state for one direction. Fields already in either table
+// go out as a one or two byte index. Other fields are literals, which add
+// themselves to the dynamic table unless they are unlikely to repeat
+// (paths, lengths, dates) or are credentials, which are never indexed so
+// intermediaries do not either. Strings are Huffman coded whenever that
+// is shorter.
+class HpackEncoder {
+  public:
+    explicit HpackEncoder(size_t max_table_size = 4096);
+
+    // The peer's SETTINGS_HEADER_TABLE_SIZE. The change is announced at the
+    // start of the next header block.
+    void set_max_table_size(size_t max_size);
+
+    std::string encode(const HeaderList &headers);
+    void encode(const HeaderList &headers, std::string &out);
+
+    const HpackDynamicTable &table() const { return dynamic; }
+
+  private:
+    void encode_string(std::string &out, std::string_view value);
+
+    HpackDynamicTable dynamic;
+    bool size_update_pending = false;
+    size_t smallest_pending_size = 0;
+};
+
+class HpackDecoder {
+  public:
+    explicit HpackDecoder(size_t max_table_size = 4096);
+
+    // Our SETTINGS_HEADER_TABLE_SIZE: the most the peer's size updates may
+    // ask for.
+    void set_max_table_size(size_t max_size);
+
+    // Decoded list size (name + value + 32 per field) above which decode()
+    // fails, so a small block cannot expand into unbounded memory.
+    void set_max_header_list_size(size_t max_size) {
+        max_list_size = max_size;
+    }
+
+    // Decodes one complete header block. Throws std::runtime_error if it is
+    // malformed; the table state is then undefined and the connection must
+    // be closed (COMPRESSION_ERROR).
+    HeaderList decode(std::string_view block);
+
+    const HpackDynamicTable &table() const { return dynamic; }
+
+  private:
+    std::string decode_string(std::string_view block, size_t &pos);
+    HeaderField lookup(uint64_t index) const;
+
+    HpackDynamicTable dynamic;
+    size_t settings_max_size;
+    size_t max_list_size = 64 * 1024;
+};
@@ -3,6 +3,7 @@
 //
 
 #include <algorithm>
+#include <cerrno>
 #include <bits/types/struct_timeval.h>
 #include <cstring>
 #include <functional>
@@ -13,8 +14,59 @@
 #include <sys/select.h>
 #include <sys/socket.h>
 
+#include "buffer_pool.hpp"
 #include "http.hpp"
+#include "http2.hpp"
+#include "http_tables.hpp"
 #include "string_utils.hpp"
+#include "tls.hpp"
+#include "websocket.hpp"
+
+// Case-insensitive prefix test against an already lower-case `prefix`.
+static bool starts_with_lowercase(std::string_view text,
+                                  std::string_view prefix) {
+    if (text.size() < prefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/////////////////////////////////
+// Serialization helpers
+/////////////////////////////////
+
+// Both to_string() implementations size the output exactly up front and then
+// memcpy every piece into a single allocation. Registered header names and
+// standard status lines come preformatted from http_tables.hpp, so the only
+// per-character work left is format_header_name() for unknown headers.
+
+static char *copy_bytes(char *out, std::string_view bytes) {
+    std::memcpy(out, bytes.data(), bytes.size());
+    return out + bytes.size();
+}
+
+static size_t header_line_size(const std::string &name,
+                               const std::string &value) {
+    return name.size() + 2 + value.size() + 2;
+}
+
+static char *write_header_line(char *out, const std::string &name,
+                               const std::string &value) {
+    std::string_view canonical = canonical_header_name(name);
+    if (!canonical.empty()) {
+        out = copy_bytes(out, canonical);
+    } else {
+        out = copy_bytes(out, format_header_name(name));
+    }
+    out = copy_bytes(out, ": ");
+    out = copy_bytes(out, value);
+    return copy_bytes(out, "\r\n");
+}
 
 HttpRequest HttpRequest::parse(const std::string &raw_request) {
     HttpRequest request;
@@ -50,17 +102,66 @@ HttpRequest HttpRequest::parse(const std::string &raw_request) {
         }
     }
 
-    std::string body;
-    while (std::getline(stream, line)) {
-        body += line + "\n";
+    std::streampos body_start = stream.tellg();
+    if (body_start < 0 ||
+        static_cast<size_t>(body_start) >= raw_request.size()) {
+        return request;
     }
-
-    if (!body.empty()) {
+    std::string_view body =
+        std::string_view(raw_request).substr(static_cast<size_t>(body_start));
+    if (request.get_header("transfer-encoding") != "chunked") {
         request.body = body;
+        return request;
     }
+
+    BodyLimits unlimited;
+    unlimited.memory_limit = unlimited.max_size = SIZE_MAX;
+    RequestBody decoded(unlimited);
+    BodyDecoder decoder(BodyFraming{true, 0});
+    decoder.feed(body, decoded);
+    request.body = decoded.take_memory();
     return request;
 }
 
+// Shared framing for both message directions: the head up to the blank line
+// plus a Content-Length body, or 0 while more bytes are needed.
+static size_t content_length_framed(std::string_view data) {
+    size_t head_end = data.find("\r\n\r\n");
+    if (head_end == std::string_view::npos) {
+        return 0;
+    }
+    head_end += 4;
+
+    size_t body_length = 0;
+    std::string_view head = data.substr(0, head_end);
+    size_t line_start = head.find("\r\n") + 2;
+    while (line_start < head_end) {
+        size_t line_end = head.find("\r\n", line_start);
+        std::string_view line = head.substr(line_start, line_end - line_start);
+        line_start = line_end + 2;
+
+        static constexpr std::string_view name = "content-length:";
+        if (!starts_with_lowercase(line, name)) {
+            continue;
+        }
+        std::string_view value = line.substr(name.size());
+        size_t digits = value.find_first_not_of(" \t");
+        if (digits != std::string_view::npos) {
+            body_length = std::strtoull(value.data() + digits, nullptr, 10);
+        }
+        break;
+    }
+
+    if (data.size() - head_end < body_length) {
+        return 0;
+    }
+    return head_end + body_length;
+}
+
+size_t HttpRequest::complete_length(std::string_view data) {
+    return content_length_framed(data);
+}
+
 void HttpRequest::create_get(
     const std::string &request_uri,
     const std::map<std::string, std::string> &parameters) {
@@ -159,21 +260,32 @@ void HttpRequest::create_put(
 }
 
 std::string HttpRequest::to_string() const {
-    auto headers_copy = headers;
-
-    std::ostringstream request_stream;
-    request_stream << method << " " << path << " " << version << "\r\n";
-    for (const auto [name, value] : headers_copy) {
-        std::string display_name = format_header_name(name);
-        request_stream << display_name << ": " << value << "\r\n";
+    size_t total =
+        method.size() + 1 + path.size() + 1 + version.size() + 2 + 2;
+    for (const auto &[name, value] : headers) {
+        total += header_line_size(name, value);
     }
+    total += body.size();
 
-    request_stream << "\r\n";
-    if (!body.empty()) {
-        request_stream << body;
+    std::string request_str;
+    request_str.resize(total);
+    char *cursor = request_str.data();
+
+    cursor = copy_bytes(cursor, method);
+    *cursor++ = ' ';
+    cursor = copy_bytes(cursor, path);
+    *cursor++ = ' ';
+    cursor = copy_bytes(cursor, version);
+    cursor = copy_bytes(cursor, "\r\n");
+
+    for (const auto &[name, value] : headers) {
+        cursor = write_header_line(cursor, name, value);
     }
 
-    return request_stream.str();
+    cursor = copy_bytes(cursor, "\r\n");
+    copy_bytes(cursor, body);
+
+    return request_str;
 }
 
 void HttpRequest::create_delete(
@@ -217,12 +329,13 @@ void HttpRequest::create_delete(
     set_header("Host", "localhost");
 }
 
-HttpResponse HttpResponse::switching_protocol() {
-    // TODO: Implment correct header values
+HttpResponse HttpResponse::switching_protocol(
+    const std::string &websocket_key) {
     HttpResponse response(101, "Switching Protocols");
     response.set_header("Upgrade", "websocket");
     response.set_header("Connection", "Upgrade");
-    response.set_header("Sec-WebSocket-Accept", "SAMPLE_CODE");
+    response.set_header("Sec-WebSocket-Accept",
+                        websocket_accept_key(websocket_key));
 
     return response;
 }
@@ -283,6 +396,19 @@ HttpResponse HttpResponse::bad_request(const std::string &message) {
     return response;
 }
 
+HttpResponse HttpResponse::event_stream(bool chunked) {
+    HttpResponse response(200, "OK");
+    response.is_sse = true;
+    response.set_header("Content-Type", "text/event-stream");
+    response.set_header("Cache-Control", "no-cache");
+    if (chunked) {
+        response.set_header("Transfer-Encoding", "chunked");
+    } else {
+        response.set_header("Connection", "close");
+    }
+    return response;
+}
+
 void HttpResponse::set_streaming(
     std::function<void(std::ostream &)> stream_callback, size_t content_length,
     const std::string &content_type) {
@@ -299,27 +425,60 @@ void HttpResponse::write_to_stream(std::ostream &os) const {
 }
 
 std::string HttpResponse::to_string() const {
-    std::ostringstream response_stream;
-    response_stream << version << " " << status_code << " " << reason_phrase
-                    << "\r\n";
-
-    auto headers_copy = headers;
-
-    if (!has_header("content-length")) {
-        headers_copy["content-length"] = std::to_string(body.length());
+    std::string_view status_line =
+        precomputed_status_line(status_code, version, reason_phrase);
+    std::string formatted_status_line;
+    if (status_line.empty()) {
+        formatted_status_line = version + " " + std::to_string(status_code) +
+                                " " + reason_phrase + "\r\n";
+        status_line = formatted_status_line;
     }
 
-    for (const auto [name, value] : headers_copy) {
-        std::string display_name = format_header_name(name);
-        response_stream << display_name << ": " << value << "\r\n";
+    // A missing Content-Length is synthesized from the body and emitted at
+    // the position std::map ordering would have given it, without copying
+    // the header map to insert it. 1xx and 204 responses never carry one,
+    // and chunked or event-stream ones are framed by their chunks or the
+    // connection closing instead.
+    static const std::string content_length_name = "content-length";
+    bool add_length = status_code >= 200 && status_code != 204 && !is_sse &&
+                      headers.find(content_length_name) == headers.end() &&
+                      headers.find("transfer-encoding") == headers.end();
+    std::string length_value;
+
+    size_t total = status_line.size() + 2 + body.size();
+    for (const auto &[name, value] : headers) {
+        total += header_line_size(name, value);
+    }
+    if (add_length) {
+        length_value = std::to_string(body.length());
+        total += header_line_size(content_length_name, length_value);
     }
 
-    response_stream << "\r\n";
-    if (!body.empty()) {
-        response_stream << body;
+    std::string response_str;
+    response_str.resize(total);
+    char *cursor = response_str.data();
+
+    cursor = copy_bytes(cursor, status_line);
+    for (const auto &[name, value] : headers) {
+        if (add_length && name > content_length_name) {
+            cursor =
+                write_header_line(cursor, content_length_name, length_value);
+            add_length = false;
+        }
+        cursor = write_header_line(cursor, name, value);
+    }
+    if (add_length) {
+        cursor = write_header_line(cursor, content_length_name, length_value);
     }
 
-    return response_stream.str();
+    cursor = copy_bytes(cursor, "\r\n");
+    copy_bytes(cursor, body);
+
+    return response_str;
+}
+
+size_t HttpResponse::complete_length(std::string_view data) {
+    return content_length_framed(data);
 }
 
 HttpResponse HttpResponse::parse(const std::string &raw_response) {
@@ -328,9 +487,13 @@ HttpResponse HttpResponse::parse(const std::string &raw_response) {
     std::string line;
 
     if (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
         std::istringstream response_line(line);
-        response_line >> response.version >> response.status_code >>
-            response.reason_phrase;
+        response_line >> response.version >> response.status_code;
+        // "Not Found" and the like are more than one word.
+        std::getline(response_line >> std::ws, response.reason_phrase);
     }
 
     while (std::getline(stream, line) && !line.empty() && line != "\r") {
@@ -357,62 +520,440 @@ HttpResponse HttpResponse::parse(const std::string &raw_response) {
         }
     }
 
-    std::string body;
-    while (std::getline(stream, line)) {
-        body += line + "\n";
+    // The body is taken byte for byte, like a request's, so binary bodies
+    // and bodies with line breaks come back unchanged.
+    std::streampos body_start = stream.tellg();
+    if (body_start < 0 ||
+        static_cast<size_t>(body_start) >= raw_response.size()) {
+        return response;
     }
-
-    if (!body.empty()) {
+    std::string_view body =
+        std::string_view(raw_response).substr(static_cast<size_t>(body_start));
+    if (response.get_header("transfer-encoding") != "chunked") {
         response.body = body;
+        return response;
     }
+
+    BodyDecoder decoder(BodyFraming{true, 0});
+    decoder.feed(body, [&response](std::string_view data) {
+        response.body.append(data);
+    });
     return response;
 }
 
-HttpResponse HttpClient::send_request(HttpRequest request) {
-    if (!is_connected) {
-        throw std::runtime_error("Not connected to server");
+HttpClient::HttpClient(std::string host_name, short int host_port)
+    : HttpClient(Endpoint::tcp(std::move(host_name),
+                               static_cast<uint16_t>(host_port))) {}
+
+HttpClient::HttpClient(Endpoint endpoint)
+    : endpoint(std::move(endpoint)), addresses(resolve(this->endpoint)) {
+    std::cout << "Creating client for " << this->endpoint.to_string()
+              << "\n";
+}
+
+HttpClient::~HttpClient() {
+    if (client_fd >= 0) {
+        close(client_fd);
     }
+    std::cout << "Removing client\n";
+}
 
-    std::string request_str = request.to_string();
-    if (send(client_fd, request_str.c_str(), request_str.length(), 0) < 0) {
-        throw std::runtime_error("Failed to send request");
+signed int HttpClient::connect_to_server() {
+    if (is_connected) {
+        return 0;
+    }
+    if (client_fd >= 0) {
+        close(client_fd);
     }
+    client_fd = connect_socket(addresses);
+    if (client_fd < 0) {
+        std::cerr << "Connect to " << endpoint.to_string()
+                  << " failed: " << strerror(errno) << "\n";
+        return -1;
+    }
+    is_connected = true;
+
+    std::cout << "Connected to server\n";
+    return 0;
+}
 
-    std::string response_data;
-    char buffer[4096];
+static void send_all(int fd, TlsSession *tls, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t sent = tls ? tls->write(data.data(), data.size())
+                           : send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            throw std::runtime_error("Failed to send request");
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+}
+
+// Waits at most five seconds for `fd` to become readable.
+static void wait_readable(int fd) {
     fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(fd, &read_fds);
     struct timeval timeout;
     timeout.tv_sec = 5;
     timeout.tv_usec = 0;
 
-    while (true) {
-        FD_ZERO(&read_fds);
-        FD_SET(client_fd, &read_fds);
+    int select_result = select(fd + 1, &read_fds, nullptr, nullptr, &timeout);
+    if (select_result < 0) {
+        throw std::runtime_error("Select error");
+    } else if (select_result == 0) {
+        throw std::runtime_error("Timeout waiting for response");
+    }
+}
 
-        int select_result =
-            select(client_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+// Appends whatever arrives next, waiting at most five seconds. Returns false
+// once the server has closed the connection.
+static bool receive_some(int fd, TlsSession *tls, BufferPool::Buffer &buffer,
+                         std::string &received) {
+    // Bytes OpenSSL has already decrypted never show up on the fd.
+    if (!tls || !tls->has_buffered_input()) {
+        wait_readable(fd);
+    }
 
-        if (select_result < 0) {
-            throw std::runtime_error("Select error");
-        } else if (select_result == 0) {
-            throw std::runtime_error("Timeout waiting for response");
-        }
+    ssize_t bytes_received =
+        tls ? tls->read(buffer.data(), buffer.capacity())
+            : recv(fd, buffer.data(), buffer.capacity(), 0);
+    if (bytes_received < 0) {
+        throw std::runtime_error("Error receiving response");
+    }
+    // Appending by length keeps NUL bytes in binary bodies intact.
+    received.append(buffer.data(), static_cast<size_t>(bytes_received));
+    return bytes_received > 0;
+}
 
-        int bytes_received = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-        if (bytes_received < 0) {
+namespace {
+
+// A pipe that closes itself, for moving a download into a file with
+// splice(); one end of every splice() must be a pipe.
+class SplicePipe {
+  public:
+    SplicePipe() {
+        if (pipe2(fds, O_CLOEXEC) < 0) {
+            throw std::runtime_error(std::string("Cannot create a pipe: ") +
+                                     std::strerror(errno));
+        }
+    }
+    ~SplicePipe() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    SplicePipe(const SplicePipe &) = delete;
+    SplicePipe &operator=(const SplicePipe &) = delete;
+
+    // Moves up to `length` bytes from the socket into the file at its
+    // current offset. Returns how many, 0 once the server has closed.
+    size_t move(int socket_fd, int file_fd, size_t length) {
+        wait_readable(socket_fd);
+        // A pipe holds 64KB by default, and it is drained before returning.
+        length = std::min<size_t>(length, 64 * 1024);
+        ssize_t received;
+        do {
+            received = splice(socket_fd, nullptr, fds[1], nullptr, length,
+                              SPLICE_F_MOVE);
+        } while (received < 0 && errno == EINTR);
+        if (received < 0) {
             throw std::runtime_error("Error receiving response");
         }
+        size_t moved = 0;
+        while (moved < static_cast<size_t>(received)) {
+            ssize_t result =
+                splice(fds[0], nullptr, file_fd, nullptr,
+                       static_cast<size_t>(received) - moved, SPLICE_F_MOVE);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                throw std::runtime_error(
+                    std::string("Cannot write download: ") +
+                    std::strerror(errno));
+            }
+            moved += static_cast<size_t>(result);
+        }
+        return moved;
+    }
+
+  private:
+    int fds[2];
+};
+
+}  // namespace
 
-        if (bytes_received == 0) {
+HttpResponse HttpClient::exchange(const HttpRequest &request,
+                                  const BodySink &sink, int file_fd) {
+    send_all(client_fd, tls.get(), request.to_string());
+
+    std::string received = std::move(unread);
+    unread.clear();
+    BufferPool::Buffer buffer = BufferPool::instance().acquire();
+
+    // Interim 1xx responses come ahead of the final one; a 101 is final
+    // because the connection speaks another protocol after it.
+    HttpResponse response;
+    BodyFraming framing;
+    while (true) {
+        size_t head_end;
+        while ((head_end = received.find("\r\n\r\n")) ==
+               std::string::npos) {
+            if (!receive_some(client_fd, tls.get(), buffer, received)) {
+                throw std::runtime_error("Connection closed by server");
+            }
+        }
+        std::string head = received.substr(0, head_end + 4);
+        received.erase(0, head.size());
+        response = HttpResponse::parse(head);
+        if (response.status_code < 100 || response.status_code >= 200 ||
+            response.status_code == 101) {
+            framing = response_body_framing(head, response.status_code,
+                                            request.method == "HEAD");
             break;
         }
+    }
 
-        buffer[bytes_received] = '\0';
-        response_data += buffer;
+    // Whatever stops the body half way leaves the connection in the middle
+    // of a response, so it is given up.
+    BodyDecoder decoder(framing);
+    bool closed = false;
+    try {
+        received.erase(0, decoder.feed(received, sink));
+        std::unique_ptr<SplicePipe> pipe;
+        while (!decoder.done()) {
+            // Raw bytes can skip userspace; TLS records must be decrypted.
+            if (file_fd >= 0 && !tls && decoder.raw_remaining() > 0) {
+                if (!pipe) {
+                    pipe = std::make_unique<SplicePipe>();
+                }
+                size_t moved =
+                    pipe->move(client_fd, file_fd, decoder.raw_remaining());
+                if (moved == 0) {
+                    closed = true;
+                    break;
+                }
+                decoder.skip_raw(moved);
+                continue;
+            }
+            if (!receive_some(client_fd, tls.get(), buffer, received)) {
+                closed = true;
+                break;
+            }
+            received.erase(0, decoder.feed(received, sink));
+        }
+        if (closed && !framing.until_close) {
+            throw std::runtime_error(
+                "Connection closed before the response body ended");
+        }
+    } catch (...) {
+        tls.reset();
+        disconnect();
+        throw;
+    }
 
-        if (response_data.find("\r\n\r\n") != std::string::npos) {
-            break;
+    if (closed || response.get_header("connection") == "close") {
+        tls.reset();
+        disconnect();
+    } else {
+        unread = std::move(received);
+    }
+    return response;
+}
+
+HttpResponse HttpClient::send_request(HttpRequest request) {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    if (http2) {
+        return send_requests({request}).front();
+    }
+
+    std::string body;
+    HttpResponse response = exchange(
+        request, [&body](std::string_view data) { body.append(data); });
+    response.body = std::move(body);
+    return response;
+}
+
+HttpResponse HttpClient::send_request(HttpRequest request,
+                                      const BodySink &sink) {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    if (!http2) {
+        return exchange(request, sink);
+    }
+
+    HttpResponse response = send_requests({request}).front();
+    sink(response.body);
+    response.body.clear();
+    return response;
+}
+
+HttpResponse HttpClient::download(HttpRequest request, int file_fd) {
+    auto write_file = [file_fd](std::string_view data) {
+        while (!data.empty()) {
+            ssize_t written = write(file_fd, data.data(), data.size());
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                throw std::runtime_error(
+                    std::string("Cannot write download: ") +
+                    std::strerror(errno));
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+    };
+    if (is_connected && !http2) {
+        return exchange(request, write_file, file_fd);
+    }
+    return send_request(request, write_file);
+}
+
+HttpResponse HttpClient::download(HttpRequest request, char *buffer,
+                                  size_t capacity, size_t &body_size) {
+    body_size = 0;
+    return send_request(request, [&](std::string_view data) {
+        if (data.size() > capacity - body_size) {
+            throw std::runtime_error("Response body larger than " +
+                                     std::to_string(capacity) + " bytes");
+        }
+        std::memcpy(buffer + body_size, data.data(), data.size());
+        body_size += data.size();
+    });
+}
+
+void HttpClient::start_tls(const std::string &ca_path) {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    if (tls) {
+        return;
+    }
+    // The session keeps its own reference to the OpenSSL context. The
+    // socket is blocking, so the handshake runs to completion here.
+    auto session = std::make_unique<TlsSession>(TlsContext::client(ca_path),
+                                                client_fd, endpoint.host);
+    if (session->handshake() != TlsSession::Status::DONE) {
+        throw std::runtime_error(session->error());
+    }
+    tls = std::move(session);
+}
+
+void HttpClient::start_http2() {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    if (http2) {
+        return;
+    }
+    http2 = std::make_unique<Http2Connection>(Http2Connection::Role::CLIENT);
+    send_all(client_fd, tls.get(), http2->take_output());
+}
+
+HttpResponse HttpClient::upgrade_to_http2(HttpRequest request) {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    if (http2) {
+        return send_request(request);
+    }
+
+    auto connection =
+        std::make_unique<Http2Connection>(Http2Connection::Role::CLIENT);
+    request.set_header("connection", "Upgrade, HTTP2-Settings");
+    request.set_header("upgrade", "h2c");
+    request.set_header("http2-settings",
+                       base64url_encode(connection->settings_payload()));
+    send_all(client_fd, tls.get(), request.to_string());
+
+    std::string received = std::move(unread);
+    unread.clear();
+    BufferPool::Buffer buffer = BufferPool::instance().acquire();
+    size_t head_length = 0;
+    while ((head_length = HttpResponse::complete_length(received)) == 0) {
+        if (!receive_some(client_fd, tls.get(), buffer, received)) {
+            throw std::runtime_error("Connection closed by server");
+        }
+    }
+    HttpResponse response =
+        HttpResponse::parse(received.substr(0, head_length));
+    if (response.status_code != 101) {
+        return response;
+    }
+
+    // The preface and our SETTINGS follow the 101; the server's frames may
+    // already be in `received`.
+    connection->complete_upgrade();
+    http2 = std::move(connection);
+    return await_http2_responses(
+               {1}, std::string_view(received).substr(head_length))
+        .front();
+}
+
+std::vector<HttpResponse>
+HttpClient::send_requests(const std::vector<HttpRequest> &requests) {
+    if (!is_connected) {
+        throw std::runtime_error("Not connected to server");
+    }
+    std::vector<HttpResponse> responses;
+    if (!http2) {
+        for (const HttpRequest &request : requests) {
+            responses.push_back(send_request(request));
+        }
+        return responses;
+    }
+
+    std::vector<uint32_t> stream_ids;
+    for (const HttpRequest &request : requests) {
+        stream_ids.push_back(http2->submit_request(request));
+    }
+    return await_http2_responses(stream_ids, {});
+}
+
+std::vector<HttpResponse>
+HttpClient::await_http2_responses(const std::vector<uint32_t> &stream_ids,
+                                  std::string_view received) {
+    std::map<uint32_t, size_t> positions;
+    for (size_t i = 0; i < stream_ids.size(); ++i) {
+        positions[stream_ids[i]] = i;
+    }
+    std::vector<HttpResponse> responses(stream_ids.size());
+    size_t outstanding = stream_ids.size();
+
+    http2->receive(received);
+    std::string input;
+    BufferPool::Buffer buffer = BufferPool::instance().acquire();
+    while (true) {
+        send_all(client_fd, tls.get(), http2->take_output());
+        for (auto &[stream_id, response, error] : http2->take_responses()) {
+            auto position = positions.find(stream_id);
+            if (position == positions.end()) {
+                continue;
+            }
+            if (error != Http2ErrorCode::NO_ERROR) {
+                throw std::runtime_error("HTTP/2 stream " +
+                                         std::to_string(stream_id) +
+                                         " was reset");
+            }
+            responses[position->second] = std::move(response);
+            --outstanding;
+        }
+        if (outstanding == 0) {
+            return responses;
+        }
+        if (http2->closed()) {
+            throw std::runtime_error("HTTP/2 connection closed");
+        }
+
+        input.clear();
+        if (!receive_some(client_fd, tls.get(), buffer, input)) {
+            throw std::runtime_error("Connection closed by server");
         }
+        http2->receive(input);
     }
-    return HttpResponse::parse(response_data);
 }
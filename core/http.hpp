@@ -3,7 +3,10 @@
 //
 
 #pragma once
+#include "json.hpp"
+#include "request_body.hpp"
 #include "string_utils.hpp"
+#include "transport.hpp"
 
 #include <algorithm>
 #include <cstdint>
@@ -11,7 +14,9 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <arpa/inet.h>
@@ -38,15 +43,41 @@ class HttpRequest {
     std::map<std::string, std::string> headers;
     std::string body;
 
+    // Set instead of `body` when the body outgrew BodyLimits::memory_limit
+    // while it was received and now lives in a temporary file.
+    std::shared_ptr<RequestBody> spilled_body;
+
     // Default constructor just creating an empty HttpRequest shell
     HttpRequest() {}
 
+    // The body is taken byte for byte after the blank line, and decoded
+    // first when the head says "Transfer-Encoding: chunked" (a malformed
+    // chunk throws std::runtime_error).
     static HttpRequest parse(const std::string &raw_request);
 
+    // Length of the first complete request at the start of `data`: the head
+    // up to the blank line plus a Content-Length body. Returns 0 while more
+    // bytes are needed, so a server can frame pipelined or partially
+    // received requests before handing them to parse().
+    static size_t complete_length(std::string_view data);
+
     bool has_header(const std::string &name) const;
     std::string get_header(const std::string &name) const;
     void set_header(const std::string &key, const std::string &value);
 
+    // The body as a stream, wherever it is kept. The request must outlive
+    // the stream.
+    std::unique_ptr<std::istream> open_body() const {
+        return spilled_body ? spilled_body->open() : open_memory_stream(body);
+    }
+    size_t body_size() const {
+        return spilled_body ? spilled_body->size() : body.size();
+    }
+
+    // Indexes the body for on-demand field access (see JsonDocument). The
+    // document points into `body`, so the request must outlive it.
+    JsonDocument json() const { return JsonDocument(body); }
+
     void create_get(const std::string &request_uri,
                     const std::map<std::string, std::string> &parameters = {});
 
@@ -63,6 +94,8 @@ class HttpRequest {
     void create_post(const std::string &request_uri,
                      const std::map<std::string, std::string> &form_data);
 
+    // Strings are sent as they are; any other value is serialized with
+    // to_json() (see json.hpp), which must support its type.
     template <typename T>
     void create_post(const std::string &request_uri, const T &data,
                      const std::string &content_type = "application/json");
@@ -101,19 +134,14 @@ void HttpRequest::create_post(const std::string &request_uri, const T &data,
     path = request_uri;
     version = "HTTP/1.1";
 
-    std::string content;
-
-    if constexpr (std::is_same_v<T, std::string>) {
-        content = data;
+    if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        body = std::string_view(data);
     } else {
-        static_assert(std::is_same_v<T, std::string>,
-                      "Unsupported data type for POST request");
+        body = to_json(data);
     }
 
     set_header("content-type", content_type);
-    set_header("content-length", std::to_string(content.length()));
-
-    body = content;
+    set_header("content-length", std::to_string(body.length()));
 }
 
 template <typename T>
@@ -123,19 +151,14 @@ void HttpRequest::create_put(const std::string &request_uri, const T &data,
     path = request_uri;
     version = "HTTP/1.1";
 
-    std::string content;
-
-    if constexpr (std::is_same_v<T, std::string>) {
-        content = data;
+    if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        body = std::string_view(data);
     } else {
-        static_assert(std::is_same_v<T, std::string>,
-                      "Unsupported data type for PUT request");
+        body = to_json(data);
     }
 
     set_header("content-type", content_type);
-    set_header("content-length", std::to_string(content.length()));
-
-    body = content;
+    set_header("content-length", std::to_string(body.length()));
 }
 
 inline bool HttpRequest::has_header(const std::string &name) const {
@@ -183,17 +206,34 @@ class HttpResponse {
     // Status code 200
     static HttpResponse ok(const std::string &body = "");
     static HttpResponse json_response(const std::string &json = "");
+
+    // Serializes `value` with to_json() straight into the body.
+    template <typename T>
+        requires(!std::is_convertible_v<const T &, std::string_view>)
+    static HttpResponse json_response(const T &value);
     static HttpResponse html_response(const std::string &html = "");
     static HttpResponse binary_response(const std::vector<uint8_t> &binary);
 
-    static HttpResponse switching_protocol();
+    // 101 answer to a WebSocket upgrade carrying the client's
+    // Sec-WebSocket-Key.
+    static HttpResponse switching_protocol(const std::string &websocket_key);
     static HttpResponse not_found(const std::string &resource = "");
     static HttpResponse server_error(const std::string &message = "");
     static HttpResponse bad_request(const std::string &message = "");
 
+    // Head of a long-lived text/event-stream response; the events follow as
+    // they are published (see core/sse.hpp). Chunked for HTTP/1.1 clients;
+    // otherwise the body runs until the connection closes.
+    static HttpResponse event_stream(bool chunked = true);
+
     // parsing
     static HttpResponse parse(const std::string &raw_response);
 
+    // Length of the first complete Content-Length framed response at the
+    // start of `data`, or 0 while more bytes are needed. Chunked and
+    // close-delimited bodies are not framed by this.
+    static size_t complete_length(std::string_view data);
+
     bool has_header(const std::string &name) const;
     void set_header(const std::string &key, const std::string &value);
     std::string get_header(const std::string &name) const;
@@ -206,7 +246,7 @@ class HttpResponse {
         return *this;
     }
 
-    bool is_binary_response() { return is_binary; };
+    bool is_binary_response() const { return is_binary; };
 
     HttpResponse &set_binary_body(
         const std::vector<uint8_t> &binary_content,
@@ -224,7 +264,8 @@ class HttpResponse {
 
     std::string to_string() const;
 
-    bool is_streaming_response() { return is_streaming; };
+    bool is_streaming_response() const { return is_streaming; };
+    bool is_event_stream() const { return is_sse; }
     void set_streaming(std::function<void(std::ostream &)> stream_callback,
                        size_t content_length,
                        const std::string &content_type = "text/plain");
@@ -233,10 +274,21 @@ class HttpResponse {
   private:
     bool is_binary = false;
     bool is_streaming = false;
+    bool is_sse = false;
 
     std::function<void(std::ostream &)> stream_callback;
 };
 
+template <typename T>
+    requires(!std::is_convertible_v<const T &, std::string_view>)
+HttpResponse HttpResponse::json_response(const T &value) {
+    HttpResponse response(200, "OK");
+    response.body = to_json(value);
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Content-Length", std::to_string(response.body.size()));
+    return response;
+}
+
 inline bool HttpResponse::has_header(const std::string &name) const {
     std::string lower_name = name;
     std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
@@ -265,100 +317,102 @@ inline std::string HttpResponse::get_header(const std::string &name) const {
 // HTTP Client
 /////////////////////////////////
 
+class Http2Connection;
+class TlsSession;
+
 class HttpClient {
   public:
-    HttpClient(std::string host_name, short int host_port)
-        : hostname(host_name), port(host_port) {
-        std::cout << "Creating client \n";
-        if (!resolve_hostname()) {
-            throw std::runtime_error("Failed to resolve hostname: " + hostname);
-        }
-    }
-
-    signed int connect_to_server() {
-        std::cout << "Hostname: " << addr.sin_addr.s_addr << std::endl;
-        std::cout << "Port: " << addr.sin_port << std::endl;
-
-        if (connect(client_fd, reinterpret_cast<struct sockaddr *>(&addr),
-                    sizeof(addr)) < 0) {
-            std::cerr << "Connect failed\n";
-            close(client_fd);
-            return -1;
-        }
-        is_connected = true;
-
-        std::cout << "Connected to server\n";
-        return 0;
-    };
-
+    // Out of line, like the destructor: both need Http2Connection complete.
+    // A TCP host is resolved here; throws std::runtime_error if it does
+    // not resolve.
+    HttpClient(std::string host_name, short int host_port);
+    explicit HttpClient(Endpoint endpoint);
+
+    // Connects to the first resolved address that accepts. Returns 0 when
+    // connected, also if the client already was, and -1 otherwise.
+    signed int connect_to_server();
+
+    // The whole response, body included. The body is framed by
+    // Content-Length, chunked coding or the server closing the connection,
+    // and kept byte for byte.
     HttpResponse send_request(HttpRequest request);
 
+    // Receives a response body piece by piece as it arrives, so a download
+    // of any size costs a fixed amount of memory.
+    using BodySink = std::function<void(std::string_view data)>;
+
+    // Like send_request(), but the body goes to `sink` and the returned
+    // response has none. Over HTTP/2 the body is collected first. Throws
+    // std::runtime_error if the connection ends before the body does, or
+    // whatever `sink` throws; the client is disconnected then.
+    HttpResponse send_request(HttpRequest request, const BodySink &sink);
+
+    // Writes the body to `file_fd` at its current offset. Over plain TCP a
+    // Content-Length or close-delimited body moves with splice(), socket to
+    // file, without passing through userspace.
+    HttpResponse download(HttpRequest request, int file_fd);
+
+    // Reads the body into the caller's `buffer`; `body_size` is set to its
+    // length. Throws std::runtime_error if it does not fit.
+    HttpResponse download(HttpRequest request, char *buffer, size_t capacity,
+                          size_t &body_size);
+
+    // Runs a TLS handshake on the connected socket, sending the host name as
+    // SNI and verifying the certificate against it. `ca_path` is a PEM file
+    // of trusted certificates, the system store when empty. Everything sent
+    // afterwards, HTTP/2 included, is encrypted. Over a UNIX socket there is
+    // no host name, so only the certificate chain is checked. Throws
+    // std::runtime_error if the handshake fails.
+    void start_tls(const std::string &ca_path = "");
+
+    bool using_tls() const { return tls != nullptr; }
+
+    // Switches to HTTP/2 with prior knowledge: the connection preface goes
+    // out before any request. Later send_request() calls use HTTP/2.
+    void start_http2();
+
+    // Sends `request` as HTTP/1.1 with "Upgrade: h2c". If the server agrees
+    // (101) the connection continues as HTTP/2 and the response arrives on
+    // stream 1; otherwise the plain HTTP/1.1 response is returned.
+    HttpResponse upgrade_to_http2(HttpRequest request);
+
+    // Over HTTP/2 all requests are in flight at once, one stream each;
+    // over HTTP/1.1 they are sent one after another. Responses come back in
+    // request order. Throws std::runtime_error if a stream is reset.
+    std::vector<HttpResponse>
+    send_requests(const std::vector<HttpRequest> &requests);
+
+    bool using_http2() const { return http2 != nullptr; }
+
     void disconnect() {
         is_connected = false;
         std::cout << "Disconnected from server\n";
     };
 
-    ~HttpClient() { std::cout << "Removing client\n"; };
+    ~HttpClient();
 
   private:
-    std::string hostname;
-    std::string port_str;
+    Endpoint endpoint;
+    std::vector<SocketAddress> addresses;
 
     bool is_connected = false;
-    int client_fd;
-    struct sockaddr res;
-    struct sockaddr_in addr;
-    short int port;
-
-    bool resolve_hostname() {
-        struct addrinfo hints;
-        struct addrinfo *result;
-
-        memset(&hints, 0, sizeof(hints));
-
-        hints.ai_family = AF_UNSPEC;
-        hints.ai_socktype = SOCK_STREAM;
-        hints.ai_flags = AI_PASSIVE;
-
-        port_str = std::to_string(port);
-
-        std::cout << "Hostname: " << hostname << std::endl;
-        std::cout << "Port: " << port_str << std::endl;
-
-        int status =
-            getaddrinfo(hostname.c_str(), port_str.c_str(), &hints, &result);
-
-        if (status != 0) {
-            std::cerr << "getaddrinfo error: " << gai_strerror(status)
-                      << std::endl;
-            return false;
-        }
-
-        struct addrinfo *rp;
-        for (rp = result; rp != NULL; rp = rp->ai_next) {
-            client_fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-
-            if (client_fd == -1) {
-                continue;
-            }
-
-            std::cout << "before Memcpy: " << addr.sin_addr.s_addr << ", "
-                      << addr.sin_port << std::endl;
-            if (rp->ai_family == AF_INET) {
-                memcpy(&addr, rp->ai_addr, sizeof(struct sockaddr_in));
-                std::cout << "after Memcpy: " << addr.sin_addr.s_addr << ", "
-                          << addr.sin_port << std::endl;
-                break;
-            }
-        }
-
-        freeaddrinfo(result);
-
-        if (rp == nullptr) {
-            std::cerr << "Could not resolve hostname" << std::endl;
-            return false;
-        }
-
-        return true;
-    }
+    int client_fd = -1;
+    std::unique_ptr<Http2Connection> http2;
+    std::unique_ptr<TlsSession> tls;
+
+    // Bytes read past the end of the last response.
+    std::string unread;
+
+    // Drives the HTTP/2 connection until every stream in `stream_ids` has
+    // its response; `received` is input already read off the socket.
+    std::vector<HttpResponse>
+    await_http2_responses(const std::vector<uint32_t> &stream_ids,
+                          std::string_view received);
+
+    // Sends `request` over HTTP/1.1 and reads its response: the head into
+    // the returned response, the body into `sink`. With a `file_fd` the
+    // body is spliced there where it can be. Anything thrown while the
+    // body is read disconnects the client.
+    HttpResponse exchange(const HttpRequest &request, const BodySink &sink,
+                          int file_fd = -1);
 };
@@ -0,0 +1,1140 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <cctype>
+
+#include "http2.hpp"
+#include "http_tables.hpp"
+
+/////////////////////////////////
+// Frames
+/////////////////////////////////
+
+enum Http2SettingId : uint16_t {
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5,
+    SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+// The encoder never keeps more than this, whatever the peer allows.
+static constexpr uint32_t MAX_ENCODER_TABLE_SIZE = 4096;
+
+static void put_uint32(std::string &out, uint32_t value) {
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>(value >> 16);
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+}
+
+static uint32_t get_uint32(std::string_view data, size_t pos) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(data[pos])) << 24 |
+           static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 1])) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 2])) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 3]));
+}
+
+Http2FrameHeader decode_http2_frame_header(std::string_view data) {
+    Http2FrameHeader header;
+    header.length = static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 16 |
+                    static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 8 |
+                    static_cast<uint32_t>(static_cast<uint8_t>(data[2]));
+    header.type = static_cast<Http2FrameType>(data[3]);
+    header.flags = static_cast<uint8_t>(data[4]);
+    header.stream_id = get_uint32(data, 5) & HTTP2_MAX_WINDOW;
+    return header;
+}
+
+void append_http2_frame(std::string &out, Http2FrameType type, uint8_t flags,
+                        uint32_t stream_id, std::string_view payload) {
+    out += static_cast<char>(payload.size() >> 16);
+    out += static_cast<char>(payload.size() >> 8);
+    out += static_cast<char>(payload.size());
+    out += static_cast<char>(type);
+    out += static_cast<char>(flags);
+    put_uint32(out, stream_id);
+    out.append(payload);
+}
+
+std::string encode_http2_settings(const Http2Settings &settings) {
+    static const Http2Settings defaults;
+    std::string payload;
+    auto put = [&payload](uint16_t id, uint32_t value) {
+        payload += static_cast<char>(id >> 8);
+        payload += static_cast<char>(id);
+        put_uint32(payload, value);
+    };
+    if (settings.header_table_size != defaults.header_table_size) {
+        put(SETTINGS_HEADER_TABLE_SIZE, settings.header_table_size);
+    }
+    if (settings.enable_push != defaults.enable_push) {
+        put(SETTINGS_ENABLE_PUSH, settings.enable_push);
+    }
+    if (settings.max_concurrent_streams != defaults.max_concurrent_streams) {
+        put(SETTINGS_MAX_CONCURRENT_STREAMS, settings.max_concurrent_streams);
+    }
+    if (settings.initial_window_size != defaults.initial_window_size) {
+        put(SETTINGS_INITIAL_WINDOW_SIZE, settings.initial_window_size);
+    }
+    if (settings.max_frame_size != defaults.max_frame_size) {
+        put(SETTINGS_MAX_FRAME_SIZE, settings.max_frame_size);
+    }
+    if (settings.max_header_list_size != defaults.max_header_list_size) {
+        put(SETTINGS_MAX_HEADER_LIST_SIZE, settings.max_header_list_size);
+    }
+    return payload;
+}
+
+void apply_http2_settings(std::string_view payload, Http2Settings &settings) {
+    if (payload.size() % 6 != 0) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "SETTINGS length is not a multiple of 6");
+    }
+    for (size_t pos = 0; pos < payload.size(); pos += 6) {
+        uint16_t id = static_cast<uint8_t>(payload[pos]) << 8 |
+                      static_cast<uint8_t>(payload[pos + 1]);
+        uint32_t value = get_uint32(payload, pos + 2);
+        switch (id) {
+        case SETTINGS_HEADER_TABLE_SIZE:
+            settings.header_table_size = value;
+            break;
+        case SETTINGS_ENABLE_PUSH:
+            if (value > 1) {
+                throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                                 "SETTINGS_ENABLE_PUSH must be 0 or 1");
+            }
+            settings.enable_push = value;
+            break;
+        case SETTINGS_MAX_CONCURRENT_STREAMS:
+            settings.max_concurrent_streams = value;
+            break;
+        case SETTINGS_INITIAL_WINDOW_SIZE:
+            if (value > HTTP2_MAX_WINDOW) {
+                throw Http2Error(Http2ErrorCode::FLOW_CONTROL_ERROR,
+                                 "SETTINGS_INITIAL_WINDOW_SIZE too large");
+            }
+            settings.initial_window_size = value;
+            break;
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < HTTP2_MIN_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE) {
+                throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                                 "SETTINGS_MAX_FRAME_SIZE out of range");
+            }
+            settings.max_frame_size = value;
+            break;
+        case SETTINGS_MAX_HEADER_LIST_SIZE:
+            settings.max_header_list_size = value;
+            break;
+        default:
+            // Unknown settings must be ignored.
+            break;
+        }
+    }
+}
+
+/////////////////////////////////
+// Message Mapping
+/////////////////////////////////
+
+// Hop-by-hop headers have no meaning in HTTP/2 and make a message
+// malformed.
+static bool is_connection_specific(std::string_view name) {
+    return name == "connection" || name == "keep-alive" ||
+           name == "proxy-connection" || name == "transfer-encoding" ||
+           name == "upgrade" || name == "http2-settings";
+}
+
+static bool has_upper_case(std::string_view name) {
+    return std::any_of(name.begin(), name.end(),
+                       [](unsigned char c) { return std::isupper(c); });
+}
+
+// Repeated fields are folded into one map entry the way HTTP/1.1 allows;
+// cookies use "; " as RFC 9113 section 8.2.3 asks.
+static void add_regular_field(std::map<std::string, std::string> &headers,
+                              const HeaderField &field) {
+    auto [entry, created] = headers.try_emplace(field.name, field.value);
+    if (!created) {
+        entry->second += (field.name == "cookie" ? "; " : ", ") + field.value;
+    }
+}
+
+// Returns false for a malformed request, which resets the stream.
+static bool build_request(const HeaderList &fields, HttpRequest &request) {
+    std::string scheme;
+    std::string authority;
+    bool regular_seen = false;
+    for (const HeaderField &field : fields) {
+        if (field.name.empty() || has_upper_case(field.name)) {
+            return false;
+        }
+        if (field.name[0] == ':') {
+            std::string *target = nullptr;
+            if (field.name == ":method") {
+                target = &request.method;
+            } else if (field.name == ":path") {
+                target = &request.path;
+            } else if (field.name == ":scheme") {
+                target = &scheme;
+            } else if (field.name == ":authority") {
+                target = &authority;
+            }
+            if (regular_seen || target == nullptr || !target->empty()) {
+                return false;
+            }
+            *target = field.value;
+            continue;
+        }
+        regular_seen = true;
+        if (is_connection_specific(field.name) ||
+            (field.name == "te" && field.value != "trailers")) {
+            return false;
+        }
+        add_regular_field(request.headers, field);
+    }
+
+    if (request.method.empty() || request.path.empty() || scheme.empty()) {
+        return false;
+    }
+    request.version = "HTTP/2";
+    if (!authority.empty() && !request.has_header("host")) {
+        request.set_header("host", authority);
+    }
+    return true;
+}
+
+static bool build_response(const HeaderList &fields, HttpResponse &response) {
+    bool status_seen = false;
+    bool regular_seen = false;
+    response.headers.clear();
+    for (const HeaderField &field : fields) {
+        if (field.name.empty() || has_upper_case(field.name)) {
+            return false;
+        }
+        if (field.name[0] == ':') {
+            if (regular_seen || status_seen || field.name != ":status" ||
+                field.value.size() != 3 ||
+                !std::all_of(field.value.begin(), field.value.end(),
+                             [](unsigned char c) { return std::isdigit(c); })) {
+                return false;
+            }
+            status_seen = true;
+            response.status_code = std::stoi(field.value);
+            continue;
+        }
+        regular_seen = true;
+        if (is_connection_specific(field.name)) {
+            return false;
+        }
+        add_regular_field(response.headers, field);
+    }
+    if (!status_seen) {
+        return false;
+    }
+    response.version = "HTTP/2";
+    response.reason_phrase =
+        std::string(standard_reason_phrase(response.status_code));
+    return true;
+}
+
+/////////////////////////////////
+// Connection Setup
+/////////////////////////////////
+
+static bool contains_token(std::string value, std::string_view token) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return value.find(token) != std::string::npos;
+}
+
+bool is_h2c_upgrade(const HttpRequest &request) {
+    return contains_token(request.get_header("upgrade"), "h2c") &&
+           contains_token(request.get_header("connection"), "upgrade") &&
+           contains_token(request.get_header("connection"), "http2-settings") &&
+           request.has_header("http2-settings");
+}
+
+Http2Connection::Http2Connection(Role role, Options options)
+    : role(role), options(options),
+      encoder(MAX_ENCODER_TABLE_SIZE),
+      next_local_stream(role == Role::CLIENT ? 1 : 2) {
+    local.max_concurrent_streams = options.max_concurrent_streams;
+    local.initial_window_size = options.initial_window_size;
+    local.max_header_list_size = options.max_header_list_size;
+    if (role == Role::CLIENT) {
+        // Servers send no preface beyond their SETTINGS.
+        local.enable_push = 0;
+        output += HTTP2_CONNECTION_PREFACE;
+        preface_received = true;
+    }
+    decoder.set_max_header_list_size(options.max_header_list_size);
+
+    append_http2_frame(output, Http2FrameType::SETTINGS, 0, 0,
+                       encode_http2_settings(local));
+    if (options.connection_window > HTTP2_DEFAULT_WINDOW) {
+        std::string increment;
+        put_uint32(increment, options.connection_window - HTTP2_DEFAULT_WINDOW);
+        append_http2_frame(output, Http2FrameType::WINDOW_UPDATE, 0, 0,
+                           increment);
+        connection_recv_window = options.connection_window;
+    }
+}
+
+std::string Http2Connection::settings_payload() const {
+    return encode_http2_settings(local);
+}
+
+void Http2Connection::accept_upgrade(std::string_view settings,
+                                     HttpRequest request) {
+    apply_http2_settings(settings, peer);
+    encoder.set_max_table_size(
+        std::min(peer.header_table_size, MAX_ENCODER_TABLE_SIZE));
+
+    Stream &stream = open_stream(1);
+    stream.state = StreamState::HALF_CLOSED_REMOTE;
+    stream.head_request = request.method == "HEAD";
+    last_peer_stream = 1;
+    ready_requests.push_back({1, std::move(request)});
+}
+
+void Http2Connection::complete_upgrade() {
+    Stream &stream = open_stream(1);
+    stream.state = StreamState::HALF_CLOSED_LOCAL;
+    next_local_stream = 3;
+}
+
+bool Http2Connection::closed() const {
+    if (goaway_sent) {
+        return goaway_code != Http2ErrorCode::NO_ERROR || streams.empty();
+    }
+    return goaway_received && streams.empty() && queued_requests.empty();
+}
+
+std::string Http2Connection::take_output() {
+    std::string taken;
+    taken.swap(output);
+    return taken;
+}
+
+void Http2Connection::shutdown(Http2ErrorCode code) {
+    if (goaway_sent) {
+        return;
+    }
+    std::string payload;
+    put_uint32(payload, last_peer_stream);
+    put_uint32(payload, static_cast<uint32_t>(code));
+    append_http2_frame(output, Http2FrameType::GOAWAY, 0, 0, payload);
+    goaway_sent = true;
+    goaway_code = code;
+}
+
+/////////////////////////////////
+// Receiving
+/////////////////////////////////
+
+void Http2Connection::receive(std::string_view data) {
+    if (goaway_sent && goaway_code != Http2ErrorCode::NO_ERROR) {
+        return;
+    }
+    input.append(data);
+
+    try {
+        size_t pos = 0;
+        if (!preface_received) {
+            size_t compared =
+                std::min(input.size(), HTTP2_CONNECTION_PREFACE.size());
+            if (std::string_view(input).substr(0, compared) !=
+                HTTP2_CONNECTION_PREFACE.substr(0, compared)) {
+                throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                                 "Invalid connection preface");
+            }
+            if (compared < HTTP2_CONNECTION_PREFACE.size()) {
+                return;
+            }
+            preface_received = true;
+            pos = HTTP2_CONNECTION_PREFACE.size();
+        }
+
+        while (input.size() - pos >= HTTP2_FRAME_HEADER_SIZE) {
+            std::string_view pending(input);
+            pending.remove_prefix(pos);
+            Http2FrameHeader header = decode_http2_frame_header(pending);
+            if (header.length > local.max_frame_size) {
+                throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                                 "Frame larger than SETTINGS_MAX_FRAME_SIZE");
+            }
+            if (pending.size() - HTTP2_FRAME_HEADER_SIZE < header.length) {
+                break;
+            }
+            if (!settings_received &&
+                header.type != Http2FrameType::SETTINGS) {
+                throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                                 "First frame is not SETTINGS");
+            }
+            pos += HTTP2_FRAME_HEADER_SIZE + header.length;
+            process_frame(header, pending.substr(HTTP2_FRAME_HEADER_SIZE,
+                                                 header.length));
+        }
+        input.erase(0, pos);
+    } catch (const Http2Error &error) {
+        shutdown(error.code);
+        input.clear();
+        return;
+    }
+    pump();
+}
+
+void Http2Connection::process_frame(const Http2FrameHeader &header,
+                                    std::string_view payload) {
+    if (continuation_stream != 0 &&
+        (header.type != Http2FrameType::CONTINUATION ||
+         header.stream_id != continuation_stream)) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "Header block interrupted");
+    }
+
+    switch (header.type) {
+    case Http2FrameType::DATA:
+        handle_data(header, payload);
+        break;
+    case Http2FrameType::HEADERS:
+        handle_headers(header, payload);
+        break;
+    case Http2FrameType::PRIORITY:
+        handle_priority(header, payload);
+        break;
+    case Http2FrameType::RST_STREAM:
+        handle_rst_stream(header, payload);
+        break;
+    case Http2FrameType::SETTINGS:
+        handle_settings(header, payload);
+        break;
+    case Http2FrameType::PUSH_PROMISE:
+        // Clients disable push in their SETTINGS; servers never get it.
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "Unexpected PUSH_PROMISE");
+    case Http2FrameType::PING:
+        handle_ping(header, payload);
+        break;
+    case Http2FrameType::GOAWAY:
+        handle_goaway(header, payload);
+        break;
+    case Http2FrameType::WINDOW_UPDATE:
+        handle_window_update(header, payload);
+        break;
+    case Http2FrameType::CONTINUATION:
+        if (continuation_stream == 0) {
+            throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                             "CONTINUATION without HEADERS");
+        }
+        header_block.append(payload);
+        if (header_block.size() > options.max_header_list_size) {
+            throw Http2Error(Http2ErrorCode::ENHANCE_YOUR_CALM,
+                             "Header block too large");
+        }
+        if (header.flags & HTTP2_FLAG_END_HEADERS) {
+            finish_header_block();
+        }
+        break;
+    default:
+        // Unknown frame types are ignored.
+        break;
+    }
+}
+
+static std::string_view strip_padding(const Http2FrameHeader &header,
+                                      std::string_view payload) {
+    if (!(header.flags & HTTP2_FLAG_PADDED)) {
+        return payload;
+    }
+    if (payload.empty() ||
+        static_cast<uint8_t>(payload[0]) >= payload.size()) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "Padding longer than the frame");
+    }
+    size_t padding = static_cast<uint8_t>(payload[0]);
+    return payload.substr(1, payload.size() - 1 - padding);
+}
+
+bool Http2Connection::is_idle(uint32_t id) const {
+    bool peer_initiated = (id % 2 == 1) == (role == Role::SERVER);
+    return peer_initiated ? id > last_peer_stream : id >= next_local_stream;
+}
+
+void Http2Connection::handle_data(const Http2FrameHeader &header,
+                                  std::string_view payload) {
+    if (header.stream_id == 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR, "DATA on stream 0");
+    }
+
+    // Flow control counts the whole payload, padding included, even for
+    // frames on streams that are already gone.
+    if (header.length > connection_recv_window) {
+        throw Http2Error(Http2ErrorCode::FLOW_CONTROL_ERROR,
+                         "Connection flow-control window exceeded");
+    }
+    connection_recv_window -= header.length;
+    connection_recv_unacknowledged += header.length;
+    uint32_t connection_window =
+        std::max(options.connection_window, HTTP2_DEFAULT_WINDOW);
+    if (connection_recv_unacknowledged >= connection_window / 2) {
+        std::string increment;
+        put_uint32(increment, connection_recv_unacknowledged);
+        append_http2_frame(output, Http2FrameType::WINDOW_UPDATE, 0, 0,
+                           increment);
+        connection_recv_window += connection_recv_unacknowledged;
+        connection_recv_unacknowledged = 0;
+    }
+
+    auto found = streams.find(header.stream_id);
+    if (found == streams.end() ||
+        found->second.state == StreamState::HALF_CLOSED_REMOTE) {
+        if (is_idle(header.stream_id)) {
+            throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                             "DATA on idle stream");
+        }
+        reset_stream(header.stream_id, Http2ErrorCode::STREAM_CLOSED);
+        return;
+    }
+    Stream &stream = found->second;
+    std::string_view data = strip_padding(header, payload);
+
+    if (header.length > stream.recv_window) {
+        reset_stream(stream.id, Http2ErrorCode::FLOW_CONTROL_ERROR);
+        return;
+    }
+    stream.recv_window -= header.length;
+
+    std::string &body =
+        role == Role::SERVER ? stream.request.body : stream.response.body;
+    if (body.size() + data.size() > options.max_body_size) {
+        reset_stream(stream.id, Http2ErrorCode::CANCEL);
+        return;
+    }
+    body.append(data);
+
+    if (header.flags & HTTP2_FLAG_END_STREAM) {
+        end_remote(stream);
+        return;
+    }
+    stream.recv_unacknowledged += header.length;
+    if (stream.recv_unacknowledged >= options.initial_window_size / 2) {
+        std::string increment;
+        put_uint32(increment, stream.recv_unacknowledged);
+        append_http2_frame(output, Http2FrameType::WINDOW_UPDATE, 0,
+                           stream.id, increment);
+        stream.recv_window += stream.recv_unacknowledged;
+        stream.recv_unacknowledged = 0;
+    }
+}
+
+void Http2Connection::handle_headers(const Http2FrameHeader &header,
+                                     std::string_view payload) {
+    if (header.stream_id == 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "HEADERS on stream 0");
+    }
+    std::string_view fragment = strip_padding(header, payload);
+
+    block_dependency = 0;
+    block_weight = 16;
+    block_exclusive = false;
+    if (header.flags & HTTP2_FLAG_PRIORITY) {
+        if (fragment.size() < 5) {
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                             "HEADERS too short for its priority");
+        }
+        uint32_t dependency = get_uint32(fragment, 0);
+        block_exclusive = dependency & 0x80000000;
+        block_dependency = dependency & HTTP2_MAX_WINDOW;
+        block_weight = static_cast<uint8_t>(fragment[4]) + 1;
+        fragment.remove_prefix(5);
+        if (block_dependency == header.stream_id) {
+            throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                             "Stream depends on itself");
+        }
+    }
+
+    continuation_stream = header.stream_id;
+    continuation_flags = header.flags;
+    header_block.assign(fragment);
+    if (header.flags & HTTP2_FLAG_END_HEADERS) {
+        finish_header_block();
+    }
+}
+
+void Http2Connection::finish_header_block() {
+    uint32_t id = continuation_stream;
+    bool end_stream = continuation_flags & HTTP2_FLAG_END_STREAM;
+    bool has_priority = continuation_flags & HTTP2_FLAG_PRIORITY;
+    continuation_stream = 0;
+
+    // Always decode, even for streams about to be refused: the block
+    // updates the shared dynamic table.
+    HeaderList fields;
+    try {
+        fields = decoder.decode(header_block);
+    } catch (const std::runtime_error &error) {
+        throw Http2Error(Http2ErrorCode::COMPRESSION_ERROR, error.what());
+    }
+    header_block.clear();
+
+    auto found = streams.find(id);
+    if (role == Role::SERVER) {
+        if (found == streams.end()) {
+            bool peer_initiated = id % 2 == 1;
+            if (!peer_initiated || id <= last_peer_stream) {
+                throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                                 "HEADERS on a closed stream");
+            }
+            last_peer_stream = id;
+            if (goaway_sent) {
+                return;
+            }
+            if (streams.size() >= options.max_concurrent_streams) {
+                std::string code;
+                put_uint32(code, static_cast<uint32_t>(
+                                     Http2ErrorCode::REFUSED_STREAM));
+                append_http2_frame(output, Http2FrameType::RST_STREAM, 0, id,
+                                   code);
+                return;
+            }
+
+            Stream &stream = open_stream(id);
+            if (has_priority) {
+                set_priority(stream, block_dependency, block_weight,
+                             block_exclusive);
+            }
+            if (!build_request(fields, stream.request)) {
+                reset_stream(id, Http2ErrorCode::PROTOCOL_ERROR);
+                return;
+            }
+            stream.head_request = stream.request.method == "HEAD";
+            if (end_stream) {
+                end_remote(stream);
+            }
+            return;
+        }
+
+        // Trailers: they must end the stream, and are not passed on.
+        Stream &stream = found->second;
+        if (stream.state == StreamState::HALF_CLOSED_REMOTE) {
+            reset_stream(id, Http2ErrorCode::STREAM_CLOSED);
+        } else if (!end_stream) {
+            reset_stream(id, Http2ErrorCode::PROTOCOL_ERROR);
+        } else {
+            end_remote(stream);
+        }
+        return;
+    }
+
+    if (found == streams.end()) {
+        if (is_idle(id)) {
+            throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                             "HEADERS on an idle stream");
+        }
+        return;
+    }
+    Stream &stream = found->second;
+    if (stream.state == StreamState::HALF_CLOSED_REMOTE) {
+        reset_stream(id, Http2ErrorCode::STREAM_CLOSED);
+        return;
+    }
+    if (!stream.responded) {
+        if (!build_response(fields, stream.response)) {
+            reset_stream(id, Http2ErrorCode::PROTOCOL_ERROR);
+            return;
+        }
+        if (stream.response.status_code < 200) {
+            // Interim response (100 Continue, 103 Early Hints).
+            if (end_stream) {
+                reset_stream(id, Http2ErrorCode::PROTOCOL_ERROR);
+            }
+            return;
+        }
+        stream.responded = true;
+    } else if (!end_stream) {
+        reset_stream(id, Http2ErrorCode::PROTOCOL_ERROR);
+        return;
+    }
+    if (end_stream) {
+        end_remote(stream);
+    }
+}
+
+void Http2Connection::handle_priority(const Http2FrameHeader &header,
+                                      std::string_view payload) {
+    if (header.stream_id == 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "PRIORITY on stream 0");
+    }
+    if (payload.size() != 5) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "PRIORITY frame of the wrong size");
+    }
+    uint32_t dependency = get_uint32(payload, 0);
+    bool exclusive = dependency & 0x80000000;
+    dependency &= HTTP2_MAX_WINDOW;
+    uint16_t weight = static_cast<uint8_t>(payload[4]) + 1;
+
+    auto found = streams.find(header.stream_id);
+    if (found == streams.end()) {
+        // Priority for idle or closed streams is not tracked.
+        return;
+    }
+    if (dependency == header.stream_id) {
+        reset_stream(header.stream_id, Http2ErrorCode::PROTOCOL_ERROR);
+        return;
+    }
+    set_priority(found->second, dependency, weight, exclusive);
+}
+
+void Http2Connection::handle_rst_stream(const Http2FrameHeader &header,
+                                        std::string_view payload) {
+    if (payload.size() != 4) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "RST_STREAM frame of the wrong size");
+    }
+    if (header.stream_id == 0 || is_idle(header.stream_id)) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "RST_STREAM on an idle stream");
+    }
+    fail_stream(header.stream_id,
+                static_cast<Http2ErrorCode>(get_uint32(payload, 0)));
+}
+
+void Http2Connection::handle_settings(const Http2FrameHeader &header,
+                                      std::string_view payload) {
+    if (header.stream_id != 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "SETTINGS on a stream");
+    }
+    if (header.flags & HTTP2_FLAG_ACK) {
+        if (!payload.empty()) {
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                             "SETTINGS ACK with a payload");
+        }
+        return;
+    }
+
+    uint32_t old_window = peer.initial_window_size;
+    apply_http2_settings(payload, peer);
+    settings_received = true;
+
+    uint32_t table_size =
+        std::min(peer.header_table_size, MAX_ENCODER_TABLE_SIZE);
+    if (table_size != encoder.table().max_size()) {
+        encoder.set_max_table_size(table_size);
+    }
+
+    // A new initial window applies to every open stream retroactively.
+    int64_t delta = static_cast<int64_t>(peer.initial_window_size) -
+                    static_cast<int64_t>(old_window);
+    for (auto &[id, stream] : streams) {
+        stream.send_window += delta;
+        if (stream.send_window > HTTP2_MAX_WINDOW) {
+            throw Http2Error(Http2ErrorCode::FLOW_CONTROL_ERROR,
+                             "Stream window above 2^31-1");
+        }
+    }
+
+    append_http2_frame(output, Http2FrameType::SETTINGS, HTTP2_FLAG_ACK, 0,
+                       {});
+    start_queued_requests();
+}
+
+void Http2Connection::handle_ping(const Http2FrameHeader &header,
+                                  std::string_view payload) {
+    if (header.stream_id != 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR, "PING on a stream");
+    }
+    if (payload.size() != 8) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "PING frame of the wrong size");
+    }
+    if (!(header.flags & HTTP2_FLAG_ACK)) {
+        append_http2_frame(output, Http2FrameType::PING, HTTP2_FLAG_ACK, 0,
+                           payload);
+    }
+}
+
+void Http2Connection::handle_goaway(const Http2FrameHeader &header,
+                                    std::string_view payload) {
+    if (header.stream_id != 0) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "GOAWAY on a stream");
+    }
+    if (payload.size() < 8) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "GOAWAY frame too short");
+    }
+    goaway_received = true;
+    uint32_t last_stream = get_uint32(payload, 0) & HTTP2_MAX_WINDOW;
+
+    // Streams we opened above the peer's last processed id were never
+    // seen, and requests still queued will never be sent.
+    std::vector<uint32_t> dropped;
+    for (const auto &[id, stream] : streams) {
+        if (!is_idle(id) && (id % 2 == 1) == (role == Role::CLIENT) &&
+            id > last_stream) {
+            dropped.push_back(id);
+        }
+    }
+    for (uint32_t id : dropped) {
+        fail_stream(id, Http2ErrorCode::REFUSED_STREAM);
+    }
+    for (auto &[id, request] : queued_requests) {
+        ready_responses.push_back(
+            {id, HttpResponse(0, ""), Http2ErrorCode::REFUSED_STREAM});
+    }
+    queued_requests.clear();
+}
+
+void Http2Connection::handle_window_update(const Http2FrameHeader &header,
+                                           std::string_view payload) {
+    if (payload.size() != 4) {
+        throw Http2Error(Http2ErrorCode::FRAME_SIZE_ERROR,
+                         "WINDOW_UPDATE frame of the wrong size");
+    }
+    uint32_t increment = get_uint32(payload, 0) & HTTP2_MAX_WINDOW;
+
+    if (header.stream_id == 0) {
+        if (increment == 0) {
+            throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                             "WINDOW_UPDATE of 0");
+        }
+        connection_send_window += increment;
+        if (connection_send_window > HTTP2_MAX_WINDOW) {
+            throw Http2Error(Http2ErrorCode::FLOW_CONTROL_ERROR,
+                             "Connection window above 2^31-1");
+        }
+        return;
+    }
+
+    if (is_idle(header.stream_id)) {
+        throw Http2Error(Http2ErrorCode::PROTOCOL_ERROR,
+                         "WINDOW_UPDATE on an idle stream");
+    }
+    auto found = streams.find(header.stream_id);
+    if (found == streams.end()) {
+        return;
+    }
+    if (increment == 0) {
+        reset_stream(header.stream_id, Http2ErrorCode::PROTOCOL_ERROR);
+        return;
+    }
+    found->second.send_window += increment;
+    if (found->second.send_window > HTTP2_MAX_WINDOW) {
+        reset_stream(header.stream_id, Http2ErrorCode::FLOW_CONTROL_ERROR);
+    }
+}
+
+/////////////////////////////////
+// Stream Lifecycle
+/////////////////////////////////
+
+Http2Connection::Stream &Http2Connection::open_stream(uint32_t id) {
+    Stream &stream = streams[id];
+    stream.id = id;
+    stream.send_window = peer.initial_window_size;
+    stream.recv_window = local.initial_window_size;
+    set_priority(stream, 0, 16, false);
+    return stream;
+}
+
+void Http2Connection::close_stream(uint32_t id) {
+    auto found = streams.find(id);
+    if (found == streams.end()) {
+        return;
+    }
+    Stream &stream = found->second;
+
+    // Its children take its place under its parent.
+    std::vector<uint32_t> &siblings = children_of(stream.parent);
+    siblings.erase(std::remove(siblings.begin(), siblings.end(), id),
+                   siblings.end());
+    for (uint32_t child : stream.children) {
+        streams[child].parent = stream.parent;
+        siblings.push_back(child);
+    }
+    streams.erase(found);
+    start_queued_requests();
+}
+
+void Http2Connection::reset_stream(uint32_t id, Http2ErrorCode code) {
+    std::string payload;
+    put_uint32(payload, static_cast<uint32_t>(code));
+    append_http2_frame(output, Http2FrameType::RST_STREAM, 0, id, payload);
+    fail_stream(id, code);
+}
+
+void Http2Connection::fail_stream(uint32_t id, Http2ErrorCode code) {
+    if (!streams.count(id)) {
+        return;
+    }
+    if (role == Role::CLIENT) {
+        ready_responses.push_back({id, HttpResponse(0, ""), code});
+    }
+    close_stream(id);
+}
+
+void Http2Connection::end_remote(Stream &stream) {
+    if (role == Role::SERVER) {
+        ready_requests.push_back({stream.id, std::move(stream.request)});
+    } else {
+        ready_responses.push_back({stream.id, std::move(stream.response)});
+    }
+    if (stream.state == StreamState::HALF_CLOSED_LOCAL) {
+        close_stream(stream.id);
+    } else {
+        stream.state = StreamState::HALF_CLOSED_REMOTE;
+    }
+}
+
+void Http2Connection::end_local(Stream &stream) {
+    if (stream.state == StreamState::HALF_CLOSED_REMOTE) {
+        close_stream(stream.id);
+    } else {
+        stream.state = StreamState::HALF_CLOSED_LOCAL;
+    }
+}
+
+/////////////////////////////////
+// Sending
+/////////////////////////////////
+
+std::vector<Http2Connection::Request> Http2Connection::take_requests() {
+    std::vector<Request> taken;
+    taken.swap(ready_requests);
+    return taken;
+}
+
+std::vector<Http2Connection::Response> Http2Connection::take_responses() {
+    std::vector<Response> taken;
+    taken.swap(ready_responses);
+    return taken;
+}
+
+void Http2Connection::send_headers(uint32_t stream_id,
+                                   const HeaderList &headers,
+                                   bool end_stream) {
+    std::string block = encoder.encode(headers);
+    std::string_view remaining(block);
+    bool first = true;
+    do {
+        std::string_view chunk = remaining.substr(0, peer.max_frame_size);
+        remaining.remove_prefix(chunk.size());
+        uint8_t flags = remaining.empty() ? HTTP2_FLAG_END_HEADERS : 0;
+        if (first && end_stream) {
+            flags |= HTTP2_FLAG_END_STREAM;
+        }
+        append_http2_frame(output,
+                           first ? Http2FrameType::HEADERS
+                                 : Http2FrameType::CONTINUATION,
+                           flags, stream_id, chunk);
+        first = false;
+    } while (!remaining.empty());
+}
+
+void Http2Connection::submit_response(uint32_t stream_id,
+                                      const HttpResponse &response) {
+    auto found = streams.find(stream_id);
+    if (role != Role::SERVER || found == streams.end() ||
+        found->second.responded || goaway_code != Http2ErrorCode::NO_ERROR) {
+        return;
+    }
+    Stream &stream = found->second;
+    stream.responded = true;
+
+    HeaderList headers;
+    headers.push_back({":status", std::to_string(response.status_code)});
+    for (const auto &[name, value] : response.headers) {
+        if (!is_connection_specific(name)) {
+            headers.push_back({name, value});
+        }
+    }
+
+    int status = response.status_code;
+    bool has_body = !stream.head_request && !response.body.empty() &&
+                    status >= 200 && status != 204 && status != 304;
+    send_headers(stream_id, headers, !has_body);
+    if (!has_body) {
+        end_local(stream);
+        return;
+    }
+    stream.pending = response.body;
+    stream.pending_offset = 0;
+    pump();
+}
+
+uint32_t Http2Connection::submit_request(const HttpRequest &request) {
+    if (role != Role::CLIENT) {
+        throw std::runtime_error("Only an HTTP/2 client sends requests");
+    }
+    if (goaway_sent || goaway_received) {
+        throw std::runtime_error("HTTP/2 connection is going away");
+    }
+    if (next_local_stream > HTTP2_MAX_WINDOW) {
+        throw std::runtime_error("HTTP/2 stream ids exhausted");
+    }
+    uint32_t id = next_local_stream;
+    next_local_stream += 2;
+    queued_requests.emplace_back(id, request);
+    start_queued_requests();
+    pump();
+    return id;
+}
+
+void Http2Connection::start_queued_requests() {
+    // Streams must open in id order, so the queue is strictly FIFO.
+    while (!queued_requests.empty() &&
+           streams.size() < peer.max_concurrent_streams) {
+        auto [id, request] = std::move(queued_requests.front());
+        queued_requests.pop_front();
+
+        Stream &stream = open_stream(id);
+        stream.head_request = request.method == "HEAD";
+
+        std::string authority = request.get_header("host");
+        HeaderList headers;
+        headers.push_back({":method", request.method});
+        headers.push_back({":scheme", "http"});
+        headers.push_back(
+            {":authority", authority.empty() ? "localhost" : authority});
+        headers.push_back({":path", request.path.empty() ? "/" : request.path});
+        for (const auto &[name, value] : request.headers) {
+            if (name != "host" && !is_connection_specific(name)) {
+                headers.push_back({name, value});
+            }
+        }
+
+        bool has_body = !request.body.empty();
+        send_headers(id, headers, !has_body);
+        if (has_body) {
+            stream.pending = std::move(request.body);
+        } else {
+            end_local(stream);
+        }
+    }
+}
+
+void Http2Connection::pump() {
+    while (connection_send_window > 0) {
+        Stream *stream = next_sendable(root_children);
+        if (stream == nullptr) {
+            break;
+        }
+
+        size_t remaining = stream->pending.size() - stream->pending_offset;
+        size_t length = std::min<int64_t>(
+            {static_cast<int64_t>(remaining), peer.max_frame_size,
+             stream->send_window, connection_send_window});
+        bool last = length == remaining;
+        append_http2_frame(
+            output, Http2FrameType::DATA, last ? HTTP2_FLAG_END_STREAM : 0,
+            stream->id,
+            std::string_view(stream->pending)
+                .substr(stream->pending_offset, length));
+        stream->pending_offset += length;
+        stream->send_window -= length;
+        connection_send_window -= length;
+
+        // Charge the bytes to the stream and every ancestor, each at its
+        // own weight, so every level of the tree shares by weight.
+        for (Stream *node = stream;;) {
+            node->cycle += length * 256 / node->weight + 1;
+            if (node->parent == 0) {
+                break;
+            }
+            node = &streams[node->parent];
+        }
+
+        if (last) {
+            stream->pending.clear();
+            stream->pending_offset = 0;
+            end_local(*stream);
+        }
+    }
+}
+
+/////////////////////////////////
+// Priority
+/////////////////////////////////
+
+std::vector<uint32_t> &Http2Connection::children_of(uint32_t id) {
+    return id == 0 ? root_children : streams[id].children;
+}
+
+void Http2Connection::set_priority(Stream &stream, uint32_t parent,
+                                   uint16_t weight, bool exclusive) {
+    if (parent != 0 && !streams.count(parent)) {
+        // Unknown parents get the default priority (RFC 7540 5.3.1).
+        parent = 0;
+        weight = 16;
+        exclusive = false;
+    }
+
+    // Depending on one's own descendant: the descendant first moves up to
+    // take the stream's place (RFC 7540 5.3.3).
+    for (uint32_t up = parent; up != 0; up = streams[up].parent) {
+        if (up == stream.id) {
+            Stream &moved = streams[parent];
+            std::vector<uint32_t> &old = children_of(moved.parent);
+            old.erase(std::remove(old.begin(), old.end(), parent), old.end());
+            moved.parent = stream.parent;
+            children_of(stream.parent).push_back(parent);
+            break;
+        }
+    }
+
+    std::vector<uint32_t> &previous = children_of(stream.parent);
+    previous.erase(std::remove(previous.begin(), previous.end(), stream.id),
+                   previous.end());
+
+    stream.parent = parent;
+    stream.weight = weight;
+    std::vector<uint32_t> &siblings = children_of(parent);
+    if (exclusive) {
+        for (uint32_t child : siblings) {
+            streams[child].parent = stream.id;
+            stream.children.push_back(child);
+        }
+        siblings.clear();
+    }
+
+    // Start level with the least served sibling rather than at zero, so a
+    // new stream does not monopolize the connection to catch up.
+    stream.cycle = 0;
+    for (size_t i = 0; i < siblings.size(); ++i) {
+        uint64_t cycle = streams[siblings[i]].cycle;
+        stream.cycle = i == 0 ? cycle : std::min(stream.cycle, cycle);
+    }
+    siblings.push_back(stream.id);
+}
+
+Http2Connection::Stream *
+Http2Connection::next_sendable(const std::vector<uint32_t> &children) {
+    std::vector<Stream *> order;
+    order.reserve(children.size());
+    for (uint32_t id : children) {
+        order.push_back(&streams[id]);
+    }
+    std::sort(order.begin(), order.end(), [](Stream *a, Stream *b) {
+        return a->cycle < b->cycle;
+    });
+
+    for (Stream *child : order) {
+        if (child->pending_offset < child->pending.size() &&
+            child->send_window > 0) {
+            return child;
+        }
+        if (Stream *descendant = next_sendable(child->children)) {
+            return descendant;
+        }
+    }
+    return nullptr;
+}
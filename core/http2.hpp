@@ -0,0 +1,299 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hpack.hpp"
+#include "http.hpp"
+
+/////////////////////////////////
+// HTTP/2 Frames
+/////////////////////////////////
+
+// RFC 9113. Only cleartext HTTP/2 (h2c) is spoken here, entered either with
+// prior knowledge (the client opens with the connection preface) or by an
+// HTTP/1.1 "Upgrade: h2c" request.
+constexpr std::string_view HTTP2_CONNECTION_PREFACE =
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr size_t HTTP2_FRAME_HEADER_SIZE = 9;
+constexpr uint32_t HTTP2_DEFAULT_WINDOW = 65535;
+constexpr uint32_t HTTP2_MAX_WINDOW = 0x7fffffff;
+constexpr uint32_t HTTP2_MIN_FRAME_SIZE = 16384;
+constexpr uint32_t HTTP2_MAX_FRAME_SIZE = 16777215;
+
+enum class Http2FrameType : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    PRIORITY = 0x2,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PUSH_PROMISE = 0x5,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9,
+};
+
+constexpr uint8_t HTTP2_FLAG_END_STREAM = 0x1;
+constexpr uint8_t HTTP2_FLAG_ACK = 0x1;
+constexpr uint8_t HTTP2_FLAG_END_HEADERS = 0x4;
+constexpr uint8_t HTTP2_FLAG_PADDED = 0x8;
+constexpr uint8_t HTTP2_FLAG_PRIORITY = 0x20;
+
+enum class Http2ErrorCode : uint32_t {
+    NO_ERROR = 0x0,
+    PROTOCOL_ERROR = 0x1,
+    INTERNAL_ERROR = 0x2,
+    FLOW_CONTROL_ERROR = 0x3,
+    SETTINGS_TIMEOUT = 0x4,
+    STREAM_CLOSED = 0x5,
+    FRAME_SIZE_ERROR = 0x6,
+    REFUSED_STREAM = 0x7,
+    CANCEL = 0x8,
+    COMPRESSION_ERROR = 0x9,
+    CONNECT_ERROR = 0xa,
+    ENHANCE_YOUR_CALM = 0xb,
+    INADEQUATE_SECURITY = 0xc,
+    HTTP_1_1_REQUIRED = 0xd,
+};
+
+// A protocol violation, carrying the code the connection is closed with.
+class Http2Error : public std::runtime_error {
+  public:
+    Http2Error(Http2ErrorCode code, const std::string &message)
+        : std::runtime_error(message), code(code) {}
+    Http2ErrorCode code;
+};
+
+struct Http2FrameHeader {
+    uint32_t length = 0;
+    Http2FrameType type = Http2FrameType::DATA;
+    uint8_t flags = 0;
+    uint32_t stream_id = 0;
+};
+
+// `data` must hold at least HTTP2_FRAME_HEADER_SIZE bytes.
+Http2FrameHeader decode_http2_frame_header(std::string_view data);
+void append_http2_frame(std::string &out, Http2FrameType type, uint8_t flags,
+                        uint32_t stream_id, std::string_view payload);
+
+struct Http2Settings {
+    uint32_t header_table_size = 4096;
+    uint32_t enable_push = 1;
+    uint32_t max_concurrent_streams = UINT32_MAX;
+    uint32_t initial_window_size = HTTP2_DEFAULT_WINDOW;
+    uint32_t max_frame_size = HTTP2_MIN_FRAME_SIZE;
+    uint32_t max_header_list_size = UINT32_MAX;
+};
+
+// SETTINGS payload listing every value that differs from the defaults.
+std::string encode_http2_settings(const Http2Settings &settings);
+
+// Applies a SETTINGS payload. Throws Http2Error on a malformed payload or
+// an out of range value.
+void apply_http2_settings(std::string_view payload, Http2Settings &settings);
+
+/////////////////////////////////
+// HTTP/2 Connection
+/////////////////////////////////
+
+// An HTTP/1.1 request asking to continue as h2c (RFC 7540 section 3.2):
+// "Upgrade: h2c", "Connection: Upgrade, HTTP2-Settings" and the settings.
+bool is_h2c_upgrade(const HttpRequest &request);
+
+// One HTTP/2 connection, either end, independent of the socket: feed it the
+// bytes read with receive(), write out what take_output() returns. Requests
+// and responses use the same HttpRequest/HttpResponse types as HTTP/1.1;
+// pseudo-headers map to method, path and status and the rest to `headers`.
+//
+// Flow control: the receive windows are refilled with WINDOW_UPDATE once
+// half of them is used, and response bodies are queued per stream and sent
+// as DATA only as far as the peer's windows allow. Whenever several
+// streams have data ready, the one to send next is chosen from the
+// priority tree that HEADERS and PRIORITY frames build (RFC 7540 section
+// 5.3). A stream is only served when none of its ancestors can send.
+// Siblings share the connection in proportion to their weights.
+//
+// Connection errors queue a GOAWAY and make closed() true; the caller
+// should flush the output and close the socket. Stream errors only reset
+// the stream.
+class Http2Connection {
+  public:
+    enum class Role { CLIENT, SERVER };
+
+    struct Options {
+        uint32_t max_concurrent_streams = 256;
+        uint32_t initial_window_size = 1 << 20;
+        uint32_t connection_window = 16 << 20;
+        uint32_t max_header_list_size = 64 * 1024;
+        size_t max_body_size = 16 << 20;
+    };
+
+    struct Request {
+        uint32_t stream_id;
+        HttpRequest request;
+    };
+
+    // `error` is NO_ERROR for a complete response, otherwise the reason the
+    // stream was reset or dropped by GOAWAY before completing.
+    struct Response {
+        uint32_t stream_id;
+        HttpResponse response;
+        Http2ErrorCode error = Http2ErrorCode::NO_ERROR;
+    };
+
+    explicit Http2Connection(Role role) : Http2Connection(role, Options{}) {}
+    Http2Connection(Role role, Options options);
+
+    // Our SETTINGS payload, for the client's HTTP2-Settings header.
+    std::string settings_payload() const;
+
+    // Server, on "Upgrade: h2c": applies the client's HTTP2-Settings and
+    // takes `request` as stream 1, already complete. Its response is
+    // submitted like any other. Throws Http2Error if the settings are
+    // malformed.
+    void accept_upgrade(std::string_view settings, HttpRequest request);
+
+    // Client, after the server answered the upgrade request with 101: the
+    // response to that request arrives on stream 1.
+    void complete_upgrade();
+
+    void receive(std::string_view data);
+
+    // Server side.
+    std::vector<Request> take_requests();
+    // Ignored when the stream has been reset or closed meanwhile.
+    void submit_response(uint32_t stream_id, const HttpResponse &response);
+
+    // Client side. Returns the stream id; streams beyond the server's
+    // concurrency limit wait until one finishes. Throws std::runtime_error
+    // once the connection is going away.
+    uint32_t submit_request(const HttpRequest &request);
+    std::vector<Response> take_responses();
+
+    // Sends GOAWAY. With NO_ERROR no new streams are accepted but open ones
+    // may finish; with an error code the connection is done.
+    void shutdown(Http2ErrorCode code = Http2ErrorCode::NO_ERROR);
+
+    std::string take_output();
+    bool wants_write() const { return !output.empty(); }
+    bool closed() const;
+    size_t active_streams() const { return streams.size(); }
+
+    const Http2Settings &peer_settings() const { return peer; }
+
+  private:
+    enum class StreamState { OPEN, HALF_CLOSED_LOCAL, HALF_CLOSED_REMOTE };
+
+    struct Stream {
+        uint32_t id = 0;
+        StreamState state = StreamState::OPEN;
+        HttpRequest request;
+        HttpResponse response;
+        bool head_request = false;
+        // Server: response submitted. Client: final response headers in.
+        bool responded = false;
+
+        int64_t send_window = 0;
+        int64_t recv_window = 0;
+        uint32_t recv_unacknowledged = 0;
+
+        // Body bytes waiting for flow-control credit.
+        std::string pending;
+        size_t pending_offset = 0;
+
+        // Priority tree position. `cycle` is the virtual time the stream
+        // has been served for; the lowest sibling goes next.
+        uint32_t parent = 0;
+        uint16_t weight = 16;
+        std::vector<uint32_t> children;
+        uint64_t cycle = 0;
+    };
+
+    void process_frame(const Http2FrameHeader &header,
+                       std::string_view payload);
+    void handle_data(const Http2FrameHeader &header,
+                     std::string_view payload);
+    void handle_headers(const Http2FrameHeader &header,
+                        std::string_view payload);
+    void finish_header_block();
+    void handle_priority(const Http2FrameHeader &header,
+                         std::string_view payload);
+    void handle_rst_stream(const Http2FrameHeader &header,
+                           std::string_view payload);
+    void handle_settings(const Http2FrameHeader &header,
+                         std::string_view payload);
+    void handle_ping(const Http2FrameHeader &header, std::string_view payload);
+    void handle_goaway(const Http2FrameHeader &header,
+                       std::string_view payload);
+    void handle_window_update(const Http2FrameHeader &header,
+                              std::string_view payload);
+
+    Stream &open_stream(uint32_t id);
+    void close_stream(uint32_t id);
+    void reset_stream(uint32_t id, Http2ErrorCode code);
+    void fail_stream(uint32_t id, Http2ErrorCode code);
+    bool is_idle(uint32_t id) const;
+    void end_remote(Stream &stream);
+    void end_local(Stream &stream);
+
+    void send_headers(uint32_t stream_id, const HeaderList &headers,
+                      bool end_stream);
+    void start_queued_requests();
+    void pump();
+
+    std::vector<uint32_t> &children_of(uint32_t id);
+    void set_priority(Stream &stream, uint32_t parent, uint16_t weight,
+                      bool exclusive);
+    Stream *next_sendable(const std::vector<uint32_t> &children);
+
+    Role role;
+    Options options;
+    Http2Settings local;
+    Http2Settings peer;
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+
+    std::string input;
+    std::string output;
+    bool preface_received = false;
+    bool settings_received = false;
+
+    std::map<uint32_t, Stream> streams;
+    std::vector<uint32_t> root_children;
+    uint32_t last_peer_stream = 0;
+    uint32_t next_local_stream;
+
+    // Header block being assembled from HEADERS + CONTINUATION frames, and
+    // the priority its HEADERS frame carried.
+    uint32_t continuation_stream = 0;
+    uint8_t continuation_flags = 0;
+    std::string header_block;
+    uint32_t block_dependency = 0;
+    uint16_t block_weight = 16;
+    bool block_exclusive = false;
+
+    int64_t connection_send_window = HTTP2_DEFAULT_WINDOW;
+    int64_t connection_recv_window = HTTP2_DEFAULT_WINDOW;
+    uint32_t connection_recv_unacknowledged = 0;
+
+    // Client requests waiting for a free stream slot, in stream id order.
+    std::deque<std::pair<uint32_t, HttpRequest>> queued_requests;
+
+    std::vector<Request> ready_requests;
+    std::vector<Response> ready_responses;
+
+    bool goaway_sent = false;
+    bool goaway_received = false;
+    Http2ErrorCode goaway_code = Http2ErrorCode::NO_ERROR;
+};
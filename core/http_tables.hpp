@@ -0,0 +1,238 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+/////////////////////////////////
+// Canonical Header Names
+/////////////////////////////////
+
+// Headers are stored lower-case (see set_header), but go out on the wire in
+// their registered spelling. Looking the spelling up in a sorted constexpr
+// table replaces the per-character rebuild in format_header_name(), which is
+// only left as the slow path for names that are not in here. The table also
+// covers the handful of names whose canonical form does not follow the
+// "capitalize after every dash" rule (ETag, WWW-Authenticate, TE, ...).
+struct HeaderNameEntry {
+    std::string_view lower;
+    std::string_view canonical;
+};
+
+inline constexpr std::array<HeaderNameEntry, 62> canonical_header_names{{
+    {"accept", "Accept"},
+    {"accept-charset", "Accept-Charset"},
+    {"accept-encoding", "Accept-Encoding"},
+    {"accept-language", "Accept-Language"},
+    {"accept-ranges", "Accept-Ranges"},
+    {"access-control-allow-credentials", "Access-Control-Allow-Credentials"},
+    {"access-control-allow-headers", "Access-Control-Allow-Headers"},
+    {"access-control-allow-methods", "Access-Control-Allow-Methods"},
+    {"access-control-allow-origin", "Access-Control-Allow-Origin"},
+    {"access-control-max-age", "Access-Control-Max-Age"},
+    {"age", "Age"},
+    {"allow", "Allow"},
+    {"authorization", "Authorization"},
+    {"cache-control", "Cache-Control"},
+    {"connection", "Connection"},
+    {"content-disposition", "Content-Disposition"},
+    {"content-encoding", "Content-Encoding"},
+    {"content-language", "Content-Language"},
+    {"content-length", "Content-Length"},
+    {"content-location", "Content-Location"},
+    {"content-range", "Content-Range"},
+    {"content-security-policy", "Content-Security-Policy"},
+    {"content-type", "Content-Type"},
+    {"cookie", "Cookie"},
+    {"date", "Date"},
+    {"dnt", "DNT"},
+    {"etag", "ETag"},
+    {"expect", "Expect"},
+    {"expires", "Expires"},
+    {"forwarded", "Forwarded"},
+    {"from", "From"},
+    {"host", "Host"},
+    {"if-match", "If-Match"},
+    {"if-modified-since", "If-Modified-Since"},
+    {"if-none-match", "If-None-Match"},
+    {"if-range", "If-Range"},
+    {"if-unmodified-since", "If-Unmodified-Since"},
+    {"keep-alive", "Keep-Alive"},
+    {"last-event-id", "Last-Event-ID"},
+    {"last-modified", "Last-Modified"},
+    {"link", "Link"},
+    {"location", "Location"},
+    {"origin", "Origin"},
+    {"pragma", "Pragma"},
+    {"range", "Range"},
+    {"referer", "Referer"},
+    {"retry-after", "Retry-After"},
+    {"sec-websocket-accept", "Sec-WebSocket-Accept"},
+    {"sec-websocket-key", "Sec-WebSocket-Key"},
+    {"sec-websocket-protocol", "Sec-WebSocket-Protocol"},
+    {"sec-websocket-version", "Sec-WebSocket-Version"},
+    {"server", "Server"},
+    {"set-cookie", "Set-Cookie"},
+    {"strict-transport-security", "Strict-Transport-Security"},
+    {"te", "TE"},
+    {"trailer", "Trailer"},
+    {"transfer-encoding", "Transfer-Encoding"},
+    {"upgrade", "Upgrade"},
+    {"user-agent", "User-Agent"},
+    {"vary", "Vary"},
+    {"via", "Via"},
+    {"www-authenticate", "WWW-Authenticate"},
+}};
+
+static_assert(std::is_sorted(canonical_header_names.begin(),
+                             canonical_header_names.end(),
+                             [](const HeaderNameEntry &a,
+                                const HeaderNameEntry &b) {
+                                 return a.lower < b.lower;
+                             }),
+              "canonical_header_names must stay sorted for lower_bound");
+
+// Serializers size their output from the stored lower-case name, so a
+// canonical spelling may only ever change case, never length.
+static_assert(std::all_of(canonical_header_names.begin(),
+                          canonical_header_names.end(),
+                          [](const HeaderNameEntry &entry) {
+                              return entry.lower.size() ==
+                                     entry.canonical.size();
+                          }),
+              "canonical header names must match their lower-case length");
+
+// Returns the registered spelling of a lower-case header name, or an empty
+// view when the name is unknown and the caller has to fall back to
+// format_header_name().
+constexpr std::string_view canonical_header_name(std::string_view lower) {
+    auto it = std::lower_bound(
+        canonical_header_names.begin(), canonical_header_names.end(), lower,
+        [](const HeaderNameEntry &entry, std::string_view name) {
+            return entry.lower < name;
+        });
+    if (it != canonical_header_names.end() && it->lower == lower) {
+        return it->canonical;
+    }
+    return {};
+}
+
+/////////////////////////////////
+// Status Lines
+/////////////////////////////////
+
+struct StatusLineEntry {
+    int code;
+    std::string_view reason;
+    std::string_view line;  // "HTTP/1.1 <code> <reason>\r\n"
+};
+
+#define HTTP_STATUS_LINE(code, reason)                                         \
+    StatusLineEntry { code, reason, "HTTP/1.1 " #code " " reason "\r\n" }
+
+inline constexpr std::array<StatusLineEntry, 62> standard_status_lines{{
+    HTTP_STATUS_LINE(100, "Continue"),
+    HTTP_STATUS_LINE(101, "Switching Protocols"),
+    HTTP_STATUS_LINE(102, "Processing"),
+    HTTP_STATUS_LINE(103, "Early Hints"),
+    HTTP_STATUS_LINE(200, "OK"),
+    HTTP_STATUS_LINE(201, "Created"),
+    HTTP_STATUS_LINE(202, "Accepted"),
+    HTTP_STATUS_LINE(203, "Non-Authoritative Information"),
+    HTTP_STATUS_LINE(204, "No Content"),
+    HTTP_STATUS_LINE(205, "Reset Content"),
+    HTTP_STATUS_LINE(206, "Partial Content"),
+    HTTP_STATUS_LINE(207, "Multi-Status"),
+    HTTP_STATUS_LINE(208, "Already Reported"),
+    HTTP_STATUS_LINE(226, "IM Used"),
+    HTTP_STATUS_LINE(300, "Multiple Choices"),
+    HTTP_STATUS_LINE(301, "Moved Permanently"),
+    HTTP_STATUS_LINE(302, "Found"),
+    HTTP_STATUS_LINE(303, "See Other"),
+    HTTP_STATUS_LINE(304, "Not Modified"),
+    HTTP_STATUS_LINE(305, "Use Proxy"),
+    HTTP_STATUS_LINE(307, "Temporary Redirect"),
+    HTTP_STATUS_LINE(308, "Permanent Redirect"),
+    HTTP_STATUS_LINE(400, "Bad Request"),
+    HTTP_STATUS_LINE(401, "Unauthorized"),
+    HTTP_STATUS_LINE(402, "Payment Required"),
+    HTTP_STATUS_LINE(403, "Forbidden"),
+    HTTP_STATUS_LINE(404, "Not Found"),
+    HTTP_STATUS_LINE(405, "Method Not Allowed"),
+    HTTP_STATUS_LINE(406, "Not Acceptable"),
+    HTTP_STATUS_LINE(407, "Proxy Authentication Required"),
+    HTTP_STATUS_LINE(408, "Request Timeout"),
+    HTTP_STATUS_LINE(409, "Conflict"),
+    HTTP_STATUS_LINE(410, "Gone"),
+    HTTP_STATUS_LINE(411, "Length Required"),
+    HTTP_STATUS_LINE(412, "Precondition Failed"),
+    HTTP_STATUS_LINE(413, "Content Too Large"),
+    HTTP_STATUS_LINE(414, "URI Too Long"),
+    HTTP_STATUS_LINE(415, "Unsupported Media Type"),
+    HTTP_STATUS_LINE(416, "Range Not Satisfiable"),
+    HTTP_STATUS_LINE(417, "Expectation Failed"),
+    HTTP_STATUS_LINE(418, "I'm a teapot"),
+    HTTP_STATUS_LINE(421, "Misdirected Request"),
+    HTTP_STATUS_LINE(422, "Unprocessable Content"),
+    HTTP_STATUS_LINE(423, "Locked"),
+    HTTP_STATUS_LINE(424, "Failed Dependency"),
+    HTTP_STATUS_LINE(425, "Too Early"),
+    HTTP_STATUS_LINE(426, "Upgrade Required"),
+    HTTP_STATUS_LINE(428, "Precondition Required"),
+    HTTP_STATUS_LINE(429, "Too Many Requests"),
+    HTTP_STATUS_LINE(431, "Request Header Fields Too Large"),
+    HTTP_STATUS_LINE(451, "Unavailable For Legal Reasons"),
+    HTTP_STATUS_LINE(500, "Internal Server Error"),
+    HTTP_STATUS_LINE(501, "Not Implemented"),
+    HTTP_STATUS_LINE(502, "Bad Gateway"),
+    HTTP_STATUS_LINE(503, "Service Unavailable"),
+    HTTP_STATUS_LINE(504, "Gateway Timeout"),
+    HTTP_STATUS_LINE(505, "HTTP Version Not Supported"),
+    HTTP_STATUS_LINE(506, "Variant Also Negotiates"),
+    HTTP_STATUS_LINE(507, "Insufficient Storage"),
+    HTTP_STATUS_LINE(508, "Loop Detected"),
+    HTTP_STATUS_LINE(510, "Not Extended"),
+    HTTP_STATUS_LINE(511, "Network Authentication Required"),
+}};
+
+#undef HTTP_STATUS_LINE
+
+// Direct-indexed by status code so the lookup on the serialization path is
+// a bounds check and one load rather than a search.
+inline constexpr auto status_line_index = [] {
+    std::array<const StatusLineEntry *, 600> index{};
+    for (const StatusLineEntry &entry : standard_status_lines) {
+        index[entry.code] = &entry;
+    }
+    return index;
+}();
+
+// Returns the preserialized "HTTP/1.1 <code> <reason>\r\n" when `code` is a
+// standard status and `reason` is its standard phrase, otherwise an empty
+// view so the caller formats the line itself.
+constexpr std::string_view precomputed_status_line(int code,
+                                                   std::string_view version,
+                                                   std::string_view reason) {
+    if (code < 0 || code >= static_cast<int>(status_line_index.size()) ||
+        version != "HTTP/1.1") {
+        return {};
+    }
+    const StatusLineEntry *entry = status_line_index[code];
+    if (entry == nullptr || entry->reason != reason) {
+        return {};
+    }
+    return entry->line;
+}
+
+// Standard reason phrase for `code`, empty for unregistered codes.
+constexpr std::string_view standard_reason_phrase(int code) {
+    if (code < 0 || code >= static_cast<int>(status_line_index.size()) ||
+        status_line_index[code] == nullptr) {
+        return {};
+    }
+    return status_line_index[code]->reason;
+}
@@ -0,0 +1,727 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "json.hpp"
+
+/////////////////////////////////
+// JSON Serialization
+/////////////////////////////////
+
+// Extra bytes each character takes once escaped: '"', '\\' and the five
+// controls with a short form become two bytes, other controls \u00XX.
+static constexpr unsigned char ESCAPE_EXTRA[256] = {
+    5, 5, 5, 5, 5, 5, 5, 5, 1, 1, 1, 5, 1, 1, 5, 5,  // 0x00
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  // 0x10
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x20 '"'
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x30
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x40
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,  // 0x50 '\\'
+};
+
+size_t json_detail::string_size(std::string_view text) {
+    size_t size = text.size() + 2;
+    for (unsigned char c : text) {
+        size += ESCAPE_EXTRA[c];
+    }
+    return size;
+}
+
+char *json_detail::write_string(char *out, std::string_view text) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    *out++ = '"';
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (ESCAPE_EXTRA[c] == 0) {
+            continue;
+        }
+        // Runs of plain characters are copied in one go.
+        std::memcpy(out, text.data() + start, i - start);
+        out += i - start;
+        start = i + 1;
+
+        *out++ = '\\';
+        switch (c) {
+        case '"':
+        case '\\':
+            *out++ = static_cast<char>(c);
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        default:
+            out = write_literal(out, "u00");
+            *out++ = HEX[c >> 4];
+            *out++ = HEX[c & 0xF];
+        }
+    }
+    std::memcpy(out, text.data() + start, text.size() - start);
+    out += text.size() - start;
+    *out++ = '"';
+    return out;
+}
+
+/////////////////////////////////
+// JSON Reader
+/////////////////////////////////
+
+namespace {
+
+// One bit per byte of a 64-byte block.
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;  // { } [ ] : ,
+    uint64_t whitespace;
+};
+
+#if defined(__x86_64__)
+
+// '[' and ']' are '{' and '}' with bit 5 cleared, so OR-ing 0x20 folds
+// each pair into one compare.
+BlockMasks classify_sse2(const char *block) {
+    BlockMasks masks{};
+    for (int i = 0; i < 4; ++i) {
+        __m128i chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(block + 16 * i));
+        auto bits = [&chunk](char c) {
+            return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
+        };
+        __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                         _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(bits(':'), bits(',')));
+        __m128i whitespace =
+            _mm_or_si128(_mm_or_si128(bits(' '), bits('\t')),
+                         _mm_or_si128(bits('\n'), bits('\r')));
+        int shift = 16 * i;
+        auto mask = [](__m128i v) {
+            return static_cast<uint64_t>(
+                static_cast<uint16_t>(_mm_movemask_epi8(v)));
+        };
+        masks.quote |= mask(bits('"')) << shift;
+        masks.backslash |= mask(bits('\\')) << shift;
+        masks.op |= mask(op) << shift;
+        masks.whitespace |= mask(whitespace) << shift;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2"))) BlockMasks classify_avx2(const char *block) {
+    BlockMasks masks{};
+    for (int i = 0; i < 2; ++i) {
+        __m256i chunk = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(block + 32 * i));
+        auto bits = [&chunk](char c) __attribute__((target("avx2"))) {
+            return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
+        };
+        __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                            _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(bits(':'), bits(',')));
+        __m256i whitespace =
+            _mm256_or_si256(_mm256_or_si256(bits(' '), bits('\t')),
+                            _mm256_or_si256(bits('\n'), bits('\r')));
+        int shift = 32 * i;
+        auto mask = [](__m256i v) __attribute__((target("avx2"))) {
+            return static_cast<uint64_t>(
+                static_cast<uint32_t>(_mm256_movemask_epi8(v)));
+        };
+        masks.quote |= mask(bits('"')) << shift;
+        masks.backslash |= mask(bits('\\')) << shift;
+        masks.op |= mask(op) << shift;
+        masks.whitespace |= mask(whitespace) << shift;
+    }
+    return masks;
+}
+
+#else
+
+BlockMasks classify_scalar(const char *block) {
+    BlockMasks masks{};
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+        case '"':
+            masks.quote |= bit;
+            break;
+        case '\\':
+            masks.backslash |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            masks.op |= bit;
+            break;
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            masks.whitespace |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+    return masks;
+}
+
+#endif
+
+using Classifier = BlockMasks (*)(const char *);
+
+Classifier pick_classifier() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_avx2;
+    }
+    return classify_sse2;
+#else
+    return classify_scalar;
+#endif
+}
+
+const Classifier classify = pick_classifier();
+
+// Bit i of the result is the XOR of bits 0..i: set from an opening quote
+// up to, not including, its closing quote.
+uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Bytes escaped by a backslash. Backslashes are rare outside of escaped
+// text, so they are walked one by one rather than with carry tricks.
+// `carry` is set when the block ends in an unescaped backslash.
+uint64_t escaped_bytes(uint64_t backslash, bool &carry) {
+    uint64_t escaped = 0;
+    if (carry) {
+        escaped = 1;
+        backslash &= ~1ULL;
+    }
+    carry = false;
+    while (backslash != 0) {
+        int i = __builtin_ctzll(backslash);
+        if (i == 63) {
+            carry = true;
+            break;
+        }
+        escaped |= 1ULL << (i + 1);
+        // The escaped byte cannot escape anything itself.
+        backslash &= ~(3ULL << i);
+    }
+    return escaped;
+}
+
+[[noreturn]] void malformed(const std::string &what, size_t offset) {
+    throw std::runtime_error("Malformed JSON: " + what + " at offset " +
+                             std::to_string(offset));
+}
+
+// What may come next inside the innermost container while the structural
+// index is checked. FIRST_* also allow the closing bracket.
+enum class StructuralExpect : uint8_t {
+    VALUE,
+    FIRST_VALUE,
+    KEY,
+    FIRST_KEY,
+    COLON,
+    COMMA,
+};
+
+bool is_json_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+}  // namespace
+
+JsonDocument::JsonDocument(std::string_view json) : text(json) {
+    if (json.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("JSON document too large");
+    }
+    structurals.reserve(json.size() / 2 + 16);
+
+    bool in_string = false;
+    bool escape_carry = false;
+    // The byte before the first one counts as a separator, so a scalar at
+    // the very start is found.
+    bool after_separator = true;
+    for (size_t base = 0; base < json.size(); base += 64) {
+        const char *block = json.data() + base;
+        char padded[64];
+        if (json.size() - base < 64) {
+            std::memset(padded, ' ', sizeof(padded));
+            std::memcpy(padded, block, json.size() - base);
+            block = padded;
+        }
+        BlockMasks masks = classify(block);
+
+        uint64_t quotes =
+            masks.quote & ~escaped_bytes(masks.backslash, escape_carry);
+        uint64_t inside = prefix_xor(quotes) ^ (in_string ? ~0ULL : 0);
+        in_string = (inside >> 63) != 0;
+
+        uint64_t separators = masks.op | masks.whitespace;
+        uint64_t follows_separator =
+            (separators << 1) | (after_separator ? 1 : 0);
+        after_separator = (separators >> 63) != 0;
+
+        uint64_t scalar_starts = ~(separators | masks.quote) & ~inside &
+                                 follows_separator;
+        uint64_t bits = (masks.op & ~inside) | (quotes & inside) |
+                        scalar_starts;
+        // Padding is whitespace, so it never shows up here.
+        while (bits != 0) {
+            uint32_t offset =
+                static_cast<uint32_t>(base + __builtin_ctzll(bits));
+            structurals.push_back({offset, 0});
+            bits &= bits - 1;
+        }
+    }
+    if (in_string) {
+        malformed("unterminated string", json.size());
+    }
+    if (structurals.empty()) {
+        malformed("empty document", 0);
+    }
+
+    // Match brackets; each container learns where its value ends. The
+    // grammar is checked on the way, so lookups can step from a key to its
+    // value and from a value to the next without looking.
+    std::vector<uint32_t> open;
+    open.reserve(32);
+    StructuralExpect expect = StructuralExpect::VALUE;
+    for (uint32_t i = 0; i < structurals.size(); ++i) {
+        structurals[i].next = i + 1;
+        uint32_t offset = structurals[i].offset;
+        char c = json[offset];
+        auto unexpected = [&] {
+            if (open.empty() && expect == StructuralExpect::COMMA) {
+                malformed("trailing content", offset);
+            }
+            malformed("unexpected '" + std::string(1, c) + "'", offset);
+        };
+        switch (c) {
+        case ':':
+            if (expect != StructuralExpect::COLON) {
+                unexpected();
+            }
+            expect = StructuralExpect::VALUE;
+            break;
+        case ',':
+            if (expect != StructuralExpect::COMMA || open.empty()) {
+                unexpected();
+            }
+            expect = json[structurals[open.back()].offset] == '{'
+                         ? StructuralExpect::KEY
+                         : StructuralExpect::VALUE;
+            break;
+        case '}':
+        case ']':
+            if (open.empty() ||
+                json[structurals[open.back()].offset] != (c == '}' ? '{'
+                                                                   : '[') ||
+                (expect != StructuralExpect::COMMA &&
+                 expect != StructuralExpect::FIRST_KEY &&
+                 expect != StructuralExpect::FIRST_VALUE)) {
+                unexpected();
+            }
+            structurals[open.back()].next = i + 1;
+            open.pop_back();
+            expect = StructuralExpect::COMMA;
+            break;
+        default:
+            if (c == '"' && (expect == StructuralExpect::FIRST_KEY ||
+                             expect == StructuralExpect::KEY)) {
+                expect = StructuralExpect::COLON;
+                break;
+            }
+            if (expect != StructuralExpect::VALUE &&
+                expect != StructuralExpect::FIRST_VALUE) {
+                unexpected();
+            }
+            if (c == '{' || c == '[') {
+                open.push_back(i);
+                expect = c == '{' ? StructuralExpect::FIRST_KEY
+                                  : StructuralExpect::FIRST_VALUE;
+            } else {
+                expect = StructuralExpect::COMMA;
+            }
+        }
+    }
+    if (!open.empty()) {
+        malformed("unclosed bracket", structurals[open.back()].offset);
+    }
+    if (expect != StructuralExpect::COMMA) {
+        malformed("missing value", json.size());
+    }
+}
+
+char JsonValue::first_char() const {
+    return document->text[document->structurals[position].offset];
+}
+
+JsonValue::Type JsonValue::type() const {
+    switch (first_char()) {
+    case '{':
+        return Type::OBJECT;
+    case '[':
+        return Type::ARRAY;
+    case '"':
+        return Type::STRING;
+    case 't':
+    case 'f':
+        return Type::BOOLEAN;
+    case 'n':
+        return Type::NULL_VALUE;
+    default:
+        char c = first_char();
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return Type::NUMBER;
+        }
+        malformed("unexpected '" + std::string(1, c) + "'",
+                  document->structurals[position].offset);
+    }
+}
+
+void JsonValue::expect(Type expected) const {
+    static const char *const NAMES[] = {"an object", "an array", "a string",
+                                        "a number",  "a boolean", "null"};
+    if (type() != expected) {
+        throw std::runtime_error(
+            std::string("JSON value is not ") +
+            NAMES[static_cast<int>(expected)] + " at offset " +
+            std::to_string(document->structurals[position].offset));
+    }
+}
+
+// Index of the closing bracket of this object or array.
+uint32_t JsonValue::close_position() const {
+    return document->structurals[position].next - 1;
+}
+
+std::optional<JsonValue> JsonValue::find(std::string_view key) const {
+    expect(Type::OBJECT);
+    for (Iterator it = begin(); it != end(); ++it) {
+        std::string_view candidate = it.key();
+        if (candidate == key) {
+            return *it;
+        }
+        // Keys with escapes are rare; decode only those.
+        if (candidate.find('\\') != std::string_view::npos &&
+            JsonValue(document, it.position).get_string() == key) {
+            return *it;
+        }
+    }
+    return std::nullopt;
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+    std::optional<JsonValue> value = find(key);
+    if (!value) {
+        throw std::runtime_error("JSON field not found: " + std::string(key));
+    }
+    return *value;
+}
+
+JsonValue JsonValue::operator[](size_t index) const {
+    expect(Type::ARRAY);
+    size_t i = 0;
+    for (Iterator it = begin(); it != end(); ++it, ++i) {
+        if (i == index) {
+            return *it;
+        }
+    }
+    throw std::runtime_error("JSON array index out of range: " +
+                             std::to_string(index));
+}
+
+JsonValue JsonValue::at_path(std::string_view pointer) const {
+    JsonValue value = *this;
+    while (!pointer.empty()) {
+        if (pointer.front() != '/') {
+            throw std::runtime_error("JSON pointer must start with '/'");
+        }
+        pointer.remove_prefix(1);
+        std::string_view token = pointer.substr(0, pointer.find('/'));
+        pointer.remove_prefix(token.size());
+
+        // "~1" stands for '/' and "~0" for '~'.
+        std::string unescaped;
+        if (token.find('~') != std::string_view::npos) {
+            for (size_t i = 0; i < token.size(); ++i) {
+                if (token[i] == '~' && i + 1 < token.size()) {
+                    unescaped += token[++i] == '1' ? '/' : '~';
+                } else {
+                    unescaped += token[i];
+                }
+            }
+            token = unescaped;
+        }
+
+        if (value.type() == Type::ARRAY) {
+            size_t index = 0;
+            auto [end, error] = std::from_chars(
+                token.data(), token.data() + token.size(), index);
+            if (error != std::errc() || end != token.data() + token.size()) {
+                throw std::runtime_error("JSON pointer index is not a "
+                                         "number: " +
+                                         std::string(token));
+            }
+            value = value[index];
+        } else {
+            value = value[token];
+        }
+    }
+    return value;
+}
+
+size_t JsonValue::size() const {
+    size_t count = 0;
+    for (Iterator it = begin(); it != end(); ++it) {
+        ++count;
+    }
+    return count;
+}
+
+// Text of a number, boolean or null: up to the next separator.
+std::string_view JsonValue::scalar() const {
+    std::string_view text = document->text;
+    size_t start = document->structurals[position].offset;
+    size_t end = start;
+    while (end < text.size() && !is_json_whitespace(text[end]) &&
+           text[end] != ',' && text[end] != '}' && text[end] != ']' &&
+           text[end] != ':') {
+        ++end;
+    }
+    return text.substr(start, end - start);
+}
+
+template <typename T>
+static T parse_number(std::string_view text, size_t offset) {
+    T value{};
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error == std::errc::result_out_of_range) {
+        throw std::runtime_error("JSON number out of range at offset " +
+                                 std::to_string(offset));
+    }
+    if (error != std::errc() || end != text.data() + text.size()) {
+        malformed("number '" + std::string(text) + "'", offset);
+    }
+    return value;
+}
+
+int64_t JsonValue::get_int64() const {
+    expect(Type::NUMBER);
+    return parse_number<int64_t>(scalar(),
+                                 document->structurals[position].offset);
+}
+
+uint64_t JsonValue::get_uint64() const {
+    expect(Type::NUMBER);
+    return parse_number<uint64_t>(scalar(),
+                                  document->structurals[position].offset);
+}
+
+double JsonValue::get_double() const {
+    expect(Type::NUMBER);
+    return parse_number<double>(scalar(),
+                                document->structurals[position].offset);
+}
+
+bool JsonValue::get_bool() const {
+    expect(Type::BOOLEAN);
+    std::string_view text = scalar();
+    if (text != "true" && text != "false") {
+        malformed("literal '" + std::string(text) + "'",
+                  document->structurals[position].offset);
+    }
+    return text == "true";
+}
+
+std::string_view JsonValue::get_raw_string() const {
+    expect(Type::STRING);
+    std::string_view text = document->text;
+    size_t start = document->structurals[position].offset + 1;
+    size_t end = start;
+    // The indexer already proved the string is terminated.
+    while (true) {
+        end = text.find_first_of("\"\\", end);
+        if (text[end] == '"') {
+            return text.substr(start, end - start);
+        }
+        end += 2;
+    }
+}
+
+static void append_utf8(std::string &out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+std::string JsonValue::get_string() const {
+    std::string_view raw_text = get_raw_string();
+    size_t offset = document->structurals[position].offset;
+    std::string decoded;
+    decoded.reserve(raw_text.size());
+
+    auto hex4 = [&](size_t at) {
+        uint32_t value = 0;
+        if (at + 4 > raw_text.size() ||
+            std::from_chars(raw_text.data() + at, raw_text.data() + at + 4,
+                            value, 16)
+                    .ptr != raw_text.data() + at + 4) {
+            malformed("\\u escape", offset);
+        }
+        return value;
+    };
+
+    for (size_t i = 0; i < raw_text.size(); ++i) {
+        char c = raw_text[i];
+        if (c != '\\') {
+            decoded += c;
+            continue;
+        }
+        char escape = raw_text[++i];
+        switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+            decoded += escape;
+            break;
+        case 'b':
+            decoded += '\b';
+            break;
+        case 'f':
+            decoded += '\f';
+            break;
+        case 'n':
+            decoded += '\n';
+            break;
+        case 'r':
+            decoded += '\r';
+            break;
+        case 't':
+            decoded += '\t';
+            break;
+        case 'u': {
+            uint32_t code_point = hex4(i + 1);
+            i += 4;
+            // A high surrogate must be followed by an escaped low one.
+            if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                if (raw_text.substr(i + 1, 2) != "\\u") {
+                    malformed("lone surrogate", offset);
+                }
+                uint32_t low = hex4(i + 3);
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    malformed("lone surrogate", offset);
+                }
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                             (low - 0xDC00);
+                i += 6;
+            }
+            append_utf8(decoded, code_point);
+            break;
+        }
+        default:
+            malformed("escape '\\" + std::string(1, escape) + "'", offset);
+        }
+    }
+    return decoded;
+}
+
+std::string_view JsonValue::raw() const {
+    size_t start = document->structurals[position].offset;
+    switch (type()) {
+    case Type::OBJECT:
+    case Type::ARRAY:
+        return document->text.substr(
+            start, document->structurals[close_position()].offset + 1 - start);
+    case Type::STRING:
+        return document->text.substr(start, get_raw_string().size() + 2);
+    default:
+        return scalar();
+    }
+}
+
+// An iterator sits on the first entry of an element (arrays) or on the key
+// of a member (objects); end() is the closing bracket.
+JsonValue::Iterator JsonValue::begin() const {
+    Type container = type();
+    if (container != Type::OBJECT && container != Type::ARRAY) {
+        expect(Type::ARRAY);
+    }
+    return Iterator(document, position + 1, container == Type::OBJECT);
+}
+
+JsonValue::Iterator JsonValue::end() const {
+    return Iterator(document, close_position(), type() == Type::OBJECT);
+}
+
+JsonValue JsonValue::Iterator::operator*() const {
+    return JsonValue(document, object ? position + 2 : position);
+}
+
+std::string_view JsonValue::Iterator::key() const {
+    return JsonValue(document, position).get_raw_string();
+}
+
+JsonValue::Iterator &JsonValue::Iterator::operator++() {
+    uint32_t value = object ? position + 2 : position;
+    uint32_t after = document->structurals[value].next;
+    // Either a comma before the next element or the closing bracket.
+    char c = document->text[document->structurals[after].offset];
+    position = c == ',' ? after + 1 : after;
+    return *this;
+}
@@ -0,0 +1,415 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/////////////////////////////////
+// JSON Serialization
+/////////////////////////////////
+
+// to_json() turns a value into JSON text, with the whole shape resolved at
+// compile time:
+//   - bool, integers and floating point numbers (NaN and infinities, which
+//     JSON cannot express, become null);
+//   - anything convertible to std::string_view, as an escaped string;
+//   - std::optional, null when empty, and std::nullptr_t;
+//   - maps with string keys as objects, any other range as an array;
+//   - structs registered with JSON_FIELDS as objects.
+// They nest freely. Anything else fails to compile.
+//
+//     struct Item {
+//         int id;
+//         std::string name;
+//         std::vector<std::string> tags;
+//     };
+//     JSON_FIELDS(Item, id, name, tags)
+//
+//     to_json(Item{7, "widget", {"a"}});
+//     // {"id":7,"name":"widget","tags":["a"]}
+//
+// The output is written in two passes over the value. The first adds up
+// its size: exact for strings, the widest a number can print for numbers.
+// The second writes into a string of that size with std::to_chars, which is
+// trimmed at the end, so a body is allocated exactly once and never grows.
+
+// Filled in by JSON_FIELDS; `visit` calls `visitor(key, member)` for every
+// listed member in order, with the key already quoted and followed by ':'.
+template <typename T> struct JsonFields {
+    static constexpr bool registered = false;
+};
+
+// Registers the listed members of `Type` (at most 16) for to_json(). Use it
+// at global scope, after the struct is defined.
+#define JSON_FIELDS(Type, ...)                                               \
+    template <> struct JsonFields<Type> {                                    \
+        static constexpr bool registered = true;                             \
+        template <typename Visitor>                                          \
+        static void visit(const Type &value, Visitor &&visitor) {            \
+            JSON_DETAIL_FOR_EACH(JSON_DETAIL_VISIT, __VA_ARGS__)             \
+        }                                                                    \
+    };
+
+#define JSON_DETAIL_VISIT(field) visitor("\"" #field "\":", value.field);
+
+#define JSON_DETAIL_EACH_1(m, a) m(a)
+#define JSON_DETAIL_EACH_2(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_1(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_3(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_2(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_4(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_3(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_5(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_4(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_6(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_5(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_7(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_6(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_8(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_7(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_9(m, a, ...)   \
+    m(a) JSON_DETAIL_EACH_8(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_10(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_9(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_11(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_10(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_12(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_11(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_13(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_12(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_14(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_13(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_15(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_14(m, __VA_ARGS__)
+#define JSON_DETAIL_EACH_16(m, a, ...)  \
+    m(a) JSON_DETAIL_EACH_15(m, __VA_ARGS__)
+#define JSON_DETAIL_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12,  \
+                         _13, _14, _15, _16, NAME, ...)                      \
+    NAME
+#define JSON_DETAIL_FOR_EACH(m, ...)                                         \
+    JSON_DETAIL_PICK(__VA_ARGS__, JSON_DETAIL_EACH_16, JSON_DETAIL_EACH_15,  \
+                     JSON_DETAIL_EACH_14, JSON_DETAIL_EACH_13,               \
+                     JSON_DETAIL_EACH_12, JSON_DETAIL_EACH_11,               \
+                     JSON_DETAIL_EACH_10, JSON_DETAIL_EACH_9,                \
+                     JSON_DETAIL_EACH_8, JSON_DETAIL_EACH_7,                 \
+                     JSON_DETAIL_EACH_6, JSON_DETAIL_EACH_5,                 \
+                     JSON_DETAIL_EACH_4, JSON_DETAIL_EACH_3,                 \
+                     JSON_DETAIL_EACH_2, JSON_DETAIL_EACH_1)                 \
+    (m, __VA_ARGS__)
+
+namespace json_detail {
+
+// Quoted and escaped: '"', '\\' and control characters. Other bytes,
+// UTF-8 included, are copied as they are.
+size_t string_size(std::string_view text);
+char *write_string(char *out, std::string_view text);
+
+template <typename T> struct is_optional : std::false_type {};
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_string_like = std::is_convertible_v<const T &,
+                                                      std::string_view>;
+
+template <typename T>
+constexpr bool is_range = requires(const T &value) {
+    std::begin(value);
+    std::end(value);
+};
+
+template <typename T>
+constexpr bool is_string_keyed_map = requires {
+    typename T::mapped_type;
+    requires is_string_like<typename T::key_type>;
+};
+
+template <typename T> constexpr bool unsupported = false;
+
+// Widest output of std::to_chars() in shortest form: sign, 17 digits, the
+// point and an exponent such as "e-308".
+constexpr size_t MAX_FLOAT_SIZE = 24;
+
+template <typename T> size_t max_size(const T &value) {
+    if constexpr (is_optional<T>::value) {
+        return value ? max_size(*value) : 4;
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        return 4;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return 5;
+    } else if constexpr (is_string_like<T>) {
+        return string_size(value);
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::numeric_limits<T>::digits10 + 2;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return MAX_FLOAT_SIZE;
+    } else if constexpr (JsonFields<T>::registered) {
+        size_t size = 2;
+        JsonFields<T>::visit(value, [&size](std::string_view key,
+                                            const auto &member) {
+            size += key.size() + 1 + max_size(member);
+        });
+        return size;
+    } else if constexpr (is_string_keyed_map<T>) {
+        size_t size = 2;
+        for (const auto &[key, member] : value) {
+            size += string_size(key) + 2 + max_size(member);
+        }
+        return size;
+    } else if constexpr (is_range<T>) {
+        size_t size = 2;
+        for (const auto &element : value) {
+            size += max_size(element) + 1;
+        }
+        return size;
+    } else {
+        static_assert(unsupported<T>, "Type cannot be serialized to JSON; "
+                                      "register structs with JSON_FIELDS");
+    }
+}
+
+inline char *write_literal(char *out, std::string_view text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+template <typename T> char *write(char *out, const T &value) {
+    if constexpr (is_optional<T>::value) {
+        return value ? write(out, *value) : write_literal(out, "null");
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        return write_literal(out, "null");
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return write_literal(out, value ? "true" : "false");
+    } else if constexpr (is_string_like<T>) {
+        return write_string(out, value);
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::to_chars(out, out + max_size(value), value).ptr;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        if (!std::isfinite(value)) {
+            return write_literal(out, "null");
+        }
+        return std::to_chars(out, out + MAX_FLOAT_SIZE, value).ptr;
+    } else if constexpr (JsonFields<T>::registered) {
+        *out++ = '{';
+        bool first = true;
+        JsonFields<T>::visit(value, [&out, &first](std::string_view key,
+                                                   const auto &member) {
+            if (!first) {
+                *out++ = ',';
+            }
+            first = false;
+            out = write(write_literal(out, key), member);
+        });
+        *out++ = '}';
+        return out;
+    } else if constexpr (is_string_keyed_map<T>) {
+        *out++ = '{';
+        bool first = true;
+        for (const auto &[key, member] : value) {
+            if (!first) {
+                *out++ = ',';
+            }
+            first = false;
+            out = write_string(out, key);
+            *out++ = ':';
+            out = write(out, member);
+        }
+        *out++ = '}';
+        return out;
+    } else {
+        *out++ = '[';
+        bool first = true;
+        for (const auto &element : value) {
+            if (!first) {
+                *out++ = ',';
+            }
+            first = false;
+            out = write(out, element);
+        }
+        *out++ = ']';
+        return out;
+    }
+}
+
+}  // namespace json_detail
+
+template <typename T> std::string to_json(const T &value) {
+    std::string json;
+    json.resize(json_detail::max_size(value));
+    char *end = json_detail::write(json.data(), value);
+    json.resize(static_cast<size_t>(end - json.data()));
+    return json;
+}
+
+/////////////////////////////////
+// JSON Reader
+/////////////////////////////////
+
+class JsonDocument;
+
+// A position in a JsonDocument: a handle of two words that reads its value
+// only when asked. Lookups walk the document's structural index, jumping
+// over nested objects and arrays in one step, so nothing is parsed or
+// allocated for the fields a handler never touches. Access with the wrong
+// type, a missing key or an out-of-range index throws std::runtime_error.
+class JsonValue {
+  public:
+    enum class Type { OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+    Type type() const;
+    bool is_null() const { return type() == Type::NULL_VALUE; }
+
+    // Object member and array element.
+    JsonValue operator[](std::string_view key) const;
+    JsonValue operator[](size_t index) const;
+    std::optional<JsonValue> find(std::string_view key) const;
+
+    // JSON Pointer (RFC 6901) relative to this value: "/items/0/price".
+    JsonValue at_path(std::string_view pointer) const;
+
+    // Members of an object or elements of an array; walks them.
+    size_t size() const;
+
+    int64_t get_int64() const;
+    uint64_t get_uint64() const;
+    double get_double() const;
+    bool get_bool() const;
+
+    // The string's bytes between the quotes, escapes left as they are.
+    // Points into the document: no copy, no allocation.
+    std::string_view get_raw_string() const;
+
+    // Decoded string, \uXXXX escapes included (as UTF-8).
+    std::string get_string() const;
+
+    // One of the getters above, chosen by type: get<int>(),
+    // get<std::string_view>(), get<std::optional<double>>() (empty for
+    // null).
+    template <typename T> T get() const;
+
+    // The value's text as it appears in the document.
+    std::string_view raw() const;
+
+    // Iterates array elements, or object members with key() alongside.
+    class Iterator {
+      public:
+        JsonValue operator*() const;
+        Iterator &operator++();
+        bool operator!=(const Iterator &other) const {
+            return position != other.position;
+        }
+        // The current member's key, as get_raw_string() would return it.
+        std::string_view key() const;
+
+      private:
+        friend class JsonValue;
+        Iterator(const JsonDocument *document, uint32_t position,
+                 bool object)
+            : document(document), position(position), object(object) {}
+        const JsonDocument *document;
+        uint32_t position;
+        bool object;
+    };
+    Iterator begin() const;
+    Iterator end() const;
+
+  private:
+    friend class JsonDocument;
+    JsonValue(const JsonDocument *document, uint32_t position)
+        : document(document), position(position) {}
+
+    char first_char() const;
+    void expect(Type expected) const;
+    std::string_view scalar() const;
+    uint32_t close_position() const;
+
+    const JsonDocument *document;
+    uint32_t position;
+};
+
+// Structural index over JSON text, built in one pass of 64-byte blocks with
+// SIMD compares (AVX2 when the CPU has it, SSE2 otherwise). Each block
+// yields bitmasks of quotes, backslashes, brackets/colons/commas and
+// whitespace; escaped quotes are dropped and a prefix XOR over the rest
+// marks which bytes are inside strings. What remains are the positions of
+// every bracket, colon and comma outside strings and the start of every
+// string and scalar. A second pass over those positions matches brackets,
+// so skipping a nested value is a single jump.
+//
+// The constructor checks only that strings are terminated and brackets
+// balance; numbers and escapes are validated by the getters that read
+// them. The text must outlive the document, as HttpRequest::body does for
+// HttpRequest::json(). Throws std::runtime_error on malformed input.
+class JsonDocument {
+  public:
+    explicit JsonDocument(std::string_view json);
+
+    JsonValue root() const { return JsonValue(this, 0); }
+    JsonValue operator[](std::string_view key) const { return root()[key]; }
+    JsonValue at_path(std::string_view pointer) const {
+        return root().at_path(pointer);
+    }
+
+    size_t structural_count() const { return structurals.size(); }
+
+  private:
+    friend class JsonValue;
+
+    // `next` is the index of the entry after this value: the next one for
+    // scalars and strings, the one after the matching bracket otherwise.
+    struct Structural {
+        uint32_t offset;
+        uint32_t next;
+    };
+
+    std::string_view text;
+    std::vector<Structural> structurals;
+};
+
+template <typename T> T JsonValue::get() const {
+    if constexpr (json_detail::is_optional<T>::value) {
+        if (is_null()) {
+            return T();
+        }
+        return get<typename T::value_type>();
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return get_bool();
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        return get_raw_string();
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return get_string();
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(get_double());
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        int64_t value = get_int64();
+        if (value < std::numeric_limits<T>::min() ||
+            value > std::numeric_limits<T>::max()) {
+            throw std::runtime_error("JSON number out of range");
+        }
+        return static_cast<T>(value);
+    } else if constexpr (std::is_integral_v<T>) {
+        uint64_t value = get_uint64();
+        if (value > std::numeric_limits<T>::max()) {
+            throw std::runtime_error("JSON number out of range");
+        }
+        return static_cast<T>(value);
+    } else {
+        static_assert(json_detail::unsupported<T>,
+                      "JsonValue::get() supports numbers, bool, strings and "
+                      "std::optional of those");
+    }
+}
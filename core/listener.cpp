@@ -0,0 +1,124 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "listener.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <unistd.h>
+
+/////////////////////////////////
+// TCP Listener
+/////////////////////////////////
+
+namespace {
+
+void set_option(int fd, int level, int name, int value, const char *what) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("Failed to set ") + what +
+                                 ": " + std::strerror(error));
+    }
+}
+
+}  // namespace
+
+int open_tcp_listener(uint16_t port, const ListenerOptions &options) {
+    int listen_fd =
+        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        throw std::runtime_error(std::string("Failed to create socket: ") +
+                                 std::strerror(errno));
+    }
+    // A restarted server can bind while old connections sit in TIME_WAIT.
+    set_option(listen_fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+    if (options.reuse_port) {
+        set_option(listen_fd, SOL_SOCKET, SO_REUSEPORT, 1, "SO_REUSEPORT");
+    }
+    if (options.incoming_cpu >= 0) {
+        set_option(listen_fd, SOL_SOCKET, SO_INCOMING_CPU,
+                   options.incoming_cpu, "SO_INCOMING_CPU");
+    }
+    if (options.defer_accept_seconds > 0) {
+        set_option(listen_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                   options.defer_accept_seconds, "TCP_DEFER_ACCEPT");
+    }
+    if (options.fastopen_queue > 0) {
+        set_option(listen_fd, IPPROTO_TCP, TCP_FASTOPEN,
+                   options.fastopen_queue, "TCP_FASTOPEN");
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr),
+             sizeof(addr)) < 0 ||
+        listen(listen_fd, options.backlog) < 0) {
+        int error = errno;
+        close(listen_fd);
+        throw std::runtime_error("Failed to listen on port " +
+                                 std::to_string(port) + ": " +
+                                 std::strerror(error));
+    }
+    return listen_fd;
+}
+
+uint16_t local_port(int socket_fd) {
+    struct sockaddr_storage addr = {};
+    socklen_t length = sizeof(addr);
+    if (getsockname(socket_fd, reinterpret_cast<struct sockaddr *>(&addr),
+                    &length) < 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6 &>(addr).sin6_port);
+    }
+    return ntohs(reinterpret_cast<sockaddr_in &>(addr).sin_port);
+}
+
+AcceptResult accept_batch(
+    int listen_fd, size_t max,
+    const std::function<void(int fd, const sockaddr_storage &peer)>
+        &on_accept) {
+    AcceptResult result;
+    while (result.accepted < max) {
+        struct sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        int fd = accept4(listen_fd, reinterpret_cast<struct sockaddr *>(&peer),
+                         &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // The client gave up between the handshake and accept().
+            if (errno == ECONNABORTED || errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                result.error = errno;
+            }
+            break;
+        }
+        ++result.accepted;
+        on_accept(fd, peer);
+    }
+    return result;
+}
+
+std::string peer_address(const sockaddr_storage &peer) {
+    char text[INET6_ADDRSTRLEN] = {};
+    if (peer.ss_family == AF_INET) {
+        inet_ntop(AF_INET,
+                  &reinterpret_cast<const sockaddr_in &>(peer).sin_addr, text,
+                  sizeof(text));
+    } else if (peer.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6,
+                  &reinterpret_cast<const sockaddr_in6 &>(peer).sin6_addr, text,
+                  sizeof(text));
+    }
+    return text;
+}
@@ -0,0 +1,60 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/socket.h>
+
+/////////////////////////////////
+// TCP Listener
+/////////////////////////////////
+
+struct ListenerOptions {
+    // Connections the kernel completes and queues while we are not
+    // accepting.
+    int backlog = SOMAXCONN;
+    // Wake the acceptor only once a connection has sent data, or after this
+    // many seconds (TCP_DEFER_ACCEPT); 0 wakes it on the handshake. Clients
+    // that connect and never speak then cost no accept() or fd.
+    int defer_accept_seconds = 0;
+    // Pending TCP Fast Open requests: a returning client's first request
+    // rides on its SYN and saves a round trip. 0 leaves it off.
+    int fastopen_queue = 0;
+    // SO_REUSEPORT, so several server processes can share the port, and the
+    // CPU whose connections this listener should be handed
+    // (SO_INCOMING_CPU), so each process can stay on the CPU that received
+    // its packets. -1 leaves the choice to the kernel's hash.
+    bool reuse_port = false;
+    int incoming_cpu = -1;
+};
+
+// Non-blocking listening socket on all interfaces; port 0 picks a free
+// one. Throws std::runtime_error if it cannot be bound or an option is
+// refused.
+int open_tcp_listener(uint16_t port, const ListenerOptions &options = {});
+
+// The port a socket is bound to.
+uint16_t local_port(int socket_fd);
+
+struct AcceptResult {
+    size_t accepted = 0;
+    // What ended the batch early, such as EMFILE; 0 when the backlog was
+    // emptied or `max` was reached.
+    int error = 0;
+};
+
+// Accepts until the backlog is empty or `max` connections were taken,
+// with accept4() so every fd starts non-blocking and close-on-exec. Each
+// goes to `on_accept` with the peer address.
+AcceptResult accept_batch(
+    int listen_fd, size_t max,
+    const std::function<void(int fd, const sockaddr_storage &peer)>
+        &on_accept);
+
+// "203.0.113.7" or "2001:db8::1"; empty for other families.
+std::string peer_address(const sockaddr_storage &peer);
@@ -0,0 +1,118 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "loopback.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+
+/////////////////////////////////
+// Loopback Transport
+/////////////////////////////////
+
+ByteRing::ByteRing(size_t capacity)
+    : storage(std::bit_ceil(std::max<size_t>(capacity, 1))),
+      mask(storage.size() - 1) {}
+
+size_t ByteRing::write(const char *data, size_t size) {
+    size = std::min(size, space());
+    size_t offset = static_cast<size_t>(tail) & mask;
+    size_t first = std::min(size, capacity() - offset);
+    std::memcpy(storage.data() + offset, data, first);
+    std::memcpy(storage.data(), data + first, size - first);
+    tail += size;
+    return size;
+}
+
+size_t ByteRing::read(char *data, size_t size) {
+    size = std::min(size, this->size());
+    size_t offset = static_cast<size_t>(head) & mask;
+    size_t first = std::min(size, capacity() - offset);
+    std::memcpy(data, storage.data() + offset, first);
+    std::memcpy(data + first, storage.data(), size - first);
+    head += size;
+    return size;
+}
+
+std::pair<LoopbackStream, LoopbackStream>
+LoopbackStream::pair(size_t capacity) {
+    auto forward = std::make_shared<Channel>(capacity);
+    auto backward = std::make_shared<Channel>(capacity);
+    return {LoopbackStream(backward, forward),
+            LoopbackStream(forward, backward)};
+}
+
+ssize_t LoopbackStream::read(char *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size_t count = inbound->ring.read(data, size);
+    if (count > 0 || inbound->closed) {
+        return static_cast<ssize_t>(count);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+ssize_t LoopbackStream::write(const char *data, size_t size) {
+    if (outbound->closed) {
+        errno = EPIPE;
+        return -1;
+    }
+    size_t count = outbound->ring.write(data, size);
+    if (count > 0 || size == 0) {
+        return static_cast<ssize_t>(count);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+void LoopbackStream::close() { outbound->closed = true; }
+
+bool serve(ServerConnection &connection, LoopbackStream &stream) {
+    auto write = [&stream](const char *data, size_t size) {
+        return stream.write(data, size);
+    };
+    bool peer_closed = false;
+    while (true) {
+        bool progress = false;
+        // Like a server that only reads once poll() reports input, an idle
+        // connection holds no input buffer.
+        while (!connection.closing() &&
+               !connection.output().above_high_watermark()) {
+            if (stream.readable() == 0) {
+                peer_closed = stream.at_end();
+                break;
+            }
+            size_t room = connection.input_room();
+            if (room == 0) {
+                break;
+            }
+            ssize_t count = stream.read(connection.input_tail(), room);
+            if (count <= 0) {
+                break;
+            }
+            connection.received(static_cast<size_t>(count));
+            progress = true;
+        }
+
+        size_t pending = connection.output().pending_bytes();
+        OutputQueue::FlushResult result = connection.output().flush(write);
+        if (result == OutputQueue::FlushResult::ERROR) {
+            peer_closed = true;
+        }
+        progress |= connection.output().pending_bytes() < pending;
+
+        if (peer_closed ||
+            (connection.closing() && connection.output().empty())) {
+            stream.close();
+            return false;
+        }
+        if (!progress) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+#include "connection.hpp"
+
+/////////////////////////////////
+// Loopback Transport
+/////////////////////////////////
+
+// Fixed-capacity byte FIFO. The capacity is rounded up to a power of two,
+// so positions wrap with a mask, and every read or write is at most two
+// memcpy()s. Used from one thread.
+class ByteRing {
+  public:
+    explicit ByteRing(size_t capacity);
+
+    // Copy as much as fits, or as much as is there; return the bytes moved.
+    size_t write(const char *data, size_t size);
+    size_t read(char *data, size_t size);
+
+    size_t size() const { return static_cast<size_t>(tail - head); }
+    size_t capacity() const { return storage.size(); }
+    size_t space() const { return capacity() - size(); }
+
+  private:
+    std::vector<char> storage;
+    size_t mask;
+    // Running totals; the difference is what is buffered.
+    uint64_t head = 0;
+    uint64_t tail = 0;
+};
+
+// One end of an in-memory stream: what one end writes the other reads,
+// like a socketpair() without the kernel. read() and write() return like
+// recv() and send() on a non-blocking socket: -1 with errno EAGAIN when
+// the ring is empty or full, and 0 from read() once the other end has
+// closed and everything was read. close() only ends this end's writing,
+// like shutdown(SHUT_WR): write() after it fails with EPIPE, while the
+// other end may still write and this end read. Both ends must be used from
+// the same thread.
+class LoopbackStream {
+  public:
+    static std::pair<LoopbackStream, LoopbackStream>
+    pair(size_t capacity = 64 * 1024);
+
+    ssize_t read(char *data, size_t size);
+    ssize_t write(const char *data, size_t size);
+
+    // Stops writing; the other end reads the rest and then end of stream,
+    // but can still write to this end.
+    void close();
+
+    size_t readable() const { return inbound->ring.size(); }
+    // The other end has closed and everything it wrote was read.
+    bool at_end() const { return inbound->closed && readable() == 0; }
+
+  private:
+    struct Channel {
+        explicit Channel(size_t capacity) : ring(capacity) {}
+        ByteRing ring;
+        bool closed = false;
+    };
+
+    LoopbackStream(std::shared_ptr<Channel> inbound,
+                   std::shared_ptr<Channel> outbound)
+        : inbound(std::move(inbound)), outbound(std::move(outbound)) {}
+
+    std::shared_ptr<Channel> inbound;
+    std::shared_ptr<Channel> outbound;
+};
+
+// Moves bytes between `stream` and `connection` until neither can make
+// progress, as one event loop iteration would for a readable and writable
+// socket: input is read while the output stays below its high watermark,
+// and the output is written until the ring is full. Returns false once
+// the connection is done: it is closing() and all its output was written,
+// or the other end closed. The stream is closed then.
+bool serve(ServerConnection &connection, LoopbackStream &stream);
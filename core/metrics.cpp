@@ -0,0 +1,264 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "histogram.hpp"
+#include "metrics.hpp"
+
+static const size_t histogram_buckets =
+    HdrHistogram::bucket_count(MetricsRegistry::HISTOGRAM_SIGNIFICANT_BITS,
+                               MetricsRegistry::HISTOGRAM_MAX_VALUE_BITS);
+
+MetricsRegistry &MetricsRegistry::instance() {
+    // Never destroyed: threads may still record while static destructors
+    // run at exit.
+    static MetricsRegistry *registry = new MetricsRegistry();
+    return *registry;
+}
+
+/////////////////////////////////
+// Recording
+/////////////////////////////////
+
+// Hands the slab back to the registry when its thread exits, so the counts
+// survive the thread.
+struct MetricsRegistry::SlabOwner {
+    ThreadSlab *slab = nullptr;
+    ~SlabOwner() {
+        if (slab) {
+            MetricsRegistry::instance().retire(slab);
+        }
+    }
+};
+
+MetricsRegistry::ThreadSlab &MetricsRegistry::thread_slab() {
+    static thread_local SlabOwner owner;
+    if (!owner.slab) {
+        owner.slab = new ThreadSlab();
+        MetricsRegistry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.slabs.push_back(owner.slab);
+    }
+    return *owner.slab;
+}
+
+// Single writer per slab: a plain load and store is enough, the atomics only
+// make the concurrent read from a scrape well defined.
+void MetricsRegistry::bump(size_t slot, uint64_t value) {
+    std::atomic<uint64_t> &cell = thread_slab().values[slot];
+    cell.store(cell.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+}
+
+void MetricsRegistry::Counter::add(uint64_t value) const {
+    bump(slot, value);
+}
+
+void MetricsRegistry::Gauge::add(int64_t value) const {
+    // Two's complement: the per-thread values wrap, their sum does not.
+    bump(slot, static_cast<uint64_t>(value));
+}
+
+// Values past the last bucket are only counted in the sum and count, so
+// they show up under le="+Inf" and not as the largest finite bound.
+void MetricsRegistry::Histogram::record_microseconds(uint64_t value) const {
+    size_t bucket =
+        HdrHistogram::bucket_index(value, HISTOGRAM_SIGNIFICANT_BITS);
+    if (bucket < histogram_buckets) {
+        bump(slot + bucket, 1);
+    }
+    bump(slot + histogram_buckets, value);
+    bump(slot + histogram_buckets + 1, 1);
+}
+
+void MetricsRegistry::retire(ThreadSlab *slab) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < next_slot; ++i) {
+        retired[i] += slab->values[i].load(std::memory_order_relaxed);
+    }
+    slabs.erase(std::remove(slabs.begin(), slabs.end(), slab), slabs.end());
+    delete slab;
+}
+
+/////////////////////////////////
+// Registration
+/////////////////////////////////
+
+static std::string escape_label_value(const std::string &value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string render_labels(const MetricsRegistry::Labels &labels) {
+    std::string rendered;
+    for (const auto &[name, value] : labels) {
+        if (!rendered.empty()) {
+            rendered += ',';
+        }
+        rendered += name + "=\"" + escape_label_value(value) + "\"";
+    }
+    return rendered;
+}
+
+size_t MetricsRegistry::register_series(const std::string &name,
+                                        const std::string &help, Type type,
+                                        const Labels &labels, size_t slots) {
+    std::string rendered = render_labels(labels);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [family, created] = families.try_emplace(name, Family{type, help, {}});
+    if (!created && family->second.type != type) {
+        throw std::runtime_error("Metric registered with another type: " +
+                                 name);
+    }
+    for (const Series &series : family->second.series) {
+        if (series.labels == rendered) {
+            return series.slot;
+        }
+    }
+
+    if (next_slot + slots > MAX_SLOTS) {
+        throw std::runtime_error("Out of metric slots registering " + name);
+    }
+    size_t slot = next_slot;
+    next_slot += slots;
+    family->second.series.push_back({rendered, slot, nullptr});
+    return slot;
+}
+
+MetricsRegistry::Counter MetricsRegistry::counter(const std::string &name,
+                                                  const std::string &help,
+                                                  const Labels &labels) {
+    return Counter(register_series(name, help, Type::COUNTER, labels, 1));
+}
+
+MetricsRegistry::Gauge MetricsRegistry::gauge(const std::string &name,
+                                              const std::string &help,
+                                              const Labels &labels) {
+    return Gauge(register_series(name, help, Type::GAUGE, labels, 1));
+}
+
+MetricsRegistry::Histogram
+MetricsRegistry::histogram(const std::string &name, const std::string &help,
+                           const Labels &labels) {
+    return Histogram(register_series(name, help, Type::HISTOGRAM, labels,
+                                     histogram_buckets + 2));
+}
+
+void MetricsRegistry::gauge_callback(const std::string &name,
+                                     const std::string &help,
+                                     const Labels &labels,
+                                     std::function<double()> read) {
+    std::string rendered = render_labels(labels);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [family, created] =
+        families.try_emplace(name, Family{Type::GAUGE, help, {}});
+    if (!created && family->second.type != Type::GAUGE) {
+        throw std::runtime_error("Metric registered with another type: " +
+                                 name);
+    }
+    for (Series &series : family->second.series) {
+        if (series.labels == rendered) {
+            series.read = std::move(read);
+            return;
+        }
+    }
+    family->second.series.push_back({rendered, 0, std::move(read)});
+}
+
+/////////////////////////////////
+// Exposition
+/////////////////////////////////
+
+uint64_t MetricsRegistry::total(size_t slot) const {
+    uint64_t sum = retired[slot];
+    for (const ThreadSlab *slab : slabs) {
+        sum += slab->values[slot].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+static std::string format_number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    return buffer;
+}
+
+static std::string series_name(const std::string &name,
+                               const std::string &labels,
+                               const std::string &extra = "") {
+    std::string all = labels;
+    if (!extra.empty()) {
+        all += all.empty() ? extra : "," + extra;
+    }
+    return all.empty() ? name : name + "{" + all + "}";
+}
+
+std::string MetricsRegistry::render() const {
+    std::string out;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const auto &[name, family] : families) {
+        static const char *type_names[] = {"counter", "gauge", "histogram"};
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " +
+               type_names[static_cast<int>(family.type)] + "\n";
+
+        for (const Series &series : family.series) {
+            if (series.read) {
+                out += series_name(name, series.labels) + " " +
+                       format_number(series.read()) + "\n";
+                continue;
+            }
+
+            if (family.type == Type::COUNTER) {
+                out += series_name(name, series.labels) + " " +
+                       std::to_string(total(series.slot)) + "\n";
+            } else if (family.type == Type::GAUGE) {
+                out += series_name(name, series.labels) + " " +
+                       std::to_string(
+                           static_cast<int64_t>(total(series.slot))) +
+                       "\n";
+            } else {
+                // Cumulative buckets, bounds in seconds. Every bucket is
+                // emitted so the bucket set is the same on every scrape.
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < histogram_buckets; ++i) {
+                    cumulative += total(series.slot + i);
+                    uint64_t upper = HdrHistogram::bucket_upper_bound(
+                        i, HISTOGRAM_SIGNIFICANT_BITS);
+                    out += series_name(
+                               name + "_bucket", series.labels,
+                               "le=\"" + format_number(upper / 1e6) + "\"") +
+                           " " + std::to_string(cumulative) + "\n";
+                }
+                uint64_t count = total(series.slot + histogram_buckets + 1);
+                out += series_name(name + "_bucket", series.labels,
+                                   "le=\"+Inf\"") +
+                       " " + std::to_string(count) + "\n";
+                out += series_name(name + "_sum", series.labels) + " " +
+                       format_number(
+                           total(series.slot + histogram_buckets) / 1e6) +
+                       "\n";
+                out += series_name(name + "_count", series.labels) + " " +
+                       std::to_string(count) + "\n";
+            }
+        }
+    }
+    return out;
+}
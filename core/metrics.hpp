@@ -0,0 +1,137 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/////////////////////////////////
+// Metrics Registry
+/////////////////////////////////
+
+// Process-wide counters, gauges and latency histograms, rendered in the
+// Prometheus text exposition format on scrape.
+//
+// Every thread that records gets its own slab of slots, and only that
+// thread ever writes to it, so recording is a relaxed load and store on a
+// cache line no other thread touches: no lock, no atomic read-modify-write,
+// no contention. A scrape sums each series over all live slabs plus the
+// totals left behind by threads that have exited.
+//
+// Registration (creating a series) takes a mutex and is meant to happen
+// once per series; callers keep the returned handle. Handles are small
+// value types and stay valid for the life of the process.
+class MetricsRegistry {
+  public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    // Slots per thread slab; a counter or gauge uses one, a histogram uses
+    // one per bucket plus two for sum and count.
+    static constexpr size_t MAX_SLOTS = 8192;
+
+    // Histograms are log-linear with two sub-buckets per power of two
+    // (at most 50% apart) over microseconds, up to about 9 minutes; longer
+    // durations fall only into the +Inf bucket.
+    static constexpr unsigned HISTOGRAM_SIGNIFICANT_BITS = 2;
+    static constexpr unsigned HISTOGRAM_MAX_VALUE_BITS = 29;
+
+    class Counter {
+      public:
+        Counter() = default;
+        void add(uint64_t value = 1) const;
+
+      private:
+        friend class MetricsRegistry;
+        explicit Counter(size_t slot) : slot(slot) {}
+        size_t slot = 0;
+    };
+
+    // Up/down value summed across threads, e.g. open connections: the
+    // thread that opens one adds, whichever thread closes it subtracts.
+    class Gauge {
+      public:
+        Gauge() = default;
+        void add(int64_t value = 1) const;
+        void sub(int64_t value = 1) const { add(-value); }
+
+      private:
+        friend class MetricsRegistry;
+        explicit Gauge(size_t slot) : slot(slot) {}
+        size_t slot = 0;
+    };
+
+    class Histogram {
+      public:
+        Histogram() = default;
+        void record_microseconds(uint64_t value) const;
+
+      private:
+        friend class MetricsRegistry;
+        explicit Histogram(size_t slot) : slot(slot) {}
+        size_t slot = 0;
+    };
+
+    static MetricsRegistry &instance();
+
+    Counter counter(const std::string &name, const std::string &help,
+                    const Labels &labels = {});
+    Gauge gauge(const std::string &name, const std::string &help,
+                const Labels &labels = {});
+    Histogram histogram(const std::string &name, const std::string &help,
+                        const Labels &labels = {});
+
+    // Gauge computed at scrape time, for state that already lives somewhere
+    // (queue depths, pool sizes). The callback runs on the scraping thread.
+    void gauge_callback(const std::string &name, const std::string &help,
+                        const Labels &labels, std::function<double()> read);
+
+    // Prometheus text format, version 0.0.4.
+    std::string render() const;
+
+  private:
+    MetricsRegistry() = default;
+
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Series {
+        std::string labels;  // rendered, without braces
+        size_t slot = 0;
+        std::function<double()> read;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<Series> series;
+    };
+
+    struct ThreadSlab {
+        std::array<std::atomic<uint64_t>, MAX_SLOTS> values{};
+    };
+    struct SlabOwner;
+    friend struct SlabOwner;
+
+    static ThreadSlab &thread_slab();
+    static void bump(size_t slot, uint64_t value);
+
+    size_t register_series(const std::string &name, const std::string &help,
+                           Type type, const Labels &labels, size_t slots);
+    uint64_t total(size_t slot) const;
+    void retire(ThreadSlab *slab);
+
+    mutable std::mutex mutex;
+    std::map<std::string, Family> families;
+    std::vector<ThreadSlab *> slabs;
+    std::array<uint64_t, MAX_SLOTS> retired{};
+    size_t next_slot = 0;
+};
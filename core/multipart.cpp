@@ -0,0 +1,340 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "multipart.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/////////////////////////////////
+// Boundary Search
+/////////////////////////////////
+
+BoundarySearch::BoundarySearch(std::string pattern)
+    : needle(std::move(pattern)) {
+    shift.fill(needle.size());
+    for (size_t i = 0; i + 1 < needle.size(); ++i) {
+        shift[static_cast<unsigned char>(needle[i])] = needle.size() - 1 - i;
+    }
+}
+
+#if defined(__x86_64__)
+
+// Compares the pattern's first and last bytes against 32 window positions
+// at once; only positions where both match are checked in full. Returns
+// where it stopped when fewer than 32 positions are left.
+__attribute__((target("avx2"))) static size_t
+find_avx2(const char *data, size_t size, size_t from,
+          const std::string &needle, size_t &found) {
+    size_t length = needle.size();
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[length - 1]);
+    size_t position = from;
+    for (; position + length - 1 + 32 <= size; position += 32) {
+        __m256i head = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + position));
+        __m256i tail = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + position + length - 1));
+        uint32_t candidates = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi8(head, first),
+                _mm256_cmpeq_epi8(tail, last))));
+        while (candidates != 0) {
+            size_t offset = position + __builtin_ctz(candidates);
+            if (std::memcmp(data + offset + 1, needle.data() + 1,
+                            length - 2) == 0) {
+                found = offset;
+                return position;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return position;
+}
+
+static const bool has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+#endif
+
+size_t BoundarySearch::find(std::string_view haystack, size_t from) const {
+    size_t length = needle.size();
+    if (length == 0) {
+        return from <= haystack.size() ? from : std::string_view::npos;
+    }
+    const char *data = haystack.data();
+#if defined(__x86_64__)
+    if (has_avx2 && length >= 2) {
+        size_t found = std::string_view::npos;
+        from = find_avx2(data, haystack.size(), from, needle, found);
+        if (found != std::string_view::npos) {
+            return found;
+        }
+    }
+#endif
+    char last = needle[length - 1];
+    for (size_t position = from; position + length <= haystack.size();) {
+        char tail = data[position + length - 1];
+        if (tail == last &&
+            std::memcmp(data + position, needle.data(), length - 1) == 0) {
+            return position;
+        }
+        position += shift[static_cast<unsigned char>(tail)];
+    }
+    return std::string_view::npos;
+}
+
+/////////////////////////////////
+// Multipart Parser
+/////////////////////////////////
+
+namespace {
+
+std::string lowercase(std::string_view text) {
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return lower;
+}
+
+std::string_view trim(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    return text.substr(start, text.find_last_not_of(" \t") + 1 - start);
+}
+
+// The `; key=value` parameters after a header value's first token, keys
+// lowercased and quoted values unescaped.
+std::map<std::string, std::string> header_parameters(std::string_view value) {
+    std::map<std::string, std::string> parameters;
+    size_t position = value.find(';');
+    while (position != std::string_view::npos && position < value.size()) {
+        ++position;
+        size_t equals = value.find('=', position);
+        if (equals == std::string_view::npos) {
+            break;
+        }
+        std::string key = lowercase(trim(value.substr(position,
+                                                      equals - position)));
+        position = value.find_first_not_of(" \t", equals + 1);
+        std::string parameter;
+        if (position != std::string_view::npos && value[position] == '"') {
+            for (++position; position < value.size() && value[position] != '"';
+                 ++position) {
+                if (value[position] == '\\' && position + 1 < value.size()) {
+                    ++position;
+                }
+                parameter += value[position];
+            }
+            position = value.find(';', position);
+        } else if (position != std::string_view::npos) {
+            size_t end = value.find(';', position);
+            parameter = trim(value.substr(position, end - position));
+            position = end;
+        }
+        parameters[key] = parameter;
+    }
+    return parameters;
+}
+
+}  // namespace
+
+std::string multipart_boundary(std::string_view content_type) {
+    std::string type = lowercase(trim(content_type.substr(
+        0, content_type.find(';'))));
+    if (type.rfind("multipart/", 0) != 0) {
+        throw std::runtime_error("Not a multipart type: " + type);
+    }
+    std::string boundary = header_parameters(content_type)["boundary"];
+    if (boundary.empty() || boundary.size() > 70) {
+        throw std::runtime_error("Missing or invalid multipart boundary");
+    }
+    return boundary;
+}
+
+// The first delimiter may open the body without a CRLF in front of it;
+// starting with one held back lets a single pattern find them all.
+MultipartParser::MultipartParser(std::string_view boundary,
+                                 MultipartCallbacks callbacks)
+    : delimiter("\r\n--" + std::string(boundary)),
+      callbacks(std::move(callbacks)), pending("\r\n") {}
+
+// Held-back bytes are joined with this much new input at a time, which is
+// enough to settle a delimiter and keeps the copying small.
+static constexpr size_t JOIN_SIZE = 4096;
+
+void MultipartParser::feed(std::string_view input) {
+    while (!input.empty() && state != State::DONE) {
+        if (pending.empty()) {
+            size_t used = process(input);
+            pending.assign(input.substr(used));
+            return;
+        }
+        size_t held = pending.size();
+        size_t take = std::min(input.size(), JOIN_SIZE);
+        pending.append(input.substr(0, take));
+        size_t used = process(pending);
+        if (used >= held) {
+            // Everything held back is settled; the rest of the input can be
+            // parsed where it is.
+            input.remove_prefix(used - held);
+            pending.clear();
+        } else {
+            pending.erase(0, used);
+            input.remove_prefix(take);
+        }
+    }
+}
+
+void MultipartParser::finish() const {
+    if (state != State::DONE) {
+        throw std::runtime_error("Multipart body ended before its closing "
+                                 "delimiter");
+    }
+}
+
+size_t MultipartParser::process(std::string_view data) {
+    size_t used = 0;
+    const std::string &pattern = delimiter.pattern();
+    while (state != State::DONE) {
+        std::string_view rest = data.substr(used);
+        switch (state) {
+        case State::PREAMBLE:
+        case State::BODY: {
+            size_t found = delimiter.find(rest);
+            if (found == std::string_view::npos) {
+                // The tail might be the start of a delimiter.
+                size_t settled = rest.size() >= pattern.size()
+                                     ? rest.size() - (pattern.size() - 1)
+                                     : 0;
+                if (state == State::BODY && settled > 0 && callbacks.on_data) {
+                    callbacks.on_data(rest.substr(0, settled));
+                }
+                return used + settled;
+            }
+            if (state == State::BODY) {
+                if (found > 0 && callbacks.on_data) {
+                    callbacks.on_data(rest.substr(0, found));
+                }
+                if (callbacks.on_part_end) {
+                    callbacks.on_part_end(part);
+                }
+            }
+            used += found + pattern.size();
+            state = State::AFTER_DELIMITER;
+            break;
+        }
+        case State::AFTER_DELIMITER: {
+            if (rest.size() < 2) {
+                return used;
+            }
+            if (rest.substr(0, 2) == "--") {
+                // The epilogue after the closing delimiter is ignored.
+                state = State::DONE;
+                return data.size();
+            }
+            // Transport padding may follow the delimiter.
+            size_t padding_end = rest.find_first_not_of(" \t");
+            if (padding_end == std::string_view::npos ||
+                rest.size() - padding_end < 2) {
+                if (rest.size() > 256) {
+                    throw std::runtime_error("Malformed multipart delimiter");
+                }
+                return used;
+            }
+            if (rest.substr(padding_end, 2) != "\r\n") {
+                throw std::runtime_error("Malformed multipart delimiter");
+            }
+            used += padding_end + 2;
+            part = MultipartPart();
+            state = State::HEADERS;
+            break;
+        }
+        case State::HEADERS: {
+            // A part without headers has its blank line right away.
+            size_t block_end = rest.substr(0, 2) == "\r\n"
+                                   ? 0
+                                   : rest.find("\r\n\r\n");
+            if (block_end == std::string_view::npos) {
+                if (rest.size() > MAX_HEADER_SIZE) {
+                    throw std::runtime_error("Multipart headers too large");
+                }
+                return used;
+            }
+            parse_headers(rest.substr(0, block_end));
+            used += block_end == 0 ? 2 : block_end + 4;
+            if (callbacks.on_part) {
+                callbacks.on_part(part);
+            }
+            state = State::BODY;
+            break;
+        }
+        case State::DONE:
+            break;
+        }
+    }
+    return data.size();
+}
+
+void MultipartParser::parse_headers(std::string_view block) {
+    size_t line_start = 0;
+    while (line_start < block.size()) {
+        size_t line_end = block.find("\r\n", line_start);
+        if (line_end == std::string_view::npos) {
+            line_end = block.size();
+        }
+        std::string_view line =
+            block.substr(line_start, line_end - line_start);
+        line_start = line_end + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            throw std::runtime_error("Malformed multipart header: " +
+                                     std::string(line));
+        }
+        part.headers[lowercase(trim(line.substr(0, colon)))] =
+            trim(line.substr(colon + 1));
+    }
+
+    auto disposition = part.headers.find("content-disposition");
+    if (disposition != part.headers.end()) {
+        std::map<std::string, std::string> parameters =
+            header_parameters(disposition->second);
+        part.name = parameters["name"];
+        part.filename = parameters["filename"];
+    }
+    auto type = part.headers.find("content-type");
+    if (type != part.headers.end()) {
+        part.content_type = type->second;
+    }
+}
+
+void parse_multipart(std::istream &body, std::string_view content_type,
+                     const MultipartCallbacks &callbacks) {
+    MultipartParser parser(multipart_boundary(content_type), callbacks);
+    std::vector<char> chunk(64 * 1024);
+    while (!parser.done() &&
+           (body.read(chunk.data(), chunk.size()) || body.gcount() > 0)) {
+        parser.feed(std::string_view(chunk.data(),
+                                     static_cast<size_t>(body.gcount())));
+    }
+    parser.finish();
+}
+
+void parse_multipart(const HttpRequest &request,
+                     const MultipartCallbacks &callbacks) {
+    std::unique_ptr<std::istream> body = request.open_body();
+    parse_multipart(*body, request.get_header("content-type"), callbacks);
+}
@@ -0,0 +1,108 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+#include "http.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <string>
+#include <string_view>
+
+/////////////////////////////////
+// Boundary Search
+/////////////////////////////////
+
+// Search for one fixed pattern, such as a multipart delimiter. With AVX2
+// the pattern's first and last bytes are compared against 32 positions at
+// a time, and only positions matching both get a full compare; in binary
+// file data that is a handful per megabyte. Otherwise, and for the last
+// few positions, Boyer-Moore-Horspool: a mismatch shifts the window by how
+// far the byte under its last position is from the end of the pattern.
+class BoundarySearch {
+  public:
+    explicit BoundarySearch(std::string pattern);
+
+    // Offset of the first match at or after `from`, or npos.
+    size_t find(std::string_view haystack, size_t from = 0) const;
+
+    const std::string &pattern() const { return needle; }
+
+  private:
+    std::string needle;
+    std::array<size_t, 256> shift;
+};
+
+/////////////////////////////////
+// Multipart Parser
+/////////////////////////////////
+
+// One part of a multipart/form-data body. `name` and `filename` come from
+// its Content-Disposition header; `filename` is empty for plain fields.
+struct MultipartPart {
+    std::map<std::string, std::string> headers;  // lowercase names
+    std::string name;
+    std::string filename;
+    std::string content_type = "text/plain";
+};
+
+// Called in order for every part: on_part once its headers are in,
+// on_data for each piece of its body as it arrives, on_part_end after the
+// last piece. Any of them may be left empty.
+struct MultipartCallbacks {
+    std::function<void(const MultipartPart &)> on_part;
+    std::function<void(std::string_view)> on_data;
+    std::function<void(const MultipartPart &)> on_part_end;
+};
+
+// The boundary parameter of a multipart Content-Type, unquoted. Throws
+// std::runtime_error when the type is not multipart or has no boundary.
+std::string multipart_boundary(std::string_view content_type);
+
+// Incremental multipart/form-data parser (RFC 7578) fed a body in pieces of
+// any size. Part bodies are handed to on_data as they are found, so only
+// the last few bytes that might start a delimiter are held back between
+// calls; a part's headers are the one thing buffered whole, up to
+// MAX_HEADER_SIZE. Throws std::runtime_error on malformed input.
+class MultipartParser {
+  public:
+    static constexpr size_t MAX_HEADER_SIZE = 16 * 1024;
+
+    MultipartParser(std::string_view boundary, MultipartCallbacks callbacks);
+
+    void feed(std::string_view input);
+
+    // Call at the end of the body; throws unless the closing delimiter was
+    // seen.
+    void finish() const;
+
+    bool done() const { return state == State::DONE; }
+
+  private:
+    enum class State { PREAMBLE, AFTER_DELIMITER, HEADERS, BODY, DONE };
+
+    // Handles as much of `data` as it can; returns how much was used.
+    size_t process(std::string_view data);
+    void parse_headers(std::string_view block);
+
+    BoundarySearch delimiter;
+    MultipartCallbacks callbacks;
+    State state = State::PREAMBLE;
+    MultipartPart part;
+    // Input held back until more arrives: a possible delimiter start or an
+    // incomplete header block.
+    std::string pending;
+};
+
+// Parses `body` with the boundary from `content_type`, reading it in 64KB
+// pieces.
+void parse_multipart(std::istream &body, std::string_view content_type,
+                     const MultipartCallbacks &callbacks);
+
+// Parses a request's body wherever it is kept (see HttpRequest::open_body).
+void parse_multipart(const HttpRequest &request,
+                     const MultipartCallbacks &callbacks);
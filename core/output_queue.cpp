@@ -0,0 +1,120 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <cerrno>
+
+#include <sys/uio.h>
+
+#include "output_queue.hpp"
+
+void OutputQueue::append(std::string data) {
+    if (data.empty()) {
+        return;
+    }
+    pending += data.size();
+    appended += data.size();
+
+    if (!segments.empty()) {
+        Segment &tail = segments.back();
+        if (!tail.keepalive && tail.size + data.size() <= COALESCE_LIMIT) {
+            tail.owned += data;
+            tail.size += data.size();
+            return;
+        }
+    }
+
+    Segment segment;
+    segment.size = data.size();
+    segment.owned = std::move(data);
+    segments.push_back(std::move(segment));
+}
+
+void OutputQueue::append_shared(std::shared_ptr<const void> keepalive,
+                                const char *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    pending += size;
+    appended += size;
+
+    Segment segment;
+    segment.keepalive = std::move(keepalive);
+    segment.borrowed = data;
+    segment.size = size;
+    segments.push_back(std::move(segment));
+}
+
+OutputQueue::FlushResult OutputQueue::flush(int fd) {
+    while (!segments.empty()) {
+        iovec iov[MAX_IOVECS];
+        size_t count = 0;
+        size_t requested = 0;
+        for (auto it = segments.begin();
+             it != segments.end() && count < MAX_IOVECS; ++it, ++count) {
+            iov[count].iov_base = const_cast<char *>(it->bytes() + it->offset);
+            iov[count].iov_len = it->size - it->offset;
+            requested += iov[count].iov_len;
+        }
+
+        ssize_t written = writev(fd, iov, static_cast<int>(count));
+        ++syscalls;
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FlushResult::BLOCKED;
+            }
+            return FlushResult::ERROR;
+        }
+
+        consume(static_cast<size_t>(written));
+
+        // A short write means the socket buffer is full; trying again right
+        // away would only earn an EAGAIN.
+        if (static_cast<size_t>(written) < requested) {
+            return FlushResult::BLOCKED;
+        }
+    }
+    return FlushResult::DONE;
+}
+
+OutputQueue::FlushResult OutputQueue::flush(
+    const std::function<ssize_t(const char *, size_t)> &write) {
+    while (!segments.empty()) {
+        const Segment &front = segments.front();
+        size_t requested = front.size - front.offset;
+        ssize_t written = write(front.bytes() + front.offset, requested);
+        ++syscalls;
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FlushResult::BLOCKED;
+            }
+            return FlushResult::ERROR;
+        }
+
+        consume(static_cast<size_t>(written));
+        if (static_cast<size_t>(written) < requested) {
+            return FlushResult::BLOCKED;
+        }
+    }
+    return FlushResult::DONE;
+}
+
+void OutputQueue::consume(size_t written) {
+    pending -= written;
+    while (written > 0) {
+        Segment &front = segments.front();
+        size_t left = front.size - front.offset;
+        if (written < left) {
+            front.offset += written;
+            break;
+        }
+        written -= left;
+        segments.pop_front();
+    }
+}
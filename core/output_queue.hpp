@@ -0,0 +1,99 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+/////////////////////////////////
+// Output Queue
+/////////////////////////////////
+
+// Per-connection queue of bytes waiting to go out on a non-blocking socket.
+//
+// send() on a non-blocking socket may take only part of a buffer, or none of
+// it (EAGAIN), so responses are appended here and flush() writes as much as
+// the kernel accepts, remembering how far into the front segment it got.
+// When flush() reports BLOCKED the caller registers write interest for the
+// fd (POLLOUT in its poll() events) and calls flush() again once it is
+// writable.
+//
+// Segments are either owned strings or borrowed views kept alive by a
+// shared_ptr, so a cached response can be queued without copying it.
+// Small owned appends are coalesced into the tail segment, and flush() hands
+// up to MAX_IOVECS segments to a single writev(), so a burst of pipelined
+// responses costs one syscall instead of one per response.
+//
+// The watermarks implement backpressure: once pending bytes reach the high
+// watermark the caller should stop reading from the client, and resume when
+// they drain below the low watermark. A client that does not read its
+// responses can then not make the server buffer without bound.
+class OutputQueue {
+  public:
+    enum class FlushResult { DONE, BLOCKED, ERROR };
+
+    static constexpr size_t COALESCE_LIMIT = 16 * 1024;
+    static constexpr size_t MAX_IOVECS = 64;
+
+    explicit OutputQueue(size_t high_watermark = 1024 * 1024,
+                         size_t low_watermark = 256 * 1024)
+        : high_watermark(high_watermark), low_watermark(low_watermark) {}
+
+    void append(std::string data);
+    // Queues `size` bytes at `data` without copying; `keepalive` owns them.
+    void append_shared(std::shared_ptr<const void> keepalive, const char *data,
+                       size_t size);
+
+    FlushResult flush(int fd);
+
+    // For connections whose bytes pass through a userspace transform before
+    // reaching the socket (TLS without kernel offload). `write` gets one
+    // segment at a time and returns like send(): the bytes it took, or -1
+    // with errno set (EAGAIN when it would block).
+    FlushResult
+    flush(const std::function<ssize_t(const char *, size_t)> &write);
+
+    size_t pending_bytes() const { return pending; }
+    bool empty() const { return pending == 0; }
+    bool above_high_watermark() const { return pending >= high_watermark; }
+    bool below_low_watermark() const { return pending <= low_watermark; }
+
+    // Total number of writev() calls issued, for observing coalescing.
+    size_t write_calls() const { return syscalls; }
+
+    // Running byte totals. A caller that notes appended_bytes() right after
+    // queueing a response knows it has been fully handed to the kernel once
+    // flushed_bytes() reaches that value.
+    uint64_t appended_bytes() const { return appended; }
+    uint64_t flushed_bytes() const { return appended - pending; }
+
+  private:
+    void consume(size_t written);
+
+    struct Segment {
+        std::string owned;
+        std::shared_ptr<const void> keepalive;
+        const char *borrowed = nullptr;
+        size_t size = 0;
+        size_t offset = 0;  // bytes of this segment already written
+
+        const char *bytes() const {
+            return keepalive ? borrowed : owned.data();
+        }
+    };
+
+    std::deque<Segment> segments;
+    size_t pending = 0;
+    size_t high_watermark;
+    size_t low_watermark;
+    size_t syscalls = 0;
+    uint64_t appended = 0;
+};
@@ -0,0 +1,372 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "request_body.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <streambuf>
+#include <unistd.h>
+#include <vector>
+
+/////////////////////////////////
+// Request Body
+/////////////////////////////////
+
+RequestBody::RequestBody(BodyLimits limits) : limits(std::move(limits)) {}
+
+RequestBody::~RequestBody() {
+    for (int fd : {file_fd, pipe_fds[0], pipe_fds[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void RequestBody::append(std::string_view data) {
+    if (data.size() > limits.max_size - total) {
+        throw BodyTooLarge();
+    }
+    if (!spilled() && buffer.size() + data.size() > limits.memory_limit) {
+        spill();
+    }
+    if (spilled()) {
+        write_file(data.data(), data.size(), total);
+    } else {
+        buffer.append(data);
+    }
+    total += data.size();
+}
+
+// O_TMPFILE creates the file without a name at all; mkstemp() and an
+// immediate unlink() are the fallback for filesystems without it.
+void RequestBody::spill() {
+    file_fd = ::open(limits.spill_directory.c_str(),
+                     O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (file_fd < 0) {
+        std::string path = limits.spill_directory + "/body-XXXXXX";
+        file_fd = mkostemp(path.data(), O_CLOEXEC);
+        if (file_fd >= 0) {
+            unlink(path.c_str());
+        }
+    }
+    if (file_fd < 0) {
+        throw std::runtime_error("Cannot create a temporary file in " +
+                                 limits.spill_directory + ": " +
+                                 std::strerror(errno));
+    }
+    write_file(buffer.data(), buffer.size(), 0);
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
+
+void RequestBody::write_file(const char *data, size_t size, size_t offset) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = pwrite(file_fd, data + written, size - written,
+                                static_cast<off_t>(offset + written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw std::runtime_error(
+                std::string("Cannot write request body: ") +
+                std::strerror(errno));
+        }
+        written += static_cast<size_t>(result);
+    }
+}
+
+ssize_t RequestBody::splice_from(int socket_fd, size_t length) {
+    if (length > limits.max_size - total) {
+        throw BodyTooLarge();
+    }
+    if (!spilled()) {
+        spill();
+    }
+    if (pipe_fds[0] < 0 && pipe2(pipe_fds, O_CLOEXEC | O_NONBLOCK) < 0) {
+        throw std::runtime_error(std::string("Cannot create a pipe: ") +
+                                 std::strerror(errno));
+    }
+
+    // A pipe holds 64KB by default; whatever enters it is drained into the
+    // file before returning, so it is empty again on the next call.
+    length = std::min<size_t>(length, 64 * 1024);
+    ssize_t received = splice(socket_fd, nullptr, pipe_fds[1], nullptr,
+                              length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (received <= 0) {
+        return received;
+    }
+    loff_t offset = static_cast<loff_t>(total);
+    size_t moved = 0;
+    while (moved < static_cast<size_t>(received)) {
+        ssize_t result =
+            splice(pipe_fds[0], nullptr, file_fd, &offset,
+                   static_cast<size_t>(received) - moved, SPLICE_F_MOVE);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw std::runtime_error(
+                std::string("Cannot write request body: ") +
+                std::strerror(errno));
+        }
+        moved += static_cast<size_t>(result);
+    }
+    total += moved;
+    return received;
+}
+
+namespace {
+
+// Reads a RequestBody from the start: straight out of the string while it
+// is in memory, with pread() into a small window once it is in a file.
+class BodyStreambuf : public std::streambuf {
+  public:
+    BodyStreambuf(std::string_view memory, int file_fd, size_t size)
+        : file_fd(file_fd), size(size) {
+        if (file_fd < 0) {
+            // Only ever read through; the get area needs a non-const char*.
+            char *data = const_cast<char *>(memory.data());
+            setg(data, data, data + memory.size());
+        }
+    }
+
+  protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (file_fd < 0 || offset >= size) {
+            return traits_type::eof();
+        }
+        window.resize(64 * 1024);
+        ssize_t result =
+            pread(file_fd, window.data(),
+                  std::min(window.size(), size - offset),
+                  static_cast<off_t>(offset));
+        if (result <= 0) {
+            return traits_type::eof();
+        }
+        offset += static_cast<size_t>(result);
+        setg(window.data(), window.data(), window.data() + result);
+        return traits_type::to_int_type(*gptr());
+    }
+
+  private:
+    int file_fd;
+    size_t size;
+    size_t offset = 0;
+    std::vector<char> window;
+};
+
+// The stream owns its buffer.
+class BodyStream : public std::istream {
+  public:
+    BodyStream(std::string_view memory, int file_fd, size_t size)
+        : std::istream(nullptr), streambuf(memory, file_fd, size) {
+        rdbuf(&streambuf);
+    }
+
+  private:
+    BodyStreambuf streambuf;
+};
+
+}  // namespace
+
+std::unique_ptr<std::istream> RequestBody::open() const {
+    return std::make_unique<BodyStream>(buffer, file_fd, total);
+}
+
+std::unique_ptr<std::istream> open_memory_stream(std::string_view data) {
+    return std::make_unique<BodyStream>(data, -1, data.size());
+}
+
+/////////////////////////////////
+// Body Decoder
+/////////////////////////////////
+
+// Compares ASCII case-insensitively against an already lowercase string.
+static bool equals_lowercase(std::string_view text, std::string_view lower) {
+    return text.size() == lower.size() &&
+           std::equal(text.begin(), text.end(), lower.begin(),
+                      [](char a, char b) {
+                          return std::tolower(static_cast<unsigned char>(a)) ==
+                                 b;
+                      });
+}
+
+// Also reports whether a Content-Length was given at all, which only
+// matters for responses.
+static BodyFraming parse_framing(std::string_view head, bool &has_length) {
+    BodyFraming framing;
+    has_length = false;
+    size_t line_start = head.find("\r\n");
+    while (line_start != std::string_view::npos && line_start < head.size()) {
+        line_start += 2;
+        size_t line_end = head.find("\r\n", line_start);
+        std::string_view line = head.substr(line_start, line_end - line_start);
+        line_start = line_end;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = line.substr(colon + 1);
+        value.remove_prefix(
+            std::min(value.find_first_not_of(" \t"), value.size()));
+        value = value.substr(0, value.find_last_not_of(" \t") + 1);
+
+        if (equals_lowercase(name, "transfer-encoding")) {
+            if (!equals_lowercase(value, "chunked")) {
+                throw std::runtime_error("Unsupported transfer coding: " +
+                                         std::string(value));
+            }
+            framing.chunked = true;
+        } else if (equals_lowercase(name, "content-length")) {
+            auto [end, error] = std::from_chars(
+                value.data(), value.data() + value.size(),
+                framing.content_length);
+            if (value.empty() || error != std::errc() ||
+                end != value.data() + value.size()) {
+                throw std::runtime_error("Invalid Content-Length: " +
+                                         std::string(value));
+            }
+            has_length = true;
+        }
+    }
+    // Chunked wins over Content-Length (RFC 9112 section 6.3).
+    if (framing.chunked) {
+        framing.content_length = 0;
+    }
+    return framing;
+}
+
+BodyFraming body_framing(std::string_view head) {
+    bool has_length;
+    return parse_framing(head, has_length);
+}
+
+BodyFraming response_body_framing(std::string_view head, int status_code,
+                                  bool head_request) {
+    if (head_request || (status_code >= 100 && status_code < 200) ||
+        status_code == 204 || status_code == 304) {
+        return {};
+    }
+    bool has_length;
+    BodyFraming framing = parse_framing(head, has_length);
+    framing.until_close = !framing.chunked && !has_length;
+    return framing;
+}
+
+// A body read until the connection closes is one Content-Length body
+// that never ends.
+BodyDecoder::BodyDecoder(BodyFraming framing)
+    : chunked(framing.chunked),
+      remaining(framing.until_close ? SIZE_MAX : framing.content_length) {
+    state = chunked ? State::SIZE : remaining == 0 ? State::DONE : State::DATA;
+}
+
+void BodyDecoder::skip_raw(size_t length) {
+    remaining -= length;
+    if (remaining == 0) {
+        state = State::DONE;
+    }
+}
+
+namespace {
+
+// Chunk-size and trailer lines longer than this are refused rather than
+// buffered.
+constexpr size_t MAX_CHUNK_LINE = 4096;
+
+// Collects one CRLF-terminated line from the front of `input` into `line`.
+// Returns false while the line is still incomplete.
+bool take_line(std::string_view input, size_t &used, std::string &line) {
+    size_t newline = input.find('\n', used);
+    size_t end = newline == std::string_view::npos ? input.size() : newline;
+    line.append(input.substr(used, end - used));
+    used = newline == std::string_view::npos ? input.size() : newline + 1;
+    if (line.size() > MAX_CHUNK_LINE) {
+        throw std::runtime_error("Chunk line too long");
+    }
+    if (newline == std::string_view::npos) {
+        return false;
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return true;
+}
+
+}  // namespace
+
+size_t BodyDecoder::feed(std::string_view input, RequestBody &body) {
+    return feed(input, [&body](std::string_view data) { body.append(data); });
+}
+
+size_t BodyDecoder::feed(std::string_view input,
+                         const std::function<void(std::string_view)> &sink) {
+    size_t used = 0;
+    while (used < input.size() && state != State::DONE) {
+        switch (state) {
+        case State::DATA: {
+            size_t take = std::min(remaining, input.size() - used);
+            sink(input.substr(used, take));
+            used += take;
+            remaining -= take;
+            if (remaining == 0) {
+                state = chunked ? State::DATA_END : State::DONE;
+            }
+            break;
+        }
+        case State::SIZE: {
+            if (!take_line(input, used, line)) {
+                break;
+            }
+            // Extensions after ';' carry nothing we use.
+            std::string_view digits = line;
+            digits = digits.substr(0, digits.find(';'));
+            digits = digits.substr(0, digits.find_last_not_of(" \t") + 1);
+            auto [end, error] = std::from_chars(
+                digits.data(), digits.data() + digits.size(), remaining, 16);
+            if (digits.empty() || error != std::errc() ||
+                end != digits.data() + digits.size()) {
+                throw std::runtime_error("Invalid chunk size: " + line);
+            }
+            line.clear();
+            state = remaining == 0 ? State::TRAILER : State::DATA;
+            break;
+        }
+        case State::DATA_END:
+            if (!take_line(input, used, line)) {
+                break;
+            }
+            if (!line.empty()) {
+                throw std::runtime_error("Chunk longer than its size");
+            }
+            state = State::SIZE;
+            break;
+        case State::TRAILER:
+            // Trailer fields are read and dropped up to the blank line.
+            if (!take_line(input, used, line)) {
+                break;
+            }
+            if (line.empty()) {
+                state = State::DONE;
+            }
+            line.clear();
+            break;
+        case State::DONE:
+            break;
+        }
+    }
+    return used;
+}
@@ -0,0 +1,146 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+/////////////////////////////////
+// Request Body
+/////////////////////////////////
+
+// Bounds for one request body. Up to `memory_limit` bytes are kept in
+// memory; past that the body moves to an unlinked temporary file in
+// `spill_directory`, so a large upload costs disk rather than heap. Bodies
+// over `max_size` are refused with BodyTooLarge.
+struct BodyLimits {
+    size_t memory_limit = 1024 * 1024;
+    size_t max_size = 1024ULL * 1024 * 1024;
+    std::string spill_directory = "/tmp";
+};
+
+// Thrown when a body grows past BodyLimits::max_size; answered with 413.
+class BodyTooLarge : public std::runtime_error {
+  public:
+    BodyTooLarge() : std::runtime_error("Request body too large") {}
+};
+
+// The bytes of one request body, in memory or in a temporary file. Filled
+// by a BodyDecoder as the body arrives and read by handlers through
+// open(). The file is unlinked as soon as it is created, so it disappears
+// with the last descriptor even if the process dies mid-upload.
+class RequestBody {
+  public:
+    explicit RequestBody(BodyLimits limits = {});
+    ~RequestBody();
+    RequestBody(const RequestBody &) = delete;
+    RequestBody &operator=(const RequestBody &) = delete;
+
+    // Throws BodyTooLarge past the size limit and std::runtime_error when
+    // the temporary file cannot be written.
+    void append(std::string_view data);
+
+    // Moves up to `length` bytes straight from socket `socket_fd` into the
+    // temporary file with splice(), through a pipe and without copying
+    // them into userspace. Spills first if the body is still in memory.
+    // Returns like recv(): bytes moved, 0 at end of stream, -1 with errno
+    // set (EAGAIN when the socket has nothing more).
+    ssize_t splice_from(int socket_fd, size_t length);
+
+    size_t size() const { return total; }
+    bool spilled() const { return file_fd >= 0; }
+
+    // The body while it is still in memory.
+    const std::string &memory() const { return buffer; }
+    std::string take_memory() { return std::move(buffer); }
+
+    // Reads the body from the start, wherever it is kept. The stream
+    // refers to this body, which must outlive it.
+    std::unique_ptr<std::istream> open() const;
+
+  private:
+    void spill();
+    void write_file(const char *data, size_t size, size_t offset);
+
+    BodyLimits limits;
+    std::string buffer;
+    size_t total = 0;
+    int file_fd = -1;
+    int pipe_fds[2] = {-1, -1};
+};
+
+// Stream over bytes in memory, without copying them. They must outlive it.
+std::unique_ptr<std::istream> open_memory_stream(std::string_view data);
+
+/////////////////////////////////
+// Body Decoder
+/////////////////////////////////
+
+// How the body after a message head is delimited.
+struct BodyFraming {
+    bool chunked = false;
+    size_t content_length = 0;
+    // Responses only: the body is everything until the server closes the
+    // connection.
+    bool until_close = false;
+};
+
+// Reads Transfer-Encoding and Content-Length out of a request head (the
+// bytes up to and including the blank line). Throws std::runtime_error for
+// a transfer coding other than chunked and for an invalid Content-Length.
+BodyFraming body_framing(std::string_view head);
+
+// The same for a response head (RFC 9112 section 6.3): no body after a
+// HEAD request or for 1xx, 204 and 304; without Transfer-Encoding or
+// Content-Length it runs until the connection closes.
+BodyFraming response_body_framing(std::string_view head, int status_code,
+                                  bool head_request);
+
+// Incremental decoder for one message body, fed whatever has arrived so
+// far. Content-Length bodies are copied through; chunked bodies have their
+// chunk sizes, extensions and trailers stripped. Throws std::runtime_error
+// on a malformed chunk and BodyTooLarge from the target body.
+//
+// A body that runs until the connection closes is never done(); the caller
+// ends it at end of stream.
+class BodyDecoder {
+  public:
+    explicit BodyDecoder(BodyFraming framing);
+
+    // Decodes from the front of `input` into `body`. Returns how many bytes
+    // were used; stops at the end of the body, leaving any pipelined
+    // request behind it.
+    size_t feed(std::string_view input, RequestBody &body);
+    // The same, handing each run of decoded bytes to `sink`.
+    size_t feed(std::string_view input,
+                const std::function<void(std::string_view)> &sink);
+
+    bool done() const { return state == State::DONE; }
+
+    // Raw body bytes that can be moved without decoding: the rest of a
+    // Content-Length body, 0 for chunked ones.
+    size_t raw_remaining() const { return chunked ? 0 : remaining; }
+
+    // Accounts for bytes moved with RequestBody::splice_from().
+    void skip_raw(size_t length);
+
+  private:
+    enum class State { SIZE, DATA, DATA_END, TRAILER, DONE };
+
+    bool chunked;
+    State state;
+    // Content-Length bytes still expected, or the rest of the current
+    // chunk.
+    size_t remaining;
+    // A chunk-size or trailer line split across reads.
+    std::string line;
+};
@@ -0,0 +1,223 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+#include <sys/uio.h>
+
+#include "response_cache.hpp"
+
+const CachedVariant &
+CachedResponse::select(const std::string &accept_encoding) const {
+    // variants[0] is always identity, so a single variant needs no parsing.
+    if (variants.size() == 1) {
+        return variants.front();
+    }
+
+    std::vector<ContentEncoding> available;
+    for (const CachedVariant &variant : variants) {
+        available.push_back(variant.encoding);
+    }
+    ContentEncoding chosen = negotiate_encoding(accept_encoding, available);
+
+    for (const CachedVariant &variant : variants) {
+        if (variant.encoding == chosen) {
+            return variant;
+        }
+    }
+    return variants.front();
+}
+
+size_t CachedResponse::size() const {
+    size_t total = 0;
+    for (const CachedVariant &variant : variants) {
+        total += variant.size();
+    }
+    return total;
+}
+
+ResponseCache::ResponseCache(std::vector<std::string> vary_headers,
+                             size_t capacity_bytes, size_t shard_count)
+    : vary_headers(std::move(vary_headers)) {
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    shard_capacity = capacity_bytes / shard_count;
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+std::string ResponseCache::make_key(const HttpRequest &request) const {
+    std::string key;
+    key.reserve(request.path.size() + request.method.size() + 2);
+    key += request.path;
+    key += '\0';
+    key += request.method;
+    for (const std::string &name : vary_headers) {
+        key += '\0';
+        key += request.get_header(name);
+    }
+    return key;
+}
+
+ResponseCache::Shard &ResponseCache::shard_for(const std::string &path) {
+    return *shards[std::hash<std::string>{}(path) % shards.size()];
+}
+
+void ResponseCache::erase_node(
+    Shard &shard,
+    std::map<std::string, std::list<Node>::iterator>::iterator it) {
+    shard.bytes -= it->second->entry->size();
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+}
+
+std::shared_ptr<const CachedResponse>
+ResponseCache::lookup(const HttpRequest &request) {
+    std::string key = make_key(request);
+    Shard &shard = shard_for(request.path);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return nullptr;
+    }
+
+    if (it->second->entry->expires_at <= std::chrono::steady_clock::now()) {
+        erase_node(shard, it);
+        return nullptr;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->entry;
+}
+
+bool ResponseCache::insert(
+    const HttpRequest &request, const HttpResponse &response,
+    std::chrono::milliseconds ttl,
+    const std::map<ContentEncoding, std::string> &encoded_bodies) {
+    if (response.is_streaming_response()) {
+        return false;
+    }
+
+    auto entry = std::make_shared<CachedResponse>();
+    entry->status_code = response.status_code;
+    entry->expires_at = std::chrono::steady_clock::now() + ttl;
+
+    // Build every head from a body-less copy so to_string() emits only the
+    // status line and headers, with Content-Length already pointing at the
+    // body that will follow it.
+    HttpResponse head_only = response;
+    head_only.body.clear();
+    if (!encoded_bodies.empty()) {
+        head_only.set_header("Vary", "Accept-Encoding");
+    }
+
+    CachedVariant identity;
+    if (!response.has_header("content-length")) {
+        head_only.set_header("Content-Length",
+                             std::to_string(response.body.size()));
+    }
+    identity.head = head_only.to_string();
+    identity.body = response.body;
+    entry->variants.push_back(std::move(identity));
+
+    for (const auto &[encoding, encoded_body] : encoded_bodies) {
+        if (encoding == ContentEncoding::IDENTITY) {
+            continue;
+        }
+        HttpResponse encoded_head = head_only;
+        encoded_head.set_header("Content-Encoding",
+                                content_encoding_token(encoding));
+        encoded_head.set_header("Content-Length",
+                                std::to_string(encoded_body.size()));
+
+        CachedVariant variant;
+        variant.encoding = encoding;
+        variant.head = encoded_head.to_string();
+        variant.body = encoded_body;
+        entry->variants.push_back(std::move(variant));
+    }
+
+    size_t entry_size = entry->size();
+    if (entry_size > shard_capacity) {
+        return false;
+    }
+
+    std::string key = make_key(request);
+    Shard &shard = shard_for(request.path);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto existing = shard.index.find(key);
+    if (existing != shard.index.end()) {
+        erase_node(shard, existing);
+    }
+
+    while (shard.bytes + entry_size > shard_capacity && !shard.lru.empty()) {
+        erase_node(shard, shard.index.find(shard.lru.back().key));
+    }
+
+    shard.lru.push_front(Node{key, std::move(entry)});
+    shard.index.emplace(std::move(key), shard.lru.begin());
+    shard.bytes += entry_size;
+    return true;
+}
+
+size_t ResponseCache::invalidate(const std::string &path) {
+    std::string prefix = path;
+    prefix += '\0';
+
+    Shard &shard = shard_for(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    size_t removed = 0;
+    auto it = shard.index.lower_bound(prefix);
+    while (it != shard.index.end() &&
+           it->first.compare(0, prefix.size(), prefix) == 0) {
+        auto next = std::next(it);
+        erase_node(shard, it);
+        it = next;
+        ++removed;
+    }
+    return removed;
+}
+
+void ResponseCache::clear() {
+    for (auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->index.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
+
+size_t ResponseCache::entry_count() const {
+    size_t count = 0;
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        count += shard->index.size();
+    }
+    return count;
+}
+
+size_t ResponseCache::size_bytes() const {
+    size_t bytes = 0;
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        bytes += shard->bytes;
+    }
+    return bytes;
+}
+
+ssize_t ResponseCache::write_hit(int fd, const CachedResponse &entry,
+                                 const HttpRequest &request) {
+    const CachedVariant &variant =
+        entry.select(request.get_header("accept-encoding"));
+    std::array<iovec, 2> iov = variant.iovecs();
+    int count = (request.method == "HEAD" || variant.body.empty()) ? 1 : 2;
+    return writev(fd, iov.data(), count);
+}
@@ -0,0 +1,127 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+#include "compression.hpp"
+#include "http.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/////////////////////////////////
+// Response Cache
+/////////////////////////////////
+
+// One fully serialized representation of a response. Head (status line and
+// headers including the terminating CRLF) and body are kept apart so that a
+// HEAD request can reuse the head alone and a GET goes out as a single
+// two-element writev() without concatenating anything.
+struct CachedVariant {
+    ContentEncoding encoding = ContentEncoding::IDENTITY;
+    std::string head;
+    std::string body;
+
+    std::array<iovec, 2> iovecs() const {
+        return {iovec{const_cast<char *>(head.data()), head.size()},
+                iovec{const_cast<char *>(body.data()), body.size()}};
+    }
+
+    size_t size() const { return head.size() + body.size(); }
+};
+
+// Immutable once inserted. Lookups hand out shared_ptrs so an entry that is
+// evicted or invalidated while a connection is still writing it stays alive
+// until that write finishes.
+struct CachedResponse {
+    int status_code = 200;
+    std::chrono::steady_clock::time_point expires_at;
+    // IDENTITY is always present, the compressed variants only when the
+    // caller supplies them.
+    std::vector<CachedVariant> variants;
+
+    const CachedVariant &select(const std::string &accept_encoding) const;
+    size_t size() const;
+};
+
+// Sharded LRU cache of serialized responses.
+//
+// The key is "path \0 method \0 vary-value \0 ..." where the vary values are
+// the request's values for the header names passed to the constructor.
+// Putting the path first means every method and every Vary combination of one
+// resource sits in one contiguous range of the ordered index, so invalidate()
+// is a lower_bound plus a range erase instead of a scan. Shards are selected
+// by hashing the path alone for the same reason.
+//
+// Accept-Encoding is deliberately *not* part of the key: the compressed
+// bodies live inside one entry as variants and are negotiated on every hit.
+//
+// Each shard has its own mutex, so concurrent lookups only contend when they
+// hit the same shard. The capacity is enforced per shard in bytes.
+class ResponseCache {
+  public:
+    explicit ResponseCache(std::vector<std::string> vary_headers = {},
+                           size_t capacity_bytes = 64 * 1024 * 1024,
+                           size_t shard_count = 16);
+
+    // Returns the live entry for this request or nullptr on miss/expiry.
+    // A hit moves the entry to the front of its shard's LRU list.
+    std::shared_ptr<const CachedResponse> lookup(const HttpRequest &request);
+
+    // Serializes `response` once and stores it under the request's key.
+    // `encoded_bodies` holds optional precompressed bodies, one per encoding;
+    // a head carrying the matching Content-Encoding and Content-Length is
+    // built for each. Streaming responses cannot be cached and are rejected.
+    bool insert(const HttpRequest &request, const HttpResponse &response,
+                std::chrono::milliseconds ttl,
+                const std::map<ContentEncoding, std::string> &encoded_bodies =
+                    {});
+
+    // Drops every cached method and Vary combination of `path`.
+    size_t invalidate(const std::string &path);
+    void clear();
+
+    size_t entry_count() const;
+    size_t size_bytes() const;
+
+    // Writes the variant matching the request's Accept-Encoding with one
+    // writev(). HEAD requests only get the head. Returns what writev()
+    // returned, so short writes are visible to the caller.
+    static ssize_t write_hit(int fd, const CachedResponse &entry,
+                             const HttpRequest &request);
+
+  private:
+    struct Node {
+        std::string key;
+        std::shared_ptr<const CachedResponse> entry;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Node> lru;  // front is most recently used
+        std::map<std::string, std::list<Node>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    std::vector<std::string> vary_headers;
+    size_t shard_capacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::string make_key(const HttpRequest &request) const;
+    Shard &shard_for(const std::string &path);
+
+    static void erase_node(Shard &shard,
+                           std::map<std::string,
+                                    std::list<Node>::iterator>::iterator it);
+};
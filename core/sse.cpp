@@ -0,0 +1,153 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "sse.hpp"
+
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <stdexcept>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/////////////////////////////////
+// Server-Sent Events
+/////////////////////////////////
+
+std::string encode_sse_event(const ServerSentEvent &event) {
+    std::string wire;
+    wire.reserve(event.data.size() + event.id.size() + event.event.size() +
+                 32);
+    auto field = [&wire](std::string_view name, std::string_view value) {
+        wire.append(name).append(": ").append(value).append(1, '\n');
+    };
+    if (!event.id.empty()) {
+        field("id", event.id);
+    }
+    if (!event.event.empty()) {
+        field("event", event.event);
+    }
+    if (event.retry) {
+        field("retry", std::to_string(*event.retry));
+    }
+
+    std::string_view data = event.data;
+    size_t line_start = 0;
+    while (line_start <= data.size()) {
+        size_t line_end = data.find_first_of("\r\n", line_start);
+        if (line_end == std::string_view::npos) {
+            line_end = data.size();
+        }
+        wire += "data: ";
+        wire += data.substr(line_start, line_end - line_start);
+        wire += '\n';
+        if (line_end == data.size()) {
+            break;
+        }
+        line_start = line_end + 1;
+        if (data[line_end] == '\r' && line_start < data.size() &&
+            data[line_start] == '\n') {
+            ++line_start;
+        }
+    }
+    wire += '\n';
+    return wire;
+}
+
+EncodedEvent encode_sse_chunk(std::string_view wire, uint64_t id) {
+    char size_line[24];
+    int prefix = std::snprintf(size_line, sizeof(size_line), "%zx\r\n",
+                               wire.size());
+    std::string chunk;
+    chunk.reserve(prefix + wire.size() + 2);
+    chunk.append(size_line, prefix);
+    chunk.append(wire);
+    chunk.append("\r\n");
+    return {id, std::make_shared<const std::string>(std::move(chunk)),
+            static_cast<size_t>(prefix)};
+}
+
+EventStream::EventStream(size_t history,
+                         std::chrono::milliseconds heartbeat_interval)
+    : history_size(history) {
+    // Nanoseconds since the Unix epoch, in hex: distinct for a process
+    // started later, and short enough to repeat on every event.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char digits[20];
+    int length = std::snprintf(
+        digits, sizeof(digits), "%llx",
+        static_cast<unsigned long long>(now.tv_sec) * 1000000000ULL +
+            static_cast<unsigned long long>(now.tv_nsec));
+    epoch.assign(digits, static_cast<size_t>(length));
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        throw std::runtime_error("Failed to create heartbeat timerfd");
+    }
+    struct itimerspec interval = {};
+    interval.it_interval.tv_sec = heartbeat_interval.count() / 1000;
+    interval.it_interval.tv_nsec = (heartbeat_interval.count() % 1000) *
+                                   1000000;
+    interval.it_value = interval.it_interval;
+    timerfd_settime(timer_fd, 0, &interval, nullptr);
+}
+
+EventStream::~EventStream() { close(timer_fd); }
+
+EncodedEvent EventStream::publish(ServerSentEvent event) {
+    uint64_t id = next_id++;
+    event.id = event_id(id);
+    EncodedEvent encoded = encode_sse_chunk(encode_sse_event(event), id);
+    history.push_back(encoded);
+    if (history.size() > history_size) {
+        history.pop_front();
+    }
+    return encoded;
+}
+
+std::string EventStream::event_id(uint64_t sequence) const {
+    return epoch + "-" + std::to_string(sequence);
+}
+
+std::vector<EncodedEvent>
+EventStream::since(std::string_view last_event_id) const {
+    size_t dash = last_event_id.find('-');
+    if (dash == 0 || dash == std::string_view::npos) {
+        return {};
+    }
+    std::string_view sequence = last_event_id.substr(dash + 1);
+    uint64_t last = 0;
+    auto [end, error] = std::from_chars(
+        sequence.data(), sequence.data() + sequence.size(), last);
+    if (error != std::errc() || end != sequence.data() + sequence.size()) {
+        return {};
+    }
+    if (last_event_id.substr(0, dash) != epoch) {
+        // Another process numbered it; everything kept here is new to
+        // the client.
+        last = 0;
+    } else if (last >= next_id) {
+        return {};
+    }
+    std::vector<EncodedEvent> missed;
+    for (const EncodedEvent &event : history) {
+        if (event.id > last) {
+            missed.push_back(event);
+        }
+    }
+    return missed;
+}
+
+bool EventStream::heartbeat_due() {
+    uint64_t expirations = 0;
+    return read(timer_fd, &expirations, sizeof(expirations)) ==
+               sizeof(expirations) &&
+           expirations > 0;
+}
+
+const EncodedEvent &EventStream::heartbeat() {
+    static const EncodedEvent encoded = encode_sse_chunk(":heartbeat\n\n");
+    return encoded;
+}
@@ -0,0 +1,101 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/////////////////////////////////
+// Server-Sent Events
+/////////////////////////////////
+
+// One event on a text/event-stream (HTML Living Standard, "Server-sent
+// events"). Empty fields are left out; `data` may span lines.
+struct ServerSentEvent {
+    std::string id;
+    std::string event;
+    std::string data;
+    std::optional<uint32_t> retry;
+};
+
+// The event's wire form, ending in the blank line that dispatches it. Each
+// line of `data` (split at \r\n, \n or \r) becomes its own "data:" field.
+std::string encode_sse_event(const ServerSentEvent &event);
+
+// An event encoded once, as one chunk of a chunked response. HTTP/1.1
+// subscribers are sent all of `chunk`; HTTP/1.0 ones, whose response is
+// delimited by closing the connection, only payload(). Both borrow the
+// same bytes.
+struct EncodedEvent {
+    uint64_t id = 0;
+    std::shared_ptr<const std::string> chunk;
+    size_t payload_offset = 0;
+
+    std::string_view payload() const {
+        return std::string_view(*chunk).substr(
+            payload_offset, chunk->size() - payload_offset - 2);
+    }
+};
+
+// Wraps wire bytes in one chunk of chunked transfer coding.
+EncodedEvent encode_sse_chunk(std::string_view wire, uint64_t id = 0);
+
+// A broadcast channel of events. publish() numbers and encodes each event
+// once; the server queues the same bytes on every subscriber. The last
+// `history` events are kept, so a client reconnecting with Last-Event-ID
+// gets what it missed.
+//
+// Ids are "<epoch>-<n>", the epoch being fixed when the stream is created.
+// A client that reconnects to a replacement process after a handoff sends
+// an id from the old epoch, and is given the new stream's history from
+// the start instead of having its id compared with unrelated numbers.
+//
+// Heartbeats come from one timerfd for the whole stream rather than a
+// timer per connection: poll heartbeat_fd() and, when it is readable,
+// call heartbeat_due() and queue heartbeat() on every subscriber. The
+// comment line keeps proxies from timing idle streams out.
+class EventStream {
+  public:
+    explicit EventStream(size_t history = 256,
+                         std::chrono::milliseconds heartbeat_interval =
+                             std::chrono::seconds(15));
+    ~EventStream();
+    EventStream(const EventStream &) = delete;
+    EventStream &operator=(const EventStream &) = delete;
+
+    // Replaces the event's id with the next one in the stream.
+    EncodedEvent publish(ServerSentEvent event);
+
+    // Events published after `last_event_id`. An id older than everything
+    // kept, or from an earlier epoch, yields all of the history; an empty
+    // or malformed one, or one not published yet, yields nothing.
+    std::vector<EncodedEvent> since(std::string_view last_event_id) const;
+
+    // The wire id of the event numbered `sequence`.
+    std::string event_id(uint64_t sequence) const;
+
+    int heartbeat_fd() const { return timer_fd; }
+
+    // Clears the timer's expirations; true if any were pending.
+    bool heartbeat_due();
+
+    static const EncodedEvent &heartbeat();
+
+    uint64_t last_id() const { return next_id - 1; }
+
+  private:
+    size_t history_size;
+    std::string epoch;
+    std::deque<EncodedEvent> history;
+    uint64_t next_id = 1;
+    int timer_fd = -1;
+};
@@ -2,7 +2,9 @@
 //
 //
 
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 #include "string_utils.hpp"
@@ -163,3 +165,87 @@ std::string percent_encoding(const std::string &string_value,
         return string_value;
     }
 }
+
+std::string base64_encode(std::string_view data) {
+    static constexpr char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string encoded;
+    encoded.reserve((data.size() + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        uint32_t group = static_cast<uint8_t>(data[i]) << 16 |
+                         static_cast<uint8_t>(data[i + 1]) << 8 |
+                         static_cast<uint8_t>(data[i + 2]);
+        encoded += alphabet[group >> 18 & 0x3F];
+        encoded += alphabet[group >> 12 & 0x3F];
+        encoded += alphabet[group >> 6 & 0x3F];
+        encoded += alphabet[group & 0x3F];
+    }
+
+    size_t remaining = data.size() - i;
+    if (remaining > 0) {
+        uint32_t group = static_cast<uint8_t>(data[i]) << 16;
+        if (remaining == 2) {
+            group |= static_cast<uint8_t>(data[i + 1]) << 8;
+        }
+        encoded += alphabet[group >> 18 & 0x3F];
+        encoded += alphabet[group >> 12 & 0x3F];
+        encoded += remaining == 2 ? alphabet[group >> 6 & 0x3F] : '=';
+        encoded += '=';
+    }
+    return encoded;
+}
+
+std::string base64url_encode(std::string_view data) {
+    std::string encoded = base64_encode(data);
+    while (!encoded.empty() && encoded.back() == '=') {
+        encoded.pop_back();
+    }
+    for (char &c : encoded) {
+        if (c == '+') {
+            c = '-';
+        } else if (c == '/') {
+            c = '_';
+        }
+    }
+    return encoded;
+}
+
+std::string base64url_decode(std::string_view encoded) {
+    while (!encoded.empty() && encoded.back() == '=') {
+        encoded.remove_suffix(1);
+    }
+    if (encoded.size() % 4 == 1) {
+        throw std::runtime_error("Invalid base64url length");
+    }
+
+    std::string decoded;
+    decoded.reserve(encoded.size() * 3 / 4);
+    uint32_t group = 0;
+    int bits = 0;
+    for (char c : encoded) {
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '-') {
+            value = 62;
+        } else if (c == '_') {
+            value = 63;
+        } else {
+            throw std::runtime_error("Invalid base64url character");
+        }
+        group = group << 6 | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            decoded += static_cast<char>(group >> bits & 0xFF);
+        }
+    }
+    return decoded;
+}
@@ -7,6 +7,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 
 std::string format_header_name(std::string header_name);
 
@@ -16,4 +17,12 @@ std::string percent_encoding(const std::string &string_value);
 std::string percent_encoding(const std::string &string_value,
                              const std::string &mode);
 
+// Standard base64 alphabet with '=' padding (RFC 4648).
+std::string base64_encode(std::string_view data);
+
+// URL-safe alphabet without padding, as HTTP2-Settings uses (RFC 4648
+// section 5). Decoding throws std::runtime_error on other characters.
+std::string base64url_encode(std::string_view data);
+std::string base64url_decode(std::string_view encoded);
+
 #endif  // STRING_UTILS_HPP_
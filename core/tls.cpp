@@ -0,0 +1,299 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tls.hpp"
+
+// Drains the OpenSSL error queue into one message.
+static std::string openssl_error(const std::string &what) {
+    std::string message = what;
+    char buffer[256];
+    while (unsigned long code = ERR_get_error()) {
+        ERR_error_string_n(code, buffer, sizeof(buffer));
+        message += message == what ? ": " : "; ";
+        message += buffer;
+    }
+    return message;
+}
+
+static bool is_ip_address(const std::string &host) {
+    unsigned char address[16];
+    return inet_pton(AF_INET, host.c_str(), address) == 1 ||
+           inet_pton(AF_INET6, host.c_str(), address) == 1;
+}
+
+/////////////////////////////////
+// TLS Context
+/////////////////////////////////
+
+TlsContext::TlsContext(ssl_ctx_st *native_context, bool server_side)
+    : context(native_context, SSL_CTX_free), server_side(server_side) {
+    SSL_CTX_set_min_proto_version(native_context, TLS1_2_VERSION);
+    SSL_CTX_set_options(native_context, SSL_OP_ENABLE_KTLS);
+    // write() may then take part of a buffer and be retried with the rest
+    // from a different address, as OutputQueue does.
+    SSL_CTX_set_mode(native_context, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                         SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+}
+
+TlsContext TlsContext::server(const std::string &certificate_path,
+                              const std::string &key_path) {
+    SSL_CTX *native_context = SSL_CTX_new(TLS_server_method());
+    if (native_context == nullptr) {
+        throw std::runtime_error(openssl_error("SSL_CTX_new failed"));
+    }
+    TlsContext tls_context(native_context, true);
+
+    if (SSL_CTX_use_certificate_chain_file(native_context,
+                                           certificate_path.c_str()) != 1) {
+        throw std::runtime_error(
+            openssl_error("Cannot load certificate " + certificate_path));
+    }
+    if (SSL_CTX_use_PrivateKey_file(native_context, key_path.c_str(),
+                                    SSL_FILETYPE_PEM) != 1) {
+        throw std::runtime_error(
+            openssl_error("Cannot load private key " + key_path));
+    }
+    if (SSL_CTX_check_private_key(native_context) != 1) {
+        throw std::runtime_error(
+            openssl_error("Private key does not match the certificate"));
+    }
+    return tls_context;
+}
+
+TlsContext TlsContext::client(const std::string &ca_path) {
+    SSL_CTX *native_context = SSL_CTX_new(TLS_client_method());
+    if (native_context == nullptr) {
+        throw std::runtime_error(openssl_error("SSL_CTX_new failed"));
+    }
+    TlsContext tls_context(native_context, false);
+
+    SSL_CTX_set_verify(native_context, SSL_VERIFY_PEER, nullptr);
+    int loaded = ca_path.empty()
+                     ? SSL_CTX_set_default_verify_paths(native_context)
+                     : SSL_CTX_load_verify_locations(native_context,
+                                                     ca_path.c_str(), nullptr);
+    if (loaded != 1) {
+        throw std::runtime_error(
+            openssl_error("Cannot load CA certificates " + ca_path));
+    }
+    return tls_context;
+}
+
+void write_self_signed_certificate(const std::string &certificate_path,
+                                   const std::string &key_path,
+                                   const std::string &host) {
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(
+        EVP_EC_gen("P-256"), EVP_PKEY_free);
+    std::unique_ptr<X509, decltype(&X509_free)> certificate(X509_new(),
+                                                            X509_free);
+    if (!key || !certificate) {
+        throw std::runtime_error(openssl_error("Cannot create certificate"));
+    }
+
+    X509 *cert = certificate.get();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert),
+                     static_cast<long>(time(nullptr)));
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 30L * 24 * 60 * 60);
+    X509_set_pubkey(cert, key.get());
+
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char *>(host.c_str()), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    X509V3_CTX extension_context;
+    X509V3_set_ctx_nodb(&extension_context);
+    X509V3_set_ctx(&extension_context, cert, cert, nullptr, nullptr, 0);
+    std::string alt_name = (is_ip_address(host) ? "IP:" : "DNS:") + host;
+    for (auto [nid, value] :
+         {std::pair<int, std::string>{NID_basic_constraints,
+                                      "critical,CA:TRUE"},
+          {NID_subject_alt_name, alt_name}}) {
+        X509_EXTENSION *extension = X509V3_EXT_conf_nid(
+            nullptr, &extension_context, nid, value.c_str());
+        if (extension == nullptr) {
+            throw std::runtime_error(
+                openssl_error("Cannot add certificate extension"));
+        }
+        X509_add_ext(cert, extension, -1);
+        X509_EXTENSION_free(extension);
+    }
+    if (X509_sign(cert, key.get(), EVP_sha256()) == 0) {
+        throw std::runtime_error(openssl_error("Cannot sign certificate"));
+    }
+
+    // The key is created owner-only; fchmod() covers a file left over
+    // from an earlier run with wider permissions.
+    auto write_pem = [](const std::string &path, mode_t mode, auto write) {
+        int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC,
+                      mode);
+        FILE *file = nullptr;
+        if (fd == -1 || fchmod(fd, mode) == -1 ||
+            (file = fdopen(fd, "w")) == nullptr) {
+            if (fd != -1) {
+                close(fd);
+            }
+            throw std::runtime_error("Cannot write " + path);
+        }
+        bool written = write(file);
+        fclose(file);
+        if (!written) {
+            throw std::runtime_error(openssl_error("Cannot write " + path));
+        }
+    };
+    write_pem(certificate_path, 0644,
+              [&](FILE *file) { return PEM_write_X509(file, cert) == 1; });
+    write_pem(key_path, 0600, [&](FILE *file) {
+        return PEM_write_PrivateKey(file, key.get(), nullptr, nullptr, 0,
+                                    nullptr, nullptr) == 1;
+    });
+}
+
+/////////////////////////////////
+// TLS Session
+/////////////////////////////////
+
+TlsSession::TlsSession(const TlsContext &context, int fd,
+                       const std::string &server_name)
+    : ssl(SSL_new(context.native())) {
+    if (ssl == nullptr || SSL_set_fd(ssl, fd) != 1) {
+        SSL_free(ssl);
+        throw std::runtime_error(openssl_error("Cannot create TLS session"));
+    }
+    if (context.is_server()) {
+        SSL_set_accept_state(ssl);
+        return;
+    }
+
+    SSL_set_connect_state(ssl);
+    if (server_name.empty()) {
+        return;
+    }
+    int checked;
+    if (is_ip_address(server_name)) {
+        checked = X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl),
+                                                server_name.c_str());
+    } else {
+        checked = SSL_set_tlsext_host_name(ssl, server_name.c_str()) == 1 &&
+                  SSL_set1_host(ssl, server_name.c_str()) == 1;
+    }
+    if (checked != 1) {
+        SSL_free(ssl);
+        throw std::runtime_error(
+            openssl_error("Invalid TLS server name " + server_name));
+    }
+}
+
+TlsSession::~TlsSession() { SSL_free(ssl); }
+
+TlsSession::Status TlsSession::handshake() {
+    if (handshake_done) {
+        return Status::DONE;
+    }
+    ERR_clear_error();
+    int result = SSL_do_handshake(ssl);
+    if (result == 1) {
+        handshake_done = true;
+        return Status::DONE;
+    }
+    switch (SSL_get_error(ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+        return Status::WANT_READ;
+    case SSL_ERROR_WANT_WRITE:
+        return Status::WANT_WRITE;
+    default:
+        last_error = openssl_error("TLS handshake failed");
+        if (SSL_get_verify_result(ssl) != X509_V_OK) {
+            last_error += std::string(" (") +
+                          X509_verify_cert_error_string(
+                              SSL_get_verify_result(ssl)) +
+                          ")";
+        }
+        return Status::FAILED;
+    }
+}
+
+ssize_t TlsSession::fail(int result) {
+    switch (SSL_get_error(ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        errno = EAGAIN;
+        return -1;
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        // A plain EOF without close_notify; errno is left as is otherwise.
+        if (ERR_peek_error() == 0 && errno == 0) {
+            return 0;
+        }
+        last_error = openssl_error("TLS I/O failed");
+        return -1;
+    default:
+        last_error = openssl_error("TLS protocol error");
+        errno = EIO;
+        return -1;
+    }
+}
+
+ssize_t TlsSession::read(char *buffer, size_t size) {
+    ERR_clear_error();
+    errno = 0;
+    int result = SSL_read(ssl, buffer, static_cast<int>(std::min<size_t>(
+                                           size, INT_MAX)));
+    return result > 0 ? result : fail(result);
+}
+
+ssize_t TlsSession::write(const char *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    ERR_clear_error();
+    errno = 0;
+    int result = SSL_write(ssl, data, static_cast<int>(std::min<size_t>(
+                                          size, INT_MAX)));
+    return result > 0 ? result : fail(result);
+}
+
+bool TlsSession::has_buffered_input() const { return SSL_has_pending(ssl); }
+
+bool TlsSession::kernel_send() const {
+    return handshake_done && BIO_get_ktls_send(SSL_get_wbio(ssl));
+}
+
+bool TlsSession::kernel_receive() const {
+    return handshake_done && BIO_get_ktls_recv(SSL_get_rbio(ssl));
+}
+
+std::string TlsSession::protocol() const { return SSL_get_version(ssl); }
+
+std::string TlsSession::cipher() const {
+    const char *name = SSL_get_cipher_name(ssl);
+    return name ? name : "";
+}
+
+void TlsSession::shutdown() {
+    if (handshake_done) {
+        ERR_clear_error();
+        SSL_shutdown(ssl);
+    }
+}
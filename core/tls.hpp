@@ -0,0 +1,110 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+/////////////////////////////////
+// TLS Context
+/////////////////////////////////
+
+// OpenSSL configuration shared by every connection on one side. Both sides
+// ask OpenSSL for kernel TLS (SSL_OP_ENABLE_KTLS): once the handshake is
+// done the session keys are installed on the socket, and the kernel then
+// encrypts whatever is written to the fd. OpenSSL only does that for
+// ciphers the kernel implements (AES-GCM, ChaCha20-Poly1305). Without the
+// "tls" kernel module, or for other ciphers, records are encrypted by
+// OpenSSL in userspace instead; TlsSession::kernel_send() tells which.
+class TlsContext {
+  public:
+    // PEM certificate chain and private key. Throws std::runtime_error if
+    // either cannot be loaded or they do not match.
+    static TlsContext server(const std::string &certificate_path,
+                             const std::string &key_path);
+
+    // Verifies the server against the PEM certificates in `ca_path`, or the
+    // system trust store when it is empty. Throws std::runtime_error.
+    static TlsContext client(const std::string &ca_path = "");
+
+    ssl_ctx_st *native() const { return context.get(); }
+    bool is_server() const { return server_side; }
+
+  private:
+    TlsContext(ssl_ctx_st *context, bool server_side);
+
+    std::shared_ptr<ssl_ctx_st> context;
+    bool server_side;
+};
+
+// Writes a fresh self-signed certificate for `host` (as CN and DNS
+// subjectAltName) and its key, both PEM. Enough for loopback testing; a
+// client trusts it by passing `certificate_path` as its CA file. Throws
+// std::runtime_error.
+void write_self_signed_certificate(const std::string &certificate_path,
+                                   const std::string &key_path,
+                                   const std::string &host = "localhost");
+
+/////////////////////////////////
+// TLS Session
+/////////////////////////////////
+
+// TLS on one connected socket, blocking or not. read() and write() follow
+// recv()/send(): bytes moved, 0 on close_notify or EOF from read(), or -1
+// with errno set to EAGAIN when the socket would block and EIO on a TLS
+// error.
+//
+// Reads always go through OpenSSL, which also handles the handshake and
+// alert records the kernel does not. Writes may bypass it: once
+// kernel_send() is true, write()/writev() straight on the fd produce TLS
+// records, so OutputQueue::flush(fd) keeps its single writev() per batch
+// and borrowed segments are never copied into userspace buffers.
+class TlsSession {
+  public:
+    enum class Status { DONE, WANT_READ, WANT_WRITE, FAILED };
+
+    // `server_name` is sent as SNI and checked against the certificate on
+    // the client side.
+    TlsSession(const TlsContext &context, int fd,
+               const std::string &server_name = "");
+    ~TlsSession();
+    TlsSession(const TlsSession &) = delete;
+    TlsSession &operator=(const TlsSession &) = delete;
+
+    // Advances the handshake. On a non-blocking socket, call again when
+    // the fd is readable (WANT_READ) or writable (WANT_WRITE).
+    Status handshake();
+    bool established() const { return handshake_done; }
+
+    ssize_t read(char *buffer, size_t size);
+    ssize_t write(const char *data, size_t size);
+
+    // Decrypted bytes OpenSSL holds that poll() cannot see on the fd.
+    bool has_buffered_input() const;
+
+    bool kernel_send() const;
+    bool kernel_receive() const;
+    std::string protocol() const;
+    std::string cipher() const;
+
+    // Why the last operation failed, from the OpenSSL error queue.
+    const std::string &error() const { return last_error; }
+
+    // Sends close_notify, without waiting for the peer's.
+    void shutdown();
+
+  private:
+    ssize_t fail(int result);
+
+    ssl_st *ssl;
+    bool handshake_done = false;
+    std::string last_error;
+};
@@ -0,0 +1,302 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "tracing.hpp"
+
+/////////////////////////////////
+// TSC Clock
+/////////////////////////////////
+
+uint64_t TscClock::fallback_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+namespace {
+
+struct Calibration {
+    double ticks_per_ns = 1.0;
+    uint64_t anchor_ticks = 0;
+    uint64_t anchor_unix_ns = 0;
+};
+
+// Measured once, on first use: the tick rate over a 20ms sleep, and the
+// wall-clock time of one tick value to anchor absolute timestamps.
+// RequestTracer's constructor makes that first use, at startup, so the
+// sleep never lands on a thread serving requests.
+const Calibration &calibration() {
+    static const Calibration result = [] {
+        Calibration c;
+        auto steady_start = std::chrono::steady_clock::now();
+        uint64_t ticks_start = TscClock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto steady_end = std::chrono::steady_clock::now();
+        uint64_t ticks_end = TscClock::now();
+
+        double elapsed_ns = std::chrono::duration<double, std::nano>(
+                                steady_end - steady_start)
+                                .count();
+        if (elapsed_ns > 0 && ticks_end > ticks_start) {
+            c.ticks_per_ns = (ticks_end - ticks_start) / elapsed_ns;
+        }
+        c.anchor_ticks = ticks_end;
+        c.anchor_unix_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        return c;
+    }();
+    return result;
+}
+
+}  // namespace
+
+double TscClock::ticks_per_ns() { return calibration().ticks_per_ns; }
+
+uint64_t TscClock::to_ns(uint64_t ticks) {
+    return static_cast<uint64_t>(
+        std::llround(ticks / calibration().ticks_per_ns));
+}
+
+uint64_t TscClock::to_unix_ns(uint64_t ticks) {
+    const Calibration &c = calibration();
+    double offset_ns = (static_cast<double>(ticks) -
+                        static_cast<double>(c.anchor_ticks)) /
+                       c.ticks_per_ns;
+    return static_cast<uint64_t>(static_cast<double>(c.anchor_unix_ns) +
+                                 offset_ns);
+}
+
+/////////////////////////////////
+// Request Traces
+/////////////////////////////////
+
+struct PhaseSpan {
+    const char *name;
+    TraceMark start;
+    TraceMark end;
+};
+
+static constexpr PhaseSpan phase_spans[] = {
+    {"accept", TraceMark::ACCEPT_START, TraceMark::ACCEPT_END},
+    {"read", TraceMark::FIRST_BYTE, TraceMark::COMPLETE},
+    {"parse", TraceMark::COMPLETE, TraceMark::PARSED},
+    {"handler", TraceMark::PARSED, TraceMark::HANDLED},
+    {"serialize", TraceMark::HANDLED, TraceMark::SERIALIZED},
+    {"send", TraceMark::SERIALIZED, TraceMark::SENT},
+};
+
+static uint64_t first_mark(const RequestTrace &trace) {
+    for (uint64_t mark : trace.marks) {
+        if (mark) {
+            return mark;
+        }
+    }
+    return 0;
+}
+
+static uint64_t last_mark(const RequestTrace &trace) {
+    uint64_t last = 0;
+    for (uint64_t mark : trace.marks) {
+        last = std::max(last, mark);
+    }
+    return last;
+}
+
+uint64_t RequestTrace::duration_ns() const {
+    return TscClock::to_ns(last_mark(*this) - first_mark(*this));
+}
+
+RequestTracer::RequestTracer(TracerOptions options)
+    : options(options),
+      random_state(TscClock::now() | 1) {
+    ring.reserve(options.capacity);
+    TscClock::ticks_per_ns();
+}
+
+// xorshift64: good enough to pick a sample, and costs a few instructions.
+bool RequestTracer::sampled() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return static_cast<double>(random_state >> 11) * 0x1.0p-53 <
+           options.sample_fraction;
+}
+
+bool RequestTracer::finish(const RequestTrace &trace) {
+    ++seen;
+    if (options.capacity == 0) {
+        return false;
+    }
+    bool slow = trace.duration_ns() >= options.slow_threshold_us * 1000;
+    if (!slow && !sampled()) {
+        return false;
+    }
+
+    ++kept_count;
+    if (ring.size() < options.capacity) {
+        ring.push_back(trace);
+    } else {
+        ring[next] = trace;
+    }
+    next = (next + 1) % options.capacity;
+    return true;
+}
+
+std::vector<RequestTrace> RequestTracer::snapshot() const {
+    if (ring.size() < options.capacity) {
+        return ring;
+    }
+    std::vector<RequestTrace> ordered(ring.begin() + next, ring.end());
+    ordered.insert(ordered.end(), ring.begin(), ring.begin() + next);
+    return ordered;
+}
+
+void RequestTracer::clear() {
+    ring.clear();
+    next = 0;
+}
+
+/////////////////////////////////
+// Export
+/////////////////////////////////
+
+static std::string json_escape(const std::string &value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string hex_id(uint64_t high, uint64_t low, bool wide) {
+    char buffer[33];
+    if (wide) {
+        std::snprintf(buffer, sizeof(buffer), "%016llx%016llx",
+                      static_cast<unsigned long long>(high),
+                      static_cast<unsigned long long>(low));
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%016llx",
+                      static_cast<unsigned long long>(low));
+    }
+    return buffer;
+}
+
+void RequestTracer::write_chrome_trace(std::ostream &out) const {
+    std::vector<RequestTrace> traces = snapshot();
+    uint64_t base = UINT64_MAX;
+    for (const RequestTrace &trace : traces) {
+        base = std::min(base, first_mark(trace));
+    }
+
+    auto microseconds = [base](uint64_t ticks) {
+        return static_cast<double>(TscClock::to_ns(ticks - base)) / 1000.0;
+    };
+
+    char number[64];
+    auto event = [&](const char *name, const RequestTrace &trace,
+                     uint64_t start, uint64_t end, bool root) {
+        std::snprintf(number, sizeof(number), "%.3f", microseconds(start));
+        out << "{\"name\":\"" << name << "\",\"cat\":\"http\",\"ph\":\"X\""
+            << ",\"ts\":" << number;
+        std::snprintf(number, sizeof(number), "%.3f",
+                      static_cast<double>(TscClock::to_ns(end - start)) /
+                          1000.0);
+        out << ",\"dur\":" << number << ",\"pid\":1,\"tid\":"
+            << trace.connection_id;
+        if (root) {
+            out << ",\"args\":{\"method\":\"" << json_escape(trace.method)
+                << "\",\"route\":\"" << json_escape(trace.route)
+                << "\",\"status\":" << trace.status << "}";
+        }
+        out << "}";
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const RequestTrace &trace : traces) {
+        out << (first ? "" : ",");
+        first = false;
+        event("request", trace, first_mark(trace), last_mark(trace), true);
+        for (const PhaseSpan &phase : phase_spans) {
+            uint64_t start = trace.at(phase.start);
+            uint64_t end = trace.at(phase.end);
+            if (start && end >= start) {
+                out << ",";
+                event(phase.name, trace, start, end, false);
+            }
+        }
+    }
+    out << "]}\n";
+}
+
+void RequestTracer::write_otlp_json(std::ostream &out) const {
+    std::vector<RequestTrace> traces = snapshot();
+
+    auto span = [&out](const std::string &trace_id, uint64_t span_id,
+                       uint64_t parent_id, const char *name, int kind,
+                       uint64_t start, uint64_t end) {
+        out << "{\"traceId\":\"" << trace_id << "\",\"spanId\":\""
+            << hex_id(0, span_id, false) << "\"";
+        if (parent_id) {
+            out << ",\"parentSpanId\":\"" << hex_id(0, parent_id, false)
+                << "\"";
+        }
+        out << ",\"name\":\"" << name << "\",\"kind\":" << kind
+            << ",\"startTimeUnixNano\":\"" << TscClock::to_unix_ns(start)
+            << "\",\"endTimeUnixNano\":\"" << TscClock::to_unix_ns(end)
+            << "\"";
+    };
+
+    out << "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":"
+           "\"service.name\",\"value\":{\"stringValue\":\"web_sockets_"
+           "server\"}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"server\"},"
+           "\"spans\":[";
+    bool first = true;
+    for (const RequestTrace &trace : traces) {
+        std::string trace_id = hex_id(trace.connection_id, first_mark(trace),
+                                      true);
+
+        out << (first ? "" : ",");
+        first = false;
+        // Span kind 2 is SERVER, 1 is INTERNAL.
+        span(trace_id, 1, 0, "request", 2, first_mark(trace),
+             last_mark(trace));
+        out << ",\"attributes\":["
+            << "{\"key\":\"http.request.method\",\"value\":{\"stringValue\":\""
+            << json_escape(trace.method) << "\"}},"
+            << "{\"key\":\"http.route\",\"value\":{\"stringValue\":\""
+            << json_escape(trace.route) << "\"}},"
+            << "{\"key\":\"http.response.status_code\",\"value\":"
+            << "{\"intValue\":\"" << trace.status << "\"}}]}";
+
+        uint64_t span_id = 2;
+        for (const PhaseSpan &phase : phase_spans) {
+            uint64_t start = trace.at(phase.start);
+            uint64_t end = trace.at(phase.end);
+            if (start && end >= start) {
+                out << ",";
+                span(trace_id, span_id++, 1, phase.name, 1, start, end);
+                out << "}";
+            }
+        }
+    }
+    out << "]}]}]}\n";
+}
@@ -0,0 +1,130 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/////////////////////////////////
+// TSC Clock
+/////////////////////////////////
+
+// Cycle-counter timestamps for phase timing. Reading the TSC is a single
+// instruction with no syscall or vDSO call, so a request can be stamped at
+// every phase boundary without the stamping showing up in its latency.
+// Ticks are converted to nanoseconds only when traces are exported, using
+// a rate calibrated once against steady_clock. Other architectures fall
+// back to steady_clock nanoseconds (one tick per ns).
+class TscClock {
+  public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return fallback_now();
+#endif
+    }
+
+    // The first conversion calibrates the clock, which takes 20ms.
+    static double ticks_per_ns();
+    static uint64_t to_ns(uint64_t ticks);
+    // Wall-clock time of a tick value, for exporters that need absolute
+    // timestamps.
+    static uint64_t to_unix_ns(uint64_t ticks);
+
+  private:
+    static uint64_t fallback_now();
+};
+
+/////////////////////////////////
+// Request Traces
+/////////////////////////////////
+
+// Timestamps taken at the phase boundaries of one request. A zero mark was
+// not taken (ACCEPT_* is only set for the first request on a connection).
+enum class TraceMark {
+    ACCEPT_START,  // accept() called
+    ACCEPT_END,    // connection set up and registered
+    FIRST_BYTE,    // first byte of the request read
+    COMPLETE,      // whole request buffered
+    PARSED,        // HttpRequest::parse done
+    HANDLED,       // handler / cache lookup produced the response
+    SERIALIZED,    // response bytes queued for the client
+    SENT,          // last response byte accepted by the kernel
+    COUNT,
+};
+
+struct RequestTrace {
+    uint64_t connection_id = 0;
+    std::string method;
+    std::string route;
+    int status = 0;
+    std::array<uint64_t, static_cast<size_t>(TraceMark::COUNT)> marks{};
+
+    void mark(TraceMark which) {
+        marks[static_cast<size_t>(which)] = TscClock::now();
+    }
+    uint64_t at(TraceMark which) const {
+        return marks[static_cast<size_t>(which)];
+    }
+
+    // First mark taken to the last, normally SENT, in nanoseconds.
+    uint64_t duration_ns() const;
+};
+
+struct TracerOptions {
+    // Requests at least this slow are always kept.
+    uint64_t slow_threshold_us = 10'000;
+    // Fraction of all other requests kept, for a baseline to compare with.
+    double sample_fraction = 0.01;
+    // Kept traces live in a ring buffer of this many entries; the oldest
+    // is overwritten.
+    size_t capacity = 4096;
+};
+
+// Tail-based sampler: the keep/drop decision is made once a request has
+// finished and its total latency is known, so every slow request is kept
+// no matter how rare, while fast ones are only sampled. Not thread-safe;
+// the server's I/O thread owns it.
+class RequestTracer {
+  public:
+    explicit RequestTracer(TracerOptions options = {});
+
+    // Returns true when the trace was kept.
+    bool finish(const RequestTrace &trace);
+
+    uint64_t finished() const { return seen; }
+    uint64_t kept() const { return kept_count; }
+
+    // Kept traces, oldest first.
+    std::vector<RequestTrace> snapshot() const;
+    void clear();
+
+    // Chrome trace event format (chrome://tracing, Perfetto): one row per
+    // connection, a "request" slice with one child slice per phase.
+    void write_chrome_trace(std::ostream &out) const;
+
+    // OTLP/JSON ExportTraceServiceRequest: one trace per request with a
+    // root span and a child span per phase.
+    void write_otlp_json(std::ostream &out) const;
+
+  private:
+    bool sampled();
+
+    TracerOptions options;
+    std::vector<RequestTrace> ring;
+    size_t next = 0;
+    uint64_t seen = 0;
+    uint64_t kept_count = 0;
+    uint64_t random_state;
+};
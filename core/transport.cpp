@@ -0,0 +1,206 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "transport.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <netdb.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/////////////////////////////////
+// Endpoints
+/////////////////////////////////
+
+Endpoint Endpoint::tcp(std::string host, uint16_t port) {
+    Endpoint endpoint;
+    endpoint.host = std::move(host);
+    endpoint.port = port;
+    return endpoint;
+}
+
+Endpoint Endpoint::unix_socket(std::string path) {
+    Endpoint endpoint;
+    endpoint.kind = Kind::UNIX;
+    endpoint.path = std::move(path);
+    return endpoint;
+}
+
+Endpoint Endpoint::parse(const std::string &text) {
+    if (text.rfind("unix:", 0) == 0) {
+        if (text.size() == 5) {
+            throw std::runtime_error("Missing socket path in " + text);
+        }
+        return unix_socket(text.substr(5));
+    }
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon + 1 == text.size()) {
+        throw std::runtime_error("Expected host:port, got " + text);
+    }
+    std::string host = text.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    size_t parsed = 0;
+    unsigned long port = 0;
+    try {
+        port = std::stoul(text.substr(colon + 1), &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed != text.size() - colon - 1 || port > 65535) {
+        throw std::runtime_error("Invalid port in " + text);
+    }
+    return tcp(host, static_cast<uint16_t>(port));
+}
+
+std::string Endpoint::to_string() const {
+    if (kind == Kind::UNIX) {
+        return "unix:" + path;
+    }
+    if (host.find(':') != std::string::npos) {
+        return "[" + host + "]:" + std::to_string(port);
+    }
+    return host + ":" + std::to_string(port);
+}
+
+namespace {
+
+SocketAddress unix_address(const std::string &path) {
+    SocketAddress address;
+    auto &un = reinterpret_cast<sockaddr_un &>(address.storage);
+    // sun_path needs no terminator for abstract names, but does for files.
+    size_t limit = path[0] == '@' ? sizeof(un.sun_path)
+                                  : sizeof(un.sun_path) - 1;
+    if (path.size() > limit) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    un.sun_family = AF_UNIX;
+    std::memcpy(un.sun_path, path.data(), path.size());
+    address.length =
+        static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+    if (path[0] == '@') {
+        // The abstract name is exactly the bytes after the NUL, so the
+        // length must not include a terminator.
+        un.sun_path[0] = '\0';
+    } else {
+        address.length += 1;
+    }
+    return address;
+}
+
+// True when something accepts connections at `address`.
+bool is_served(const SocketAddress &address) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        return false;
+    }
+    bool served = connect(probe, address.get(), address.length) == 0 ||
+                  errno != ECONNREFUSED;
+    close(probe);
+    return served;
+}
+
+}  // namespace
+
+std::vector<SocketAddress> resolve(const Endpoint &endpoint) {
+    if (endpoint.kind == Endpoint::Kind::UNIX) {
+        if (endpoint.path.empty()) {
+            throw std::runtime_error("Empty socket path");
+        }
+        return {unix_address(endpoint.path)};
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    // Skips IPv6 results on hosts without IPv6 configured, and vice versa.
+    hints.ai_flags = AI_ADDRCONFIG;
+    std::string port = std::to_string(endpoint.port);
+    struct addrinfo *result = nullptr;
+    int status =
+        getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0) {
+        throw std::runtime_error("Failed to resolve " + endpoint.host + ": " +
+                                 gai_strerror(status));
+    }
+    std::vector<SocketAddress> addresses;
+    for (struct addrinfo *rp = result; rp != nullptr; rp = rp->ai_next) {
+        SocketAddress address;
+        std::memcpy(&address.storage, rp->ai_addr, rp->ai_addrlen);
+        address.length = rp->ai_addrlen;
+        addresses.push_back(address);
+    }
+    freeaddrinfo(result);
+    return addresses;
+}
+
+int connect_socket(const std::vector<SocketAddress> &addresses) {
+    int error = EADDRNOTAVAIL;
+    for (const SocketAddress &address : addresses) {
+        int fd = socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            error = errno;
+            continue;
+        }
+        if (connect(fd, address.get(), address.length) == 0) {
+            return fd;
+        }
+        error = errno;
+        close(fd);
+    }
+    errno = error;
+    return -1;
+}
+
+int open_listener(const Endpoint &endpoint, const ListenerOptions &options) {
+    if (endpoint.kind == Endpoint::Kind::TCP) {
+        return open_tcp_listener(endpoint.port, options);
+    }
+
+    SocketAddress address = resolve(endpoint).front();
+    if (!endpoint.is_abstract()) {
+        // A server that exits leaves its socket file behind, and bind()
+        // refuses to reuse it.
+        struct stat status;
+        if (stat(endpoint.path.c_str(), &status) == 0 &&
+            S_ISSOCK(status.st_mode)) {
+            if (is_served(address)) {
+                throw std::runtime_error("Socket " + endpoint.path +
+                                         " is in use");
+            }
+            unlink(endpoint.path.c_str());
+        }
+    }
+
+    int listen_fd =
+        socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        throw std::runtime_error(std::string("Failed to create socket: ") +
+                                 std::strerror(errno));
+    }
+    if (bind(listen_fd, address.get(), address.length) < 0 ||
+        listen(listen_fd, options.backlog) < 0) {
+        int error = errno;
+        close(listen_fd);
+        throw std::runtime_error("Failed to listen on " +
+                                 endpoint.to_string() + ": " +
+                                 std::strerror(error));
+    }
+    return listen_fd;
+}
+
+int socket_family(int socket_fd) {
+    struct sockaddr_storage address = {};
+    socklen_t length = sizeof(address);
+    if (getsockname(socket_fd, reinterpret_cast<struct sockaddr *>(&address),
+                    &length) < 0) {
+        return AF_UNSPEC;
+    }
+    return address.ss_family;
+}
@@ -0,0 +1,72 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+#include "listener.hpp"
+
+/////////////////////////////////
+// Endpoints
+/////////////////////////////////
+
+// Where a stream socket listens or connects: a TCP host and port, or a UNIX
+// domain socket. A UNIX path starting with '@' names a socket in the
+// abstract namespace, which has no file, disappears with its last fd and
+// is reachable from the same network namespace only.
+struct Endpoint {
+    enum class Kind { TCP, UNIX };
+
+    Kind kind = Kind::TCP;
+    std::string host;
+    uint16_t port = 0;
+    std::string path;
+
+    static Endpoint tcp(std::string host, uint16_t port);
+    static Endpoint unix_socket(std::string path);
+
+    // "unix:/run/app.sock", "unix:@app" or "host:port"; "[::1]:8080" for
+    // IPv6. Throws std::runtime_error for anything else.
+    static Endpoint parse(const std::string &text);
+
+    bool is_abstract() const {
+        return kind == Kind::UNIX && !path.empty() && path[0] == '@';
+    }
+
+    // The inverse of parse().
+    std::string to_string() const;
+};
+
+struct SocketAddress {
+    sockaddr_storage storage = {};
+    socklen_t length = 0;
+
+    const sockaddr *get() const {
+        return reinterpret_cast<const sockaddr *>(&storage);
+    }
+    int family() const { return storage.ss_family; }
+};
+
+// Every address a TCP endpoint's host resolves to, in the order to try
+// them, or the one address of a UNIX endpoint. Throws std::runtime_error
+// if the host does not resolve or the path does not fit a sockaddr_un.
+std::vector<SocketAddress> resolve(const Endpoint &endpoint);
+
+// A blocking, close-on-exec stream socket connected to the first of
+// `addresses` that accepts; -1 with errno set when none does.
+int connect_socket(const std::vector<SocketAddress> &addresses);
+
+// Non-blocking listening socket for `endpoint`. TCP goes through
+// open_tcp_listener(), on every interface; a UNIX socket only uses the
+// backlog. A socket file left behind by a server that is gone is
+// replaced, one still being served is not. Throws std::runtime_error.
+int open_listener(const Endpoint &endpoint,
+                  const ListenerOptions &options = {});
+
+// AF_INET, AF_INET6 or AF_UNIX for a socket; AF_UNSPEC if it has none.
+int socket_family(int socket_fd);
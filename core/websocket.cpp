@@ -0,0 +1,261 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "string_utils.hpp"
+#include "websocket.hpp"
+
+/////////////////////////////////
+// WebSocket Handshake
+/////////////////////////////////
+
+static uint32_t rotate_left(uint32_t value, unsigned bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+std::array<uint8_t, 20> sha1(std::string_view data) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                     0xC3D2E1F0};
+
+    // Message, a 0x80 byte, zero padding to 56 mod 64, then the bit length.
+    std::string message(data);
+    uint64_t bit_length = static_cast<uint64_t>(data.size()) * 8;
+    message += static_cast<char>(0x80);
+    while (message.size() % 64 != 56) {
+        message += '\0';
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        message += static_cast<char>(bit_length >> shift);
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto *bytes = reinterpret_cast<const uint8_t *>(
+                message.data() + chunk + i * 4);
+            w[i] = uint32_t{bytes[0]} << 24 | uint32_t{bytes[1]} << 16 |
+                   uint32_t{bytes[2]} << 8 | uint32_t{bytes[3]};
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate_left(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+    return digest;
+}
+
+std::string websocket_accept_key(const std::string &client_key) {
+    static constexpr std::string_view guid =
+        "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    auto digest = sha1(client_key + std::string(guid));
+    return base64_encode(std::string_view(
+        reinterpret_cast<const char *>(digest.data()), digest.size()));
+}
+
+static bool contains_token(std::string value, std::string_view token) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return value.find(token) != std::string::npos;
+}
+
+bool is_websocket_upgrade(const HttpRequest &request) {
+    return request.method == "GET" &&
+           contains_token(request.get_header("upgrade"), "websocket") &&
+           contains_token(request.get_header("connection"), "upgrade") &&
+           !request.get_header("sec-websocket-key").empty() &&
+           request.get_header("sec-websocket-version") == "13";
+}
+
+/////////////////////////////////
+// WebSocket Framing
+/////////////////////////////////
+
+// XORs `size` bytes with the repeating 4-byte masking key.
+static void apply_mask(char *data, size_t size, const uint8_t key[4]) {
+    size_t i = 0;
+    // Eight bytes at a time; the key repeats every 4 so it tiles evenly.
+    uint64_t wide_key;
+    uint8_t repeated[8] = {key[0], key[1], key[2], key[3],
+                           key[0], key[1], key[2], key[3]};
+    std::memcpy(&wide_key, repeated, sizeof(wide_key));
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        word ^= wide_key;
+        std::memcpy(data + i, &word, sizeof(word));
+    }
+    for (; i < size; ++i) {
+        data[i] ^= key[i % 4];
+    }
+}
+
+std::string encode_websocket_frame(WebSocketOpcode opcode,
+                                   std::string_view payload, bool mask,
+                                   uint32_t masking_key) {
+    std::string frame;
+    frame.reserve(payload.size() + 14);
+
+    frame += static_cast<char>(0x80 | static_cast<uint8_t>(opcode));
+    uint8_t mask_bit = mask ? 0x80 : 0x00;
+    if (payload.size() < 126) {
+        frame += static_cast<char>(mask_bit | payload.size());
+    } else if (payload.size() <= 0xFFFF) {
+        frame += static_cast<char>(mask_bit | 126);
+        frame += static_cast<char>(payload.size() >> 8);
+        frame += static_cast<char>(payload.size());
+    } else {
+        frame += static_cast<char>(mask_bit | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame += static_cast<char>(static_cast<uint64_t>(payload.size()) >>
+                                       shift);
+        }
+    }
+
+    if (!mask) {
+        frame.append(payload);
+        return frame;
+    }
+
+    uint8_t key[4] = {static_cast<uint8_t>(masking_key >> 24),
+                      static_cast<uint8_t>(masking_key >> 16),
+                      static_cast<uint8_t>(masking_key >> 8),
+                      static_cast<uint8_t>(masking_key)};
+    frame.append(reinterpret_cast<const char *>(key), 4);
+    size_t payload_start = frame.size();
+    frame.append(payload);
+    apply_mask(frame.data() + payload_start, payload.size(), key);
+    return frame;
+}
+
+std::string encode_websocket_close(uint16_t code, std::string_view reason) {
+    std::string payload;
+    payload += static_cast<char>(code >> 8);
+    payload += static_cast<char>(code);
+    payload.append(reason.substr(0, 123));
+    return encode_websocket_frame(WebSocketOpcode::CLOSE, payload);
+}
+
+size_t websocket_frame_header(std::string_view data,
+                              uint64_t &payload_length) {
+    if (data.size() < 2) {
+        return 0;
+    }
+    payload_length = static_cast<uint8_t>(data[1]) & 0x7F;
+    size_t size = 2;
+    if (payload_length == 126) {
+        if (data.size() < size + 2) {
+            return 0;
+        }
+        payload_length = uint64_t{static_cast<uint8_t>(data[2])} << 8 |
+                         static_cast<uint8_t>(data[3]);
+        size += 2;
+    } else if (payload_length == 127) {
+        if (data.size() < size + 8) {
+            return 0;
+        }
+        payload_length = 0;
+        for (int i = 0; i < 8; ++i) {
+            payload_length =
+                payload_length << 8 | static_cast<uint8_t>(data[2 + i]);
+        }
+        size += 8;
+    }
+    if (static_cast<uint8_t>(data[1]) & 0x80) {
+        size += 4;
+    }
+    return data.size() < size ? 0 : size;
+}
+
+size_t decode_websocket_frame(std::string_view data, WebSocketFrame &frame,
+                              bool require_mask) {
+    if (data.size() < 2) {
+        return 0;
+    }
+
+    uint8_t first = static_cast<uint8_t>(data[0]);
+    uint8_t second = static_cast<uint8_t>(data[1]);
+    if (first & 0x70) {
+        throw std::runtime_error("WebSocket frame uses reserved bits");
+    }
+
+    uint8_t opcode = first & 0x0F;
+    bool control = opcode & 0x08;
+    if ((opcode > 0x2 && opcode < 0x8) || opcode > 0xA) {
+        throw std::runtime_error("Unknown WebSocket opcode");
+    }
+
+    bool fin = first & 0x80;
+    bool masked = second & 0x80;
+
+    if (require_mask && !masked) {
+        throw std::runtime_error("Unmasked WebSocket frame from a client");
+    }
+
+    if (control && (!fin || (second & 0x7F) > 125)) {
+        throw std::runtime_error("Malformed WebSocket control frame");
+    }
+
+    uint64_t length;
+    size_t offset = websocket_frame_header(data, length);
+    if (offset == 0) {
+        return 0;
+    }
+
+    uint8_t key[4] = {};
+    if (masked) {
+        std::memcpy(key, data.data() + offset - 4, 4);
+    }
+
+    if (data.size() - offset < length) {
+        return 0;
+    }
+
+    frame.fin = fin;
+    frame.opcode = static_cast<WebSocketOpcode>(opcode);
+    frame.payload.assign(data.data() + offset, length);
+    if (masked) {
+        apply_mask(frame.payload.data(), frame.payload.size(), key);
+    }
+    return offset + length;
+}
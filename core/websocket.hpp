@@ -0,0 +1,80 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "http.hpp"
+
+/////////////////////////////////
+// WebSocket Handshake
+/////////////////////////////////
+
+// SHA-1 digest; only used for the RFC 6455 accept key, not for security.
+std::array<uint8_t, 20> sha1(std::string_view data);
+
+// Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key:
+// base64(sha1(key + the RFC 6455 GUID)).
+std::string websocket_accept_key(const std::string &client_key);
+
+// GET with `Upgrade: websocket`, a Connection header containing "upgrade",
+// a Sec-WebSocket-Key and version 13.
+bool is_websocket_upgrade(const HttpRequest &request);
+
+/////////////////////////////////
+// WebSocket Framing
+/////////////////////////////////
+
+enum class WebSocketOpcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xA,
+};
+
+struct WebSocketFrame {
+    bool fin = true;
+    WebSocketOpcode opcode = WebSocketOpcode::TEXT;
+    std::string payload;  // already unmasked
+};
+
+// Close status codes used by the server (RFC 6455 section 7.4.1).
+constexpr uint16_t WS_CLOSE_NORMAL = 1000;
+constexpr uint16_t WS_CLOSE_GOING_AWAY = 1001;
+constexpr uint16_t WS_CLOSE_PROTOCOL_ERROR = 1002;
+constexpr uint16_t WS_CLOSE_POLICY_VIOLATION = 1008;
+constexpr uint16_t WS_CLOSE_MESSAGE_TOO_BIG = 1009;
+// The client should reconnect; another process is taking over.
+constexpr uint16_t WS_CLOSE_SERVICE_RESTART = 1012;
+
+// Encodes a single final frame. Servers send unmasked frames; clients must
+// mask theirs with a 32-bit key.
+std::string encode_websocket_frame(WebSocketOpcode opcode,
+                                   std::string_view payload,
+                                   bool mask = false,
+                                   uint32_t masking_key = 0);
+
+std::string encode_websocket_close(uint16_t code,
+                                   std::string_view reason = "");
+
+// Decodes the first frame in `data` into `frame` and returns the number of
+// bytes it occupied, or 0 while the frame is incomplete. Throws
+// std::runtime_error on reserved bits, unknown opcodes or malformed control
+// frames, and with `require_mask` on unmasked frames, which a server must
+// refuse from its clients (RFC 6455 section 5.1).
+size_t decode_websocket_frame(std::string_view data, WebSocketFrame &frame,
+                              bool require_mask = false);
+
+// Size of the first frame's header in `data`, masking key included, with
+// its payload length in `payload_length`; 0 while the header is incomplete.
+// Nothing is validated, which is left to decode_websocket_frame().
+size_t websocket_frame_header(std::string_view data,
+                              uint64_t &payload_length);
@@ -2,145 +2,1739 @@
 //
 //
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <deque>
 #include <fcntl.h>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <netinet/in.h>
-#include <sys/select.h>
+#include <optional>
+#include <poll.h>
+#include <set>
+#include <signal.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
 
+#include "../core/admission.hpp"
+#include "../core/buffer_pool.hpp"
+#include "../core/capture.hpp"
+#include "../core/compression.hpp"
+#include "../core/connection.hpp"
+#include "../core/executor.hpp"
+#include "../core/handoff.hpp"
 #include "../core/http.hpp"
+#include "../core/http2.hpp"
+#include "../core/listener.hpp"
 #include "../core/logger.hpp"
+#include "../core/metrics.hpp"
+#include "../core/multipart.hpp"
+#include "../core/output_queue.hpp"
+#include "../core/response_cache.hpp"
+#include "../core/sse.hpp"
+#include "../core/tls.hpp"
+#include "../core/tracing.hpp"
+#include "../core/transport.hpp"
+#include "../core/websocket.hpp"
 
-std::vector<int> client_fds;
-const int MAX_FD = FD_SETSIZE;
+ResponseCache response_cache;
 
-int main() {
-    Logger server_log("server.log");
+// Everything the server keeps per client socket. fds are reused by the
+// kernel as soon as they are closed, so offloaded work remembers the
+// connection id it was started for and drops its response if the fd now
+// belongs to someone else.
+struct Connection {
+    uint64_t id = 0;
+    // The client's address; rate limits are kept per address. Empty for
+    // clients on the UNIX socket.
+    std::string peer;
+
+    // HTTP/1.1 and WebSocket framing, with the input buffer and the output
+    // queue. Replaced on accept by one whose hooks route into this server.
+    // Offloaded requests are deferred on it, and a draining server waits
+    // for them before closing.
+    ServerConnection http{ServerConnection::Hooks{}};
+    bool reading_paused = false;
+    bool flush_scheduled = false;
+
+    // Set once the connection subscribed on GET /events; from then on it
+    // only receives events, and anything it sends is discarded. HTTP/1.0
+    // clients get a close-delimited stream instead of a chunked one.
+    bool event_stream = false;
+    bool event_stream_chunked = true;
+
+    // Set once the client sent the HTTP/2 connection preface or upgraded
+    // with "Upgrade: h2c"; from then on all input goes through it.
+    std::unique_ptr<Http2Connection> http2;
+
+    // Connections accepted on the TLS port. Until the handshake is done the
+    // fd is polled for whatever it last asked for, and nothing is parsed.
+    std::unique_ptr<TlsSession> tls;
+    bool handshake_wants_write = false;
+
+    // Phase timing. The accept marks belong to the first request only;
+    // `first_byte` is when the request now being received started to
+    // arrive. A trace waits in `traces` until the output queue has flushed
+    // past the last byte of its response.
+    uint64_t accept_started = 0;
+    uint64_t accept_finished = 0;
+    uint64_t first_byte = 0;
+    struct PendingTrace {
+        RequestTrace trace;
+        uint64_t sent_at_bytes;
+    };
+    std::deque<PendingTrace> traces;
+};
+
+std::map<int, Connection> connections;
+uint64_t next_connection_id = 0;
+
+// Every upgraded /ws connection. A data message from any of them is
+// broadcast to all the others.
+std::set<int> websocket_subscribers;
+constexpr size_t MAX_WEBSOCKET_MESSAGE = 1024 * 1024;
+
+// Every connection subscribed on GET /events. POST /events and WebSocket
+// text messages are published to `event_stream`, whose timerfd also paces
+// the heartbeats sent to all of them.
+EventStream event_stream;
+std::set<int> sse_subscribers;
+
+// Set by --body-memory-limit, --max-body-size and --spill-dir.
+BodyLimits body_limits;
+
+// Set by --backlog, --defer-accept, --fastopen, --reuse-port and
+// --incoming-cpu.
+ListenerOptions listener_options;
+
+// Set by --unix: sidecars on this host connect there, skipping TCP.
+std::optional<Endpoint> unix_endpoint;
+
+// Connections taken per listener per loop iteration. A connect storm is
+// drained in a few iterations without starving clients already connected.
+constexpr size_t MAX_ACCEPT_BATCH = 1024;
+
+// Out of file descriptors or memory, accept() keeps failing while the
+// backlog keeps the listener readable. The listeners are then left out of
+// poll() until a connection closes, or for a second in case the fds are
+// held elsewhere, so the loop neither spins nor floods the log.
+constexpr std::chrono::seconds ACCEPT_PAUSE(1);
+std::optional<std::chrono::steady_clock::time_point> accept_paused_until;
+
+// Admission control. Connections past --max-connections are refused right
+// after accept(). --rate-limit gives every client address a token bucket
+// that each request draws from. The adaptive concurrency limit guards the
+// offloaded routes, where an overloaded server actually queues; requests
+// over it are refused before they join the queue.
+size_t max_connections = 10000;
+std::unique_ptr<RateLimiter> rate_limiter;
+std::unique_ptr<ConcurrencyLimiter> concurrency_limiter =
+    std::make_unique<ConcurrencyLimiter>();
+
+// Clients on the UNIX socket have no address to key on and can only be
+// local processes, so only TCP clients are rate limited.
+bool over_rate_limit(const Connection &connection) {
+    return rate_limiter && !connection.peer.empty() &&
+           !rate_limiter->try_acquire(connection.peer);
+}
+
+HttpResponse refusal(int code, const std::string &reason) {
+    HttpResponse response(code, reason);
+    response.set_header("Retry-After", "1");
+    response.set_header("Content-Length", "0");
+    return response;
+}
+
+// Refusals are serialized once and queued by reference, so shedding a
+// request costs an iovec rather than a response.
+std::shared_ptr<const std::string> prebuilt(const HttpResponse &response) {
+    return std::make_shared<const std::string>(response.to_string());
+}
+const std::shared_ptr<const std::string> RATE_LIMITED =
+    prebuilt(refusal(429, "Too Many Requests"));
+const std::shared_ptr<const std::string> OVERLOADED =
+    prebuilt(refusal(503, "Service Unavailable"));
+const std::shared_ptr<const std::string> TOO_MANY_CONNECTIONS = [] {
+    HttpResponse response = refusal(503, "Service Unavailable");
+    response.set_header("Connection", "close");
+    return prebuilt(response);
+}();
+
+// Subscribers that received broadcasts during this loop iteration. They are
+// flushed once after all input has been handled, so a burst of published
+// messages reaches each subscriber in one writev().
+std::vector<int> scheduled_flushes;
+
+// Set by SIGTERM, "quit" or a finished handoff. The listeners are closed and
+// each connection is let go as soon as nothing is in flight on it; the
+// process exits when none are left or at the deadline (--drain-timeout).
+bool draining = false;
+std::chrono::seconds drain_timeout(30);
+std::chrono::steady_clock::time_point drain_deadline;
+
+// Metric handles are registered once; recording through them is a
+// thread-local add that never takes a lock.
+struct ServerMetrics {
+    MetricsRegistry &registry = MetricsRegistry::instance();
+
+    MetricsRegistry::Counter connections_accepted = registry.counter(
+        "http_connections_accepted_total", "Accepted connections.");
+    MetricsRegistry::Gauge connections_active = registry.gauge(
+        "http_connections_active", "Currently open client connections.");
+    MetricsRegistry::Counter bytes_received = registry.counter(
+        "http_received_bytes_total", "Bytes read from client sockets.");
+    MetricsRegistry::Counter bytes_sent = registry.counter(
+        "http_sent_bytes_total", "Bytes written to client sockets.");
+    MetricsRegistry::Counter malformed_requests =
+        registry.counter("http_parse_errors_total",
+                         "Requests or frames that could not be parsed.",
+                         {{"reason", "malformed_request"}});
+    MetricsRegistry::Counter oversized_headers =
+        registry.counter("http_parse_errors_total",
+                         "Requests or frames that could not be parsed.",
+                         {{"reason", "header_too_large"}});
+    MetricsRegistry::Counter websocket_protocol_errors =
+        registry.counter("http_parse_errors_total",
+                         "Requests or frames that could not be parsed.",
+                         {{"reason", "websocket_protocol"}});
+    MetricsRegistry::Counter websocket_messages =
+        registry.counter("websocket_messages_received_total",
+                         "Data messages received from WebSocket clients.");
+    MetricsRegistry::Counter websocket_deliveries = registry.counter(
+        "websocket_deliveries_total",
+        "Broadcast messages queued to WebSocket subscribers.");
+    MetricsRegistry::Counter sse_events = registry.counter(
+        "sse_events_published_total",
+        "Events published to /events subscribers.");
+    MetricsRegistry::Counter sse_deliveries = registry.counter(
+        "sse_deliveries_total",
+        "Events and heartbeats queued to /events subscribers.");
+    MetricsRegistry::Counter sse_heartbeats = registry.counter(
+        "sse_heartbeats_total", "Heartbeat ticks sent to /events.");
+    MetricsRegistry::Counter tls_handshakes_kernel =
+        registry.counter("tls_handshakes_total",
+                         "Completed TLS handshakes, by where records are "
+                         "encrypted.",
+                         {{"offload", "kernel"}});
+    MetricsRegistry::Counter tls_handshakes_userspace =
+        registry.counter("tls_handshakes_total",
+                         "Completed TLS handshakes, by where records are "
+                         "encrypted.",
+                         {{"offload", "userspace"}});
+    MetricsRegistry::Counter tls_handshake_failures = registry.counter(
+        "tls_handshake_failures_total", "TLS handshakes that failed.");
+    MetricsRegistry::Counter compressed_gzip =
+        registry.counter("http_compressed_responses_total",
+                         "Response bodies compressed, by encoding.",
+                         {{"encoding", "gzip"}});
+    MetricsRegistry::Counter compressed_brotli =
+        registry.counter("http_compressed_responses_total",
+                         "Response bodies compressed, by encoding.",
+                         {{"encoding", "br"}});
+    MetricsRegistry::Counter compression_input = registry.counter(
+        "http_compression_input_bytes_total",
+        "Buffered response bytes before compression.");
+    MetricsRegistry::Counter compression_output = registry.counter(
+        "http_compression_output_bytes_total",
+        "Buffered response bytes after compression.");
+    MetricsRegistry::Counter streamed_bodies = registry.counter(
+        "http_streamed_request_bodies_total",
+        "Request bodies streamed instead of buffered whole.");
+    MetricsRegistry::Counter spilled_bodies = registry.counter(
+        "http_spilled_request_bodies_total",
+        "Request bodies that outgrew memory and went to a temporary file.");
+    MetricsRegistry::Counter spliced_bytes = registry.counter(
+        "http_spliced_request_bytes_total",
+        "Request body bytes moved from socket to file with splice().");
+    MetricsRegistry::Counter oversized_bodies =
+        registry.counter("http_parse_errors_total",
+                         "Requests or frames that could not be parsed.",
+                         {{"reason", "body_too_large"}});
+    MetricsRegistry::Counter shed_rate_limited =
+        registry.counter("http_requests_shed_total",
+                         "Requests and connections refused by admission "
+                         "control, by reason.",
+                         {{"reason", "rate_limit"}});
+    MetricsRegistry::Counter shed_concurrency =
+        registry.counter("http_requests_shed_total",
+                         "Requests and connections refused by admission "
+                         "control, by reason.",
+                         {{"reason", "concurrency"}});
+    MetricsRegistry::Counter shed_connections =
+        registry.counter("http_requests_shed_total",
+                         "Requests and connections refused by admission "
+                         "control, by reason.",
+                         {{"reason", "max_connections"}});
+    MetricsRegistry::Counter http2_connections = registry.counter(
+        "http2_connections_total",
+        "Connections that switched to HTTP/2, by prior knowledge or "
+        "upgrade.");
+
+    struct RouteMetrics {
+        MetricsRegistry::Histogram duration;
+        std::map<int, MetricsRegistry::Counter> by_status;
+    };
+    std::map<std::string, RouteMetrics> routes;
+
+    // Time from the request being complete in the input buffer to its
+    // response being queued.
+    void record_request(const std::string &route, int status,
+                        std::chrono::steady_clock::time_point started) {
+        auto found = routes.find(route);
+        if (found == routes.end()) {
+            MetricsRegistry::Histogram duration = registry.histogram(
+                "http_request_duration_seconds",
+                "Request handling latency by route.", {{"route", route}});
+            found = routes.emplace(route, RouteMetrics{duration, {}}).first;
+        }
+        RouteMetrics &metrics = found->second;
+
+        auto counter = metrics.by_status.find(status);
+        if (counter == metrics.by_status.end()) {
+            counter = metrics.by_status
+                          .emplace(status,
+                                   registry.counter(
+                                       "http_requests_total",
+                                       "Requests handled by route and status.",
+                                       {{"route", route},
+                                        {"status", std::to_string(status)}}))
+                          .first;
+        }
+        counter->second.add();
+        metrics.duration.record_microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started)
+                .count());
+    }
+};
+
+ServerMetrics server_metrics;
 
-    int max_fd = 100;
-    timeval timeout;
+// Slow requests and a small sample of the rest, served on /debug/traces and
+// written to traces.json on shutdown.
+RequestTracer request_tracer;
 
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    int flags = fcntl(server_fd, F_GETFL);
-    fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
+// Set by --capture <file>: every byte read from clients, and the status and
+// size of every response, for `client --replay`.
+std::unique_ptr<CaptureWriter> capture;
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(8080);
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+// Set by --tls or --tls-self-signed: connections on the TLS port are
+// terminated here instead of by a proxy in front.
+std::unique_ptr<TlsContext> tls_context;
 
-    int bind_return = bind(
-        server_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+// Backs off towards level 1 while the process is short of CPU. Null after
+// --compression-level 0.
+std::unique_ptr<AdaptiveCompressionLevel> compression_level =
+    std::make_unique<AdaptiveCompressionLevel>();
 
-    int listen_return = listen(server_fd, 100);
+// Routes marked `offload` run on the handler pool so templating, compression
+// or JSON building cannot stall the poll() loop. Everything else runs
+// inline on the I/O thread.
+struct Route {
+    std::function<HttpResponse(const HttpRequest &)> handler;
+    bool offload = false;
+};
 
-    server_log.write("Server starting on port 8080");
+HttpResponse report_handler(const HttpRequest &) {
+    std::string html = "<html><body><table>";
+    for (int row = 1; row <= 1000; ++row) {
+        html += "<tr><td>" + std::to_string(row) + "</td><td>" +
+                std::to_string(row * row) + "</td></tr>";
+    }
+    html += "</table></body></html>";
+    return HttpResponse::html_response(html);
+}
+
+HttpResponse metrics_handler(const HttpRequest &) {
+    HttpResponse response(200, "OK");
+    response.set_body(MetricsRegistry::instance().render(),
+                      "text/plain; version=0.0.4; charset=utf-8");
+    return response;
+}
+
+// Load into chrome://tracing or ui.perfetto.dev.
+HttpResponse traces_handler(const HttpRequest &) {
+    std::ostringstream json;
+    request_tracer.write_chrome_trace(json);
+    return HttpResponse::json_response(json.str());
+}
+
+// POST the body to an OpenTelemetry collector's /v1/traces.
+HttpResponse otlp_traces_handler(const HttpRequest &) {
+    std::ostringstream json;
+    request_tracer.write_otlp_json(json);
+    return HttpResponse::json_response(json.str());
+}
+
+struct UploadedPart {
+    std::string name;
+    std::string filename;
+    std::string content_type;
+    size_t bytes;
+};
+JSON_FIELDS(UploadedPart, name, filename, content_type, bytes)
+
+struct UploadSummary {
+    size_t bytes;
+    bool spilled;
+    std::vector<UploadedPart> parts;
+};
+JSON_FIELDS(UploadSummary, bytes, spilled, parts)
+
+// Reads the whole body back, wherever it was kept, and reports its size.
+// Forms (multipart/form-data) are parsed as they are read, and each part
+// is reported too.
+HttpResponse upload_handler(const HttpRequest &request) {
+    UploadSummary summary{request.body_size(),
+                          request.spilled_body != nullptr,
+                          {}};
+    if (request.get_header("content-type").rfind("multipart/", 0) != 0) {
+        std::unique_ptr<std::istream> body = request.open_body();
+        char chunk[64 * 1024];
+        size_t bytes = 0;
+        while (body->read(chunk, sizeof(chunk)) || body->gcount() > 0) {
+            bytes += static_cast<size_t>(body->gcount());
+        }
+        summary.bytes = bytes;
+        return HttpResponse::json_response(summary);
+    }
+
+    try {
+        parse_multipart(
+            request,
+            {[&summary](const MultipartPart &part) {
+                 summary.parts.push_back(
+                     {part.name, part.filename, part.content_type, 0});
+             },
+             [&summary](std::string_view data) {
+                 summary.parts.back().bytes += data.size();
+             },
+             nullptr});
+    } catch (const std::runtime_error &e) {
+        return HttpResponse::bad_request(e.what());
+    }
+    return HttpResponse::json_response(summary);
+}
+
+std::map<std::string, Route> routes = {
+    {"/report", {report_handler, true}},
+    {"/upload", {upload_handler, true}},
+    {"/metrics", {metrics_handler, false}},
+    {"/debug/traces", {traces_handler, false}},
+    {"/debug/traces/otlp", {otlp_traces_handler, false}},
+};
+
+// Unknown paths share one label so scanners cannot blow up the number of
+// series.
+std::string metrics_route(const std::string &path) {
+    if (path == "/test" || path == "/ws" || path == "/events" ||
+        routes.count(path)) {
+        return path;
+    }
+    return "other";
+}
+
+// Called on whichever thread produced the response, so offloaded handlers
+// compress on the handler pool too. HTTP/2 and HTTP/1.0 cannot carry the
+// chunked body of a compressed streaming response.
+void compress_for(const HttpRequest &request, HttpResponse &response) {
+    if (!compression_level) {
+        return;
+    }
+    size_t uncompressed = response.body.size();
+    ContentEncoding encoding = compress_response(
+        response, request.get_header("accept-encoding"),
+        compression_level->level(), request.version == "HTTP/1.1");
+    if (encoding == ContentEncoding::IDENTITY) {
+        return;
+    }
+    if (encoding == ContentEncoding::GZIP) {
+        server_metrics.compressed_gzip.add();
+    } else {
+        server_metrics.compressed_brotli.add();
+    }
+    if (!response.is_streaming_response()) {
+        server_metrics.compression_input.add(uncompressed);
+        server_metrics.compression_output.add(response.body.size());
+    }
+}
+
+void close_connection(int client_fd, Logger &server_log) {
+    server_log.write("Client disconnected: " + std::to_string(client_fd));
+    Connection &connection = connections[client_fd];
+    if (capture) {
+        capture->close(connection.id);
+    }
+    if (connection.tls) {
+        connection.tls->shutdown();
+    }
+    close(client_fd);
+    connections.erase(client_fd);
+    websocket_subscribers.erase(client_fd);
+    sse_subscribers.erase(client_fd);
+    server_metrics.connections_active.sub();
+    accept_paused_until.reset();
+}
+
+// Writes whatever the kernel takes right now. Anything left stays queued and
+// the fd is polled for POLLOUT until it drains. Reading from a
+// client whose queue is past the high watermark is paused until it falls
+// below the low watermark again.
+void flush_connection(int client_fd, Logger &server_log) {
+    auto found = connections.find(client_fd);
+    if (found == connections.end()) {
+        return;
+    }
+    Connection &connection = found->second;
+
+    // With kernel TLS the socket encrypts what writev() hands it, so only
+    // the userspace fallback needs OpenSSL in the write path.
+    size_t queued = connection.http.output().pending_bytes();
+    OutputQueue::FlushResult result;
+    if (connection.tls && !connection.tls->kernel_send()) {
+        TlsSession &tls = *connection.tls;
+        result = connection.http.output().flush(
+            [&tls](const char *data, size_t size) {
+                return tls.write(data, size);
+            });
+    } else {
+        result = connection.http.output().flush(client_fd);
+    }
+    if (result == OutputQueue::FlushResult::ERROR) {
+        std::cerr << "Sending response failed" << strerror(errno)
+                  << std::endl;
+        close_connection(client_fd, server_log);
+        return;
+    }
+    server_metrics.bytes_sent.add(queued -
+                                  connection.http.output().pending_bytes());
+
+    while (!connection.traces.empty() &&
+           connection.traces.front().sent_at_bytes <=
+               connection.http.output().flushed_bytes()) {
+        RequestTrace &trace = connection.traces.front().trace;
+        trace.mark(TraceMark::SENT);
+        request_tracer.finish(trace);
+        connection.traces.pop_front();
+    }
+
+    if (connection.http.closing() && connection.http.output().empty()) {
+        close_connection(client_fd, server_log);
+        return;
+    }
 
-    fd_set read_fds;
+    if (connection.http.output().above_high_watermark()) {
+        connection.reading_paused = true;
+    } else if (connection.reading_paused &&
+               connection.http.output().below_low_watermark()) {
+        connection.reading_paused = false;
+    }
+}
+
+// Called once the whole response is queued; the trace completes when the
+// queue has been flushed up to here.
+void queue_trace(Connection &connection, RequestTrace &trace, int status,
+                 uint64_t queued_before) {
+    if (capture) {
+        capture->response(
+            connection.id, status,
+            connection.http.output().appended_bytes() - queued_before);
+    }
+    trace.status = status;
+    trace.mark(TraceMark::SERIALIZED);
+    connection.traces.push_back(
+        {std::move(trace), connection.http.output().appended_bytes()});
+}
+
+// Moves everything the HTTP/2 layer has produced (HEADERS and DATA,
+// SETTINGS and PING acks, WINDOW_UPDATEs, a GOAWAY) into the output queue.
+void queue_http2_output(Connection &connection) {
+    connection.http.output().append(connection.http2->take_output());
+    if (connection.http2->closed()) {
+        connection.http.close_when_flushed();
+    }
+}
+
+// Ends an offloaded request admitted by the concurrency limiter. Its
+// latency, queueing on the handler pool included, is what the limit
+// adapts to.
+void release_concurrency(std::chrono::steady_clock::time_point started,
+                         bool sample) {
+    if (concurrency_limiter) {
+        concurrency_limiter->release(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started),
+            sample);
+    }
+}
+
+// HTTP/2 requests go to the same routes as HTTP/1.1 ones. /test skips the
+// response cache, whose entries are serialized HTTP/1.1, and /ws has no
+// HTTP/2 equivalent here. Bodies larger than the peer's flow-control
+// windows are queued in the Http2Connection and sent as WINDOW_UPDATEs
+// arrive.
+void handle_http2_requests(int client_fd, Connection &connection,
+                           WorkStealingExecutor &handler_pool,
+                           Logger &server_log) {
+    for (auto &[stream_id, request] : connection.http2->take_requests()) {
+        auto started = std::chrono::steady_clock::now();
+        RequestTrace trace;
+        trace.connection_id = connection.id;
+        trace.mark(TraceMark::COMPLETE);
+        trace.mark(TraceMark::PARSED);
+        std::string route_label = metrics_route(request.path);
+        trace.method = request.method;
+        trace.route = route_label;
+
+        auto route = routes.find(request.path);
+        std::optional<HttpResponse> refused;
+        if (over_rate_limit(connection)) {
+            server_metrics.shed_rate_limited.add();
+            refused = refusal(429, "Too Many Requests");
+        } else if (route != routes.end() && route->second.offload &&
+                   concurrency_limiter &&
+                   !concurrency_limiter->try_acquire()) {
+            server_metrics.shed_concurrency.add();
+            refused = refusal(503, "Service Unavailable");
+        }
+        if (refused) {
+            trace.mark(TraceMark::HANDLED);
+            uint64_t queued_before = connection.http.output().appended_bytes();
+            connection.http2->submit_response(stream_id, *refused);
+            queue_http2_output(connection);
+            server_metrics.record_request(route_label, refused->status_code,
+                                          started);
+            queue_trace(connection, trace, refused->status_code,
+                        queued_before);
+            continue;
+        }
+
+        if (route != routes.end() && route->second.offload) {
+            uint64_t connection_id = connection.id;
+            auto response = std::make_shared<HttpResponse>();
+            auto handler = route->second.handler;
+            auto shared_trace =
+                std::make_shared<RequestTrace>(std::move(trace));
+
+            handler_pool.submit(
+                [response, handler, request, shared_trace]() {
+                    *response = handler(request);
+                    compress_for(request, *response);
+                    shared_trace->mark(TraceMark::HANDLED);
+                },
+                [response, client_fd, connection_id, stream_id, route_label,
+                 started, shared_trace,
+                 &server_log](std::exception_ptr error) {
+                    int status = error ? 500 : response->status_code;
+                    server_metrics.record_request(route_label, status,
+                                                  started);
+                    release_concurrency(started, !error);
+
+                    auto owner = connections.find(client_fd);
+                    if (owner == connections.end() ||
+                        owner->second.id != connection_id ||
+                        !owner->second.http2) {
+                        return;
+                    }
+                    Connection &connection = owner->second;
+                    uint64_t queued_before =
+                        connection.http.output().appended_bytes();
+                    connection.http2->submit_response(
+                        stream_id,
+                        error ? HttpResponse::server_error("handler failed")
+                              : *response);
+                    queue_http2_output(connection);
+                    queue_trace(connection, *shared_trace, status,
+                                queued_before);
+                    flush_connection(client_fd, server_log);
+                });
+            continue;
+        }
+
+        HttpResponse response;
+        if (request.path == "/test") {
+            response = HttpResponse::ok();
+        } else if (route != routes.end()) {
+            response = route->second.handler(request);
+            compress_for(request, response);
+        } else {
+            response = HttpResponse::not_found(request.path);
+        }
+        trace.mark(TraceMark::HANDLED);
+
+        uint64_t queued_before = connection.http.output().appended_bytes();
+        connection.http2->submit_response(stream_id, response);
+        queue_http2_output(connection);
+        server_metrics.record_request(route_label, response.status_code,
+                                      started);
+        queue_trace(connection, trace, response.status_code, queued_before);
+    }
+}
+
+// Steps the TLS handshake of a connection on the TLS port each time its fd
+// becomes ready.
+void continue_tls_handshake(int client_fd, Connection &connection,
+                            Logger &server_log) {
+    TlsSession &tls = *connection.tls;
+    TlsSession::Status status = tls.handshake();
+    connection.handshake_wants_write =
+        status == TlsSession::Status::WANT_WRITE;
+
+    if (status == TlsSession::Status::FAILED) {
+        server_metrics.tls_handshake_failures.add();
+        server_log.write("TLS handshake failed on fd " +
+                         std::to_string(client_fd) + ": " + tls.error());
+        close_connection(client_fd, server_log);
+    } else if (status == TlsSession::Status::DONE) {
+        if (tls.kernel_send()) {
+            server_metrics.tls_handshakes_kernel.add();
+        } else {
+            server_metrics.tls_handshakes_userspace.add();
+        }
+        server_log.write("TLS established on fd " + std::to_string(client_fd) +
+                         ": " + tls.protocol() + " " + tls.cipher() +
+                         (tls.kernel_send() ? ", kernel TLS" : ", userspace"));
+    }
+}
+
+// Flushed once all input of this loop iteration has been handled.
+void schedule_flush(int client_fd, Connection &connection) {
+    if (!connection.flush_scheduled) {
+        connection.flush_scheduled = true;
+        scheduled_flushes.push_back(client_fd);
+    }
+}
+
+// Queues an event on a subscriber without copying it: the whole chunk, or
+// only the event on a close-delimited stream.
+void queue_event(Connection &connection, const EncodedEvent &event) {
+    if (connection.event_stream_chunked) {
+        connection.http.output().append_shared(
+            event.chunk, event.chunk->data(), event.chunk->size());
+    } else {
+        std::string_view payload = event.payload();
+        connection.http.output().append_shared(event.chunk, payload.data(),
+                                               payload.size());
+    }
+}
+
+// Ends the stream and stops reading; the socket is closed once the last
+// chunk has been written.
+void end_event_stream(int client_fd, Connection &connection) {
+    if (connection.event_stream_chunked) {
+        connection.http.output().append("0\r\n\r\n");
+    }
+    connection.http.close_when_flushed();
+    sse_subscribers.erase(client_fd);
+}
+
+// Same scheme as broadcast(): every subscriber's queue borrows the one
+// encoded event, and subscribers that cannot keep up are dropped. They
+// resume from Last-Event-ID when they reconnect.
+void fan_out_event(const EncodedEvent &event) {
+    std::vector<int> slow_subscribers;
+    for (int subscriber_fd : sse_subscribers) {
+        Connection &subscriber = connections[subscriber_fd];
+        if (subscriber.http.output().above_high_watermark()) {
+            slow_subscribers.push_back(subscriber_fd);
+        } else {
+            queue_event(subscriber, event);
+            server_metrics.sse_deliveries.add();
+        }
+        schedule_flush(subscriber_fd, subscriber);
+    }
+
+    for (int subscriber_fd : slow_subscribers) {
+        end_event_stream(subscriber_fd, connections[subscriber_fd]);
+    }
+}
+
+void publish_event(ServerSentEvent event) {
+    server_metrics.sse_events.add();
+    fan_out_event(event_stream.publish(std::move(event)));
+}
+
+// The frame is encoded once and every subscriber's output queue references
+// the same bytes, so fanning a message out to N clients costs N iovecs, not
+// N copies. Subscribers that cannot keep up (queue past the high watermark)
+// are disconnected instead of buffering without bound.
+void broadcast(int publisher_fd, WebSocketOpcode opcode,
+               const std::string &payload) {
+    auto frame = std::make_shared<const std::string>(
+        encode_websocket_frame(opcode, payload));
+
+    std::vector<int> slow_subscribers;
+    for (int subscriber_fd : websocket_subscribers) {
+        if (subscriber_fd == publisher_fd) {
+            continue;
+        }
+        Connection &subscriber = connections[subscriber_fd];
+        if (subscriber.http.output().above_high_watermark()) {
+            slow_subscribers.push_back(subscriber_fd);
+        } else {
+            subscriber.http.output().append_shared(frame, frame->data(),
+                                                   frame->size());
+            server_metrics.websocket_deliveries.add();
+        }
+        schedule_flush(subscriber_fd, subscriber);
+    }
+
+    for (int subscriber_fd : slow_subscribers) {
+        connections[subscriber_fd].http.close_websocket(
+            WS_CLOSE_POLICY_VIOLATION);
+    }
+
+    // Browsers that cannot use WebSockets follow the same text messages
+    // on /events.
+    if (opcode == WebSocketOpcode::TEXT) {
+        publish_event({"", "", payload, std::nullopt});
+    }
+}
+
+// Tells every long-lived connection to go elsewhere. WebSocket clients get
+// a 1012 close frame, which asks them to reconnect; /events streams end
+// with a retry hint, spread over a few seconds so the subscribers do not
+// all come back at once; HTTP/2 clients get GOAWAY and may finish their
+// open streams. Plain HTTP/1.1 connections are left to
+// close_idle_connections().
+void start_draining(Logger &server_log) {
+    draining = true;
+    drain_deadline = std::chrono::steady_clock::now() + drain_timeout;
+    server_log.write("Draining " + std::to_string(connections.size()) +
+                     " connections");
+    for (auto &[client_fd, connection] : connections) {
+        if (connection.http.closing()) {
+            continue;
+        }
+        if (connection.http.is_websocket()) {
+            connection.http.close_websocket(WS_CLOSE_SERVICE_RESTART,
+                                            "server restarting");
+        } else if (connection.event_stream) {
+            uint64_t retry_ms = 1000 + connection.id * 7919 % 4000;
+            queue_event(connection,
+                        encode_sse_chunk("retry: " + std::to_string(retry_ms) +
+                                         "\n\n"));
+            end_event_stream(client_fd, connection);
+        } else if (connection.http2) {
+            connection.http2->shutdown();
+            queue_http2_output(connection);
+        } else {
+            continue;
+        }
+        schedule_flush(client_fd, connection);
+    }
+}
+
+// While draining, HTTP/1.1 connections are closed as soon as they are idle:
+// right away for idle keep-alives, after their response for the rest.
+void close_idle_connections() {
+    for (auto &[client_fd, connection] : connections) {
+        if (connection.http.closing() || connection.http.is_websocket() ||
+            connection.event_stream || connection.http2 ||
+            !connection.http.idle()) {
+            continue;
+        }
+        connection.http.close_when_flushed();
+        schedule_flush(client_fd, connection);
+    }
+}
+
+void run_scheduled_flushes(Logger &server_log) {
+    std::vector<int> pending;
+    pending.swap(scheduled_flushes);
+    for (int client_fd : pending) {
+        auto found = connections.find(client_fd);
+        if (found != connections.end()) {
+            found->second.flush_scheduled = false;
+            flush_connection(client_fd, server_log);
+        }
+    }
+}
+
+// Stamps the phases a request went through before it was complete.
+RequestTrace start_trace(Connection &connection) {
+    RequestTrace trace;
+    trace.connection_id = connection.id;
+    trace.marks[static_cast<size_t>(TraceMark::ACCEPT_START)] =
+        connection.accept_started;
+    trace.marks[static_cast<size_t>(TraceMark::ACCEPT_END)] =
+        connection.accept_finished;
+    trace.marks[static_cast<size_t>(TraceMark::FIRST_BYTE)] =
+        connection.first_byte;
+    trace.mark(TraceMark::COMPLETE);
+    connection.accept_started = connection.accept_finished = 0;
+    return trace;
+}
+
+// The request hook of every HTTP/1.1 connection. `raw_request` is the
+// whole request, or only its head when the body was streamed.
+void handle_request(int client_fd, Connection &connection,
+                    HttpRequest &request, const std::string &raw_request,
+                    WorkStealingExecutor &handler_pool, Logger &server_log) {
+    std::cout << "Received: " << raw_request << std::endl;
+
+    auto started = std::chrono::steady_clock::now();
+    uint64_t queued_before = connection.http.output().appended_bytes();
+    RequestTrace trace = start_trace(connection);
+    // A pipelined request behind this one is already here.
+    connection.first_byte = trace.at(TraceMark::COMPLETE);
+    if (request.spilled_body) {
+        server_metrics.spilled_bodies.add();
+    }
+    trace.mark(TraceMark::PARSED);
+    std::string route_label = metrics_route(request.path);
+    trace.method = request.method;
+    trace.route = route_label;
+    // Stays 0 when the response is produced later on the handler pool.
+    int status = 0;
+
+    if (request.version == "HTTP/1.1" && !draining &&
+        is_h2c_upgrade(request)) {
+        // The request itself becomes stream 1 of the new HTTP/2
+        // connection.
+        try {
+            auto http2 = std::make_unique<Http2Connection>(
+                Http2Connection::Role::SERVER);
+            http2->accept_upgrade(
+                base64url_decode(request.get_header("http2-settings")),
+                request);
+            HttpResponse switching(101, "Switching Protocols");
+            switching.set_header("Connection", "Upgrade");
+            switching.set_header("Upgrade", "h2c");
+            connection.http.send_response(switching);
+            connection.http.hand_over();
+            connection.http2 = std::move(http2);
+            server_metrics.http2_connections.add();
+            handle_http2_requests(client_fd, connection, handler_pool,
+                                  server_log);
+            return;
+        } catch (const std::runtime_error &) {
+            // Settings that do not decode leave the request on HTTP/1.1.
+        }
+    }
+
+    auto route = routes.find(request.path);
+    if (over_rate_limit(connection)) {
+        server_metrics.shed_rate_limited.add();
+        trace.mark(TraceMark::HANDLED);
+        connection.http.output().append_shared(
+            RATE_LIMITED, RATE_LIMITED->data(), RATE_LIMITED->size());
+        status = 429;
+    } else if (route != routes.end() && route->second.offload &&
+               concurrency_limiter && !concurrency_limiter->try_acquire()) {
+        server_metrics.shed_concurrency.add();
+        trace.mark(TraceMark::HANDLED);
+        connection.http.output().append_shared(
+            OVERLOADED, OVERLOADED->data(), OVERLOADED->size());
+        status = 503;
+    } else if (request.path.compare("/test") == 0) {
+        auto cached = response_cache.lookup(request);
+        if (!cached) {
+            response_cache.insert(request, HttpResponse::ok(),
+                                  std::chrono::seconds(1));
+            cached = response_cache.lookup(request);
+        }
+        trace.mark(TraceMark::HANDLED);
+
+        if (cached) {
+            // The queue borrows the cached bytes; the shared_ptr keeps them
+            // alive even if the entry is evicted before the write completes.
+            const CachedVariant &variant =
+                cached->select(request.get_header("accept-encoding"));
+            connection.http.output().append_shared(
+                cached, variant.head.data(), variant.head.size());
+            if (request.method != "HEAD") {
+                connection.http.output().append_shared(
+                    cached, variant.body.data(), variant.body.size());
+            }
+            status = cached->status_code;
+        } else {
+            connection.http.send_response(HttpResponse::ok());
+            status = 200;
+        }
+    } else if (draining && (request.path == "/ws" ||
+                            (request.path == "/events" &&
+                             request.method == "GET"))) {
+        // Long-lived connections belong on the process taking over.
+        trace.mark(TraceMark::HANDLED);
+        HttpResponse response(503, "Service Unavailable");
+        response.set_header("Retry-After", "1");
+        connection.http.send_response(response);
+        status = 503;
+    } else if (request.path == "/ws") {
+        trace.mark(TraceMark::HANDLED);
+        if (connection.http.accept_websocket(request)) {
+            websocket_subscribers.insert(client_fd);
+            status = 101;
+        } else {
+            status = 426;
+        }
+    } else if (request.path == "/events" && request.method == "GET") {
+        // The head goes out now and events follow as they are published,
+        // starting with any the client missed since Last-Event-ID.
+        trace.mark(TraceMark::HANDLED);
+        bool chunked = request.version == "HTTP/1.1";
+        connection.http.send_response(HttpResponse::event_stream(chunked));
+        connection.http.hand_over();
+        connection.event_stream = true;
+        connection.event_stream_chunked = chunked;
+        for (const EncodedEvent &missed :
+             event_stream.since(request.get_header("last-event-id"))) {
+            queue_event(connection, missed);
+        }
+        sse_subscribers.insert(client_fd);
+        status = 200;
+    } else if (request.path == "/events" && request.method == "POST") {
+        // The body becomes the event's data; an Event-Name header names it.
+        trace.mark(TraceMark::HANDLED);
+        publish_event(
+            {"", request.get_header("event-name"), request.body, std::nullopt});
+        connection.http.send_response(HttpResponse(204, "No Content"));
+        status = 204;
+    } else if (route != routes.end() && route->second.offload) {
+        uint64_t connection_id = connection.id;
+        auto response = std::make_shared<HttpResponse>();
+        auto handler = route->second.handler;
+        // The worker stamps HANDLED; the completion runs after it.
+        auto shared_trace = std::make_shared<RequestTrace>(std::move(trace));
+        connection.http.defer();
+
+        handler_pool.submit(
+            [response, handler, request, shared_trace]() {
+                *response = handler(request);
+                compress_for(request, *response);
+                shared_trace->mark(TraceMark::HANDLED);
+            },
+            [response, client_fd, connection_id, route_label, started,
+             shared_trace, &server_log](std::exception_ptr error) {
+                int status = error ? 500 : response->status_code;
+                server_metrics.record_request(route_label, status, started);
+                release_concurrency(started, !error);
+
+                auto owner = connections.find(client_fd);
+                if (owner == connections.end() ||
+                    owner->second.id != connection_id) {
+                    return;
+                }
+                ServerConnection &http = owner->second.http;
+                uint64_t queued_before = http.output().appended_bytes();
+                http.send_response(
+                    error ? HttpResponse::server_error("handler failed")
+                          : *response);
+                queue_trace(owner->second, *shared_trace, status,
+                            queued_before);
+                // Requests pipelined behind this one can go now.
+                http.resume();
+                flush_connection(client_fd, server_log);
+            });
+    } else if (route != routes.end()) {
+        HttpResponse response = route->second.handler(request);
+        compress_for(request, response);
+        trace.mark(TraceMark::HANDLED);
+        connection.http.send_response(response);
+        status = response.status_code;
+    } else {
+        trace.mark(TraceMark::HANDLED);
+        connection.http.send_response(HttpResponse::not_found(request.path));
+        status = 404;
+    }
+
+    if (status != 0) {
+        server_metrics.record_request(route_label, status, started);
+        queue_trace(connection, trace, status, queued_before);
+    }
+
+    std::cout << "Parsed response: " << request.to_string() << std::endl;
+
+    std::string client = std::to_string(client_fd);
+
+    std::string log_entry = "Client " + client + ": " + raw_request;
+    server_log.write(log_entry);
+}
+
+// Requests ServerConnection answered itself, and those refused with
+// ServerConnection::refuse().
+void request_rejected(Connection &connection, int status, size_t bytes) {
+    if (status == 400) {
+        server_metrics.malformed_requests.add();
+    } else if (status == 413) {
+        server_metrics.oversized_bodies.add();
+    } else if (status == 431) {
+        server_metrics.oversized_headers.add();
+    }
+    if (capture) {
+        capture->response(connection.id, status, bytes);
+    }
+}
+
+// Input after the connection was handed over. HTTP/2 buffers partial
+// frames itself and takes everything; event stream subscribers have
+// nothing to say, so what they send is dropped.
+void handle_raw_input(int client_fd, Connection &connection,
+                      std::string_view data,
+                      WorkStealingExecutor &handler_pool, Logger &server_log) {
+    if (!connection.http2) {
+        return;
+    }
+    connection.http2->receive(data);
+    handle_http2_requests(client_fd, connection, handler_pool, server_log);
+    queue_http2_output(connection);
+}
+
+// Wires a newly accepted connection's HTTP/1.1 and WebSocket handling to
+// the routes, the subscriber sets and the metrics. Spliced bytes bypass
+// the capture, and TLS records have to be decrypted in userspace anyway.
+ServerConnection serve_connection(int client_fd, bool tls,
+                                  WorkStealingExecutor &handler_pool,
+                                  Logger &server_log) {
+    auto owner = [client_fd]() -> Connection & {
+        return connections[client_fd];
+    };
+    ServerConnection::Hooks hooks;
+    hooks.request = [=, &handler_pool, &server_log](
+                        ServerConnection &, HttpRequest &request,
+                        const std::string &raw_request) {
+        handle_request(client_fd, owner(), request, raw_request, handler_pool,
+                       server_log);
+    };
+    hooks.message = [client_fd](ServerConnection &, WebSocketOpcode opcode,
+                                const std::string &payload) {
+        server_metrics.websocket_messages.add();
+        broadcast(client_fd, opcode, payload);
+    };
+    hooks.upload = [](ServerConnection &) {
+        server_metrics.streamed_bodies.add();
+    };
+    hooks.rejected = [=](ServerConnection &, int status, size_t bytes) {
+        request_rejected(owner(), status, bytes);
+    };
+    hooks.websocket_closed = [client_fd](ServerConnection &, uint16_t code) {
+        if (code == WS_CLOSE_PROTOCOL_ERROR) {
+            server_metrics.websocket_protocol_errors.add();
+        }
+        websocket_subscribers.erase(client_fd);
+    };
+    hooks.http2_preface = [=](ServerConnection &http) {
+        owner().http2 =
+            std::make_unique<Http2Connection>(Http2Connection::Role::SERVER);
+        server_metrics.http2_connections.add();
+        http.hand_over();
+    };
+    hooks.raw_input = [=, &handler_pool, &server_log](ServerConnection &,
+                                                      std::string_view data) {
+        handle_raw_input(client_fd, owner(), data, handler_pool, server_log);
+    };
+
+    ServerConnection::Options options;
+    options.max_message_size = MAX_WEBSOCKET_MESSAGE;
+    options.body_limits = body_limits;
+    options.splice_uploads = !tls && !capture;
+    return ServerConnection(std::move(hooks), std::move(options));
+}
+
+int main(int argc, char *argv[]) {
+    uint16_t tls_port = 8443;
+    double rate_limit = 0;
+    double rate_burst = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        try {
+            if (flag == "--capture" && i + 1 < argc) {
+                capture = std::make_unique<CaptureWriter>(argv[++i]);
+            } else if (flag == "--tls" && i + 2 < argc) {
+                std::string certificate = argv[++i];
+                std::string key = argv[++i];
+                tls_context = std::make_unique<TlsContext>(
+                    TlsContext::server(certificate, key));
+            } else if (flag == "--tls-self-signed") {
+                // For loopback testing: clients trust server-cert.pem.
+                write_self_signed_certificate("server-cert.pem",
+                                              "server-key.pem");
+                tls_context = std::make_unique<TlsContext>(
+                    TlsContext::server("server-cert.pem", "server-key.pem"));
+            } else if (flag == "--tls-port" && i + 1 < argc) {
+                tls_port = static_cast<uint16_t>(std::stoi(argv[++i]));
+            } else if (flag == "--compression-level" && i + 1 < argc) {
+                // The highest level used while CPU is plentiful; 0 turns
+                // compression off.
+                int level = std::stoi(argv[++i]);
+                compression_level =
+                    level > 0
+                        ? std::make_unique<AdaptiveCompressionLevel>(1, level)
+                        : nullptr;
+            } else if (flag == "--body-memory-limit" && i + 1 < argc) {
+                body_limits.memory_limit = std::stoull(argv[++i]);
+            } else if (flag == "--max-body-size" && i + 1 < argc) {
+                body_limits.max_size = std::stoull(argv[++i]);
+            } else if (flag == "--spill-dir" && i + 1 < argc) {
+                body_limits.spill_directory = argv[++i];
+            } else if (flag == "--drain-timeout" && i + 1 < argc) {
+                drain_timeout = std::chrono::seconds(std::stoi(argv[++i]));
+            } else if (flag == "--max-connections" && i + 1 < argc) {
+                max_connections = std::stoull(argv[++i]);
+            } else if (flag == "--backlog" && i + 1 < argc) {
+                listener_options.backlog = std::stoi(argv[++i]);
+            } else if (flag == "--defer-accept" && i + 1 < argc) {
+                listener_options.defer_accept_seconds = std::stoi(argv[++i]);
+            } else if (flag == "--fastopen" && i + 1 < argc) {
+                listener_options.fastopen_queue = std::stoi(argv[++i]);
+            } else if (flag == "--reuse-port") {
+                listener_options.reuse_port = true;
+            } else if (flag == "--incoming-cpu" && i + 1 < argc) {
+                listener_options.incoming_cpu = std::stoi(argv[++i]);
+            } else if (flag == "--unix" && i + 1 < argc) {
+                unix_endpoint = Endpoint::unix_socket(argv[++i]);
+            } else if (flag == "--rate-limit" && i + 1 < argc) {
+                rate_limit = std::stod(argv[++i]);
+            } else if (flag == "--rate-burst" && i + 1 < argc) {
+                rate_burst = std::stod(argv[++i]);
+            } else if (flag == "--concurrency-limit" && i + 1 < argc) {
+                // The most the adaptive limit may grow to; 0 turns it off.
+                size_t limit = std::stoull(argv[++i]);
+                ConcurrencyLimiter::Options options;
+                options.max_limit = limit;
+                options.min_limit = std::min(options.min_limit, limit);
+                concurrency_limiter =
+                    limit > 0 ? std::make_unique<ConcurrencyLimiter>(options)
+                              : nullptr;
+            } else {
+                std::cerr << "usage: server [--capture <file>] "
+                             "[--tls <cert.pem> <key.pem> | "
+                             "--tls-self-signed] [--tls-port <port>] "
+                             "[--compression-level <0-9>] "
+                             "[--body-memory-limit <bytes>] "
+                             "[--max-body-size <bytes>] "
+                             "[--spill-dir <dir>] "
+                             "[--drain-timeout <seconds>] "
+                             "[--max-connections <n>] [--backlog <n>] "
+                             "[--defer-accept <seconds>] "
+                             "[--fastopen <queue>] [--reuse-port] "
+                             "[--incoming-cpu <cpu>] "
+                             "[--unix <path | @abstract-name>] "
+                             "[--rate-limit <requests/s> "
+                             "[--rate-burst <requests>]] "
+                             "[--concurrency-limit <max, 0 off>]\n";
+                return EXIT_FAILURE;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // SIGUSR2 restarts: the binary at this path, which a deploy may have
+    // replaced since, is started with the same arguments and takes over the
+    // listeners. SIGTERM only drains. Both are read from a signalfd in the
+    // poll loop, so they are blocked before the handler pool's threads
+    // inherit the mask.
+    std::vector<char> executable_path(PATH_MAX + 1, '\0');
+    ssize_t path_length =
+        readlink("/proc/self/exe", executable_path.data(), PATH_MAX);
+    std::string executable =
+        path_length > 0 ? std::string(executable_path.data(), path_length)
+                        : std::string(argv[0]);
+    std::vector<std::string> arguments(argv, argv + argc);
+    sigset_t handled_signals;
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGTERM);
+    sigaddset(&handled_signals, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &handled_signals, nullptr);
+    int signal_fd =
+        signalfd(-1, &handled_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    Replacement replacement;
+
+    if (rate_limit > 0) {
+        rate_limiter = std::make_unique<RateLimiter>(
+            rate_limit, rate_burst > 0 ? rate_burst : rate_limit);
+    }
+
+    Logger server_log("server.log");
+    WorkStealingExecutor handler_pool;
+
+    // Queue depths are read from the structures that own them at scrape
+    // time; /metrics runs on this thread, so no locking is needed.
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    metrics.gauge_callback(
+        "handler_pool_jobs_in_flight",
+        "Jobs submitted to the handler pool and not yet completed.", {},
+        [&handler_pool] { return handler_pool.in_flight(); });
+    metrics.gauge_callback(
+        "output_queue_bytes", "Response bytes queued but not yet written.",
+        {}, [] {
+            size_t pending = 0;
+            for (const auto &[fd, connection] : connections) {
+                pending += connection.http.output().pending_bytes();
+            }
+            return static_cast<double>(pending);
+        });
+    metrics.gauge_callback(
+        "websocket_subscribers", "Upgraded connections on /ws.", {},
+        [] { return static_cast<double>(websocket_subscribers.size()); });
+    metrics.gauge_callback(
+        "concurrency_limit",
+        "Offloaded requests the adaptive limiter admits at once.", {}, [] {
+            return concurrency_limiter
+                       ? static_cast<double>(concurrency_limiter->limit())
+                       : 0.0;
+        });
+    metrics.gauge_callback(
+        "concurrency_limiter_in_flight",
+        "Offloaded requests admitted and not yet answered.", {}, [] {
+            return concurrency_limiter
+                       ? static_cast<double>(concurrency_limiter->in_flight())
+                       : 0.0;
+        });
+    metrics.gauge_callback(
+        "sse_subscribers", "Connections subscribed on /events.", {},
+        [] { return static_cast<double>(sse_subscribers.size()); });
+    metrics.gauge_callback(
+        "buffer_pool_buffers_outstanding", "Pooled I/O buffers in use.", {},
+        [] {
+            return static_cast<double>(BufferPool::instance().outstanding());
+        });
+    metrics.gauge_callback(
+        "http_compression_level",
+        "Compression level currently used for responses, 0 when off.", {},
+        [] {
+            return compression_level ? compression_level->level() : 0.0;
+        });
+    metrics.gauge_callback(
+        "response_cache_bytes", "Bytes held by the response cache.", {},
+        [] { return static_cast<double>(response_cache.size_bytes()); });
+    metrics.gauge_callback(
+        "request_traces_finished", "Requests seen by the tracer.", {},
+        [] { return static_cast<double>(request_tracer.finished()); });
+    metrics.gauge_callback(
+        "request_traces_kept", "Requests kept by the tail-based sampler.",
+        {}, [] { return static_cast<double>(request_tracer.kept()); });
+
+    // A client that disconnects while its output is queued must show up as
+    // EPIPE from writev(), not kill the process.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Every WebSocket subscriber is an open fd; the default soft limit of
+    // 1024 would cap fan-out far below what the machine can handle.
+    struct rlimit fd_limit;
+    if (getrlimit(RLIMIT_NOFILE, &fd_limit) == 0 &&
+        fd_limit.rlim_cur < fd_limit.rlim_max) {
+        fd_limit.rlim_cur = fd_limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &fd_limit);
+    }
+
+    // Started by a restart: the listeners come from the process being
+    // replaced, which keeps serving until this one reports ready.
+    int handoff_fd = inherited_handoff_socket();
+    int server_fd = -1;
+    // poll() skips negative fds, so the slots stay when TLS or the UNIX
+    // socket is off.
+    int tls_server_fd = -1;
+    int unix_server_fd = -1;
+    if (handoff_fd >= 0) {
+        std::vector<int> listeners;
+        try {
+            listeners = receive_fds(handoff_fd);
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        // The TCP listeners come in order, plain first; the UNIX one is
+        // told apart by its family. Whatever this process was not started
+        // to serve is closed.
+        for (int listener : listeners) {
+            if (socket_family(listener) == AF_UNIX) {
+                if (unix_endpoint) {
+                    unix_server_fd = listener;
+                }
+            } else if (server_fd < 0) {
+                server_fd = listener;
+            } else if (tls_context) {
+                tls_server_fd = listener;
+            }
+            if (listener != server_fd && listener != tls_server_fd &&
+                listener != unix_server_fd) {
+                close(listener);
+            }
+        }
+        server_log.write("Took over the listeners of the previous process");
+    }
+    try {
+        if (server_fd < 0) {
+            server_fd = open_tcp_listener(8080, listener_options);
+            server_log.write("Server starting on port 8080");
+        }
+        if (tls_context && tls_server_fd < 0) {
+            tls_server_fd = open_tcp_listener(tls_port, listener_options);
+            server_log.write("TLS on port " + std::to_string(tls_port));
+        }
+        if (unix_endpoint && unix_server_fd < 0) {
+            unix_server_fd = open_listener(*unix_endpoint, listener_options);
+            server_log.write("Listening on " + unix_endpoint->to_string());
+        }
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    // Unless the old process hears that this one is serving, it keeps its
+    // listeners too; bow out rather than have both accept indefinitely.
+    if (handoff_fd >= 0) {
+        try {
+            send_ready(handoff_fd);
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        close(handoff_fd);
+    }
+
+    // The kernel keeps queueing connections on a listener for as long as
+    // any process holds it, so closing ours only stops this process from
+    // accepting.
+    auto stop_listening = [&server_fd, &tls_server_fd, &unix_server_fd] {
+        for (int *listener : {&server_fd, &tls_server_fd, &unix_server_fd}) {
+            if (*listener >= 0) {
+                close(*listener);
+                *listener = -1;
+            }
+        }
+    };
+
+    // poll() rather than select(): select() cannot watch fds above
+    // FD_SETSIZE (1024), which a server holding thousands of WebSocket
+    // subscribers blows through immediately.
+    constexpr size_t FIRST_CLIENT_SLOT = 8;
+    std::vector<struct pollfd> poll_fds;
+    // TLS connections whose next request OpenSSL has already decrypted;
+    // poll() cannot see those bytes on the fd.
+    std::vector<int> tls_buffered;
     while (true) {
         std::cout << "server > " << std::flush;
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        FD_SET(server_fd, &read_fds);
+        poll_fds.clear();
+        tls_buffered.clear();
+        if (accept_paused_until &&
+            std::chrono::steady_clock::now() >= *accept_paused_until) {
+            accept_paused_until.reset();
+        }
+        // poll() skips negative fds, which keeps the slots in place.
+        auto listening = [](int listen_fd) {
+            return accept_paused_until ? -1 : listen_fd;
+        };
+        poll_fds.push_back({STDIN_FILENO, POLLIN, 0});
+        poll_fds.push_back({listening(server_fd), POLLIN, 0});
+        poll_fds.push_back({handler_pool.completion_fd(), POLLIN, 0});
+        poll_fds.push_back({listening(tls_server_fd), POLLIN, 0});
+        poll_fds.push_back({event_stream.heartbeat_fd(), POLLIN, 0});
+        poll_fds.push_back({signal_fd, POLLIN, 0});
+        poll_fds.push_back({replacement.socket_fd, POLLIN, 0});
+        poll_fds.push_back({listening(unix_server_fd), POLLIN, 0});
+        for (const auto &[client_fd, connection] : connections) {
+            short events = 0;
+            if (connection.tls && !connection.tls->established()) {
+                events = connection.handshake_wants_write ? POLLOUT : POLLIN;
+                poll_fds.push_back({client_fd, events, 0});
+                continue;
+            }
+            if (!connection.reading_paused && connection.http.wants_input()) {
+                events |= POLLIN;
+                if (connection.tls && connection.tls->has_buffered_input()) {
+                    tls_buffered.push_back(client_fd);
+                }
+            }
+            if (!connection.http.output().empty()) {
+                events |= POLLOUT;
+            }
+            poll_fds.push_back({client_fd, events, 0});
+        }
 
-        for (int client_fd : client_fds) {
-            FD_SET(client_fd, &read_fds);
+        int timeout_ms = tls_buffered.empty() ? -1 : 0;
+        auto wake_by = [&timeout_ms](
+                           std::chrono::steady_clock::time_point deadline) {
+            auto remaining = std::chrono::duration_cast<
+                std::chrono::milliseconds>(deadline -
+                                           std::chrono::steady_clock::now());
+            int until = static_cast<int>(
+                std::max<int64_t>(remaining.count() + 1, 0));
+            timeout_ms = timeout_ms < 0 ? until : std::min(timeout_ms, until);
+        };
+        if (draining) {
+            wake_by(drain_deadline);
+        }
+        if (accept_paused_until) {
+            wake_by(*accept_paused_until);
+        }
+        if (poll(poll_fds.data(), poll_fds.size(), timeout_ms) < 0) {
+            continue;
         }
 
-        max_fd = server_fd;
-        for (int client_fd : client_fds) {
-            max_fd = std::max(max_fd, client_fd);
+        struct signalfd_siginfo signal_info;
+        while ((poll_fds[5].revents & POLLIN) &&
+               read(signal_fd, &signal_info, sizeof(signal_info)) ==
+                   sizeof(signal_info)) {
+            if (draining) {
+                continue;
+            }
+            if (signal_info.ssi_signo == SIGTERM) {
+                server_log.write("SIGTERM received");
+                stop_listening();
+                start_draining(server_log);
+                continue;
+            }
+            if (replacement.pid >= 0) {
+                continue;  // a restart is already under way
+            }
+            std::vector<int> listeners = {server_fd};
+            for (int listener : {tls_server_fd, unix_server_fd}) {
+                if (listener >= 0) {
+                    listeners.push_back(listener);
+                }
+            }
+            try {
+                replacement = spawn_replacement(executable, arguments);
+                send_fds(replacement.socket_fd, listeners);
+                server_log.write("Handing the listeners to pid " +
+                                 std::to_string(replacement.pid));
+            } catch (const std::runtime_error &e) {
+                server_log.write(std::string("Restart failed: ") + e.what());
+                if (replacement.socket_fd >= 0) {
+                    close(replacement.socket_fd);
+                }
+                replacement = {};
+            }
         }
-        max_fd = std::max(max_fd, STDIN_FILENO);
 
-        select(max_fd + 1, &read_fds, nullptr, nullptr, nullptr);
+        // The replacement answers once it is serving, or hangs up when it
+        // could not start; then this process simply keeps going.
+        if (poll_fds[6].revents & (POLLIN | POLLERR | POLLHUP)) {
+            bool serving = receive_ready(replacement.socket_fd);
+            close(replacement.socket_fd);
+            if (serving && !draining) {
+                server_log.write("Pid " + std::to_string(replacement.pid) +
+                                 " is serving; draining");
+                stop_listening();
+                start_draining(server_log);
+            } else if (!serving) {
+                server_log.write("Replacement pid " +
+                                 std::to_string(replacement.pid) +
+                                 " failed to start");
+                waitpid(replacement.pid, nullptr, WNOHANG);
+            }
+            replacement = {};
+        }
 
-        if (FD_ISSET(server_fd, &read_fds)) {
-            struct sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_client_fd = accept(
-                server_fd, reinterpret_cast<struct sockaddr *>(&client_addr),
-                &client_len);
-            if (new_client_fd < 0) {
-                server_log.write("Failed to accept new client connection");
+        if (poll_fds[2].revents & POLLIN) {
+            handler_pool.run_completions();
+        }
+
+        // One timer for every /events subscriber; the heartbeat chunk is
+        // encoded once too.
+        if ((poll_fds[4].revents & POLLIN) && event_stream.heartbeat_due() &&
+            !sse_subscribers.empty()) {
+            server_metrics.sse_heartbeats.add();
+            fan_out_event(EventStream::heartbeat());
+        }
+
+        // Each wakeup drains the backlog, so a connect storm costs a few
+        // loop iterations rather than one per client.
+        for (size_t slot : {1, 3, 7}) {
+            if (!(poll_fds[slot].revents & POLLIN)) {
                 continue;
-            } else {
-                std::string client_ip = inet_ntoa(client_addr.sin_addr);
-                server_log.write("New client connected from " + client_ip +
-                                 " with fd: " + std::to_string(new_client_fd));
             }
+            int listen_fd = poll_fds[slot].fd;
+            uint64_t accept_started = TscClock::now();
+            auto on_accept = [&](int new_client_fd,
+                                 const sockaddr_storage &peer) {
+                // Past the cap the client is told to come back rather than
+                // left waiting in the backlog. A TLS client could not read
+                // the answer, so it is just closed.
+                if (connections.size() >= max_connections) {
+                    server_metrics.shed_connections.add();
+                    if (listen_fd != tls_server_fd) {
+                        send(new_client_fd, TOO_MANY_CONNECTIONS->data(),
+                             TOO_MANY_CONNECTIONS->size(), MSG_DONTWAIT);
+                    }
+                    close(new_client_fd);
+                    return;
+                }
 
-            client_fds.insert(client_fds.begin(), new_client_fd);
-            server_log.write("New client connected: " +
-                             std::to_string(new_client_fd));
+                Connection &connection = connections[new_client_fd];
+                connection.id = next_connection_id++;
+                // Only formatted when something keys on it.
+                if (rate_limiter) {
+                    connection.peer = peer_address(peer);
+                }
+                connection.accept_started = accept_started;
+                connection.accept_finished = TscClock::now();
+                accept_started = connection.accept_finished;
+                if (listen_fd == tls_server_fd) {
+                    connection.tls = std::make_unique<TlsSession>(
+                        *tls_context, new_client_fd);
+                }
+                connection.http =
+                    serve_connection(new_client_fd, connection.tls != nullptr,
+                                     handler_pool, server_log);
+                if (capture) {
+                    capture->open(connection.id);
+                }
+                server_metrics.connections_accepted.add();
+                server_metrics.connections_active.add();
+            };
+            AcceptResult result =
+                accept_batch(listen_fd, MAX_ACCEPT_BATCH, on_accept);
+            if (result.error == EMFILE || result.error == ENFILE ||
+                result.error == ENOBUFS || result.error == ENOMEM) {
+                if (!accept_paused_until) {
+                    server_log.write(std::string("Failed to accept: ") +
+                                     strerror(result.error) +
+                                     ", pausing accepts");
+                }
+                accept_paused_until =
+                    std::chrono::steady_clock::now() + ACCEPT_PAUSE;
+            } else if (result.error != 0) {
+                server_log.write(std::string("Failed to accept: ") +
+                                 strerror(result.error));
+            }
         }
 
-        if (FD_ISSET(STDIN_FILENO, &read_fds)) {
+        if (poll_fds[0].revents & POLLIN) {
             std::string input;
             std::getline(std::cin, input);
 
-            if (input == "quit") {
-                for (int client_fd : client_fds) {
-                    if (send(client_fd, "SERVEREXIT", 10, 0)) {
-                        std::cerr << "Failed to send exit call\n";
-                    }
-                }
+            if (input == "quit" && !draining) {
                 server_log.write("Server terminated by user");
-                break;
-            }
-        }
-
-        for (std::vector<int>::iterator it = client_fds.begin();
-             it != client_fds.end();) {
-            int client_fd = *it;
-            if (FD_ISSET(client_fd, &read_fds)) {
-                char buffer[1024];
-                int bytes_received =
-                    recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-                if (bytes_received <= 0) {
-                    server_log.write("Client disconnected: " +
-                                     std::to_string(client_fd));
-                    close(client_fd);
-                    it = client_fds.erase(it);
-                } else {
-                    buffer[bytes_received] = '\0';
-                    std::cout << "Received: " << buffer << std::endl;
-
-                    HttpRequest request = HttpRequest::parse(buffer);
-
-                    if (request.path.compare("/test") == 0) {
-                        HttpResponse response;
-                        std::string response_str = response.ok().to_string();
-                        std::cout << "response_str: " << response_str
-                                  << std::endl;
-                        int sending_status =
-                            send(client_fd, response_str.c_str(),
-                                 response_str.length(), 0);
-                        if (sending_status == -1) {
-                            std::cerr << "Sending response failed"
-                                      << strerror(errno) << std::endl;
-                        } else {
-                            std::cout << "Sent: " << sending_status << " bytes"
-                                      << std::endl;
-                        }
-                    }
+                stop_listening();
+                start_draining(server_log);
+            }
+        }
 
-                    std::cout << "Parsed response: " << request.to_string()
-                              << std::endl;
+        // Collect the ready fds first: handling one may close it and erase
+        // it from `connections`. Errors and hangups are handled as reads so
+        // recv() reports them.
+        std::vector<int> writable;
+        std::vector<int> readable;
+        for (size_t i = FIRST_CLIENT_SLOT; i < poll_fds.size(); ++i) {
+            if (poll_fds[i].revents & POLLOUT) {
+                writable.push_back(poll_fds[i].fd);
+            }
+            if (poll_fds[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+                readable.push_back(poll_fds[i].fd);
+            }
+        }
+        for (int client_fd : tls_buffered) {
+            if (std::find(readable.begin(), readable.end(), client_fd) ==
+                readable.end()) {
+                readable.push_back(client_fd);
+            }
+        }
+
+        for (int client_fd : writable) {
+            auto found = connections.find(client_fd);
+            if (found != connections.end() && found->second.tls &&
+                !found->second.tls->established()) {
+                continue_tls_handshake(client_fd, found->second, server_log);
+                continue;
+            }
+            flush_connection(client_fd, server_log);
+        }
 
-                    std::string client = std::to_string(client_fd);
+        for (int client_fd : readable) {
+            auto found = connections.find(client_fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection &connection = found->second;
+            if (connection.tls && !connection.tls->established()) {
+                continue_tls_handshake(client_fd, connection, server_log);
+                continue;
+            }
 
-                    std::string log_entry = "Client " + client + ": " + buffer;
-                    server_log.write(log_entry);
-                    ++it;
+            // A raw upload bound for a file skips the input buffer.
+            ServerConnection &http = connection.http;
+            if (http.wants_splice()) {
+                ssize_t moved = http.splice_input(client_fd);
+                if (http.closing()) {
+                    flush_connection(client_fd, server_log);
+                    continue;
                 }
-            } else {
-                ++it;
+                if (moved < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    continue;
+                }
+                if (moved <= 0) {
+                    close_connection(client_fd, server_log);
+                    continue;
+                }
+                server_metrics.bytes_received.add(moved);
+                server_metrics.spliced_bytes.add(moved);
+                flush_connection(client_fd, server_log);
+                continue;
             }
+
+            // Past the largest buffer the request or frame is refused.
+            bool mid_request = http.mid_request();
+            size_t room = http.input_room();
+            if (room == 0) {
+                flush_connection(client_fd, server_log);
+                continue;
+            }
+            char *tail = http.input_tail();
+            ssize_t bytes_received =
+                connection.tls ? connection.tls->read(tail, room)
+                               : recv(client_fd, tail, room, 0);
+            if (bytes_received < 0 &&
+                (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+            if (bytes_received <= 0) {
+                close_connection(client_fd, server_log);
+                continue;
+            }
+            if (!mid_request) {
+                connection.first_byte = TscClock::now();
+            }
+            if (capture) {
+                capture->request(connection.id,
+                                 std::string_view(tail, bytes_received));
+            }
+            server_metrics.bytes_received.add(bytes_received);
+            http.received(static_cast<size_t>(bytes_received));
+
+            // One flush per read: every response produced by this batch of
+            // input goes out in a single writev().
+            flush_connection(client_fd, server_log);
         }
+
+        if (draining) {
+            close_idle_connections();
+        }
+        run_scheduled_flushes(server_log);
+
+        if (draining && connections.empty() && handler_pool.in_flight() == 0) {
+            break;
+        }
+        if (draining && std::chrono::steady_clock::now() >= drain_deadline) {
+            server_log.write("Drain timed out with " +
+                             std::to_string(connections.size()) +
+                             " connections open");
+            while (!connections.empty()) {
+                close_connection(connections.begin()->first, server_log);
+            }
+            break;
+        }
+    }
+
+    std::ofstream trace_file("traces.json");
+    request_tracer.write_chrome_trace(trace_file);
+    if (capture && !capture->flush()) {
+        std::cerr << "Failed to write the capture file\n";
     }
     std::string end_msg = "Shutting down server\n";
     std::cout << end_msg;
@@ -0,0 +1,123 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/admission.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+
+/////////////////////////////////
+// Admission Control
+/////////////////////////////////
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Admission - Token bucket per client", "[admission]") {
+    RateLimiter limiter(10, 3);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(limiter.try_acquire("10.0.0.1", start));
+    }
+    REQUIRE_FALSE(limiter.try_acquire("10.0.0.1", start));
+    // Other clients have buckets of their own.
+    REQUIRE(limiter.try_acquire("10.0.0.2", start));
+
+    // 10 tokens per second: one is back after 100ms.
+    REQUIRE_FALSE(limiter.try_acquire("10.0.0.1", start + 50ms));
+    REQUIRE(limiter.try_acquire("10.0.0.1", start + 150ms));
+    REQUIRE_FALSE(limiter.try_acquire("10.0.0.1", start + 150ms));
+
+    // Never more than the burst, however long the client was away.
+    auto later = start + 10s;
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(limiter.try_acquire("10.0.0.1", later));
+    }
+    REQUIRE_FALSE(limiter.try_acquire("10.0.0.1", later));
+}
+
+TEST_CASE("Admission - Rate limiter forgets full buckets", "[admission]") {
+    RateLimiter limiter(1, 2, 4);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(limiter.try_acquire("client" + std::to_string(i), start));
+    }
+    REQUIRE(limiter.tracked() == 4);
+
+    // Two seconds on every bucket is full again and can be dropped.
+    REQUIRE(limiter.try_acquire("newcomer", start + 2s));
+    REQUIRE(limiter.tracked() == 1);
+
+    // Buckets still in use are dropped only when nothing else frees room.
+    RateLimiter busy(1, 2, 2);
+    REQUIRE(busy.try_acquire("a", start));
+    REQUIRE(busy.try_acquire("b", start));
+    REQUIRE(busy.try_acquire("c", start));
+    REQUIRE(busy.tracked() == 1);
+}
+
+TEST_CASE("Admission - Concurrency limit caps requests in flight",
+          "[admission]") {
+    ConcurrencyLimiter::Options options;
+    options.initial_limit = 4;
+    ConcurrencyLimiter limiter(options);
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(limiter.try_acquire());
+    }
+    REQUIRE_FALSE(limiter.try_acquire());
+    REQUIRE(limiter.in_flight() == 4);
+    limiter.release(1ms);
+    REQUIRE(limiter.try_acquire());
+}
+
+TEST_CASE("Admission - Concurrency limit follows latency", "[admission]") {
+    ConcurrencyLimiter::Options options;
+    options.initial_limit = 32;
+    options.min_limit = 4;
+    options.max_limit = 256;
+    options.window = 16;
+    ConcurrencyLimiter limiter(options);
+
+    // Runs windows with every slot in use, each request taking `latency`.
+    auto saturate = [&limiter](std::chrono::microseconds latency,
+                               int windows) {
+        for (int window = 0; window < windows; ++window) {
+            size_t admitted = 0;
+            while (limiter.try_acquire()) {
+                ++admitted;
+            }
+            for (size_t i = 0; i < admitted; ++i) {
+                limiter.release(latency);
+            }
+        }
+    };
+
+    saturate(1000us, 20);
+    size_t grown = limiter.limit();
+    REQUIRE(grown > 32);
+
+    // Latency well past twice the baseline: the limit backs off.
+    saturate(10000us, 20);
+    REQUIRE(limiter.limit() < grown / 2);
+    REQUIRE(limiter.limit() >= options.min_limit);
+
+    // Unused capacity is no reason to grow.
+    size_t limit = limiter.limit();
+    limiter.try_acquire();
+    for (int i = 0; i < 100; ++i) {
+        limiter.try_acquire();
+        limiter.release(1000us);
+    }
+    REQUIRE(limiter.limit() <= limit + 1);
+
+    // Failures are not sampled.
+    ConcurrencyLimiter untouched(options);
+    for (int i = 0; i < 100; ++i) {
+        untouched.try_acquire();
+        untouched.release(100000us, false);
+    }
+    REQUIRE(untouched.limit() == 32);
+    REQUIRE(untouched.in_flight() == 0);
+}
@@ -0,0 +1,86 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/buffer_pool.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <thread>
+
+/////////////////////////////////
+// I/O Buffer Pool
+/////////////////////////////////
+
+TEST_CASE("Buffer Pool - Size classes", "[buffer]") {
+    BufferPool &pool = BufferPool::instance();
+
+    REQUIRE(pool.acquire(100).capacity() == 4 * 1024);
+    REQUIRE(pool.acquire(4 * 1024).capacity() == 4 * 1024);
+    REQUIRE(pool.acquire(5 * 1024).capacity() == 16 * 1024);
+    REQUIRE(pool.acquire(1024 * 1024).capacity() == 64 * 1024);
+}
+
+TEST_CASE("Buffer Pool - Buffers are reused", "[buffer]") {
+    BufferPool &pool = BufferPool::instance();
+    size_t before = pool.outstanding();
+
+    char *first_memory;
+    {
+        BufferPool::Buffer buffer = pool.acquire();
+        first_memory = buffer.data();
+        REQUIRE(pool.outstanding() == before + 1);
+    }
+    REQUIRE(pool.outstanding() == before);
+
+    // Same thread, same class: the buffer comes straight back out of the
+    // thread cache.
+    BufferPool::Buffer again = pool.acquire();
+    REQUIRE(again.data() == first_memory);
+}
+
+TEST_CASE("Buffer Pool - Buffer handle", "[buffer]") {
+    BufferPool &pool = BufferPool::instance();
+
+    SECTION("Move transfers ownership") {
+        BufferPool::Buffer buffer = pool.acquire();
+        char *memory = buffer.data();
+        BufferPool::Buffer moved = std::move(buffer);
+        REQUIRE_FALSE(buffer.valid());
+        REQUIRE(moved.data() == memory);
+    }
+
+    SECTION("Consume keeps the unread tail") {
+        BufferPool::Buffer buffer = pool.acquire();
+        std::memcpy(buffer.tail(), "GET / HTTP/1.1", 14);
+        buffer.size += 14;
+        buffer.consume(4);
+        REQUIRE(std::string(buffer.data(), buffer.size) == "/ HTTP/1.1");
+        REQUIRE(buffer.tail_room() == buffer.capacity() - 10);
+    }
+
+    SECTION("Grow preserves contents") {
+        BufferPool::Buffer buffer = pool.acquire();
+        std::memcpy(buffer.tail(), "partial", 7);
+        buffer.size = 7;
+        BufferPool::Buffer bigger = pool.grow(std::move(buffer));
+        REQUIRE(bigger.capacity() == 16 * 1024);
+        REQUIRE(std::string(bigger.data(), bigger.size) == "partial");
+
+        BufferPool::Buffer largest = pool.grow(pool.grow(std::move(bigger)));
+        REQUIRE(largest.capacity() == 64 * 1024);
+        REQUIRE(std::string(largest.data(), largest.size) == "partial");
+    }
+}
+
+TEST_CASE("Buffer Pool - Cross-thread release", "[buffer]") {
+    BufferPool &pool = BufferPool::instance();
+    size_t before = pool.outstanding();
+
+    BufferPool::Buffer buffer = pool.acquire(64 * 1024);
+    std::thread releaser([buffer = std::move(buffer)]() mutable {
+        buffer.release();
+    });
+    releaser.join();
+
+    REQUIRE(pool.outstanding() == before);
+}
@@ -0,0 +1,127 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/capture.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+/////////////////////////////////
+// Traffic Capture
+/////////////////////////////////
+
+static std::string capture_path(const std::string &name) {
+    return "/tmp/capture_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+static std::string file_contents(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+TEST_CASE("Capture - Records round trip", "[capture]") {
+    std::string path = capture_path("round_trip");
+    std::string large(300, 'x');
+    {
+        CaptureWriter writer(path);
+        writer.open(7);
+        writer.request(7, "GET /test HTTP/1.1\r\n");
+        writer.request(7, "\r\n");
+        writer.response(7, 200, 123);
+        writer.open(300);
+        writer.request(300, large);
+        writer.close(7);
+        REQUIRE(writer.records() == 7);
+    }
+
+    CaptureReader reader(path);
+    CaptureRecord record;
+    uint64_t last_timestamp = 0;
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.type == CaptureRecordType::OPEN);
+    REQUIRE(record.connection_id == 7);
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.type == CaptureRecordType::REQUEST);
+    REQUIRE(record.data == "GET /test HTTP/1.1\r\n");
+    REQUIRE(record.timestamp_us >= last_timestamp);
+    last_timestamp = record.timestamp_us;
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.data == "\r\n");
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.type == CaptureRecordType::RESPONSE);
+    REQUIRE(record.status == 200);
+    REQUIRE(record.length == 123);
+    REQUIRE(record.data.empty());
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.type == CaptureRecordType::OPEN);
+    REQUIRE(record.connection_id == 300);
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.data == large);
+    REQUIRE(record.timestamp_us >= last_timestamp);
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.type == CaptureRecordType::CLOSE);
+    REQUIRE(record.connection_id == 7);
+
+    REQUIRE_FALSE(reader.next(record));
+    REQUIRE_FALSE(reader.truncated());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Capture - Small records stay compact", "[capture]") {
+    std::string path = capture_path("compact");
+    {
+        CaptureWriter writer(path);
+        writer.request(1, "GET / HTTP/1.1\r\n\r\n");
+    }
+    // Magic, type, id, time delta, length, then the 18 bytes themselves.
+    REQUIRE(file_contents(path).size() <= 8 + 1 + 1 + 3 + 1 + 18);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Capture - Truncated and foreign files", "[capture]") {
+    SECTION("A record cut short ends the capture") {
+        std::string path = capture_path("truncated");
+        {
+            CaptureWriter writer(path);
+            writer.request(1, "complete");
+            writer.request(1, "cut short by a crash");
+        }
+        std::string contents = file_contents(path);
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write(contents.data(), contents.size() - 5);
+
+        CaptureReader reader(path);
+        CaptureRecord record;
+        REQUIRE(reader.next(record));
+        REQUIRE(record.data == "complete");
+        REQUIRE_FALSE(reader.next(record));
+        REQUIRE(reader.truncated());
+        std::remove(path.c_str());
+    }
+
+    SECTION("Files without the magic are rejected") {
+        std::string path = capture_path("foreign");
+        std::ofstream(path) << "GET / HTTP/1.1\r\n\r\n";
+        REQUIRE_THROWS_AS(CaptureReader(path), std::runtime_error);
+        std::remove(path.c_str());
+    }
+
+    SECTION("Missing files are rejected") {
+        REQUIRE_THROWS_AS(CaptureReader(capture_path("missing")),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(CaptureWriter("/nonexistent/dir/capture"),
+                          std::runtime_error);
+    }
+}
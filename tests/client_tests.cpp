@@ -0,0 +1,326 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/http2.hpp"
+#include "../core/listener.hpp"
+#include "../core/string_utils.hpp"
+#include "../core/transport.hpp"
+#include "test_helpers.hpp"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/////////////////////////////////
+// Response Reading
+/////////////////////////////////
+
+namespace {
+
+
+// Answers each request on one connection with the next canned reply, then
+// closes. A reply may hold several responses, as a pipelining server would
+// send them.
+class CannedServer {
+  public:
+    explicit CannedServer(std::vector<std::string> replies)
+        : listen_fd(open_listener(Endpoint::tcp("127.0.0.1", 0))),
+          thread([this, replies = std::move(replies)] { run(replies); }) {}
+
+    ~CannedServer() {
+        thread.join();
+        close(listen_fd);
+    }
+
+    uint16_t port() const { return local_port(listen_fd); }
+
+  private:
+    void run(const std::vector<std::string> &replies) {
+        struct pollfd ready = {listen_fd, POLLIN, 0};
+        if (poll(&ready, 1, 5000) != 1) {
+            return;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        std::string received;
+        char buffer[4096];
+        for (const std::string &reply : replies) {
+            size_t head_end;
+            while ((head_end = received.find("\r\n\r\n")) ==
+                   std::string::npos) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    close(fd);
+                    return;
+                }
+                received.append(buffer, static_cast<size_t>(n));
+            }
+            received.erase(0, head_end + 4);
+            send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        }
+        close(fd);
+    }
+
+    int listen_fd;
+    std::thread thread;
+};
+
+// Serves one cleartext HTTP/2 connection, started with the preface or by
+// "Upgrade: h2c", until the client closes it. /test and /report answer 200,
+// anything else 404.
+class H2cServer {
+  public:
+    H2cServer()
+        : listen_fd(open_listener(Endpoint::tcp("127.0.0.1", 0))),
+          thread([this] { run(); }) {}
+
+    ~H2cServer() {
+        thread.join();
+        close(listen_fd);
+    }
+
+    uint16_t port() const { return local_port(listen_fd); }
+
+  private:
+    static HttpResponse respond(const HttpRequest &request) {
+        if (request.path != "/test" && request.path != "/report") {
+            return HttpResponse(404, "Not Found");
+        }
+        HttpResponse response(200, "OK");
+        response.set_header("content-type", "text/plain");
+        response.body =
+            request.path == "/test" ? "ok" : std::string(40000, 'r');
+        response.set_header("content-length",
+                            std::to_string(response.body.size()));
+        return response;
+    }
+
+    void run() {
+        struct pollfd ready = {listen_fd, POLLIN, 0};
+        if (poll(&ready, 1, 5000) != 1) {
+            return;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        Http2Connection http2(Http2Connection::Role::SERVER);
+        bool started = false;
+        std::string received;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            received.append(buffer, static_cast<size_t>(n));
+            if (!started && received.compare(0, 3, "PRI") != 0) {
+                size_t head_end = received.find("\r\n\r\n");
+                if (head_end == std::string::npos) {
+                    continue;
+                }
+                HttpRequest request =
+                    HttpRequest::parse(received.substr(0, head_end + 4));
+                received.erase(0, head_end + 4);
+                http2.accept_upgrade(
+                    base64url_decode(request.get_header("http2-settings")),
+                    request);
+                std::string switching = "HTTP/1.1 101 Switching Protocols\r\n"
+                                        "Connection: Upgrade\r\n"
+                                        "Upgrade: h2c\r\n\r\n";
+                send(fd, switching.data(), switching.size(), MSG_NOSIGNAL);
+            }
+            started = true;
+            http2.receive(received);
+            received.clear();
+            for (auto &[stream_id, request] : http2.take_requests()) {
+                http2.submit_response(stream_id, respond(request));
+            }
+            std::string output = http2.take_output();
+            send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+        }
+        close(fd);
+    }
+
+    int listen_fd;
+    std::thread thread;
+};
+
+HttpRequest get(const std::string &path) {
+    HttpRequest request;
+    request.create_get(path);
+    return request;
+}
+
+std::string sized_response(const std::string &body) {
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\n\r\n" + body;
+}
+
+}  // namespace
+
+TEST_CASE("HttpClient - Responses parse byte for byte", "[http_client]") {
+    std::string payload = binary_payload(300);
+    HttpResponse response = HttpResponse::parse(
+        "HTTP/1.1 404 Not Found\r\nContent-Length: 300\r\n\r\n" + payload);
+    REQUIRE(response.status_code == 404);
+    REQUIRE(response.reason_phrase == "Not Found");
+    REQUIRE(response.body == payload);
+
+    HttpResponse chunked = HttpResponse::parse(
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "6\r\n" + payload.substr(0, 6) + "\r\n0\r\n\r\n");
+    REQUIRE(chunked.body == payload.substr(0, 6));
+}
+
+TEST_CASE("HttpClient - Framed bodies", "[http_client]") {
+    std::string payload = binary_payload(200000);
+
+    SECTION("Content-Length bodies, with the next response read ahead") {
+        CannedServer server({sized_response(payload) + sized_response("two"),
+                             sized_response("three")});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        REQUIRE(client.send_request(get("/1")).body == payload);
+        REQUIRE(client.send_request(get("/2")).body == "two");
+        REQUIRE(client.send_request(get("/3")).body == "three");
+    }
+
+    SECTION("Chunked bodies after an interim response") {
+        std::string reply = "HTTP/1.1 100 Continue\r\n\r\n"
+                            "HTTP/1.1 200 OK\r\n"
+                            "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t offset = 0; offset < payload.size(); offset += 70000) {
+            std::string chunk = payload.substr(offset, 70000);
+            char size[16];
+            std::snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+            reply += size + chunk + "\r\n";
+        }
+        reply += "0\r\nExpires: never\r\n\r\n";
+        CannedServer server({reply, sized_response("after")});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        HttpResponse response = client.send_request(get("/chunked"));
+        REQUIRE(response.status_code == 200);
+        REQUIRE(response.body == payload);
+        REQUIRE(client.send_request(get("/after")).body == "after");
+    }
+
+    SECTION("A HEAD response has no body") {
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\n";
+        CannedServer server({head, sized_response("next")});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        HttpRequest request = get("/");
+        request.method = "HEAD";
+        REQUIRE(client.send_request(request).body.empty());
+        REQUIRE(client.send_request(get("/next")).body == "next");
+    }
+
+    SECTION("A body without a length ends with the connection") {
+        CannedServer server({"HTTP/1.1 200 OK\r\n\r\n" + payload});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        REQUIRE(client.send_request(get("/")).body == payload);
+        REQUIRE_THROWS_AS(client.send_request(get("/")), std::runtime_error);
+    }
+
+    SECTION("A body cut short throws") {
+        CannedServer server({sized_response(payload).substr(0, 1000)});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        REQUIRE_THROWS_AS(client.send_request(get("/")), std::runtime_error);
+    }
+}
+
+TEST_CASE("HttpClient - Streamed downloads", "[http_client]") {
+    std::string payload = binary_payload(8 * 1024 * 1024);
+
+    SECTION("Into a callback") {
+        CannedServer server({sized_response(payload)});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        std::string received;
+        size_t calls = 0;
+        HttpResponse response =
+            client.send_request(get("/"), [&](std::string_view data) {
+                received.append(data);
+                ++calls;
+            });
+        REQUIRE(response.status_code == 200);
+        REQUIRE(response.body.empty());
+        REQUIRE(received == payload);
+        REQUIRE(calls > 1);
+    }
+
+    SECTION("Into a file, spliced or written") {
+        // Only the chunked one has to pass through userspace.
+        std::string chunked = "HTTP/1.1 200 OK\r\n"
+                              "Transfer-Encoding: chunked\r\n\r\n"
+                              "800000\r\n" + payload + "\r\n0\r\n\r\n";
+        for (const std::string &reply :
+             {sized_response(payload), chunked,
+              "HTTP/1.1 200 OK\r\n\r\n" + payload}) {
+            CannedServer server({reply});
+            HttpClient client("127.0.0.1", server.port());
+            REQUIRE(client.connect_to_server() == 0);
+            FILE *file = std::tmpfile();
+            REQUIRE(file != nullptr);
+            REQUIRE(client.download(get("/"), fileno(file)).status_code ==
+                    200);
+            lseek(fileno(file), 0, SEEK_SET);
+            REQUIRE(read_all(fileno(file)) == payload);
+            std::fclose(file);
+        }
+    }
+
+    SECTION("Into a buffer, which must be large enough") {
+        CannedServer server({sized_response(payload)});
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        std::vector<char> buffer(payload.size());
+        size_t size = 0;
+        client.download(get("/"), buffer.data(), buffer.size(), size);
+        REQUIRE(std::string(buffer.data(), size) == payload);
+
+        CannedServer small({sized_response(payload)});
+        HttpClient other("127.0.0.1", small.port());
+        REQUIRE(other.connect_to_server() == 0);
+        REQUIRE_THROWS_AS(
+            other.download(get("/"), buffer.data(), payload.size() - 1, size),
+            std::runtime_error);
+    }
+}
+
+TEST_CASE("HttpClient - Cleartext HTTP/2", "[http_client]") {
+    SECTION("Prior knowledge multiplexes requests") {
+        H2cServer server;
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        client.start_http2();
+        auto responses =
+            client.send_requests({get("/test"), get("/report"), get("/nope")});
+
+        REQUIRE(responses.size() == 3);
+        REQUIRE(responses[0].status_code == 200);
+        REQUIRE(responses[0].version == "HTTP/2");
+        REQUIRE(responses[1].status_code == 200);
+        REQUIRE(responses[1].body.size() ==
+                std::stoul(responses[1].get_header("content-length")));
+        REQUIRE(responses[2].status_code == 404);
+    }
+
+    SECTION("Upgrade: h2c") {
+        H2cServer server;
+        HttpClient client("127.0.0.1", server.port());
+        REQUIRE(client.connect_to_server() == 0);
+        HttpResponse response = client.upgrade_to_http2(get("/test"));
+        REQUIRE(client.using_http2());
+        REQUIRE(response.status_code == 200);
+        REQUIRE(response.version == "HTTP/2");
+        REQUIRE(response.body == "ok");
+
+        REQUIRE(client.send_request(get("/nope")).status_code == 404);
+    }
+}
@@ -0,0 +1,226 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/compression.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/////////////////////////////////
+// Compression
+/////////////////////////////////
+
+static std::string sample_json(size_t items) {
+    std::string json = "[";
+    for (size_t i = 0; i < items; ++i) {
+        json += std::string(i ? "," : "") + R"({"id":)" +
+                std::to_string(i) + R"(,"name":"item","tags":["a","b"]})";
+    }
+    return json + "]";
+}
+
+// Undoes chunked transfer coding; the trailing zero-size chunk must be there.
+static std::string dechunk(const std::string &chunked) {
+    std::string body;
+    size_t position = 0;
+    while (true) {
+        size_t line_end = chunked.find("\r\n", position);
+        REQUIRE(line_end != std::string::npos);
+        size_t size = std::stoul(chunked.substr(position, line_end - position),
+                                 nullptr, 16);
+        position = line_end + 2;
+        if (size == 0) {
+            REQUIRE(chunked.substr(position) == "\r\n");
+            return body;
+        }
+        body += chunked.substr(position, size);
+        position += size + 2;
+    }
+}
+
+TEST_CASE("Compression - Round trips", "[compression]") {
+    std::string json = sample_json(500);
+
+    for (ContentEncoding encoding :
+         {ContentEncoding::GZIP, ContentEncoding::BROTLI}) {
+        for (int level : {1, 6, 9}) {
+            std::string compressed = compress(json, encoding, level);
+            REQUIRE(compressed.size() * 5 < json.size());
+            REQUIRE(decompress(compressed, encoding) == json);
+        }
+    }
+
+    SECTION("Gzip output carries the gzip magic") {
+        std::string compressed = compress(json, ContentEncoding::GZIP, 6);
+        REQUIRE(static_cast<unsigned char>(compressed[0]) == 0x1f);
+        REQUIRE(static_cast<unsigned char>(compressed[1]) == 0x8b);
+    }
+
+    SECTION("Piecewise writes with flushes decode to the same bytes") {
+        for (ContentEncoding encoding :
+             {ContentEncoding::GZIP, ContentEncoding::BROTLI}) {
+            Compressor compressor(encoding, 6);
+            std::string output;
+            for (size_t offset = 0; offset < json.size(); offset += 1000) {
+                compressor.write(std::string_view(json).substr(offset, 1000),
+                                 output);
+                compressor.flush(output);
+            }
+            compressor.finish(output);
+            REQUIRE(decompress(output, encoding) == json);
+        }
+    }
+
+    SECTION("Corrupt input throws") {
+        std::string compressed = compress(json, ContentEncoding::GZIP, 6);
+        compressed.resize(compressed.size() / 2);
+        REQUIRE_THROWS_AS(decompress(compressed, ContentEncoding::GZIP),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(decompress("not brotli", ContentEncoding::BROTLI),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Compression - Content types", "[compression]") {
+    REQUIRE(is_compressible_type("text/html"));
+    REQUIRE(is_compressible_type("text/plain; charset=utf-8"));
+    REQUIRE(is_compressible_type("application/json"));
+    REQUIRE(is_compressible_type("Application/JSON"));
+    REQUIRE(is_compressible_type("application/ld+json"));
+    REQUIRE(is_compressible_type("image/svg+xml"));
+    REQUIRE(is_compressible_type("application/javascript"));
+    REQUIRE_FALSE(is_compressible_type("image/png"));
+    REQUIRE_FALSE(is_compressible_type("application/octet-stream"));
+    REQUIRE_FALSE(is_compressible_type("application/zip"));
+    REQUIRE_FALSE(is_compressible_type(""));
+}
+
+TEST_CASE("Compression - Responses", "[compression]") {
+    std::string json = sample_json(200);
+    HttpResponse response = HttpResponse::json_response(json);
+
+    SECTION("Negotiates brotli over gzip") {
+        REQUIRE(compress_response(response, "gzip, deflate, br", 6) ==
+                ContentEncoding::BROTLI);
+        REQUIRE(response.get_header("content-encoding") == "br");
+        REQUIRE(response.get_header("vary") == "Accept-Encoding");
+        REQUIRE(response.get_header("content-length") ==
+                std::to_string(response.body.size()));
+        REQUIRE(decompress(response.body, ContentEncoding::BROTLI) == json);
+    }
+
+    SECTION("Gzip when brotli is refused") {
+        REQUIRE(compress_response(response, "br;q=0, gzip", 6) ==
+                ContentEncoding::GZIP);
+        REQUIRE(decompress(response.body, ContentEncoding::GZIP) == json);
+    }
+
+    SECTION("An explicit refusal wins over the wildcard") {
+        REQUIRE(negotiate_encoding("gzip;q=0, *", {ContentEncoding::GZIP}) ==
+                ContentEncoding::IDENTITY);
+        REQUIRE(compress_response(response, "*, br;q=0", 6) ==
+                ContentEncoding::GZIP);
+    }
+
+    SECTION("Identity without Accept-Encoding, still varying on it") {
+        REQUIRE(compress_response(response, "", 6) ==
+                ContentEncoding::IDENTITY);
+        REQUIRE(response.body == json);
+        REQUIRE_FALSE(response.has_header("content-encoding"));
+        REQUIRE(response.get_header("vary") == "Accept-Encoding");
+    }
+
+    SECTION("Tiny bodies are skipped") {
+        HttpResponse small = HttpResponse::json_response(R"({"a":1})");
+        REQUIRE(compress_response(small, "gzip", 6) ==
+                ContentEncoding::IDENTITY);
+        REQUIRE_FALSE(small.has_header("vary"));
+    }
+
+    SECTION("Incompressible types are skipped") {
+        HttpResponse image(200, "OK");
+        image.set_body(std::string(4096, 'x'), "image/png");
+        REQUIRE(compress_response(image, "gzip", 6) ==
+                ContentEncoding::IDENTITY);
+        REQUIRE(image.body.size() == 4096);
+    }
+
+    SECTION("Already encoded and bodiless statuses are skipped") {
+        response.set_header("Content-Encoding", "gzip");
+        REQUIRE(compress_response(response, "gzip", 6) ==
+                ContentEncoding::IDENTITY);
+
+        HttpResponse not_modified(304, "Not Modified");
+        not_modified.set_body(json, "application/json");
+        REQUIRE(compress_response(not_modified, "gzip", 6) ==
+                ContentEncoding::IDENTITY);
+    }
+
+    SECTION("Existing Vary is extended") {
+        response.set_header("Vary", "Origin");
+        compress_response(response, "gzip", 6);
+        REQUIRE(response.get_header("vary") == "Origin, Accept-Encoding");
+    }
+}
+
+TEST_CASE("Compression - Streaming responses", "[compression]") {
+    std::string part = sample_json(50);
+    HttpResponse response(200, "OK");
+    response.set_streaming(
+        [&part](std::ostream &os) {
+            os << part;
+            os << std::flush;
+            os << part;
+        },
+        part.size() * 2, "application/json");
+
+    SECTION("Compressed into chunks") {
+        REQUIRE(compress_response(response, "gzip", 6) ==
+                ContentEncoding::GZIP);
+        REQUIRE(response.is_streaming_response());
+        REQUIRE(response.get_header("transfer-encoding") == "chunked");
+        REQUIRE_FALSE(response.has_header("content-length"));
+        REQUIRE(response.to_string().find("content-length") ==
+                std::string::npos);
+
+        std::ostringstream stream;
+        response.write_to_stream(stream);
+        std::string chunked = stream.str();
+        // Ends with the zero-size chunk.
+        REQUIRE(chunked.find("\r\n0\r\n\r\n") + 7 == chunked.size());
+        REQUIRE(decompress(dechunk(chunked), ContentEncoding::GZIP) ==
+                part + part);
+    }
+
+    SECTION("Left alone when chunking is not allowed") {
+        REQUIRE(compress_response(response, "gzip", 6, false) ==
+                ContentEncoding::IDENTITY);
+        REQUIRE(response.get_header("content-length") ==
+                std::to_string(part.size() * 2));
+    }
+}
+
+TEST_CASE("Compression - Adaptive level", "[compression]") {
+    AdaptiveCompressionLevel level(1, 6, 60000);
+    REQUIRE(level.level() == 6);
+
+    level.update(0.99);
+    level.update(0.99);
+    REQUIRE(level.level() == 4);
+
+    for (int i = 0; i < 10; ++i) {
+        level.update(1.0);
+    }
+    REQUIRE(level.level() == 1);
+
+    // Between the thresholds nothing changes.
+    level.update(0.7);
+    REQUIRE(level.level() == 1);
+
+    for (int i = 0; i < 10; ++i) {
+        level.update(0.1);
+    }
+    REQUIRE(level.level() == 6);
+}
@@ -0,0 +1,104 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/executor.hpp"
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <poll.h>
+#include <stdexcept>
+#include <thread>
+
+// Plays the I/O thread: waits on the completion eventfd and runs completions
+// until `expected` of them have run or the deadline passes.
+static size_t drain_completions(WorkStealingExecutor &executor,
+                                size_t expected) {
+    size_t ran = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran < expected && std::chrono::steady_clock::now() < deadline) {
+        pollfd pfd{executor.completion_fd(), POLLIN, 0};
+        if (poll(&pfd, 1, 100) > 0) {
+            ran += executor.run_completions();
+        }
+    }
+    return ran;
+}
+
+/////////////////////////////////
+// Work-Stealing Executor
+/////////////////////////////////
+
+TEST_CASE("Executor - Runs work and posts completions", "[executor]") {
+    WorkStealingExecutor executor(4);
+    REQUIRE(executor.worker_count() == 4);
+
+    std::atomic<int> work_done{0};
+    int completions = 0;
+    std::thread::id io_thread = std::this_thread::get_id();
+    bool completions_on_io_thread = true;
+
+    for (int i = 0; i < 1000; ++i) {
+        executor.submit([&work_done]() { work_done.fetch_add(1); },
+                        [&](std::exception_ptr error) {
+                            REQUIRE(error == nullptr);
+                            completions_on_io_thread &=
+                                std::this_thread::get_id() == io_thread;
+                            ++completions;
+                        });
+    }
+
+    REQUIRE(drain_completions(executor, 1000) == 1000);
+    REQUIRE(work_done.load() == 1000);
+    REQUIRE(completions == 1000);
+    REQUIRE(completions_on_io_thread);
+    REQUIRE(executor.in_flight() == 0);
+}
+
+TEST_CASE("Executor - Exceptions reach the completion", "[executor]") {
+    WorkStealingExecutor executor(2);
+    bool saw_error = false;
+
+    executor.submit([]() { throw std::runtime_error("handler failed"); },
+                    [&saw_error](std::exception_ptr error) {
+                        saw_error = error != nullptr;
+                    });
+
+    REQUIRE(drain_completions(executor, 1) == 1);
+    REQUIRE(saw_error);
+}
+
+TEST_CASE("Executor - Slow jobs do not block the rest", "[executor]") {
+    WorkStealingExecutor executor(4);
+    std::atomic<bool> release{false};
+    std::atomic<int> fast_done{0};
+
+    executor.submit(
+        [&release]() {
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        },
+        nullptr);
+    for (int i = 0; i < 100; ++i) {
+        executor.submit([&fast_done]() { fast_done.fetch_add(1); }, nullptr);
+    }
+
+    REQUIRE(drain_completions(executor, 100) == 100);
+    REQUIRE(fast_done.load() == 100);
+
+    release.store(true);
+    REQUIRE(drain_completions(executor, 1) == 1);
+}
+
+TEST_CASE("Executor - Overflowing the injection queue", "[executor]") {
+    WorkStealingExecutor executor(2, 8);
+    std::atomic<int> work_done{0};
+
+    for (int i = 0; i < 500; ++i) {
+        executor.submit([&work_done]() { work_done.fetch_add(1); }, nullptr);
+    }
+
+    REQUIRE(drain_completions(executor, 500) == 500);
+    REQUIRE(work_done.load() == 500);
+}
@@ -0,0 +1,106 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/handoff.hpp"
+#include "test_helpers.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/////////////////////////////////
+// Listener Handoff
+/////////////////////////////////
+
+TEST_CASE("Handoff - Descriptors pass over a UNIX socket", "[handoff]") {
+    int pair[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    int first_pipe[2];
+    int second_pipe[2];
+    REQUIRE(pipe(first_pipe) == 0);
+    REQUIRE(pipe(second_pipe) == 0);
+
+    send_fds(pair[0], {first_pipe[1], second_pipe[1]});
+    std::vector<int> received = receive_fds(pair[1]);
+    REQUIRE(received.size() == 2);
+    REQUIRE(received[0] != first_pipe[1]);
+
+    // The received descriptors are new numbers for the same pipes.
+    REQUIRE(write(received[0], "a", 1) == 1);
+    REQUIRE(write(received[1], "b", 1) == 1);
+    char byte = 0;
+    REQUIRE(read(first_pipe[0], &byte, 1) == 1);
+    REQUIRE(byte == 'a');
+    REQUIRE(read(second_pipe[0], &byte, 1) == 1);
+    REQUIRE(byte == 'b');
+
+    for (int fd : {first_pipe[0], first_pipe[1], second_pipe[0],
+                   second_pipe[1], received[0], received[1], pair[0]}) {
+        close(fd);
+    }
+    REQUIRE_THROWS_AS(receive_fds(pair[1]), std::runtime_error);
+    REQUIRE_THROWS_AS(send_fds(pair[1], {}), std::runtime_error);
+    close(pair[1]);
+}
+
+TEST_CASE("Handoff - Replacement gets only its handoff socket", "[handoff]") {
+    // Not close-on-exec, like an accepted client socket.
+    int leaked[2];
+    REQUIRE(pipe(leaked) == 0);
+
+    std::string script = "printf %s \"$SERVER_HANDOFF_FD\" >&3; "
+                         "[ -e /proc/$$/fd/" +
+                         std::to_string(leaked[1]) +
+                         " ] && printf ' leaked' >&3; exit 0";
+    Replacement replacement =
+        spawn_replacement("/bin/sh", {"sh", "-c", script});
+    REQUIRE(replacement.pid > 0);
+    REQUIRE(read_all(replacement.socket_fd) == std::to_string(HANDOFF_FD));
+    int status = 0;
+    REQUIRE(waitpid(replacement.pid, &status, 0) == replacement.pid);
+    REQUIRE(WIFEXITED(status));
+    close(replacement.socket_fd);
+    close(leaked[0]);
+    close(leaked[1]);
+
+    // A replacement that cannot start just hangs up.
+    Replacement missing = spawn_replacement("/nonexistent/server", {"x"});
+    REQUIRE(read_all(missing.socket_fd).empty());
+    REQUIRE(waitpid(missing.pid, &status, 0) == missing.pid);
+    REQUIRE(WEXITSTATUS(status) == 127);
+    close(missing.socket_fd);
+}
+
+TEST_CASE("Handoff - The replacement reports ready", "[handoff]") {
+    int pair[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    send_ready(pair[1]);
+    REQUIRE(receive_ready(pair[0]));
+
+    // A replacement that exits without a word is not serving.
+    close(pair[1]);
+    REQUIRE_FALSE(receive_ready(pair[0]));
+
+    // Nobody left to tell: no SIGPIPE, an exception.
+    REQUIRE_THROWS_AS(send_ready(pair[0]), std::runtime_error);
+    close(pair[0]);
+}
+
+TEST_CASE("Handoff - Inherited socket is found in the environment",
+          "[handoff]") {
+    unsetenv("SERVER_HANDOFF_FD");
+    REQUIRE(inherited_handoff_socket() == -1);
+
+    int pair[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    setenv("SERVER_HANDOFF_FD", std::to_string(pair[1]).c_str(), 1);
+    REQUIRE(inherited_handoff_socket() == pair[1]);
+    REQUIRE(std::getenv("SERVER_HANDOFF_FD") == nullptr);
+    close(pair[0]);
+    close(pair[1]);
+}
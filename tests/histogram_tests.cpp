@@ -0,0 +1,115 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/histogram.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+
+/////////////////////////////////
+// HDR Histogram
+/////////////////////////////////
+
+TEST_CASE("HDR Histogram - Bucket mapping", "[histogram]") {
+    SECTION("Small values are exact") {
+        for (uint64_t value = 0; value < 256; ++value) {
+            size_t index = HdrHistogram::bucket_index(value, 8);
+            REQUIRE(index == value);
+            REQUIRE(HdrHistogram::bucket_upper_bound(index, 8) == value);
+        }
+    }
+
+    SECTION("Every value lands in a bucket that covers it") {
+        for (uint64_t value : {256ULL, 257ULL, 1000ULL, 65535ULL, 1000000ULL,
+                               123456789ULL, (1ULL << 39) + 17}) {
+            size_t index = HdrHistogram::bucket_index(value, 8);
+            uint64_t upper = HdrHistogram::bucket_upper_bound(index, 8);
+            REQUIRE(upper >= value);
+            // Bounded relative error: 2^-(8 - 1)
+            REQUIRE(upper - value <= value / 128);
+            if (index > 0) {
+                REQUIRE(HdrHistogram::bucket_upper_bound(index - 1, 8) <
+                        value);
+            }
+        }
+    }
+
+    SECTION("Bucket count covers the configured range") {
+        size_t count = HdrHistogram::bucket_count(8, 40);
+        REQUIRE(HdrHistogram::bucket_upper_bound(count - 1, 8) ==
+                (1ULL << 40) - 1);
+    }
+}
+
+TEST_CASE("HDR Histogram - Percentiles", "[histogram]") {
+    HdrHistogram histogram;
+
+    SECTION("Empty histogram reports zeros") {
+        REQUIRE(histogram.count() == 0);
+        REQUIRE(histogram.min() == 0);
+        REQUIRE(histogram.value_at_percentile(99.0) == 0);
+    }
+
+    SECTION("Uniform values") {
+        for (uint64_t value = 1; value <= 10000; ++value) {
+            histogram.record(value);
+        }
+        REQUIRE(histogram.count() == 10000);
+        REQUIRE(histogram.min() == 1);
+        REQUIRE(histogram.max() == 10000);
+        REQUIRE(histogram.mean() == 5000.5);
+
+        uint64_t p50 = histogram.value_at_percentile(50.0);
+        REQUIRE(p50 >= 5000);
+        REQUIRE(p50 <= 5000 + 5000 / 128);
+        uint64_t p99 = histogram.value_at_percentile(99.0);
+        REQUIRE(p99 >= 9900);
+        REQUIRE(p99 <= 9900 + 9900 / 128);
+        REQUIRE(histogram.value_at_percentile(100.0) == 10000);
+    }
+
+    SECTION("A single outlier only moves the tail") {
+        histogram.record(100, 999);
+        histogram.record(5000000);
+        REQUIRE(histogram.value_at_percentile(99.0) == 100);
+        REQUIRE(histogram.value_at_percentile(99.99) == 5000000);
+        REQUIRE(histogram.max() == 5000000);
+    }
+}
+
+TEST_CASE("HDR Histogram - Merge and reset", "[histogram]") {
+    HdrHistogram first;
+    HdrHistogram second;
+    first.record(10, 3);
+    second.record(1000, 1);
+
+    first.merge(second);
+    REQUIRE(first.count() == 4);
+    REQUIRE(first.min() == 10);
+    REQUIRE(first.max() == 1000);
+
+    HdrHistogram other_precision(4, 40);
+    REQUIRE_THROWS_AS(first.merge(other_precision), std::invalid_argument);
+
+    first.reset();
+    REQUIRE(first.count() == 0);
+    REQUIRE(first.max() == 0);
+}
+
+TEST_CASE("HDR Histogram - Distribution output", "[histogram]") {
+    HdrHistogram histogram;
+    histogram.record(1000, 50);
+    histogram.record(2000, 50);
+
+    std::ostringstream out;
+    histogram.write_distribution(out, 1000.0);
+    std::string text = out.str();
+
+    REQUIRE(text.find("Percentile") != std::string::npos);
+    REQUIRE(text.find("#[Total count    = 100]") != std::string::npos);
+    REQUIRE(text.find("1.000") != std::string::npos);
+
+    std::string summary = histogram.summary(1000.0, "us");
+    REQUIRE(summary.find("p99.9") != std::string::npos);
+    REQUIRE(summary.find("max") != std::string::npos);
+}
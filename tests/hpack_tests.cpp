@@ -0,0 +1,238 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/hpack.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+#include <string>
+
+/////////////////////////////////
+// HPACK
+/////////////////////////////////
+
+static std::string from_hex(std::string_view hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes += static_cast<char>(std::stoi(std::string(hex.substr(i, 2)),
+                                             nullptr, 16));
+    }
+    return bytes;
+}
+
+TEST_CASE("HPACK - Integers", "[hpack]") {
+    SECTION("RFC 7541 C.1 examples") {
+        std::string out;
+        hpack_encode_integer(out, 10, 5);
+        REQUIRE(out == from_hex("0a"));
+
+        out.clear();
+        hpack_encode_integer(out, 1337, 5);
+        REQUIRE(out == from_hex("1f9a0a"));
+
+        out.clear();
+        hpack_encode_integer(out, 42, 8);
+        REQUIRE(out == from_hex("2a"));
+    }
+
+    SECTION("Flags above the prefix are kept") {
+        std::string out;
+        hpack_encode_integer(out, 62, 7, 0x80);
+        REQUIRE(out == from_hex("be"));
+    }
+
+    SECTION("Round trip") {
+        for (uint64_t value : {0ull, 30ull, 31ull, 127ull, 128ull, 1ull << 20,
+                               (1ull << 32) - 1}) {
+            std::string out;
+            hpack_encode_integer(out, value, 5);
+            size_t pos = 0;
+            REQUIRE(hpack_decode_integer(out, pos, 5) == value);
+            REQUIRE(pos == out.size());
+        }
+    }
+
+    SECTION("Truncated and oversized integers are rejected") {
+        size_t pos = 0;
+        REQUIRE_THROWS_AS(hpack_decode_integer(from_hex("1f9a"), pos, 5),
+                          std::runtime_error);
+        pos = 0;
+        REQUIRE_THROWS_AS(
+            hpack_decode_integer(from_hex("1fffffffffffff01"), pos, 5),
+            std::runtime_error);
+    }
+}
+
+TEST_CASE("HPACK - Huffman", "[hpack]") {
+    SECTION("RFC 7541 C.4 strings") {
+        REQUIRE(huffman_encode("www.example.com") ==
+                from_hex("f1e3c2e5f23a6ba0ab90f4ff"));
+        REQUIRE(huffman_encode("no-cache") == from_hex("a8eb10649cbf"));
+        REQUIRE(huffman_encoded_length("custom-value") == 9);
+        REQUIRE(huffman_decode(from_hex("25a849e95bb8e8b4bf")) ==
+                "custom-value");
+    }
+
+    SECTION("Every byte round trips") {
+        std::string all;
+        for (int c = 0; c < 256; ++c) {
+            all += static_cast<char>(c);
+        }
+        std::string encoded = huffman_encode(all);
+        REQUIRE(encoded.size() == huffman_encoded_length(all));
+        REQUIRE(huffman_decode(encoded) == all);
+    }
+
+    SECTION("Bad padding is rejected") {
+        // "a" is 00011; padding with zeros instead of ones.
+        REQUIRE_THROWS_AS(huffman_decode(from_hex("18")), std::runtime_error);
+        // A whole byte of padding after a complete symbol.
+        REQUIRE_THROWS_AS(huffman_decode(from_hex("1fff")),
+                          std::runtime_error);
+        // The EOS symbol itself.
+        REQUIRE_THROWS_AS(huffman_decode(from_hex("ffffffff")),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("HPACK - Dynamic table", "[hpack]") {
+    HpackDynamicTable table(100);
+    table.insert("a", "1");  // 34 bytes
+    table.insert("b", "2");
+    REQUIRE(table.count() == 2);
+    REQUIRE(table.size() == 68);
+    REQUIRE(table.at(0).name == "b");
+
+    SECTION("Inserting evicts the oldest entries") {
+        table.insert("c", "3");
+        REQUIRE(table.count() == 2);
+        REQUIRE(table.at(1).name == "b");
+    }
+
+    SECTION("Entries larger than the table empty it") {
+        table.insert("big", std::string(100, 'x'));
+        REQUIRE(table.count() == 0);
+        REQUIRE(table.size() == 0);
+    }
+
+    SECTION("Shrinking evicts") {
+        table.set_max_size(40);
+        REQUIRE(table.count() == 1);
+        REQUIRE(table.at(0).name == "b");
+    }
+}
+
+TEST_CASE("HPACK - Decoder", "[hpack]") {
+    HpackDecoder decoder;
+
+    SECTION("RFC 7541 C.2.1 literal with indexing") {
+        HeaderList fields = decoder.decode(
+            from_hex("400a637573746f6d2d6b65790d637573746f6d2d686561646572"));
+        REQUIRE(fields == HeaderList{{"custom-key", "custom-header"}});
+        REQUIRE(decoder.table().count() == 1);
+        REQUIRE(decoder.table().size() == 55);
+    }
+
+    SECTION("RFC 7541 C.2.2 literal without indexing") {
+        HeaderList fields =
+            decoder.decode(from_hex("040c2f73616d706c652f70617468"));
+        REQUIRE(fields == HeaderList{{":path", "/sample/path"}});
+        REQUIRE(decoder.table().count() == 0);
+    }
+
+    SECTION("RFC 7541 C.4 request sequence") {
+        REQUIRE(decoder.decode(from_hex(
+                    "828684418cf1e3c2e5f23a6ba0ab90f4ff")) ==
+                HeaderList{{":method", "GET"},
+                           {":scheme", "http"},
+                           {":path", "/"},
+                           {":authority", "www.example.com"}});
+        REQUIRE(decoder.decode(from_hex("828684be5886a8eb10649cbf")) ==
+                HeaderList{{":method", "GET"},
+                           {":scheme", "http"},
+                           {":path", "/"},
+                           {":authority", "www.example.com"},
+                           {"cache-control", "no-cache"}});
+        REQUIRE(decoder.decode(from_hex("828785bf408825a849e95ba97d7f8925a8"
+                                        "49e95bb8e8b4bf")) ==
+                HeaderList{{":method", "GET"},
+                           {":scheme", "https"},
+                           {":path", "/index.html"},
+                           {":authority", "www.example.com"},
+                           {"custom-key", "custom-value"}});
+        REQUIRE(decoder.table().size() == 164);
+    }
+
+    SECTION("Malformed blocks are rejected") {
+        // Index 0, an index past both tables, a truncated string.
+        REQUIRE_THROWS_AS(decoder.decode(from_hex("80")), std::runtime_error);
+        REQUIRE_THROWS_AS(decoder.decode(from_hex("ff00")),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(decoder.decode(from_hex("400a6375")),
+                          std::runtime_error);
+        // A table size update after the first field.
+        REQUIRE_THROWS_AS(decoder.decode(from_hex("823f00")),
+                          std::runtime_error);
+        // A size update above our SETTINGS_HEADER_TABLE_SIZE.
+        REQUIRE_THROWS_AS(decoder.decode(from_hex("3fe21f")),
+                          std::runtime_error);
+    }
+
+    SECTION("Header lists above the limit are rejected") {
+        decoder.set_max_header_list_size(64);
+        HpackEncoder encoder;
+        REQUIRE_THROWS_AS(
+            decoder.decode(encoder.encode({{"x-big", std::string(64, 'x')}})),
+            std::runtime_error);
+    }
+}
+
+TEST_CASE("HPACK - Encoder", "[hpack]") {
+    HpackEncoder encoder;
+
+    SECTION("RFC 7541 C.4 request sequence") {
+        REQUIRE(encoder.encode({{":method", "GET"},
+                                {":scheme", "http"},
+                                {":path", "/"},
+                                {":authority", "www.example.com"}}) ==
+                from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"));
+        REQUIRE(encoder.encode({{":method", "GET"},
+                                {":scheme", "http"},
+                                {":path", "/"},
+                                {":authority", "www.example.com"},
+                                {"cache-control", "no-cache"}}) ==
+                from_hex("828684be5886a8eb10649cbf"));
+    }
+
+    SECTION("Round trip through a decoder") {
+        HpackDecoder decoder;
+        HeaderList headers = {{":status", "200"},
+                              {"content-type", "text/plain"},
+                              {"content-length", "1234"},
+                              {"set-cookie", "session=secret"},
+                              {"x-custom", "value"}};
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(decoder.decode(encoder.encode(headers)) == headers);
+        }
+        REQUIRE(decoder.table().size() == encoder.table().size());
+        // Only content-type and x-custom are worth indexing.
+        REQUIRE(encoder.table().count() == 2);
+        // Repeats are one byte per field, bar the unindexed ones.
+        std::string repeat = encoder.encode(headers);
+        REQUIRE(repeat.size() < 30);
+    }
+
+    SECTION("Table size changes are announced") {
+        HpackDecoder decoder;
+        HeaderList headers = {{"x-custom", "value"}};
+        REQUIRE(decoder.decode(encoder.encode(headers)) == headers);
+        encoder.set_max_table_size(0);
+        encoder.set_max_table_size(256);
+        std::string block = encoder.encode(headers);
+        // Both the minimum and the final size: 0x20, then 0x3f e1 01.
+        REQUIRE(block.substr(0, 4) == from_hex("203fe101"));
+        REQUIRE(decoder.decode(block) == headers);
+        REQUIRE(decoder.table().max_size() == 256);
+        REQUIRE(decoder.table().count() == 1);
+    }
+}
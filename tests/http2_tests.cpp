@@ -0,0 +1,348 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http2.hpp"
+#include "../core/string_utils.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// HTTP/2
+/////////////////////////////////
+
+// Moves bytes both ways until neither side has anything left to say.
+static void exchange(Http2Connection &client, Http2Connection &server) {
+    while (client.wants_write() || server.wants_write()) {
+        server.receive(client.take_output());
+        client.receive(server.take_output());
+    }
+}
+
+static HttpRequest make_request(const std::string &path) {
+    HttpRequest request;
+    request.method = "GET";
+    request.path = path;
+    request.version = "HTTP/1.1";
+    request.set_header("host", "localhost:8080");
+    return request;
+}
+
+static std::string frame(Http2FrameType type, uint8_t flags, uint32_t stream,
+                         std::string_view payload) {
+    std::string out;
+    append_http2_frame(out, type, flags, stream, payload);
+    return out;
+}
+
+// Type of the last frame in `output`, which must hold only whole frames.
+static Http2FrameType last_frame_type(std::string_view output,
+                                      uint32_t *error = nullptr) {
+    Http2FrameHeader header;
+    while (!output.empty()) {
+        header = decode_http2_frame_header(output);
+        std::string_view payload =
+            output.substr(HTTP2_FRAME_HEADER_SIZE, header.length);
+        if (error != nullptr && header.type == Http2FrameType::GOAWAY) {
+            *error = static_cast<uint8_t>(payload[7]);
+        }
+        output.remove_prefix(HTTP2_FRAME_HEADER_SIZE + header.length);
+    }
+    return header.type;
+}
+
+TEST_CASE("HTTP/2 - Frames and settings", "[http2]") {
+    SECTION("Frame header round trip") {
+        std::string out = frame(Http2FrameType::HEADERS, 0x5, 3, "abc");
+        REQUIRE(out.size() == HTTP2_FRAME_HEADER_SIZE + 3);
+        Http2FrameHeader header = decode_http2_frame_header(out);
+        REQUIRE(header.length == 3);
+        REQUIRE(header.type == Http2FrameType::HEADERS);
+        REQUIRE(header.flags == 0x5);
+        REQUIRE(header.stream_id == 3);
+    }
+
+    SECTION("Only non-default settings are sent") {
+        Http2Settings settings;
+        REQUIRE(encode_http2_settings(settings).empty());
+        settings.max_concurrent_streams = 100;
+        settings.initial_window_size = 1 << 20;
+
+        Http2Settings applied;
+        apply_http2_settings(encode_http2_settings(settings), applied);
+        REQUIRE(applied.max_concurrent_streams == 100);
+        REQUIRE(applied.initial_window_size == 1 << 20);
+        REQUIRE(applied.max_frame_size == HTTP2_MIN_FRAME_SIZE);
+    }
+
+    SECTION("Invalid settings are rejected") {
+        Http2Settings settings;
+        REQUIRE_THROWS_AS(apply_http2_settings("12345", settings),
+                          Http2Error);
+        // SETTINGS_MAX_FRAME_SIZE of 1.
+        std::string payload("\x00\x05\x00\x00\x00\x01", 6);
+        REQUIRE_THROWS_AS(apply_http2_settings(payload, settings),
+                          Http2Error);
+    }
+
+    SECTION("HTTP2-Settings uses unpadded base64url") {
+        std::string payload("\x00\x03\x00\x00\x00\x64\xfb\xff", 8);
+        std::string encoded = base64url_encode(payload);
+        REQUIRE(encoded == "AAMAAABk-_8");
+        REQUIRE(base64url_decode(encoded) == payload);
+        REQUIRE_THROWS_AS(base64url_decode("AA*A"), std::runtime_error);
+    }
+}
+
+TEST_CASE("HTTP/2 - Request and response", "[http2]") {
+    Http2Connection client(Http2Connection::Role::CLIENT);
+    Http2Connection server(Http2Connection::Role::SERVER);
+
+    HttpRequest request = make_request("/test?x=1");
+    request.set_header("cookie", "a=1");
+    uint32_t id = client.submit_request(request);
+    REQUIRE(id == 1);
+    exchange(client, server);
+
+    std::vector<Http2Connection::Request> requests = server.take_requests();
+    REQUIRE(requests.size() == 1);
+    REQUIRE(requests[0].stream_id == 1);
+    REQUIRE(requests[0].request.method == "GET");
+    REQUIRE(requests[0].request.path == "/test?x=1");
+    REQUIRE(requests[0].request.version == "HTTP/2");
+    REQUIRE(requests[0].request.get_header("host") == "localhost:8080");
+    REQUIRE(requests[0].request.get_header("cookie") == "a=1");
+
+    HttpResponse response(200, "OK");
+    response.set_header("content-type", "text/plain");
+    response.set_header("connection", "keep-alive");
+    response.body = "hello";
+    server.submit_response(1, response);
+    exchange(client, server);
+
+    std::vector<Http2Connection::Response> responses = client.take_responses();
+    REQUIRE(responses.size() == 1);
+    REQUIRE(responses[0].stream_id == 1);
+    REQUIRE(responses[0].error == Http2ErrorCode::NO_ERROR);
+    REQUIRE(responses[0].response.status_code == 200);
+    REQUIRE(responses[0].response.reason_phrase == "OK");
+    REQUIRE(responses[0].response.body == "hello");
+    REQUIRE(responses[0].response.get_header("content-type") == "text/plain");
+    REQUIRE_FALSE(responses[0].response.has_header("connection"));
+    REQUIRE(client.active_streams() == 0);
+    REQUIRE(server.active_streams() == 0);
+}
+
+TEST_CASE("HTTP/2 - Multiplexing and flow control", "[http2]") {
+    Http2Connection::Options options;
+    options.max_concurrent_streams = 2;
+    options.initial_window_size = HTTP2_DEFAULT_WINDOW;
+    options.connection_window = HTTP2_DEFAULT_WINDOW;
+    Http2Connection client(Http2Connection::Role::CLIENT, options);
+    Http2Connection server(Http2Connection::Role::SERVER, options);
+    exchange(client, server);
+
+    // Five requests with a limit of two: the rest wait their turn.
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 5; ++i) {
+        ids.push_back(client.submit_request(make_request("/" +
+                                                         std::to_string(i))));
+    }
+    REQUIRE(ids == std::vector<uint32_t>{1, 3, 5, 7, 9});
+    REQUIRE(client.active_streams() == 2);
+
+    // Bodies larger than both default windows need WINDOW_UPDATEs.
+    std::string body(200000, 'x');
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    std::vector<Http2Connection::Response> responses;
+    for (int round = 0; round < 10 && responses.size() < 5; ++round) {
+        exchange(client, server);
+        for (auto &[stream_id, request] : server.take_requests()) {
+            HttpResponse response(200, "OK");
+            response.body = body;
+            server.submit_response(stream_id, response);
+        }
+        exchange(client, server);
+        for (auto &response : client.take_responses()) {
+            responses.push_back(std::move(response));
+        }
+    }
+
+    REQUIRE(responses.size() == 5);
+    for (const auto &response : responses) {
+        REQUIRE(response.error == Http2ErrorCode::NO_ERROR);
+        REQUIRE(response.response.body == body);
+    }
+    REQUIRE_FALSE(client.closed());
+    REQUIRE_FALSE(server.closed());
+}
+
+TEST_CASE("HTTP/2 - Priority", "[http2]") {
+    // The client starts with zero stream windows, so all three responses
+    // are queued before any DATA may go out. Its second SETTINGS then opens
+    // the streams while the connection window allows only ten full frames,
+    // and the server has to choose where each one goes.
+    Http2Connection server(Http2Connection::Role::SERVER);
+    HpackEncoder encoder;
+    constexpr uint32_t window = 10 * HTTP2_MIN_FRAME_SIZE;
+
+    Http2Settings settings;
+    settings.initial_window_size = 0;
+    std::string input(HTTP2_CONNECTION_PREFACE);
+    input += frame(Http2FrameType::SETTINGS, 0, 0,
+                   encode_http2_settings(settings));
+    auto open = [&](uint32_t id, uint32_t dependency, uint8_t weight) {
+        std::string payload;
+        for (int shift : {24, 16, 8, 0}) {
+            payload += static_cast<char>(dependency >> shift);
+        }
+        payload += static_cast<char>(weight - 1);
+        payload += encoder.encode({{":method", "GET"},
+                                   {":scheme", "http"},
+                                   {":path", "/"}});
+        input += frame(Http2FrameType::HEADERS,
+                       HTTP2_FLAG_END_HEADERS | HTTP2_FLAG_END_STREAM |
+                           HTTP2_FLAG_PRIORITY,
+                       id, payload);
+    };
+    open(1, 0, 16);
+    open(3, 1, 16);  // child of 1
+    open(5, 0, 64);  // sibling of 1, four times its weight
+    server.receive(input);
+    server.take_output();
+    REQUIRE(server.take_requests().size() == 3);
+
+    HttpResponse response(200, "OK");
+    response.body = std::string(400000, 'x');
+    for (uint32_t id : {1u, 3u, 5u}) {
+        server.submit_response(id, response);
+    }
+    server.take_output();
+
+    settings.initial_window_size = 1 << 20;
+    std::string increment;
+    for (int shift : {24, 16, 8, 0}) {
+        increment +=
+            static_cast<char>((window - HTTP2_DEFAULT_WINDOW) >> shift);
+    }
+    server.receive(frame(Http2FrameType::SETTINGS, 0, 0,
+                         encode_http2_settings(settings)) +
+                   frame(Http2FrameType::WINDOW_UPDATE, 0, 0, increment));
+
+    std::vector<size_t> sent(6, 0);
+    std::string taken = server.take_output();
+    std::string_view output = taken;
+    while (!output.empty()) {
+        Http2FrameHeader header = decode_http2_frame_header(output);
+        if (header.type == Http2FrameType::DATA) {
+            sent[header.stream_id] += header.length;
+        }
+        output.remove_prefix(HTTP2_FRAME_HEADER_SIZE + header.length);
+    }
+    // Stream 3 waits on its parent; stream 5 gets four fifths.
+    REQUIRE(sent[3] == 0);
+    REQUIRE(sent[1] == 2 * HTTP2_MIN_FRAME_SIZE);
+    REQUIRE(sent[5] == 8 * HTTP2_MIN_FRAME_SIZE);
+}
+
+TEST_CASE("HTTP/2 - Protocol errors", "[http2]") {
+    Http2Connection server(Http2Connection::Role::SERVER);
+    std::string input(HTTP2_CONNECTION_PREFACE);
+
+    SECTION("Bad preface") {
+        server.receive("GET / HTTP/1.1\r\n\r\n");
+        REQUIRE(server.closed());
+        uint32_t error = 0;
+        REQUIRE(last_frame_type(server.take_output(), &error) ==
+                Http2FrameType::GOAWAY);
+        REQUIRE(error == static_cast<uint32_t>(
+                             Http2ErrorCode::PROTOCOL_ERROR));
+    }
+
+    SECTION("First frame not SETTINGS") {
+        input += frame(Http2FrameType::PING, 0, 0, "12345678");
+        server.receive(input);
+        REQUIRE(server.closed());
+    }
+
+    SECTION("Malformed frames") {
+        input += frame(Http2FrameType::SETTINGS, 0, 0, "");
+        uint32_t expected = 0;
+        SECTION("PING of the wrong size") {
+            input += frame(Http2FrameType::PING, 0, 0, "1234");
+            expected = static_cast<uint32_t>(
+                Http2ErrorCode::FRAME_SIZE_ERROR);
+        }
+        SECTION("Garbage header block") {
+            input += frame(Http2FrameType::HEADERS,
+                           HTTP2_FLAG_END_HEADERS, 1, "\x80");
+            expected = static_cast<uint32_t>(
+                Http2ErrorCode::COMPRESSION_ERROR);
+        }
+        SECTION("DATA on an idle stream") {
+            input += frame(Http2FrameType::DATA, 0, 7, "abc");
+            expected = static_cast<uint32_t>(Http2ErrorCode::PROTOCOL_ERROR);
+        }
+        SECTION("Window overflow") {
+            input += frame(Http2FrameType::WINDOW_UPDATE, 0, 0,
+                           std::string("\x7f\xff\xff\xff", 4));
+            expected = static_cast<uint32_t>(
+                Http2ErrorCode::FLOW_CONTROL_ERROR);
+        }
+        server.receive(input);
+        REQUIRE(server.closed());
+        uint32_t error = 0;
+        REQUIRE(last_frame_type(server.take_output(), &error) ==
+                Http2FrameType::GOAWAY);
+        REQUIRE(error == expected);
+    }
+
+    SECTION("Malformed requests only reset their stream") {
+        input += frame(Http2FrameType::SETTINGS, 0, 0, "");
+        HpackEncoder encoder;
+        input += frame(Http2FrameType::HEADERS,
+                       HTTP2_FLAG_END_HEADERS | HTTP2_FLAG_END_STREAM, 1,
+                       encoder.encode({{":method", "GET"},
+                                       {":path", "/"},
+                                       {":scheme", "http"},
+                                       {"connection", "close"}}));
+        server.receive(input);
+        REQUIRE_FALSE(server.closed());
+        REQUIRE(server.take_requests().empty());
+        REQUIRE(last_frame_type(server.take_output()) ==
+                Http2FrameType::RST_STREAM);
+    }
+}
+
+TEST_CASE("HTTP/2 - Upgrade from HTTP/1.1", "[http2]") {
+    Http2Connection client(Http2Connection::Role::CLIENT);
+    Http2Connection server(Http2Connection::Role::SERVER);
+
+    // The upgrade request went out as HTTP/1.1 and is stream 1.
+    server.accept_upgrade(client.settings_payload(), make_request("/up"));
+    client.complete_upgrade();
+    std::vector<Http2Connection::Request> requests = server.take_requests();
+    REQUIRE(requests.size() == 1);
+    REQUIRE(requests[0].stream_id == 1);
+
+    HttpResponse response(200, "OK");
+    response.body = "upgraded";
+    server.submit_response(1, response);
+    REQUIRE(client.submit_request(make_request("/next")) == 3);
+    exchange(client, server);
+
+    for (auto &[stream_id, request] : server.take_requests()) {
+        REQUIRE(request.path == "/next");
+        server.submit_response(stream_id, HttpResponse(404, "Not Found"));
+    }
+    exchange(client, server);
+
+    std::vector<Http2Connection::Response> responses = client.take_responses();
+    REQUIRE(responses.size() == 2);
+    REQUIRE(responses[0].response.body == "upgraded");
+    REQUIRE(responses[1].stream_id == 3);
+    REQUIRE(responses[1].response.status_code == 404);
+}
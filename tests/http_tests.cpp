@@ -48,7 +48,7 @@ TEST_CASE("HTTP Request Parsing - Basic POST", "[http]") {
     REQUIRE(request.headers.size() == 3);
     REQUIRE(request.get_header("content-type") ==
             "application/x-www-form-urlencoded");
-    REQUIRE(request.body == "username=john&password=pass\n");
+    REQUIRE(request.body == "username=john&password=pass");
 }
 
 TEST_CASE("HTTP Request Parsing - Edge Cases", "[http]") {
@@ -83,6 +83,31 @@ TEST_CASE("HTTP Request Parsing - Edge Cases", "[http]") {
     }
 }
 
+TEST_CASE("HTTP Request Framing", "[http]") {
+    SECTION("Incomplete head") {
+        REQUIRE(HttpRequest::complete_length("GET / HTTP/1.1\r\nHost: a") ==
+                0);
+    }
+
+    SECTION("Head without body") {
+        std::string request = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+        REQUIRE(HttpRequest::complete_length(request) == request.size());
+    }
+
+    SECTION("Body is waited for") {
+        std::string head = "POST /f HTTP/1.1\r\ncontent-LENGTH: 5\r\n\r\n";
+        REQUIRE(HttpRequest::complete_length(head + "abc") == 0);
+        REQUIRE(HttpRequest::complete_length(head + "abcde") ==
+                head.size() + 5);
+    }
+
+    SECTION("Pipelined requests are framed one at a time") {
+        std::string first = "GET /1 HTTP/1.1\r\n\r\n";
+        std::string second = "GET /2 HTTP/1.1\r\n\r\n";
+        REQUIRE(HttpRequest::complete_length(first + second) == first.size());
+    }
+}
+
 /////////////////////////////////
 // HTTP Request Creation
 /////////////////////////////////
@@ -651,6 +676,49 @@ TEST_CASE("HTTP Response - Enhanced Features", "[http]") {
     }
 }
 
+TEST_CASE("HTTP Response - Serialization", "[http]") {
+    SECTION("Standard status line and canonical header names") {
+        HttpResponse response = HttpResponse::ok("hi");
+        response.set_header("etag", "\"v1\"");
+        response.set_header("www-authenticate", "Basic");
+
+        REQUIRE(response.to_string() == "HTTP/1.1 200 OK\r\n"
+                                        "Content-Length: 2\r\n"
+                                        "Content-Type: text/plain\r\n"
+                                        "ETag: \"v1\"\r\n"
+                                        "WWW-Authenticate: Basic\r\n"
+                                        "\r\n"
+                                        "hi");
+    }
+
+    SECTION("Unknown headers fall back to format_header_name") {
+        HttpResponse response;
+        response.set_header("x-request-id", "abc");
+        REQUIRE(response.to_string().find("X-Request-Id: abc\r\n") !=
+                std::string::npos);
+    }
+
+    SECTION("Non-standard reason phrase is formatted") {
+        HttpResponse response(299, "Custom Status");
+        REQUIRE(response.to_string().rfind("HTTP/1.1 299 Custom Status\r\n",
+                                           0) == 0);
+
+        HttpResponse legacy(200, "Fine", "HTTP/1.0");
+        REQUIRE(legacy.to_string().rfind("HTTP/1.0 200 Fine\r\n", 0) == 0);
+    }
+
+    SECTION("Synthesized Content-Length keeps header order") {
+        HttpResponse response;
+        response.set_header("Age", "1");
+        response.set_header("Server", "test");
+        REQUIRE(response.to_string() == "HTTP/1.1 200 OK\r\n"
+                                        "Age: 1\r\n"
+                                        "Content-Length: 0\r\n"
+                                        "Server: test\r\n"
+                                        "\r\n");
+    }
+}
+
 TEST_CASE("HttpClient - Constructor and Hostname Resolution", "[client]") {
     SECTION("Valid hostname resolution - localhost") {
         REQUIRE_NOTHROW(HttpClient("localhost", 8080));
@@ -0,0 +1,289 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/json.hpp"
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// JSON Serialization
+/////////////////////////////////
+
+struct Dimensions {
+    double width;
+    double height;
+};
+JSON_FIELDS(Dimensions, width, height)
+
+struct Product {
+    int64_t id;
+    std::string name;
+    bool active;
+    std::vector<std::string> tags;
+    std::optional<Dimensions> size;
+    std::optional<std::string> note;
+};
+JSON_FIELDS(Product, id, name, active, tags, size, note)
+
+TEST_CASE("JSON - Scalars", "[json]") {
+    REQUIRE(to_json(true) == "true");
+    REQUIRE(to_json(false) == "false");
+    REQUIRE(to_json(nullptr) == "null");
+    REQUIRE(to_json(0) == "0");
+    REQUIRE(to_json(-42) == "-42");
+    REQUIRE(to_json(std::numeric_limits<int64_t>::min()) ==
+            "-9223372036854775808");
+    REQUIRE(to_json(std::numeric_limits<uint64_t>::max()) ==
+            "18446744073709551615");
+    REQUIRE(to_json(19.99) == "19.99");
+    REQUIRE(to_json(-2.2250738585072014e-308) == "-2.2250738585072014e-308");
+    REQUIRE(to_json(0.5f) == "0.5");
+    REQUIRE(to_json(std::numeric_limits<double>::quiet_NaN()) == "null");
+    REQUIRE(to_json(std::numeric_limits<double>::infinity()) == "null");
+}
+
+TEST_CASE("JSON - Strings are escaped", "[json]") {
+    REQUIRE(to_json("plain") == R"("plain")");
+    REQUIRE(to_json(std::string("say \"hi\"\\")) == R"("say \"hi\"\\")");
+    REQUIRE(to_json(std::string("a\nb\tc\r")) == R"("a\nb\tc\r")");
+    REQUIRE(to_json(std::string("\x01\x1f", 2)) == R"("\u0001\u001f")");
+    REQUIRE(to_json(std::string("\0", 1)) == R"("\u0000")");
+    REQUIRE(to_json(std::string("caf\xc3\xa9")) == "\"caf\xc3\xa9\"");
+    REQUIRE(to_json(std::string_view("")) == R"("")");
+}
+
+TEST_CASE("JSON - Containers and optionals", "[json]") {
+    REQUIRE(to_json(std::vector<int>{}) == "[]");
+    REQUIRE(to_json(std::vector<int>{1, 2, 3}) == "[1,2,3]");
+    REQUIRE(to_json(std::array<bool, 2>{true, false}) == "[true,false]");
+    REQUIRE(to_json(std::vector<std::vector<int>>{{1}, {}, {2, 3}}) ==
+            "[[1],[],[2,3]]");
+    REQUIRE(to_json(std::map<std::string, int>{{"a", 1}, {"b\"", 2}}) ==
+            R"({"a":1,"b\"":2})");
+    REQUIRE(to_json(std::map<std::string, std::vector<int>>{}) == "{}");
+    REQUIRE(to_json(std::optional<int>()) == "null");
+    REQUIRE(to_json(std::optional<int>(5)) == "5");
+    REQUIRE(to_json(std::vector<std::optional<std::string>>{"x", {}}) ==
+            R"(["x",null])");
+}
+
+TEST_CASE("JSON - Registered structs", "[json]") {
+    Product product{7, "widget", true, {"a", "b"}, Dimensions{1.5, 2}, {}};
+    REQUIRE(to_json(product) ==
+            R"({"id":7,"name":"widget","active":true,"tags":["a","b"],)"
+            R"("size":{"width":1.5,"height":2},"note":null})");
+
+    std::vector<Product> products(2, product);
+    products[1].size.reset();
+    products[1].note = "line\nbreak";
+    std::string json = to_json(products);
+    REQUIRE(json.front() == '[');
+    REQUIRE(json.find(R"("size":null,"note":"line\nbreak"})") !=
+            std::string::npos);
+}
+
+TEST_CASE("JSON - Requests and responses", "[json]") {
+    Product product{1, "lamp", false, {}, {}, {}};
+    std::string expected =
+        R"({"id":1,"name":"lamp","active":false,"tags":[],)"
+        R"("size":null,"note":null})";
+
+    SECTION("create_post serializes the value") {
+        HttpRequest request;
+        request.create_post("/api/products", product);
+        REQUIRE(request.method == "POST");
+        REQUIRE(request.body == expected);
+        REQUIRE(request.get_header("content-type") == "application/json");
+        REQUIRE(request.get_header("content-length") ==
+                std::to_string(expected.size()));
+    }
+
+    SECTION("create_put with a map") {
+        HttpRequest request;
+        request.create_put("/api/settings",
+                           std::map<std::string, int>{{"volume", 11}});
+        REQUIRE(request.method == "PUT");
+        REQUIRE(request.body == R"({"volume":11})");
+    }
+
+    SECTION("Strings are still sent as they are") {
+        HttpRequest request;
+        request.create_post("/api/raw", std::string(R"({"raw":true})"));
+        REQUIRE(request.body == R"({"raw":true})");
+        request.create_post("/api/raw", "literal", "text/plain");
+        REQUIRE(request.body == "literal");
+    }
+
+    SECTION("json_response serializes the value") {
+        HttpResponse response = HttpResponse::json_response(product);
+        REQUIRE(response.body == expected);
+        REQUIRE(response.get_header("content-type") == "application/json");
+        REQUIRE(response.get_header("content-length") ==
+                std::to_string(expected.size()));
+
+        HttpResponse text = HttpResponse::json_response(R"({"a":1})");
+        REQUIRE(text.body == R"({"a":1})");
+    }
+}
+
+/////////////////////////////////
+// JSON Reader
+/////////////////////////////////
+
+TEST_CASE("JSON Reader - Field access", "[json]") {
+    JsonDocument document(R"( {
+        "id": 42, "name": "widget", "price": -19.5e1, "active": true,
+        "note": null, "tags": ["a", "b", "c"],
+        "size": {"width": 1.5, "height": 2, "unit": {"name": "cm"}},
+        "empty": {}, "none": []
+    } )");
+
+    REQUIRE(document.root().type() == JsonValue::Type::OBJECT);
+    REQUIRE(document["id"].get_int64() == 42);
+    REQUIRE(document["id"].get<int>() == 42);
+    REQUIRE(document["name"].get_raw_string() == "widget");
+    REQUIRE(document["name"].get<std::string>() == "widget");
+    REQUIRE(document["price"].get_double() == -195.0);
+    REQUIRE(document["active"].get_bool());
+    REQUIRE(document["note"].is_null());
+    REQUIRE_FALSE(document["note"].get<std::optional<int>>());
+    REQUIRE(document["tags"].size() == 3);
+    REQUIRE(document["tags"][2].get_raw_string() == "c");
+    REQUIRE(document["size"]["unit"]["name"].get_raw_string() == "cm");
+    REQUIRE(document["size"].raw() ==
+            R"({"width": 1.5, "height": 2, "unit": {"name": "cm"}})");
+    REQUIRE(document["empty"].size() == 0);
+    REQUIRE(document["none"].size() == 0);
+    REQUIRE_FALSE(document.root().find("missing"));
+
+    SECTION("Paths") {
+        REQUIRE(document.at_path("/size/height").get_int64() == 2);
+        REQUIRE(document.at_path("/tags/1").get_raw_string() == "b");
+        REQUIRE(document.at_path("").type() == JsonValue::Type::OBJECT);
+        REQUIRE(JsonDocument(R"({"a/b": {"~x": 1}})")
+                    .at_path("/a~1b/~0x")
+                    .get_int64() == 1);
+        REQUIRE_THROWS_AS(document.at_path("/tags/3"), std::runtime_error);
+        REQUIRE_THROWS_AS(document.at_path("/tags/x"), std::runtime_error);
+        REQUIRE_THROWS_AS(document.at_path("size"), std::runtime_error);
+    }
+
+    SECTION("Iteration") {
+        std::vector<std::string_view> keys;
+        for (auto it = document["size"].begin(); it != document["size"].end();
+             ++it) {
+            keys.push_back(it.key());
+        }
+        REQUIRE(keys == std::vector<std::string_view>{"width", "height",
+                                                      "unit"});
+        std::string joined;
+        for (JsonValue tag : document["tags"]) {
+            joined += tag.get_raw_string();
+        }
+        REQUIRE(joined == "abc");
+    }
+
+    SECTION("Wrong types and missing fields throw") {
+        REQUIRE_THROWS_AS(document["missing"], std::runtime_error);
+        REQUIRE_THROWS_AS(document["name"].get_int64(), std::runtime_error);
+        REQUIRE_THROWS_AS(document["id"].get_raw_string(), std::runtime_error);
+        REQUIRE_THROWS_AS(document["tags"]["a"], std::runtime_error);
+        REQUIRE_THROWS_AS(document["size"][0], std::runtime_error);
+        REQUIRE_THROWS_AS(document["id"].size(), std::runtime_error);
+    }
+}
+
+TEST_CASE("JSON Reader - Numbers", "[json]") {
+    JsonDocument document(
+        R"([9223372036854775807, -9223372036854775808, 18446744073709551615,)"
+        R"( 300, -1, 1e400, 0.1, 12abc])");
+    REQUIRE(document.root()[0].get_int64() ==
+            std::numeric_limits<int64_t>::max());
+    REQUIRE(document.root()[1].get_int64() ==
+            std::numeric_limits<int64_t>::min());
+    REQUIRE(document.root()[2].get_uint64() ==
+            std::numeric_limits<uint64_t>::max());
+    REQUIRE_THROWS_AS(document.root()[2].get_int64(), std::runtime_error);
+    REQUIRE(document.root()[3].get<int16_t>() == 300);
+    REQUIRE_THROWS_AS(document.root()[3].get<int8_t>(), std::runtime_error);
+    REQUIRE_THROWS_AS(document.root()[4].get<uint32_t>(), std::runtime_error);
+    REQUIRE_THROWS_AS(document.root()[5].get_double(), std::runtime_error);
+    REQUIRE(document.root()[6].get_double() == 0.1);
+    REQUIRE_THROWS_AS(document.root()[7].get_int64(), std::runtime_error);
+    REQUIRE(JsonDocument("7").root().get_int64() == 7);
+}
+
+TEST_CASE("JSON Reader - Strings", "[json]") {
+    JsonDocument document(
+        R"({"quote": "say \"hi\" \\", "brackets": "{[,:]}",)"
+        R"( "esc\"aped": 1, "unicode": "café 😀 \/\n",)"
+        R"( "lone": "\ud83d", "bad": "\q"})");
+    REQUIRE(document["quote"].get_raw_string() == R"(say \"hi\" \\)");
+    REQUIRE(document["quote"].get_string() == R"(say "hi" \)");
+    REQUIRE(document["brackets"].get_string() == "{[,:]}");
+    REQUIRE(document["esc\"aped"].get_int64() == 1);
+    REQUIRE(document["unicode"].get_string() ==
+            "caf\xc3\xa9 \xf0\x9f\x98\x80 /\n");
+    REQUIRE_THROWS_AS(document["lone"].get_string(), std::runtime_error);
+    REQUIRE_THROWS_AS(document["bad"].get_string(), std::runtime_error);
+}
+
+TEST_CASE("JSON Reader - Block boundaries", "[json]") {
+    // Quotes, backslashes and scalars straddling the 64-byte blocks the
+    // index is built from.
+    for (size_t padding = 0; padding < 130; ++padding) {
+        std::string json = R"({"pad":")" + std::string(padding, 'x') +
+                           R"(","esc":"\\\"[{","n":12345,"list":[true,)" +
+                           std::string(padding % 7, ' ') + R"(false]})";
+        JsonDocument document(json);
+        REQUIRE(document["pad"].get_raw_string().size() == padding);
+        REQUIRE(document["esc"].get_string() == "\\\"[{");
+        REQUIRE(document["n"].get_int64() == 12345);
+        REQUIRE_FALSE(document["list"][1].get_bool());
+    }
+
+    // A run of backslashes ending exactly at a block edge.
+    for (size_t slashes = 1; slashes < 8; ++slashes) {
+        for (size_t start = 56; start < 66; ++start) {
+            std::string value =
+                std::string(start, 'y') + std::string(slashes * 2, '\\');
+            std::string json = R"({"v":")" + value + R"(","w":1})";
+            JsonDocument document(json);
+            REQUIRE(document["v"].get_raw_string() == value);
+            REQUIRE(document["w"].get_int64() == 1);
+        }
+    }
+}
+
+TEST_CASE("JSON Reader - Malformed input throws", "[json]") {
+    for (const char *json :
+         {"", "   ", R"({"a":1)", R"({"a":"1})", R"({"a":[1})", R"([1]])",
+          R"({"a":1} 2)", R"(["a])", "]", R"({"a"})", R"({"a":})",
+          R"({"a" 1})", R"({"a":1,"b"})", R"({"a":1,})", R"({"a":1 "b":2})",
+          R"({1:2})", R"({"a"::1})", R"([1,])", R"([,1])", R"([1 2])",
+          R"([1,,2])", R"({,})", R"({"a":1}:)", "1 2", ":", ","}) {
+        INFO(json);
+        REQUIRE_THROWS_AS(JsonDocument(json), std::runtime_error);
+    }
+    REQUIRE_THROWS_AS(JsonDocument("[tru]").root()[0].get_bool(),
+                      std::runtime_error);
+}
+
+TEST_CASE("JSON Reader - Request bodies", "[json]") {
+    HttpRequest request = HttpRequest::parse(
+        "POST /api/orders HTTP/1.1\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 38\r\n\r\n"
+        R"({"order":{"id":9,"items":[{"qty":3}]}})");
+    JsonDocument body = request.json();
+    REQUIRE(body.at_path("/order/id").get<int>() == 9);
+    REQUIRE(body.at_path("/order/items/0/qty").get<unsigned>() == 3);
+}
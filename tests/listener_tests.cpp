@@ -0,0 +1,118 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/listener.hpp"
+#include <arpa/inet.h>
+#include <catch2/catch_test_macros.hpp>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+/////////////////////////////////
+// TCP Listener
+/////////////////////////////////
+
+namespace {
+
+int connect_to(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)) == 0);
+    return fd;
+}
+
+int get_option(int fd, int level, int name) {
+    int value = 0;
+    socklen_t length = sizeof(value);
+    REQUIRE(getsockopt(fd, level, name, &value, &length) == 0);
+    return value;
+}
+
+}  // namespace
+
+TEST_CASE("Listener - Options are applied", "[listener]") {
+    ListenerOptions options;
+    options.backlog = 64;
+    options.defer_accept_seconds = 2;
+    options.fastopen_queue = 16;
+    options.reuse_port = true;
+    options.incoming_cpu = 0;
+    int listen_fd = open_tcp_listener(0, options);
+    REQUIRE(local_port(listen_fd) != 0);
+
+    REQUIRE(fcntl(listen_fd, F_GETFL) & O_NONBLOCK);
+    REQUIRE(fcntl(listen_fd, F_GETFD) & FD_CLOEXEC);
+    REQUIRE(get_option(listen_fd, SOL_SOCKET, SO_REUSEADDR) != 0);
+    REQUIRE(get_option(listen_fd, SOL_SOCKET, SO_REUSEPORT) != 0);
+    // The kernel rounds the timeout to whole retransmissions.
+    REQUIRE(get_option(listen_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT) >= 2);
+    REQUIRE(get_option(listen_fd, IPPROTO_TCP, TCP_FASTOPEN) == 16);
+
+    // SO_REUSEPORT lets a second listener share the port.
+    int sibling = open_tcp_listener(local_port(listen_fd), options);
+    close(sibling);
+    REQUIRE_THROWS_AS(open_tcp_listener(local_port(listen_fd)),
+                      std::runtime_error);
+    close(listen_fd);
+}
+
+TEST_CASE("Listener - Batches drain the backlog", "[listener]") {
+    int listen_fd = open_tcp_listener(0);
+    uint16_t port = local_port(listen_fd);
+
+    std::vector<int> clients;
+    for (int i = 0; i < 20; ++i) {
+        clients.push_back(connect_to(port));
+    }
+
+    std::vector<int> accepted;
+    auto on_accept = [&accepted](int fd, const sockaddr_storage &peer) {
+        REQUIRE(peer_address(peer) == "127.0.0.1");
+        REQUIRE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+        REQUIRE(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+        accepted.push_back(fd);
+    };
+    AcceptResult first = accept_batch(listen_fd, 8, on_accept);
+    REQUIRE(first.accepted == 8);
+    REQUIRE(first.error == 0);
+    AcceptResult rest = accept_batch(listen_fd, 100, on_accept);
+    REQUIRE(rest.accepted == 12);
+    REQUIRE(rest.error == 0);
+    REQUIRE(accept_batch(listen_fd, 100, on_accept).accepted == 0);
+
+    for (int fd : accepted) {
+        close(fd);
+    }
+    for (int fd : clients) {
+        close(fd);
+    }
+    close(listen_fd);
+}
+
+TEST_CASE("Listener - Peer addresses", "[listener]") {
+    sockaddr_storage peer = {};
+    auto &v4 = reinterpret_cast<sockaddr_in &>(peer);
+    v4.sin_family = AF_INET;
+    inet_pton(AF_INET, "203.0.113.7", &v4.sin_addr);
+    REQUIRE(peer_address(peer) == "203.0.113.7");
+
+    peer = {};
+    auto &v6 = reinterpret_cast<sockaddr_in6 &>(peer);
+    v6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "2001:db8::1", &v6.sin6_addr);
+    REQUIRE(peer_address(peer) == "2001:db8::1");
+
+    peer = {};
+    peer.ss_family = AF_UNIX;
+    REQUIRE(peer_address(peer).empty());
+}
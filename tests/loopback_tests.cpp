@@ -0,0 +1,298 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/loopback.hpp"
+#include "test_helpers.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// Loopback Transport
+/////////////////////////////////
+
+namespace {
+
+void write_all(LoopbackStream &stream, const std::string &data) {
+    REQUIRE(stream.write(data.data(), data.size()) ==
+            static_cast<ssize_t>(data.size()));
+}
+
+// Splits what the server sent into responses.
+std::vector<HttpResponse> parse_responses(std::string received) {
+    std::vector<HttpResponse> responses;
+    size_t length;
+    while ((length = HttpResponse::complete_length(received)) > 0) {
+        responses.push_back(HttpResponse::parse(received.substr(0, length)));
+        received.erase(0, length);
+    }
+    REQUIRE(received.empty());
+    return responses;
+}
+
+HttpResponse echo_path(const HttpRequest &request) {
+    return HttpResponse::ok(request.path);
+}
+
+void echo_message(ServerConnection &connection, WebSocketOpcode opcode,
+                  const std::string &payload) {
+    connection.send_message(opcode, payload);
+}
+
+std::string client_frame(WebSocketOpcode opcode, const std::string &payload) {
+    return encode_websocket_frame(opcode, payload, true, 0x12345678);
+}
+
+std::vector<WebSocketFrame> decode_frames(std::string_view data) {
+    std::vector<WebSocketFrame> frames;
+    while (!data.empty()) {
+        WebSocketFrame frame;
+        size_t length = decode_websocket_frame(data, frame);
+        REQUIRE(length > 0);
+        frames.push_back(frame);
+        data.remove_prefix(length);
+    }
+    return frames;
+}
+
+const std::string UPGRADE = "GET /ws HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "Upgrade: websocket\r\n"
+                            "Connection: Upgrade\r\n"
+                            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                            "Sec-WebSocket-Version: 13\r\n\r\n";
+
+}  // namespace
+
+TEST_CASE("Loopback - Rings wrap around", "[loopback]") {
+    ByteRing ring(5);
+    REQUIRE(ring.capacity() == 8);
+    REQUIRE(ring.write("abcdef", 6) == 6);
+    char out[8] = {};
+    REQUIRE(ring.read(out, 4) == 4);
+    REQUIRE(std::string(out, 4) == "abcd");
+    // Six bytes, four of them past the end of the storage.
+    REQUIRE(ring.write("ghijklmn", 8) == 6);
+    REQUIRE(ring.space() == 0);
+    REQUIRE(ring.read(out, sizeof(out)) == 8);
+    REQUIRE(std::string(out, 8) == "efghijkl");
+    REQUIRE(ring.size() == 0);
+}
+
+TEST_CASE("Loopback - Streams behave like non-blocking sockets",
+          "[loopback]") {
+    auto [client, server] = LoopbackStream::pair(16);
+    char buffer[32];
+    REQUIRE(server.read(buffer, sizeof(buffer)) == -1);
+    REQUIRE(errno == EAGAIN);
+
+    REQUIRE(client.write("0123456789abcdefXYZ", 19) == 16);
+    REQUIRE(client.write("X", 1) == -1);
+    REQUIRE(errno == EAGAIN);
+    REQUIRE(server.readable() == 16);
+
+    client.close();
+    REQUIRE(server.read(buffer, sizeof(buffer)) == 16);
+    REQUIRE(server.read(buffer, sizeof(buffer)) == 0);
+    REQUIRE(client.write("X", 1) == -1);
+    REQUIRE(errno == EPIPE);
+
+    // The other direction is still open, like after shutdown(SHUT_WR).
+    REQUIRE(server.write("pong", 4) == 4);
+    REQUIRE(client.read(buffer, sizeof(buffer)) == 4);
+    REQUIRE(client.read(buffer, sizeof(buffer)) == -1);
+    REQUIRE(errno == EAGAIN);
+
+    // Once both ends have closed, neither can write.
+    server.close();
+    REQUIRE(server.write("X", 1) == -1);
+    REQUIRE(errno == EPIPE);
+    REQUIRE(client.read(buffer, sizeof(buffer)) == 0);
+    REQUIRE(client.at_end());
+    REQUIRE(server.at_end());
+}
+
+TEST_CASE("Loopback - HTTP requests through the state machine",
+          "[loopback]") {
+    auto [client, server] = LoopbackStream::pair();
+    ServerConnection connection(echo_path);
+
+    SECTION("Pipelined requests are answered in order") {
+        write_all(client, "GET /a HTTP/1.1\r\n\r\n"
+                          "GET /b HTTP/1.1\r\n\r\n"
+                          "POST /c HTTP/1.1\r\nContent-Length: 3\r\n\r\nxyz");
+        REQUIRE(serve(connection, server));
+        auto responses = parse_responses(read_all(client));
+        REQUIRE(responses.size() == 3);
+        REQUIRE(responses[0].body.rfind("/a", 0) == 0);
+        REQUIRE(responses[1].body.rfind("/b", 0) == 0);
+        REQUIRE(responses[2].body.rfind("/c", 0) == 0);
+        REQUIRE(connection.requests() == 3);
+    }
+
+    SECTION("A request split across reads waits for its last byte") {
+        std::string request = "GET /split HTTP/1.1\r\nHost: x\r\n\r\n";
+        for (char byte : request) {
+            REQUIRE(read_all(client).empty());
+            write_all(client, std::string(1, byte));
+            REQUIRE(serve(connection, server));
+        }
+        auto responses = parse_responses(read_all(client));
+        REQUIRE(responses.size() == 1);
+        REQUIRE(responses[0].body.rfind("/split", 0) == 0);
+    }
+
+    SECTION("A malformed request line gets a 400") {
+        write_all(client, "NONSENSE\r\n\r\n");
+        REQUIRE(serve(connection, server));
+        auto responses = parse_responses(read_all(client));
+        REQUIRE(responses.size() == 1);
+        REQUIRE(responses[0].status_code == 400);
+    }
+
+    SECTION("A head that never ends is refused and the stream closed") {
+        std::string header = "X-Filler: " + std::string(1000, 'a') + "\r\n";
+        write_all(client, "GET / HTTP/1.1\r\n");
+        bool open = true;
+        for (int i = 0; i < 100 && open; ++i) {
+            write_all(client, header);
+            open = serve(connection, server);
+        }
+        REQUIRE_FALSE(open);
+        REQUIRE(connection.closing());
+        std::string received = read_all(client);
+        REQUIRE(received.rfind("HTTP/1.1 431", 0) == 0);
+        char byte;
+        REQUIRE(client.read(&byte, 1) == 0);
+    }
+
+    SECTION("Output waits while the client does not read") {
+        ServerConnection large([](const HttpRequest &) {
+            return HttpResponse::ok(std::string(200 * 1024, 'z'));
+        });
+        write_all(client, "GET / HTTP/1.1\r\n\r\n");
+        REQUIRE(serve(large, server));
+        REQUIRE_FALSE(large.output().empty());
+
+        std::string received;
+        while (!large.output().empty() || client.readable() > 0) {
+            received += read_all(client);
+            REQUIRE(serve(large, server));
+        }
+        auto responses = parse_responses(received);
+        REQUIRE(responses.size() == 1);
+        REQUIRE(responses[0].body.rfind(std::string(200 * 1024, 'z'), 0) ==
+                0);
+    }
+
+    SECTION("The client closing ends the connection") {
+        client.close();
+        REQUIRE_FALSE(serve(connection, server));
+    }
+}
+
+TEST_CASE("Loopback - WebSocket through the state machine", "[loopback]") {
+    auto [client, server] = LoopbackStream::pair();
+    ServerConnection connection(echo_path, echo_message);
+
+    write_all(client, UPGRADE);
+    REQUIRE(serve(connection, server));
+    std::string received = read_all(client);
+    REQUIRE(received.rfind("HTTP/1.1 101", 0) == 0);
+    REQUIRE(received.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") !=
+            std::string::npos);
+    REQUIRE(connection.is_websocket());
+
+    SECTION("Messages are echoed, fragmented ones reassembled") {
+        std::string fragmented =
+            client_frame(WebSocketOpcode::TEXT, "hel");
+        fragmented[0] &= 0x7F;  // FIN clear
+        std::string rest =
+            client_frame(WebSocketOpcode::CONTINUATION, "lo");
+        write_all(client, client_frame(WebSocketOpcode::BINARY, "one") +
+                              fragmented +
+                              client_frame(WebSocketOpcode::PING, "p") +
+                              rest);
+        REQUIRE(serve(connection, server));
+
+        auto frames = decode_frames(read_all(client));
+        REQUIRE(frames.size() == 3);
+        REQUIRE(frames[0].opcode == WebSocketOpcode::BINARY);
+        REQUIRE(frames[0].payload == "one");
+        // Control frames may come between fragments.
+        REQUIRE(frames[1].opcode == WebSocketOpcode::PONG);
+        REQUIRE(frames[1].payload == "p");
+        REQUIRE(frames[2].opcode == WebSocketOpcode::TEXT);
+        REQUIRE(frames[2].payload == "hello");
+        REQUIRE(connection.messages() == 2);
+    }
+
+    SECTION("A frame larger than the input buffer is collected whole") {
+        std::string payload = binary_payload(100000);
+        std::string frame = client_frame(WebSocketOpcode::BINARY, payload);
+        std::string received;
+        for (size_t offset = 0; offset < frame.size(); offset += 30000) {
+            write_all(client, frame.substr(offset, 30000));
+            REQUIRE(serve(connection, server));
+            received += read_all(client);
+        }
+        while (!connection.output().empty()) {
+            REQUIRE(serve(connection, server));
+            received += read_all(client);
+        }
+        auto frames = decode_frames(received);
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].opcode == WebSocketOpcode::BINARY);
+        REQUIRE(frames[0].payload == payload);
+        REQUIRE(connection.messages() == 1);
+    }
+
+    SECTION("A frame announcing more than max_message_size is refused") {
+        auto [small_client, small_server] = LoopbackStream::pair();
+        ServerConnection::Options options;
+        options.max_message_size = 1000;
+        ServerConnection small(echo_path, echo_message, options);
+        write_all(small_client, UPGRADE);
+        REQUIRE(serve(small, small_server));
+        read_all(small_client);
+
+        std::string frame =
+            client_frame(WebSocketOpcode::TEXT, std::string(2000, 'x'));
+        write_all(small_client, frame.substr(0, 100));
+        REQUIRE_FALSE(serve(small, small_server));
+        auto frames = decode_frames(read_all(small_client));
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].payload.substr(0, 2) == std::string("\x03\xF1", 2));
+        REQUIRE(small.messages() == 0);
+    }
+
+    SECTION("A close is echoed and ends the connection") {
+        write_all(client, client_frame(WebSocketOpcode::CLOSE,
+                                       std::string("\x03\xE8", 2)));
+        REQUIRE_FALSE(serve(connection, server));
+        auto frames = decode_frames(read_all(client));
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].opcode == WebSocketOpcode::CLOSE);
+        REQUIRE(frames[0].payload.substr(0, 2) == std::string("\x03\xE8", 2));
+    }
+
+    SECTION("Unmasked frames are a protocol error") {
+        write_all(client, encode_websocket_frame(WebSocketOpcode::TEXT, "x"));
+        REQUIRE_FALSE(serve(connection, server));
+        auto frames = decode_frames(read_all(client));
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].payload.substr(0, 2) == std::string("\x03\xEA", 2));
+    }
+
+    SECTION("Reserved bits are a protocol error") {
+        std::string frame = client_frame(WebSocketOpcode::TEXT, "x");
+        frame[0] |= 0x40;
+        write_all(client, frame);
+        REQUIRE_FALSE(serve(connection, server));
+        auto frames = decode_frames(read_all(client));
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].payload.substr(0, 2) == std::string("\x03\xEA", 2));
+    }
+}
@@ -0,0 +1,129 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/metrics.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////
+// Metrics Registry
+/////////////////////////////////
+
+// The registry is process-wide, so every test uses its own metric names.
+
+static bool contains(const std::string &text, const std::string &line) {
+    return text.find(line) != std::string::npos;
+}
+
+TEST_CASE("Metrics - Counters and gauges", "[metrics]") {
+    MetricsRegistry &registry = MetricsRegistry::instance();
+
+    auto hits = registry.counter("test_hits_total", "Hits.",
+                                 {{"route", "/a"}, {"status", "200"}});
+    hits.add();
+    hits.add(4);
+
+    auto open = registry.gauge("test_open", "Open things.");
+    open.add(3);
+    open.sub(5);
+
+    std::string text = registry.render();
+    REQUIRE(contains(text, "# HELP test_hits_total Hits.\n"));
+    REQUIRE(contains(text, "# TYPE test_hits_total counter\n"));
+    REQUIRE(
+        contains(text, "test_hits_total{route=\"/a\",status=\"200\"} 5\n"));
+    REQUIRE(contains(text, "# TYPE test_open gauge\n"));
+    REQUIRE(contains(text, "test_open -2\n"));
+
+    // Registering the same series again shares it
+    registry.counter("test_hits_total", "Hits.",
+                     {{"route", "/a"}, {"status", "200"}})
+        .add();
+    REQUIRE(contains(registry.render(),
+                     "test_hits_total{route=\"/a\",status=\"200\"} 6\n"));
+
+    // Type conflicts are rejected
+    REQUIRE_THROWS_AS(registry.gauge("test_hits_total", "Hits."),
+                      std::runtime_error);
+
+    // Label values are escaped
+    registry
+        .counter("test_escaped_total", "Escaping.", {{"path", "a\"b\\c"}})
+        .add();
+    REQUIRE(contains(registry.render(),
+                     "test_escaped_total{path=\"a\\\"b\\\\c\"} 1\n"));
+}
+
+TEST_CASE("Metrics - Per-thread recording is summed on scrape",
+          "[metrics]") {
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    auto events = registry.counter("test_thread_events_total", "Events.");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([events] {
+            for (int i = 0; i < 10000; ++i) {
+                events.add();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // The threads have exited; their slabs were folded into the totals.
+    REQUIRE(contains(registry.render(), "test_thread_events_total 40000\n"));
+}
+
+TEST_CASE("Metrics - Histograms", "[metrics]") {
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    auto latency = registry.histogram("test_latency_seconds", "Latency.",
+                                      {{"route", "/h"}});
+    latency.record_microseconds(3);
+    latency.record_microseconds(100);
+    latency.record_microseconds(100);
+    latency.record_microseconds(5000000);
+
+    std::string text = registry.render();
+    REQUIRE(contains(text, "# TYPE test_latency_seconds histogram\n"));
+    REQUIRE(contains(text, "test_latency_seconds_bucket{route=\"/h\","
+                           "le=\"3e-06\"} 1\n"));
+    // 100us falls in the [96, 127] bucket.
+    REQUIRE(contains(text, "test_latency_seconds_bucket{route=\"/h\","
+                           "le=\"0.000127\"} 3\n"));
+    REQUIRE(contains(text, "test_latency_seconds_bucket{route=\"/h\","
+                           "le=\"+Inf\"} 4\n"));
+    REQUIRE(contains(text,
+                     "test_latency_seconds_sum{route=\"/h\"} 5.000203\n"));
+    REQUIRE(contains(text, "test_latency_seconds_count{route=\"/h\"} 4\n"));
+
+    // Past the last bound, about 536s, only +Inf counts a value.
+    latency.record_microseconds(uint64_t{1}
+                                << MetricsRegistry::HISTOGRAM_MAX_VALUE_BITS);
+    latency.record_microseconds(uint64_t{3600} * 1000000);
+    text = registry.render();
+    REQUIRE(contains(text, "test_latency_seconds_bucket{route=\"/h\","
+                           "le=\"536.870911\"} 4\n"));
+    REQUIRE(contains(text, "test_latency_seconds_bucket{route=\"/h\","
+                           "le=\"+Inf\"} 6\n"));
+    REQUIRE(contains(text, "test_latency_seconds_count{route=\"/h\"} 6\n"));
+}
+
+TEST_CASE("Metrics - Gauge callbacks", "[metrics]") {
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    double depth = 7;
+    registry.gauge_callback("test_queue_depth", "Depth.", {{"queue", "q"}},
+                            [&depth] { return depth; });
+    REQUIRE(contains(registry.render(), "test_queue_depth{queue=\"q\"} 7\n"));
+
+    depth = 2.5;
+    REQUIRE(contains(registry.render(),
+                     "test_queue_depth{queue=\"q\"} 2.5\n"));
+
+    // Replace the callback before `depth` goes out of scope.
+    registry.gauge_callback("test_queue_depth", "Depth.", {{"queue", "q"}},
+                            [] { return 0.0; });
+}
@@ -0,0 +1,182 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/multipart.hpp"
+#include "test_helpers.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// Multipart
+/////////////////////////////////
+
+namespace {
+
+struct ParsedPart {
+    MultipartPart part;
+    std::string body;
+    bool ended = false;
+};
+
+// Collects every part, feeding `body` in `piece`-sized slices.
+std::vector<ParsedPart> parse_in_pieces(const std::string &body,
+                                        const std::string &boundary,
+                                        size_t piece) {
+    std::vector<ParsedPart> parts;
+    MultipartParser parser(
+        boundary,
+        {[&parts](const MultipartPart &part) {
+             parts.push_back({part, {}, false});
+         },
+         [&parts](std::string_view data) { parts.back().body += data; },
+         [&parts](const MultipartPart &) { parts.back().ended = true; }});
+    for (size_t offset = 0; offset < body.size(); offset += piece) {
+        parser.feed(std::string_view(body).substr(offset, piece));
+    }
+    parser.finish();
+    return parts;
+}
+
+std::string binary_file(size_t size) {
+    std::string file = binary_payload(size);
+    // Near-misses of the delimiter inside the data.
+    file.replace(size / 3, 16, "\r\n--XyZboundar\r\n");
+    file.replace(size / 2, 4, "\r\n--");
+    return file;
+}
+
+}  // namespace
+
+TEST_CASE("Multipart - Boundary search", "[multipart]") {
+    BoundarySearch search("\r\n--abc");
+    REQUIRE(search.find("\r\n--abc") == 0);
+    REQUIRE(search.find("xx\r\n--ab\r\n--abc") == 8);
+    REQUIRE(search.find("\r\n--ab") == std::string_view::npos);
+    REQUIRE(search.find("\r\n--abc\r\n--abc", 1) == 7);
+    REQUIRE(search.find("") == std::string_view::npos);
+
+    std::string haystack(10000, 'a');
+    haystack += "\r\n--abc";
+    REQUIRE(search.find(haystack) == 10000);
+}
+
+TEST_CASE("Multipart - Boundary from Content-Type", "[multipart]") {
+    REQUIRE(multipart_boundary("multipart/form-data; boundary=abc123") ==
+            "abc123");
+    REQUIRE(multipart_boundary(
+                R"(Multipart/Form-Data; charset=utf-8; BOUNDARY="a b;c")") ==
+            "a b;c");
+    REQUIRE_THROWS_AS(multipart_boundary("application/json"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(multipart_boundary("multipart/form-data"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(
+        multipart_boundary("multipart/form-data; boundary=" +
+                           std::string(71, 'b')),
+        std::runtime_error);
+}
+
+TEST_CASE("Multipart - Parts", "[multipart]") {
+    std::string file = binary_file(100 * 1024);
+    std::string boundary = "XyZboundary";
+    std::string body =
+        "preamble to ignore\r\n"
+        "--XyZboundary\r\n"
+        "Content-Disposition: form-data; name=\"title\"\r\n"
+        "\r\n"
+        "Holiday photos\r\n"
+        "--XyZboundary  \r\n"
+        "content-disposition: form-data; name=\"photo\"; "
+        "filename=\"a \\\"b\\\".jpg\"\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "\r\n" +
+        file +
+        "\r\n"
+        "--XyZboundary\r\n"
+        "Content-Disposition: form-data; name=\"empty\"\r\n"
+        "\r\n"
+        "\r\n"
+        "--XyZboundary\r\n"
+        "\r\n"
+        "no headers\r\n"
+        "--XyZboundary--\r\n"
+        "epilogue";
+
+    for (size_t piece : {1, 2, 5, 13, 100, 4096, 5000, 65536, 1000000}) {
+        INFO("piece " << piece);
+        std::vector<ParsedPart> parts = parse_in_pieces(body, boundary, piece);
+        REQUIRE(parts.size() == 4);
+
+        REQUIRE(parts[0].part.name == "title");
+        REQUIRE(parts[0].part.filename.empty());
+        REQUIRE(parts[0].part.content_type == "text/plain");
+        REQUIRE(parts[0].body == "Holiday photos");
+
+        REQUIRE(parts[1].part.name == "photo");
+        REQUIRE(parts[1].part.filename == "a \"b\".jpg");
+        REQUIRE(parts[1].part.content_type == "image/jpeg");
+        REQUIRE(parts[1].part.headers.count("content-disposition") == 1);
+        REQUIRE(parts[1].body == file);
+
+        REQUIRE(parts[2].part.name == "empty");
+        REQUIRE(parts[2].body.empty());
+
+        REQUIRE(parts[3].part.headers.empty());
+        REQUIRE(parts[3].body == "no headers");
+
+        for (const ParsedPart &part : parts) {
+            REQUIRE(part.ended);
+        }
+    }
+}
+
+TEST_CASE("Multipart - Body at the start and streams", "[multipart]") {
+    std::string body = "--b\r\n"
+                       "Content-Disposition: form-data; name=\"a\"\r\n\r\n"
+                       "1\r\n"
+                       "--b--";
+    REQUIRE(parse_in_pieces(body, "b", 3).at(0).body == "1");
+
+    HttpRequest request;
+    request.create_post("/upload", body, "multipart/form-data; boundary=b");
+    std::string value;
+    parse_multipart(
+        request,
+        {nullptr, [&value](std::string_view data) { value += data; },
+         nullptr});
+    REQUIRE(value == "1");
+}
+
+TEST_CASE("Multipart - Malformed bodies throw", "[multipart]") {
+    std::string head = "--b\r\nContent-Disposition: form-data; name=\"a\"";
+
+    SECTION("Missing closing delimiter") {
+        REQUIRE_THROWS_AS(parse_in_pieces(head + "\r\n\r\nvalue", "b", 4),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(parse_in_pieces("no delimiter at all", "b", 4),
+                          std::runtime_error);
+    }
+
+    SECTION("Garbage after a delimiter") {
+        REQUIRE_THROWS_AS(parse_in_pieces("--bX\r\n\r\n--b--", "b", 100),
+                          std::runtime_error);
+    }
+
+    SECTION("Header line without a colon") {
+        REQUIRE_THROWS_AS(parse_in_pieces("--b\r\nbroken\r\n\r\nx\r\n--b--",
+                                          "b", 100),
+                          std::runtime_error);
+    }
+
+    SECTION("Endless headers") {
+        std::string endless = "--b\r\nX-Long: " +
+                              std::string(MultipartParser::MAX_HEADER_SIZE,
+                                          'x');
+        REQUIRE_THROWS_AS(parse_in_pieces(endless, "b", 1000),
+                          std::runtime_error);
+    }
+}
@@ -0,0 +1,109 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/output_queue.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Non-blocking socketpair with a small send buffer, so partial writes and
+// EAGAIN are easy to provoke.
+struct SocketPair {
+    int writer = -1;
+    int reader = -1;
+
+    SocketPair() {
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        writer = fds[0];
+        reader = fds[1];
+        int size = 4096;
+        setsockopt(writer, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        fcntl(writer, F_SETFL, fcntl(writer, F_GETFL) | O_NONBLOCK);
+        fcntl(reader, F_SETFL, fcntl(reader, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~SocketPair() {
+        close(writer);
+        close(reader);
+    }
+
+    std::string drain() {
+        std::string received;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(reader, buffer, sizeof(buffer))) > 0) {
+            received.append(buffer, static_cast<size_t>(n));
+        }
+        return received;
+    }
+};
+
+/////////////////////////////////
+// Output Queue
+/////////////////////////////////
+
+TEST_CASE("Output Queue - Small writes are coalesced", "[output]") {
+    SocketPair pair;
+    OutputQueue queue;
+
+    for (int i = 0; i < 10; ++i) {
+        queue.append("response " + std::to_string(i) + "\n");
+    }
+    REQUIRE(queue.flush(pair.writer) == OutputQueue::FlushResult::DONE);
+    REQUIRE(queue.write_calls() == 1);
+    REQUIRE(queue.empty());
+
+    std::string received = pair.drain();
+    REQUIRE(received.find("response 0\n") == 0);
+    REQUIRE(received.find("response 9\n") != std::string::npos);
+}
+
+TEST_CASE("Output Queue - Shared segments are sent without copying",
+          "[output]") {
+    SocketPair pair;
+    OutputQueue queue;
+
+    auto head = std::make_shared<const std::string>("HEAD|");
+    queue.append_shared(head, head->data(), head->size());
+    queue.append("body");
+
+    REQUIRE(queue.pending_bytes() == 9);
+    REQUIRE(queue.flush(pair.writer) == OutputQueue::FlushResult::DONE);
+    REQUIRE(pair.drain() == "HEAD|body");
+}
+
+TEST_CASE("Output Queue - Partial writes keep every byte", "[output]") {
+    SocketPair pair;
+    OutputQueue queue(64 * 1024, 16 * 1024);
+
+    std::string payload;
+    for (int i = 0; i < 200000; ++i) {
+        payload += static_cast<char>('a' + i % 26);
+    }
+    queue.append(payload);
+
+    REQUIRE(queue.flush(pair.writer) == OutputQueue::FlushResult::BLOCKED);
+    REQUIRE_FALSE(queue.empty());
+    REQUIRE(queue.above_high_watermark());
+
+    std::string received;
+    while (!queue.empty()) {
+        received += pair.drain();
+        queue.flush(pair.writer);
+    }
+    received += pair.drain();
+
+    REQUIRE(queue.below_low_watermark());
+    REQUIRE(received == payload);
+}
+
+TEST_CASE("Output Queue - Errors are reported", "[output]") {
+    OutputQueue queue;
+    queue.append("data");
+    REQUIRE(queue.flush(-1) == OutputQueue::FlushResult::ERROR);
+    REQUIRE(queue.pending_bytes() == 4);
+}
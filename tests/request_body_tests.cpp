@@ -0,0 +1,246 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/request_body.hpp"
+#include "test_helpers.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/////////////////////////////////
+// Request Body
+/////////////////////////////////
+
+static std::string body_contents(const RequestBody &body) {
+    std::unique_ptr<std::istream> stream = body.open();
+    return std::string(std::istreambuf_iterator<char>(*stream), {});
+}
+
+// Sends `body` in `piece`-sized reads, as a socket would deliver it.
+static size_t feed_in_pieces(BodyDecoder &decoder, RequestBody &body,
+                             const std::string &wire, size_t piece) {
+    size_t used = 0;
+    while (used < wire.size() && !decoder.done()) {
+        std::string_view input =
+            std::string_view(wire).substr(used, std::min(piece, wire.size() -
+                                                                    used));
+        used += decoder.feed(input, body);
+    }
+    return used;
+}
+
+TEST_CASE("Request Body - Memory and spill", "[request_body]") {
+    std::string payload = binary_payload(300 * 1024);
+    BodyLimits limits;
+    limits.memory_limit = 64 * 1024;
+
+    SECTION("Small bodies stay in memory") {
+        RequestBody body(limits);
+        body.append(std::string_view(payload).substr(0, 1000));
+        REQUIRE_FALSE(body.spilled());
+        REQUIRE(body.memory() == payload.substr(0, 1000));
+        REQUIRE(body_contents(body) == payload.substr(0, 1000));
+    }
+
+    SECTION("Past the memory limit the body moves to a file") {
+        RequestBody body(limits);
+        for (size_t offset = 0; offset < payload.size(); offset += 10000) {
+            body.append(std::string_view(payload).substr(offset, 10000));
+        }
+        REQUIRE(body.spilled());
+        REQUIRE(body.memory().empty());
+        REQUIRE(body.size() == payload.size());
+        REQUIRE(body_contents(body) == payload);
+    }
+
+    SECTION("The size limit throws") {
+        limits.max_size = 1000;
+        RequestBody body(limits);
+        body.append(std::string(1000, 'x'));
+        REQUIRE_THROWS_AS(body.append("y"), BodyTooLarge);
+    }
+
+    SECTION("An unusable spill directory throws") {
+        limits.spill_directory = "/nonexistent/directory";
+        RequestBody body(limits);
+        REQUIRE_THROWS_AS(body.append(payload), std::runtime_error);
+    }
+}
+
+TEST_CASE("Request Body - Splice from a socket", "[request_body]") {
+    int sockets[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    std::string payload = binary_payload(100 * 1024);
+    std::string head = payload.substr(0, 100);
+
+    RequestBody body;
+    body.append(head);
+    // Sent in two halves so each splice call sees part of it.
+    for (size_t offset = 100; offset < payload.size(); offset += 50 * 1024) {
+        std::string_view part =
+            std::string_view(payload).substr(offset, 50 * 1024);
+        REQUIRE(write(sockets[1], part.data(), part.size()) ==
+                static_cast<ssize_t>(part.size()));
+        size_t moved = 0;
+        while (moved < part.size()) {
+            ssize_t result =
+                body.splice_from(sockets[0], payload.size() - body.size());
+            REQUIRE(result > 0);
+            moved += static_cast<size_t>(result);
+        }
+    }
+    REQUIRE(body.spilled());
+    REQUIRE(body_contents(body) == payload);
+
+    close(sockets[1]);
+    REQUIRE(body.splice_from(sockets[0], 100) == 0);
+    close(sockets[0]);
+}
+
+TEST_CASE("Request Body - Framing", "[request_body]") {
+    BodyFraming plain = body_framing("POST / HTTP/1.1\r\n"
+                                     "Content-Length: 42\r\n\r\n");
+    REQUIRE_FALSE(plain.chunked);
+    REQUIRE(plain.content_length == 42);
+
+    BodyFraming chunked = body_framing("POST / HTTP/1.1\r\n"
+                                       "Content-Length: 42\r\n"
+                                       "transfer-encoding: Chunked\r\n\r\n");
+    REQUIRE(chunked.chunked);
+    REQUIRE(chunked.content_length == 0);
+
+    REQUIRE(body_framing("GET / HTTP/1.1\r\nHost: x\r\n\r\n").content_length ==
+            0);
+    REQUIRE_THROWS_AS(body_framing("POST / HTTP/1.1\r\n"
+                                   "Content-Length: 4x\r\n\r\n"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(body_framing("POST / HTTP/1.1\r\n"
+                                   "Transfer-Encoding: gzip\r\n\r\n"),
+                      std::runtime_error);
+}
+
+TEST_CASE("Request Body - Response framing", "[request_body]") {
+    std::string sized = "HTTP/1.1 200 OK\r\nContent-Length: 42\r\n\r\n";
+    BodyFraming framing = response_body_framing(sized, 200, false);
+    REQUIRE(framing.content_length == 42);
+    REQUIRE_FALSE(framing.until_close);
+
+    // Neither a length nor chunked: the body runs until the server closes.
+    BodyFraming open = response_body_framing("HTTP/1.1 200 OK\r\n\r\n", 200,
+                                             false);
+    REQUIRE(open.until_close);
+    BodyDecoder decoder(open);
+    REQUIRE(decoder.feed(std::string(100000, 'x'), [](std::string_view) {}) ==
+            100000);
+    REQUIRE_FALSE(decoder.done());
+
+    // Some responses never have a body, whatever their headers say.
+    for (int status : {100, 204, 304}) {
+        BodyFraming none = response_body_framing(sized, status, false);
+        REQUIRE_FALSE(none.until_close);
+        REQUIRE(BodyDecoder(none).done());
+    }
+    REQUIRE(BodyDecoder(response_body_framing(sized, 200, true)).done());
+}
+
+TEST_CASE("Request Body - Decoding", "[request_body]") {
+    std::string payload = binary_payload(5000);
+
+    SECTION("Content-Length stops at the end of the body") {
+        std::string wire = payload + "GET /next HTTP/1.1\r\n\r\n";
+        for (size_t piece : {1, 7, 4096, 100000}) {
+            RequestBody body;
+            BodyDecoder decoder(BodyFraming{false, payload.size()});
+            REQUIRE(feed_in_pieces(decoder, body, wire, piece) ==
+                    payload.size());
+            REQUIRE(decoder.done());
+            REQUIRE(body.memory() == payload);
+        }
+    }
+
+    SECTION("Chunked bodies in pieces of any size") {
+        std::string wire = "10;name=value\r\n" + payload.substr(0, 16) +
+                           "\r\n" + "FA0\r\n" + payload.substr(16, 4000) +
+                           "\r\n" + "3d8 \r\n" + payload.substr(4016) +
+                           "\r\n0\r\nExpires: never\r\n\r\nNEXT";
+        for (size_t piece : {1, 2, 3, 64, 5000, 100000}) {
+            RequestBody body;
+            BodyDecoder decoder(BodyFraming{true, 0});
+            REQUIRE(feed_in_pieces(decoder, body, wire, piece) ==
+                    wire.size() - 4);
+            REQUIRE(decoder.done());
+            REQUIRE(body.memory() == payload);
+        }
+    }
+
+    SECTION("Raw bytes can be skipped") {
+        BodyDecoder decoder(BodyFraming{false, 100});
+        REQUIRE(decoder.raw_remaining() == 100);
+        decoder.skip_raw(60);
+        REQUIRE(decoder.raw_remaining() == 40);
+        decoder.skip_raw(40);
+        REQUIRE(decoder.done());
+        REQUIRE(BodyDecoder(BodyFraming{true, 0}).raw_remaining() == 0);
+        REQUIRE(BodyDecoder(BodyFraming{false, 0}).done());
+    }
+
+    SECTION("Malformed chunks throw") {
+        for (std::string wire :
+             {std::string("zz\r\n"), std::string("5\r\nhelloX\r\n"),
+              std::string(";\r\n"), std::string(5000, '1')}) {
+            RequestBody body;
+            BodyDecoder decoder(BodyFraming{true, 0});
+            REQUIRE_THROWS_AS(decoder.feed(wire, body), std::runtime_error);
+        }
+    }
+
+    SECTION("Chunked bodies respect the size limit") {
+        BodyLimits limits;
+        limits.max_size = 10;
+        RequestBody body(limits);
+        BodyDecoder decoder(BodyFraming{true, 0});
+        REQUIRE_THROWS_AS(decoder.feed("b\r\nhello world\r\n", body),
+                          BodyTooLarge);
+    }
+}
+
+TEST_CASE("Request Body - Parsed requests", "[request_body]") {
+    std::string payload = binary_payload(2000);
+
+    SECTION("Binary bodies arrive unchanged") {
+        HttpRequest request = HttpRequest::parse(
+            "POST /upload HTTP/1.1\r\nContent-Length: 2000\r\n\r\n" +
+            payload);
+        REQUIRE(request.body == payload);
+        REQUIRE(request.body_size() == payload.size());
+        std::unique_ptr<std::istream> stream = request.open_body();
+        REQUIRE(std::string(std::istreambuf_iterator<char>(*stream), {}) ==
+                payload);
+    }
+
+    SECTION("Chunked bodies are decoded") {
+        HttpRequest request = HttpRequest::parse(
+            "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+        REQUIRE(request.body == "hello world");
+    }
+
+    SECTION("Spilled bodies are read through the stream") {
+        BodyLimits limits;
+        limits.memory_limit = 100;
+        auto body = std::make_shared<RequestBody>(limits);
+        body->append(payload);
+        HttpRequest request;
+        request.spilled_body = body;
+        REQUIRE(request.body.empty());
+        REQUIRE(request.body_size() == payload.size());
+        std::unique_ptr<std::istream> stream = request.open_body();
+        REQUIRE(std::string(std::istreambuf_iterator<char>(*stream), {}) ==
+                payload);
+    }
+}
@@ -0,0 +1,161 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/response_cache.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+
+/////////////////////////////////
+// Response Cache
+/////////////////////////////////
+
+TEST_CASE("Response Cache - Lookup and Insert", "[cache]") {
+    ResponseCache cache;
+    HttpRequest request;
+    request.create_get("/api/items");
+
+    SECTION("Miss on empty cache") {
+        REQUIRE(cache.lookup(request) == nullptr);
+    }
+
+    SECTION("Hit returns the serialized response") {
+        HttpResponse response = HttpResponse::json_response(R"({"a":1})");
+        REQUIRE(cache.insert(request, response, std::chrono::seconds(10)));
+
+        auto entry = cache.lookup(request);
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->status_code == 200);
+        REQUIRE(entry->variants.size() == 1);
+
+        const CachedVariant &variant = entry->select("");
+        REQUIRE(variant.head + variant.body == response.to_string());
+        REQUIRE(variant.body == R"({"a":1})");
+    }
+
+    SECTION("Method is part of the key") {
+        cache.insert(request, HttpResponse::ok("x"), std::chrono::seconds(10));
+
+        HttpRequest head_request = request;
+        head_request.method = "HEAD";
+        REQUIRE(cache.lookup(head_request) == nullptr);
+    }
+
+    SECTION("Streaming responses are rejected") {
+        HttpResponse response;
+        response.set_streaming([](std::ostream &os) { os << "data"; }, 4);
+        REQUIRE_FALSE(cache.insert(request, response, std::chrono::seconds(1)));
+        REQUIRE(cache.entry_count() == 0);
+    }
+}
+
+TEST_CASE("Response Cache - Vary headers", "[cache]") {
+    ResponseCache cache({"accept-language"});
+
+    HttpRequest english;
+    english.create_get("/greeting");
+    english.set_header("Accept-Language", "en");
+
+    HttpRequest german = english;
+    german.set_header("Accept-Language", "de");
+
+    cache.insert(english, HttpResponse::ok("hello"), std::chrono::seconds(10));
+    cache.insert(german, HttpResponse::ok("hallo"), std::chrono::seconds(10));
+
+    REQUIRE(cache.entry_count() == 2);
+    REQUIRE(cache.lookup(english)->variants[0].body == "hello");
+    REQUIRE(cache.lookup(german)->variants[0].body == "hallo");
+}
+
+TEST_CASE("Response Cache - Expiry and invalidation", "[cache]") {
+    ResponseCache cache({"accept-language"});
+    HttpRequest request;
+    request.create_get("/news");
+
+    SECTION("Expired entries are dropped on lookup") {
+        cache.insert(request, HttpResponse::ok("old"),
+                     std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        REQUIRE(cache.lookup(request) == nullptr);
+        REQUIRE(cache.entry_count() == 0);
+    }
+
+    SECTION("Invalidate removes every method and vary combination") {
+        HttpRequest head_request = request;
+        head_request.method = "HEAD";
+        HttpRequest other_language = request;
+        other_language.set_header("Accept-Language", "fr");
+        HttpRequest sibling;
+        sibling.create_get("/news/archive");
+
+        cache.insert(request, HttpResponse::ok("a"), std::chrono::seconds(10));
+        cache.insert(head_request, HttpResponse::ok("a"),
+                     std::chrono::seconds(10));
+        cache.insert(other_language, HttpResponse::ok("b"),
+                     std::chrono::seconds(10));
+        cache.insert(sibling, HttpResponse::ok("c"), std::chrono::seconds(10));
+
+        REQUIRE(cache.invalidate("/news") == 3);
+        REQUIRE(cache.lookup(request) == nullptr);
+        REQUIRE(cache.lookup(sibling) != nullptr);
+    }
+}
+
+TEST_CASE("Response Cache - LRU eviction", "[cache]") {
+    // A single shard makes the eviction order deterministic.
+    ResponseCache cache({}, 300, 1);
+
+    HttpRequest first, second, third;
+    first.create_get("/1");
+    second.create_get("/2");
+    third.create_get("/3");
+
+    std::string body(60, 'x');
+    cache.insert(first, HttpResponse::ok(body), std::chrono::seconds(10));
+    cache.insert(second, HttpResponse::ok(body), std::chrono::seconds(10));
+    REQUIRE(cache.lookup(first) != nullptr);
+
+    cache.insert(third, HttpResponse::ok(body), std::chrono::seconds(10));
+
+    REQUIRE(cache.size_bytes() <= 300);
+    REQUIRE(cache.lookup(first) != nullptr);
+    REQUIRE(cache.lookup(second) == nullptr);
+    REQUIRE(cache.lookup(third) != nullptr);
+}
+
+TEST_CASE("Response Cache - Precompressed variants", "[cache]") {
+    ResponseCache cache;
+    HttpRequest request;
+    request.create_get("/app.js");
+
+    std::map<ContentEncoding, std::string> encoded = {
+        {ContentEncoding::GZIP, "GZ"}, {ContentEncoding::BROTLI, "BR"}};
+    cache.insert(request, HttpResponse::ok("plain body"),
+                 std::chrono::seconds(10), encoded);
+
+    auto entry = cache.lookup(request);
+    REQUIRE(entry->variants.size() == 3);
+
+    SECTION("Brotli preferred when accepted") {
+        const CachedVariant &variant = entry->select("gzip, deflate, br");
+        REQUIRE(variant.encoding == ContentEncoding::BROTLI);
+        REQUIRE(variant.head.find("Content-Encoding: br\r\n") !=
+                std::string::npos);
+        REQUIRE(variant.head.find("Content-Length: 2\r\n") !=
+                std::string::npos);
+        REQUIRE(variant.head.find("Vary: Accept-Encoding\r\n") !=
+                std::string::npos);
+    }
+
+    SECTION("Refused encodings are skipped") {
+        REQUIRE(entry->select("br;q=0, gzip").encoding ==
+                ContentEncoding::GZIP);
+    }
+
+    SECTION("Identity without Accept-Encoding") {
+        const CachedVariant &variant = entry->select("");
+        REQUIRE(variant.encoding == ContentEncoding::IDENTITY);
+        REQUIRE(variant.body == "plain body");
+    }
+}
@@ -0,0 +1,118 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/sse.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+/////////////////////////////////
+// Server-Sent Events
+/////////////////////////////////
+
+TEST_CASE("SSE - Event encoding", "[sse]") {
+    REQUIRE(encode_sse_event({"", "", "hello", std::nullopt}) ==
+            "data: hello\n\n");
+    REQUIRE(encode_sse_event({"7", "update", "a\nb\r\nc\rd", 3000}) ==
+            "id: 7\nevent: update\nretry: 3000\n"
+            "data: a\ndata: b\ndata: c\ndata: d\n\n");
+    REQUIRE(encode_sse_event({"", "", "", std::nullopt}) == "data: \n\n");
+    REQUIRE(encode_sse_event({"", "", "end\n", std::nullopt}) ==
+            "data: end\ndata: \n\n");
+}
+
+TEST_CASE("SSE - Events are wrapped in one chunk", "[sse]") {
+    std::string wire(300, 'x');
+    EncodedEvent event = encode_sse_chunk(wire, 5);
+    REQUIRE(event.id == 5);
+    REQUIRE(*event.chunk == "12c\r\n" + wire + "\r\n");
+    REQUIRE(event.payload() == wire);
+    // The payload borrows the chunk's bytes.
+    REQUIRE(event.payload().data() == event.chunk->data() + 5);
+
+    const EncodedEvent &heartbeat = EventStream::heartbeat();
+    REQUIRE(*heartbeat.chunk == "c\r\n:heartbeat\n\n\r\n");
+    REQUIRE(&EventStream::heartbeat() == &heartbeat);
+}
+
+TEST_CASE("SSE - Publish numbers events and keeps history", "[sse]") {
+    EventStream stream(3);
+    REQUIRE(stream.last_id() == 0);
+    REQUIRE(stream.since(stream.event_id(0)).empty());
+
+    std::vector<EncodedEvent> published;
+    for (int i = 1; i <= 5; ++i) {
+        published.push_back(
+            stream.publish({"ignored", "", std::to_string(i), std::nullopt}));
+    }
+    REQUIRE(stream.last_id() == 5);
+    REQUIRE(published[0].id == 1);
+    REQUIRE(published[4].payload() ==
+            "id: " + stream.event_id(5) + "\ndata: 5\n\n");
+
+    SECTION("Resume after an event still kept") {
+        std::vector<EncodedEvent> missed = stream.since(stream.event_id(3));
+        REQUIRE(missed.size() == 2);
+        REQUIRE(missed[0].id == 4);
+        // Replays share the bytes queued to live subscribers.
+        REQUIRE(missed[1].chunk == published[4].chunk);
+        REQUIRE(stream.since(stream.event_id(5)).empty());
+    }
+
+    SECTION("Resume from before the history sends all of it") {
+        std::vector<EncodedEvent> missed = stream.since(stream.event_id(1));
+        REQUIRE(missed.size() == 3);
+        REQUIRE(missed[0].id == 3);
+    }
+
+    SECTION("Missing, malformed or future ids send nothing") {
+        REQUIRE(stream.since("").empty());
+        REQUIRE(stream.since("3").empty());
+        REQUIRE(stream.since("-3").empty());
+        REQUIRE(stream.since(stream.event_id(3) + "x").empty());
+        REQUIRE(stream.since(stream.event_id(99)).empty());
+    }
+
+    SECTION("An id from another process sends all of the history") {
+        // As after a handoff: the new stream has its own epoch.
+        std::string previous = stream.event_id(4);
+        EventStream replacement(3);
+        REQUIRE(replacement.event_id(4) != previous);
+        replacement.publish({"", "", "a", std::nullopt});
+        replacement.publish({"", "", "b", std::nullopt});
+        std::vector<EncodedEvent> missed = replacement.since(previous);
+        REQUIRE(missed.size() == 2);
+        REQUIRE(missed[0].id == 1);
+    }
+}
+
+TEST_CASE("SSE - Heartbeat timer", "[sse]") {
+    EventStream stream(16, std::chrono::milliseconds(20));
+    REQUIRE(stream.heartbeat_fd() >= 0);
+
+    struct pollfd timer = {stream.heartbeat_fd(), POLLIN, 0};
+    REQUIRE(poll(&timer, 1, 1000) == 1);
+    REQUIRE(stream.heartbeat_due());
+    // Reading cleared the expirations.
+    REQUIRE_FALSE(stream.heartbeat_due());
+}
+
+TEST_CASE("SSE - Event stream response head", "[sse]") {
+    std::string chunked = HttpResponse::event_stream().to_string();
+    REQUIRE(chunked.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    REQUIRE(chunked.find("Content-Type: text/event-stream\r\n") !=
+            std::string::npos);
+    REQUIRE(chunked.find("Cache-Control: no-cache\r\n") != std::string::npos);
+    REQUIRE(chunked.find("Transfer-Encoding: chunked\r\n") !=
+            std::string::npos);
+    REQUIRE(chunked.find("Content-Length") == std::string::npos);
+
+    std::string closed = HttpResponse::event_stream(false).to_string();
+    REQUIRE(closed.find("Connection: close\r\n") != std::string::npos);
+    REQUIRE(closed.find("Transfer-Encoding") == std::string::npos);
+    REQUIRE(closed.find("Content-Length") == std::string::npos);
+}
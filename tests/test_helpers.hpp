@@ -0,0 +1,52 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+
+/////////////////////////////////
+// Test Helpers
+/////////////////////////////////
+
+// `size` bytes covering every byte value, so a body survives only if it
+// is passed through untouched.
+inline std::string binary_payload(size_t size) {
+    std::string payload(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<char>((i * 131 + i / 7) & 0xff);
+    }
+    // Line breaks and a blank line, which a head parser could trip on.
+    payload.replace(0, std::min<size_t>(size, 6), "\r\n\r\n\0\n", 6);
+    return payload;
+}
+
+// Everything `source` hands out until it reports the end or has nothing
+// more for now; `source` is anything with read(buffer, size), like a
+// LoopbackStream.
+template <typename Source> std::string read_all(Source &source) {
+    std::string data;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = source.read(buffer, sizeof(buffer))) > 0) {
+        data.append(buffer, static_cast<size_t>(count));
+    }
+    return data;
+}
+
+// Everything read from `fd` until the other end hangs up, or from its
+// current offset to the end of a file.
+inline std::string read_all(int fd) {
+    std::string data;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        data.append(buffer, static_cast<size_t>(count));
+    }
+    return data;
+}
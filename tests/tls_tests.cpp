@@ -0,0 +1,273 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/output_queue.hpp"
+#include "../core/tls.hpp"
+#include <arpa/inet.h>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/////////////////////////////////
+// TLS
+/////////////////////////////////
+
+// kTLS only attaches to TCP sockets, so the pair is a real loopback
+// connection rather than a socketpair.
+struct LoopbackPair {
+    int client = -1;
+    int server = -1;
+
+    LoopbackPair() {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(bind(listener, reinterpret_cast<sockaddr *>(&addr),
+                     sizeof(addr)) == 0);
+        REQUIRE(listen(listener, 1) == 0);
+        socklen_t length = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &length);
+
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(connect(client, reinterpret_cast<sockaddr *>(&addr),
+                        sizeof(addr)) == 0);
+        server = accept(listener, nullptr, nullptr);
+        close(listener);
+        for (int fd : {client, server}) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    ~LoopbackPair() {
+        close(client);
+        close(server);
+    }
+};
+
+struct Certificate {
+    std::string certificate;
+    std::string key;
+
+    explicit Certificate(const std::string &name = "server",
+                         const std::string &host = "localhost") {
+        std::string prefix =
+            "/tmp/tls_test_" + std::to_string(getpid()) + "_" + name;
+        certificate = prefix + "_cert.pem";
+        key = prefix + "_key.pem";
+        write_self_signed_certificate(certificate, key, host);
+    }
+    ~Certificate() {
+        std::remove(certificate.c_str());
+        std::remove(key.c_str());
+    }
+};
+
+// Steps both non-blocking handshakes until neither side is waiting.
+static void handshake(TlsSession &client, TlsSession &server,
+                      TlsSession::Status &client_status,
+                      TlsSession::Status &server_status) {
+    for (int round = 0; round < 100; ++round) {
+        client_status = client.handshake();
+        server_status = server.handshake();
+        bool waiting = client_status == TlsSession::Status::WANT_READ ||
+                       client_status == TlsSession::Status::WANT_WRITE ||
+                       server_status == TlsSession::Status::WANT_READ ||
+                       server_status == TlsSession::Status::WANT_WRITE;
+        if (!waiting) {
+            return;
+        }
+        usleep(1000);
+    }
+}
+
+static std::string read_all(TlsSession &session, size_t expected) {
+    std::string received;
+    char buffer[16384];
+    for (int round = 0; round < 1000 && received.size() < expected;
+         ++round) {
+        ssize_t n = session.read(buffer, sizeof(buffer));
+        if (n > 0) {
+            received.append(buffer, static_cast<size_t>(n));
+        } else if (n == 0 || errno != EAGAIN) {
+            break;
+        } else {
+            usleep(1000);
+        }
+    }
+    return received;
+}
+
+TEST_CASE("TLS - Generated key is private to its owner", "[tls]") {
+    Certificate files;
+    struct stat key_stat;
+    REQUIRE(stat(files.key.c_str(), &key_stat) == 0);
+    REQUIRE((key_stat.st_mode & 0777) == 0600);
+
+    chmod(files.key.c_str(), 0644);
+    write_self_signed_certificate(files.certificate, files.key, "localhost");
+    REQUIRE(stat(files.key.c_str(), &key_stat) == 0);
+    REQUIRE((key_stat.st_mode & 0777) == 0600);
+}
+
+TEST_CASE("TLS - Handshake and data over loopback", "[tls]") {
+    Certificate files;
+    TlsContext server_context =
+        TlsContext::server(files.certificate, files.key);
+    TlsContext client_context = TlsContext::client(files.certificate);
+    LoopbackPair pair;
+    TlsSession server(server_context, pair.server);
+    TlsSession client(client_context, pair.client, "localhost");
+
+    TlsSession::Status client_status;
+    TlsSession::Status server_status;
+    handshake(client, server, client_status, server_status);
+    REQUIRE(client_status == TlsSession::Status::DONE);
+    REQUIRE(server_status == TlsSession::Status::DONE);
+    REQUIRE(server.established());
+    REQUIRE(server.protocol() == "TLSv1.3");
+    REQUIRE_FALSE(server.cipher().empty());
+
+    SECTION("Both directions") {
+        REQUIRE(client.write("GET / HTTP/1.1\r\n\r\n", 18) == 18);
+        REQUIRE(read_all(server, 18) == "GET / HTTP/1.1\r\n\r\n");
+        REQUIRE(server.write("HTTP/1.1 200 OK\r\n\r\n", 19) == 19);
+        REQUIRE(read_all(client, 19) == "HTTP/1.1 200 OK\r\n\r\n");
+    }
+
+    SECTION("Output queue flushes through either path") {
+        // With kernel TLS the raw writev() is encrypted by the kernel;
+        // otherwise every segment goes through SSL_write().
+        OutputQueue queue;
+        std::string large(300000, 'x');
+        queue.append("head\r\n");
+        queue.append(large);
+        std::string expected = "head\r\n" + large;
+
+        std::string received;
+        for (int round = 0; round < 1000 && !queue.empty(); ++round) {
+            OutputQueue::FlushResult result =
+                server.kernel_send()
+                    ? queue.flush(pair.server)
+                    : queue.flush([&server](const char *data, size_t size) {
+                          return server.write(data, size);
+                      });
+            REQUIRE(result != OutputQueue::FlushResult::ERROR);
+            received += read_all(client, 1);
+        }
+        received += read_all(client, expected.size() - received.size());
+        REQUIRE(received == expected);
+    }
+
+    SECTION("close_notify reads as end of stream") {
+        client.shutdown();
+        char buffer[16];
+        ssize_t n = -1;
+        for (int round = 0; round < 100 && n < 0; ++round) {
+            n = server.read(buffer, sizeof(buffer));
+            usleep(1000);
+        }
+        REQUIRE(n == 0);
+    }
+}
+
+TEST_CASE("TLS - Verification failures", "[tls]") {
+    Certificate files;
+    TlsContext server_context =
+        TlsContext::server(files.certificate, files.key);
+    LoopbackPair pair;
+    TlsSession server(server_context, pair.server);
+
+    SECTION("Wrong host name") {
+        TlsContext client_context = TlsContext::client(files.certificate);
+        TlsSession client(client_context, pair.client, "example.com");
+        TlsSession::Status client_status;
+        TlsSession::Status server_status;
+        handshake(client, server, client_status, server_status);
+        REQUIRE(client_status == TlsSession::Status::FAILED);
+        REQUIRE(client.error().find("hostname mismatch") !=
+                std::string::npos);
+    }
+
+    SECTION("Untrusted certificate") {
+        Certificate other("other");
+        TlsContext client_context = TlsContext::client(other.certificate);
+        TlsSession client(client_context, pair.client, "localhost");
+        TlsSession::Status client_status;
+        TlsSession::Status server_status;
+        handshake(client, server, client_status, server_status);
+        REQUIRE(client_status == TlsSession::Status::FAILED);
+    }
+
+    SECTION("Missing files") {
+        REQUIRE_THROWS_AS(TlsContext::server("/nonexistent.pem", files.key),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(TlsContext::client("/nonexistent.pem"),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("TLS - HttpClient over TLS", "[tls]") {
+    Certificate files("client", "127.0.0.1");
+    TlsContext server_context =
+        TlsContext::server(files.certificate, files.key);
+
+    // HttpClient takes its port as a short, so no ephemeral port.
+    constexpr short PORT = 18443;
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(PORT);
+    REQUIRE(bind(listener, reinterpret_cast<sockaddr *>(&addr),
+                 sizeof(addr)) == 0);
+    REQUIRE(listen(listener, 1) == 0);
+
+    // A blocking one-request server; its handshake meets the client's.
+    std::string request_seen;
+    std::thread server([&] {
+        int fd = accept(listener, nullptr, nullptr);
+        TlsSession session(server_context, fd);
+        if (session.handshake() == TlsSession::Status::DONE) {
+            char buffer[4096];
+            while (request_seen.find("\r\n\r\n") == std::string::npos) {
+                ssize_t n = session.read(buffer, sizeof(buffer));
+                if (n <= 0) {
+                    break;
+                }
+                request_seen.append(buffer, static_cast<size_t>(n));
+            }
+            std::string response = HttpResponse::ok("secure").to_string();
+            session.write(response.data(), response.size());
+            session.shutdown();
+        }
+        close(fd);
+    });
+
+    HttpClient client("127.0.0.1", PORT);
+    REQUIRE(client.connect_to_server() == 0);
+    client.start_tls(files.certificate);
+    REQUIRE(client.using_tls());
+
+    HttpRequest request;
+    request.create_get("/test");
+    HttpResponse response = client.send_request(request);
+    server.join();
+    close(listener);
+
+    REQUIRE(request_seen.rfind("GET /test HTTP/1.1\r\n", 0) == 0);
+    REQUIRE(response.status_code == 200);
+    REQUIRE(response.body.rfind("secure", 0) == 0);
+}
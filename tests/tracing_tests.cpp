@@ -0,0 +1,150 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/tracing.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <string>
+
+/////////////////////////////////
+// Request Tracing
+/////////////////////////////////
+
+// A trace whose phases are `step_ns` apart, starting `offset_ns` after the
+// first call.
+static RequestTrace make_trace(uint64_t connection_id, uint64_t step_ns,
+                               uint64_t offset_ns = 0) {
+    static const uint64_t origin = TscClock::now();
+    double ticks = TscClock::ticks_per_ns();
+    RequestTrace trace;
+    trace.connection_id = connection_id;
+    trace.method = "GET";
+    trace.route = "/test";
+    trace.status = 200;
+    for (size_t i = static_cast<size_t>(TraceMark::FIRST_BYTE);
+         i < static_cast<size_t>(TraceMark::COUNT); ++i) {
+        trace.marks[i] = origin + static_cast<uint64_t>(
+                                      (offset_ns + i * step_ns) * ticks);
+    }
+    return trace;
+}
+
+static bool contains(const std::string &text, const std::string &part) {
+    return text.find(part) != std::string::npos;
+}
+
+TEST_CASE("Tracing - TSC clock is calibrated", "[tracing]") {
+    REQUIRE(TscClock::ticks_per_ns() > 0);
+    uint64_t start = TscClock::now();
+    uint64_t end = TscClock::now();
+    REQUIRE(end >= start);
+
+    // Converting a calibrated span back gives about the same nanoseconds.
+    uint64_t ticks = static_cast<uint64_t>(1'000'000 *
+                                           TscClock::ticks_per_ns());
+    uint64_t ns = TscClock::to_ns(ticks);
+    REQUIRE(ns > 999'000);
+    REQUIRE(ns < 1'001'000);
+}
+
+TEST_CASE("Tracing - Duration spans the marks taken", "[tracing]") {
+    // FIRST_BYTE through SENT: six marks, five steps of 1ms.
+    RequestTrace trace = make_trace(1, 1'000'000);
+    uint64_t duration = trace.duration_ns();
+    REQUIRE(duration > 4'990'000);
+    REQUIRE(duration < 5'010'000);
+
+    RequestTrace empty;
+    REQUIRE(empty.duration_ns() == 0);
+}
+
+TEST_CASE("Tracing - Tail-based sampling", "[tracing]") {
+    SECTION("Slow requests are always kept") {
+        RequestTracer tracer({1'000, 0.0, 16});
+        REQUIRE(tracer.finish(make_trace(1, 1'000'000)));
+        REQUIRE_FALSE(tracer.finish(make_trace(2, 10)));
+        REQUIRE(tracer.finished() == 2);
+        REQUIRE(tracer.kept() == 1);
+        REQUIRE(tracer.snapshot().size() == 1);
+        REQUIRE(tracer.snapshot()[0].connection_id == 1);
+    }
+
+    SECTION("Fast requests are sampled at the configured fraction") {
+        RequestTracer tracer({1'000'000, 0.1, 100'000});
+        for (int i = 0; i < 20'000; ++i) {
+            tracer.finish(make_trace(i, 10));
+        }
+        REQUIRE(tracer.kept() > 1'600);
+        REQUIRE(tracer.kept() < 2'400);
+    }
+
+    SECTION("Everything is kept at fraction 1") {
+        RequestTracer tracer({1'000'000, 1.0, 16});
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(tracer.finish(make_trace(i, 10)));
+        }
+        REQUIRE(tracer.kept() == 10);
+    }
+}
+
+TEST_CASE("Tracing - Ring buffer keeps the newest traces", "[tracing]") {
+    RequestTracer tracer({0, 1.0, 4});
+    for (uint64_t i = 0; i < 10; ++i) {
+        tracer.finish(make_trace(i, 10));
+    }
+    auto traces = tracer.snapshot();
+    REQUIRE(traces.size() == 4);
+    for (uint64_t i = 0; i < 4; ++i) {
+        REQUIRE(traces[i].connection_id == 6 + i);
+    }
+
+    tracer.clear();
+    REQUIRE(tracer.snapshot().empty());
+    REQUIRE(tracer.kept() == 10);
+}
+
+TEST_CASE("Tracing - Chrome trace export", "[tracing]") {
+    RequestTracer tracer({0, 1.0, 16});
+    RequestTrace trace = make_trace(7, 1'000);
+    trace.method = "G\"ET";
+    tracer.finish(trace);
+
+    std::ostringstream out;
+    tracer.write_chrome_trace(out);
+    std::string json = out.str();
+
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) ==
+            0);
+    REQUIRE(contains(json, "{\"name\":\"request\",\"cat\":\"http\","
+                           "\"ph\":\"X\",\"ts\":0.000,\"dur\":5.000,"
+                           "\"pid\":1,\"tid\":7,\"args\":{\"method\":"
+                           "\"G\\\"ET\",\"route\":\"/test\",\"status\":200}}"));
+    REQUIRE(contains(json, "\"name\":\"read\""));
+    REQUIRE(contains(json, "\"name\":\"parse\""));
+    REQUIRE(contains(json, "\"name\":\"handler\""));
+    REQUIRE(contains(json, "\"name\":\"serialize\""));
+    REQUIRE(contains(json, "{\"name\":\"send\",\"cat\":\"http\",\"ph\":\"X\","
+                           "\"ts\":4.000,\"dur\":1.000,\"pid\":1,\"tid\":7}"));
+    // Accept was not marked, so it has no slice.
+    REQUIRE_FALSE(contains(json, "\"name\":\"accept\""));
+}
+
+TEST_CASE("Tracing - OTLP JSON export", "[tracing]") {
+    RequestTracer tracer({0, 1.0, 16});
+    tracer.finish(make_trace(0x2a, 1'000));
+
+    std::ostringstream out;
+    tracer.write_otlp_json(out);
+    std::string json = out.str();
+
+    REQUIRE(json.rfind("{\"resourceSpans\":[", 0) == 0);
+    REQUIRE(contains(json, "\"traceId\":\"000000000000002a"));
+    REQUIRE(contains(json, "\"spanId\":\"0000000000000001\",\"name\":"
+                           "\"request\",\"kind\":2"));
+    REQUIRE(contains(json, "\"parentSpanId\":\"0000000000000001\",\"name\":"
+                           "\"read\",\"kind\":1"));
+    REQUIRE(contains(json, "{\"key\":\"http.response.status_code\","
+                           "\"value\":{\"intValue\":\"200\"}}"));
+    REQUIRE(contains(json, "\"startTimeUnixNano\":\""));
+}
@@ -0,0 +1,181 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/http.hpp"
+#include "../core/transport.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+/////////////////////////////////
+// Endpoints
+/////////////////////////////////
+
+namespace {
+
+std::string temporary_socket_path(const std::string &name) {
+    return "/tmp/transport_tests_" + std::to_string(getpid()) + "_" + name +
+           ".sock";
+}
+
+int accept_one(int listen_fd) {
+    struct pollfd ready = {listen_fd, POLLIN, 0};
+    REQUIRE(poll(&ready, 1, 5000) == 1);
+    return accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+}
+
+}  // namespace
+
+TEST_CASE("Transport - Endpoints parse and print", "[transport]") {
+    Endpoint file = Endpoint::parse("unix:/run/app.sock");
+    REQUIRE(file.kind == Endpoint::Kind::UNIX);
+    REQUIRE(file.path == "/run/app.sock");
+    REQUIRE_FALSE(file.is_abstract());
+    REQUIRE(file.to_string() == "unix:/run/app.sock");
+
+    Endpoint abstract = Endpoint::parse("unix:@app");
+    REQUIRE(abstract.is_abstract());
+    REQUIRE(abstract.to_string() == "unix:@app");
+
+    Endpoint tcp = Endpoint::parse("localhost:8080");
+    REQUIRE(tcp.kind == Endpoint::Kind::TCP);
+    REQUIRE(tcp.host == "localhost");
+    REQUIRE(tcp.port == 8080);
+    REQUIRE(tcp.to_string() == "localhost:8080");
+
+    Endpoint v6 = Endpoint::parse("[::1]:443");
+    REQUIRE(v6.host == "::1");
+    REQUIRE(v6.port == 443);
+    REQUIRE(v6.to_string() == "[::1]:443");
+
+    for (const char *bad :
+         {"unix:", "localhost", "localhost:", "localhost:http", "h:70000"}) {
+        REQUIRE_THROWS_AS(Endpoint::parse(bad), std::runtime_error);
+    }
+}
+
+TEST_CASE("Transport - UNIX addresses", "[transport]") {
+    SECTION("A path is NUL-terminated") {
+        auto addresses = resolve(Endpoint::unix_socket("/tmp/a.sock"));
+        REQUIRE(addresses.size() == 1);
+        REQUIRE(addresses[0].family() == AF_UNIX);
+        REQUIRE(addresses[0].length ==
+                offsetof(sockaddr_un, sun_path) + sizeof("/tmp/a.sock"));
+    }
+
+    SECTION("An abstract name is its bytes after a NUL") {
+        SocketAddress address = resolve(Endpoint::unix_socket("@app")).front();
+        const auto &un = reinterpret_cast<const sockaddr_un &>(address.storage);
+        REQUIRE(un.sun_path[0] == '\0');
+        REQUIRE(std::string(un.sun_path + 1, 3) == "app");
+        REQUIRE(address.length == offsetof(sockaddr_un, sun_path) + 4);
+    }
+
+    SECTION("Paths that do not fit are refused") {
+        REQUIRE_THROWS_AS(resolve(Endpoint::unix_socket(std::string(
+                              sizeof(sockaddr_un::sun_path), 'a'))),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(resolve(Endpoint::unix_socket("")),
+                          std::runtime_error);
+    }
+
+    SECTION("TCP hosts resolve to every address") {
+        auto addresses = resolve(Endpoint::tcp("127.0.0.1", 80));
+        REQUIRE(addresses.size() == 1);
+        REQUIRE(addresses[0].family() == AF_INET);
+        REQUIRE_THROWS_AS(resolve(Endpoint::tcp("invalid.nonexistent.", 80)),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Transport - UNIX listeners", "[transport]") {
+    SECTION("A socket file is connected to and replaced once stale") {
+        Endpoint endpoint = Endpoint::unix_socket(temporary_socket_path("f"));
+        int listen_fd = open_listener(endpoint);
+        REQUIRE(socket_family(listen_fd) == AF_UNIX);
+        struct stat status;
+        REQUIRE(stat(endpoint.path.c_str(), &status) == 0);
+        REQUIRE(S_ISSOCK(status.st_mode));
+
+        int client = connect_socket(resolve(endpoint));
+        REQUIRE(client >= 0);
+        int server = accept_one(listen_fd);
+        REQUIRE(server >= 0);
+        REQUIRE(send(client, "ping", 4, 0) == 4);
+        char buffer[4] = {};
+        REQUIRE(recv(server, buffer, sizeof(buffer), MSG_WAITALL) == 4);
+        REQUIRE(std::string(buffer, 4) == "ping");
+        close(server);
+        close(client);
+
+        // Still served, so it is left alone.
+        REQUIRE_THROWS_AS(open_listener(endpoint), std::runtime_error);
+        close(listen_fd);
+
+        // The file outlives the listener and is taken over.
+        int again = open_listener(endpoint);
+        close(again);
+        unlink(endpoint.path.c_str());
+    }
+
+    SECTION("An abstract socket has no file") {
+        Endpoint endpoint = Endpoint::unix_socket(
+            "@transport_tests_" + std::to_string(getpid()));
+        int listen_fd = open_listener(endpoint);
+        REQUIRE(access(endpoint.path.c_str(), F_OK) != 0);
+        REQUIRE_THROWS_AS(open_listener(endpoint), std::runtime_error);
+
+        int client = connect_socket(resolve(endpoint));
+        REQUIRE(client >= 0);
+        int server = accept_one(listen_fd);
+        REQUIRE(server >= 0);
+        close(server);
+        close(client);
+
+        // The name goes with the last fd.
+        close(listen_fd);
+        REQUIRE(connect_socket(resolve(endpoint)) < 0);
+    }
+}
+
+TEST_CASE("Transport - HttpClient over a UNIX socket", "[transport]") {
+    Endpoint endpoint =
+        Endpoint::unix_socket("@transport_client_" + std::to_string(getpid()));
+    int listen_fd = open_listener(endpoint);
+
+    std::string request_seen;
+    std::thread server([&] {
+        int fd = accept_one(listen_fd);
+        char buffer[4096];
+        while (request_seen.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            request_seen.append(buffer, static_cast<size_t>(n));
+        }
+        std::string response = HttpResponse::ok("local").to_string();
+        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        close(fd);
+    });
+
+    HttpClient client(endpoint);
+    REQUIRE(client.connect_to_server() == 0);
+    HttpRequest request;
+    request.create_get("/test");
+    HttpResponse response = client.send_request(request);
+    server.join();
+    close(listen_fd);
+
+    REQUIRE(request_seen.rfind("GET /test HTTP/1.1\r\n", 0) == 0);
+    REQUIRE(response.status_code == 200);
+    REQUIRE(response.body.rfind("local", 0) == 0);
+}
@@ -0,0 +1,150 @@
+// Copyright [2025] <Nicolas Selig>
+//
+//
+
+#include "../core/string_utils.hpp"
+#include "../core/websocket.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+
+/////////////////////////////////
+// WebSocket Handshake
+/////////////////////////////////
+
+TEST_CASE("WebSocket - Handshake", "[websocket]") {
+    SECTION("base64 padding") {
+        REQUIRE(base64_encode("") == "");
+        REQUIRE(base64_encode("f") == "Zg==");
+        REQUIRE(base64_encode("fo") == "Zm8=");
+        REQUIRE(base64_encode("foo") == "Zm9v");
+        REQUIRE(base64_encode("foobar") == "Zm9vYmFy");
+    }
+
+    SECTION("SHA-1 known answers") {
+        auto digest = sha1("abc");
+        std::string hex;
+        for (uint8_t byte : digest) {
+            static const char digits[] = "0123456789abcdef";
+            hex += digits[byte >> 4];
+            hex += digits[byte & 0x0F];
+        }
+        REQUIRE(hex == "a9993e364706816aba3e25717850c26c9cd0d89d");
+
+        // Two-block message: padding spills into a second chunk.
+        std::string long_input(100, 'a');
+        REQUIRE(base64_encode(std::string_view(
+                    reinterpret_cast<const char *>(sha1(long_input).data()),
+                    20)) == "f5AAJXpJGNcHJlXqRoVAzcvULgw=");
+    }
+
+    SECTION("Accept key from RFC 6455") {
+        REQUIRE(websocket_accept_key("dGhlIHNhbXBsZSBub25jZQ==") ==
+                "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    }
+
+    SECTION("Upgrade detection and response") {
+        HttpRequest request = HttpRequest::parse(
+            "GET /ws HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: keep-alive, Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n");
+        REQUIRE(is_websocket_upgrade(request));
+
+        HttpResponse response = HttpResponse::switching_protocol(
+            request.get_header("sec-websocket-key"));
+        std::string raw = response.to_string();
+        REQUIRE(raw.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+        REQUIRE(raw.find("Sec-WebSocket-Accept: "
+                         "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") !=
+                std::string::npos);
+        REQUIRE(raw.find("Content-Length") == std::string::npos);
+
+        request.headers.erase("sec-websocket-version");
+        REQUIRE_FALSE(is_websocket_upgrade(request));
+    }
+}
+
+/////////////////////////////////
+// WebSocket Framing
+/////////////////////////////////
+
+TEST_CASE("WebSocket - Framing", "[websocket]") {
+    WebSocketFrame frame;
+
+    SECTION("Round trip for every length encoding") {
+        for (size_t size : {0, 5, 125, 126, 1000, 65535, 65536, 200000}) {
+            std::string payload(size, 'a');
+            for (size_t i = 0; i < size; ++i) {
+                payload[i] = static_cast<char>(i * 7);
+            }
+
+            for (bool mask : {false, true}) {
+                std::string encoded = encode_websocket_frame(
+                    WebSocketOpcode::BINARY, payload, mask, 0x12345678);
+                REQUIRE(decode_websocket_frame(encoded, frame) ==
+                        encoded.size());
+                REQUIRE(frame.fin);
+                REQUIRE(frame.opcode == WebSocketOpcode::BINARY);
+                REQUIRE(frame.payload == payload);
+            }
+        }
+    }
+
+    SECTION("RFC 6455 masked example") {
+        std::string masked = "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58";
+        REQUIRE(decode_websocket_frame(masked, frame) == masked.size());
+        REQUIRE(frame.opcode == WebSocketOpcode::TEXT);
+        REQUIRE(frame.payload == "Hello");
+    }
+
+    SECTION("Incomplete frames need more bytes") {
+        std::string encoded = encode_websocket_frame(WebSocketOpcode::TEXT,
+                                                     std::string(300, 'x'));
+        for (size_t cut : {0, 1, 3, 100, 302}) {
+            REQUIRE(decode_websocket_frame(
+                        std::string_view(encoded).substr(0, cut), frame) == 0);
+        }
+    }
+
+    SECTION("Back to back frames") {
+        std::string stream =
+            encode_websocket_frame(WebSocketOpcode::TEXT, "one") +
+            encode_websocket_frame(WebSocketOpcode::PING, "two");
+        size_t first = decode_websocket_frame(stream, frame);
+        REQUIRE(frame.payload == "one");
+        REQUIRE(decode_websocket_frame(std::string_view(stream).substr(first),
+                                       frame) == stream.size() - first);
+        REQUIRE(frame.opcode == WebSocketOpcode::PING);
+        REQUIRE(frame.payload == "two");
+    }
+
+    SECTION("Close frames carry the status code") {
+        std::string close = encode_websocket_close(WS_CLOSE_GOING_AWAY, "bye");
+        REQUIRE(decode_websocket_frame(close, frame) == close.size());
+        REQUIRE(frame.opcode == WebSocketOpcode::CLOSE);
+        REQUIRE(frame.payload == std::string("\x03\xe9" "bye"));
+    }
+
+    SECTION("Protocol violations throw") {
+        using namespace std::string_view_literals;
+        // Reserved bit
+        REQUIRE_THROWS_AS(decode_websocket_frame("\xC1\x00"sv, frame),
+                          std::runtime_error);
+        // Reserved opcode
+        REQUIRE_THROWS_AS(decode_websocket_frame("\x83\x00"sv, frame),
+                          std::runtime_error);
+        // Fragmented ping
+        REQUIRE_THROWS_AS(decode_websocket_frame("\x09\x00"sv, frame),
+                          std::runtime_error);
+        // Control frame with a 16-bit length
+        REQUIRE_THROWS_AS(
+            decode_websocket_frame("\x89\x7e\x00\x80"sv, frame),
+            std::runtime_error);
+        // Unmasked, where a server requires a mask
+        REQUIRE(decode_websocket_frame("\x81\x00"sv, frame) == 2);
+        REQUIRE_THROWS_AS(decode_websocket_frame("\x81\x00"sv, frame, true),
+                          std::runtime_error);
+    }
+}